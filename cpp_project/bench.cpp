@@ -0,0 +1,632 @@
+// Benchmark suite for the C FFI surface, as C++ callers use it
+//
+// Every case calls the library directly (no Rust wrappers, no CString/Vec copies); timing,
+// allocation counting, JSON output and the --baseline comparison live in bench_harness.hpp.
+// With --baseline, e.g. the default build vs `make lto` / `make pgo`, each case gets a
+// speedup column and the geometric mean is printed at the end.
+//
+// Usage: cpp_bench [--filter SUBSTR] [--min-time SEC] [--quick] [--json FILE] [--baseline FILE]
+
+#include <memory>
+
+#include "bench_harness.hpp"
+
+namespace {
+
+using bench::Case;
+using bench::check;
+using bench::make_pattern;
+using bench::size_label;
+
+struct CodecInfo {
+    int id;
+    const char* name;
+    int (*compress_into)(const char*, size_t, char*, size_t, size_t*);
+    int (*decompress_into)(const char*, size_t, char*, size_t, size_t*);
+    CompressedData (*compress_alloc)(const char*, unsigned long);
+    DecompressedData (*decompress_alloc)(const char*, unsigned long);
+};
+
+const CodecInfo kCodecs[] = {
+    {CODEC_ZLIB, "zlib", compress_string_into, decompress_data_into, compress_string, decompress_data},
+    {CODEC_LZ4, "lz4", compress_string_lz4_into, decompress_data_lz4_into, compress_string_lz4, decompress_data_lz4},
+    {CODEC_ZSTD, "zstd", compress_string_zstd_into, decompress_data_zstd_into, compress_string_zstd, decompress_data_zstd},
+};
+
+// Run a whole input through a codec_stream, appending the output to out when it is given
+// (otherwise the output is only counted, as a streaming caller would write it away)
+size_t stream_all(int codec, int mode, const char* in, size_t in_len, std::vector<char>& chunk, std::vector<char>* out) {
+    codec_stream* s = stream_begin(codec, mode, codec_default_level(codec));
+    if (s == nullptr) {
+        std::cerr << "Error: stream_begin failed" << std::endl;
+        std::exit(1);
+    }
+    size_t offset = 0, total = 0;
+    int rc;
+    auto emit = [&](size_t produced) {
+        if (out != nullptr) {
+            out->insert(out->end(), chunk.data(), chunk.data() + produced);
+        }
+        total += produced;
+    };
+    do {
+        size_t consumed = 0, produced = 0;
+        rc = stream_update(s, in + offset, in_len - offset, &consumed, chunk.data(), chunk.size(), &produced);
+        offset += consumed;
+        emit(produced);
+    } while (rc == STREAM_OUTPUT_FULL || (rc == CODEC_OK && offset < in_len));
+    if (rc >= 0 && mode == STREAM_COMPRESS) {
+        do {
+            size_t produced = 0;
+            rc = stream_end(s, chunk.data(), chunk.size(), &produced);
+            emit(produced);
+        } while (rc == STREAM_OUTPUT_FULL);
+    }
+    stream_destroy(s);
+    if (rc < 0) {
+        std::cerr << "Error: stream " << (mode == STREAM_COMPRESS ? "compression" : "decompression")
+                  << " failed with code " << rc << std::endl;
+        std::exit(1);
+    }
+    return total;
+}
+
+// Buffers a case keeps alive for the lifetime of the run
+struct Fixture {
+    std::string input;
+    std::vector<char> compressed, frame, stream, container, out;
+    size_t compressed_len = 0, frame_len = 0, container_len = 0;
+};
+
+class Suite {
+public:
+    explicit Suite(bool quick) : quick_(quick) {}
+
+    std::vector<Case>& build() {
+        std::vector<size_t> sizes = {64, 1024, 16 * 1024, 256 * 1024};
+        if (!quick_) {
+            sizes.push_back(4 * 1024 * 1024);
+        }
+        const char* patterns[] = {"text", "json", "random", "repetitive"};
+        for (const char* pattern : patterns) {
+            for (size_t size : sizes) {
+                for (const CodecInfo& codec : kCodecs) {
+                    add_codec_cases(codec, pattern, size);
+                }
+                add_frame_cases(pattern, size);
+            }
+        }
+        add_container_cases();
+        add_parallel_tuning_cases();
+        add_record_cases();
+        add_batch_and_dict_cases();
+        add_header_cases();
+        add_varint_cases();
+        return cases_;
+    }
+
+private:
+    Fixture& fixture() {
+        fixtures_.emplace_back(new Fixture());
+        return *fixtures_.back();
+    }
+
+    void add(const std::string& group, const std::string& codec, const std::string& pattern, size_t size,
+             std::function<void()> op) {
+        cases_.push_back({group, codec, pattern, size, std::move(op)});
+    }
+
+    // One-shot, into, context, level and streaming calls for one codec and input
+    void add_codec_cases(const CodecInfo& codec, const char* pattern, size_t size) {
+        Fixture& f = fixture();
+        f.input = make_pattern(pattern, size, static_cast<uint32_t>(size) ^ codec.id);
+        f.compressed.resize(codec_compress_bound(codec.id, size));
+        check(codec.compress_into(f.input.data(), size, f.compressed.data(), f.compressed.size(), &f.compressed_len),
+              "compress_into");
+        f.out.resize(size + 1);
+        std::string n = codec.name;
+        int id = codec.id;
+
+        add("compress_alloc", n, pattern, size, [&f, &codec] {
+            CompressedData d = codec.compress_alloc(f.input.data(), f.input.size());
+            free_compressed_data(d);
+        });
+        add("decompress_alloc", n, pattern, size, [&f, &codec] {
+            DecompressedData d = codec.decompress_alloc(f.compressed.data(), f.compressed_len);
+            free_decompressed_data(d);
+        });
+        add("compress_into", n, pattern, size, [&f, &codec] {
+            size_t len;
+            check(codec.compress_into(f.input.data(), f.input.size(), f.compressed.data(), f.compressed.size(), &len),
+                  "compress_into");
+        });
+        add("decompress_into", n, pattern, size, [&f, &codec] {
+            size_t len;
+            check(codec.decompress_into(f.compressed.data(), f.compressed_len, f.out.data(), f.out.size(), &len),
+                  "decompress_into");
+        });
+        codec_ctx* ctx = codec_ctx_create(id);
+        contexts_.push_back(ctx);
+        add("ctx_compress", n, pattern, size, [&f, ctx] {
+            size_t len;
+            check(codec_ctx_compress(ctx, f.input.data(), f.input.size(), f.compressed.data(), f.compressed.size(), &len),
+                  "codec_ctx_compress");
+        });
+        add("ctx_decompress", n, pattern, size, [&f, ctx] {
+            size_t len;
+            check(codec_ctx_decompress(ctx, f.compressed.data(), f.compressed_len, f.out.data(), f.out.size(), &len),
+                  "codec_ctx_decompress");
+        });
+        // A slower, denser level than the default, through the one-shot level API
+        int level = id == CODEC_ZLIB ? 9 : id == CODEC_LZ4 ? 9 : 19;
+        if (size <= 256 * 1024) {
+            add("compress_level" + std::to_string(level), n, pattern, size, [&f, id, level] {
+                size_t len;
+                check(compress_string_level_into(id, level, f.input.data(), f.input.size(), f.compressed.data(),
+                                                 f.compressed.size(), &len),
+                      "compress_string_level_into");
+            });
+        }
+        std::vector<char>& chunk = stream_chunk_;
+        stream_all(id, STREAM_COMPRESS, f.input.data(), size, chunk, &f.stream);
+        add("stream_compress", n, pattern, size, [&f, &chunk, id] {
+            stream_all(id, STREAM_COMPRESS, f.input.data(), f.input.size(), chunk, nullptr);
+        });
+        add("stream_decompress", n, pattern, size, [&f, &chunk, id] {
+            stream_all(id, STREAM_DECOMPRESS, f.stream.data(), f.stream.size(), chunk, nullptr);
+        });
+    }
+
+    // Self-describing frames and automatic codec selection
+    void add_frame_cases(const char* pattern, size_t size) {
+        Fixture& f = fixture();
+        f.input = make_pattern(pattern, size, static_cast<uint32_t>(size) + 7);
+        f.frame.resize(frame_compress_bound(CODEC_AUTO, size));
+        check(compress_frame_into(CODEC_ZSTD, 3, FRAME_CHECKSUM, f.input.data(), size, f.frame.data(), f.frame.size(),
+                                  &f.frame_len),
+              "compress_frame_into");
+        f.out.resize(size + 1);
+        f.compressed.resize(f.frame.size());
+        add("frame_compress", "zstd", pattern, size, [&f] {
+            size_t len;
+            check(compress_frame_into(CODEC_ZSTD, 3, FRAME_CHECKSUM, f.input.data(), f.input.size(),
+                                      f.compressed.data(), f.compressed.size(), &len),
+                  "compress_frame_into");
+        });
+        add("frame_decompress", "zstd", pattern, size, [&f] {
+            size_t len;
+            check(decompress_auto_into(f.frame.data(), f.frame_len, f.out.data(), f.out.size(), &len),
+                  "decompress_auto_into");
+        });
+        if (size >= 1024 && size <= 256 * 1024) {
+            add("frame_compress_auto", "-", pattern, size, [&f] {
+                size_t len;
+                check(compress_frame_auto_into(200, FRAME_CHECKSUM, f.input.data(), f.input.size(),
+                                               f.compressed.data(), f.compressed.size(), &len),
+                      "compress_frame_auto_into");
+            });
+            add("codec_auto_select", "-", pattern, size, [&f] {
+                int codec, level;
+                check(codec_auto_select(f.input.data(), f.input.size(), 200, &codec, &level), "codec_auto_select");
+            });
+        }
+    }
+
+    // Block-parallel containers and range reads over them
+    void add_container_cases() {
+        size_t size = quick_ ? 1024 * 1024 : 16 * 1024 * 1024;
+        for (const CodecInfo& codec : kCodecs) {
+            Fixture& f = fixture();
+            f.input = make_pattern("json", size, 99);
+            f.container.resize(compress_parallel_bound(codec.id, size, 64 * 1024));
+            int id = codec.id;
+            check(compress_parallel_into(id, codec_default_level(id), 0, 64 * 1024, f.input.data(), size,
+                                         f.container.data(), f.container.size(), &f.container_len),
+                  "compress_parallel_into");
+            f.out.resize(size + 1);
+            f.compressed.resize(f.container.size());
+            add("parallel_compress", codec.name, "json", size, [&f, id] {
+                size_t len;
+                check(compress_parallel_into(id, codec_default_level(id), 0, 0, f.input.data(), f.input.size(),
+                                             f.compressed.data(), f.compressed.size(), &len),
+                      "compress_parallel_into");
+            });
+            add("parallel_decompress", codec.name, "json", size, [&f] {
+                size_t len;
+                check(decompress_parallel_into(0, f.container.data(), f.container_len, f.out.data(), f.out.size(), &len),
+                      "decompress_parallel_into");
+            });
+            range_reader* r = range_reader_open(f.container.data(), f.container_len);
+            readers_.push_back(r);
+            std::shared_ptr<size_t> offset = std::make_shared<size_t>(0);
+            const size_t len = 4096;
+            add("range_reader_read", codec.name, "json-4K-of-" + size_label(size), len, [&f, r, offset, len, size] {
+                size_t got;
+                *offset = (*offset + 7919 * 1031) % (size - len);
+                check(range_reader_read(r, *offset, len, f.out.data(), f.out.size(), &got), "range_reader_read");
+            });
+            add("read_range", codec.name, "json-4K-of-" + size_label(size), len, [&f, offset, len, size] {
+                size_t got;
+                *offset = (*offset + 7919 * 1031) % (size - len);
+                check(read_range(f.container.data(), f.container_len, *offset, len, f.out.data(), f.out.size(), &got),
+                      "read_range");
+            });
+        }
+    }
+
+    // Lazy record reads over varint-length-prefixed JSON messages: the first 100 records,
+    // every record, and decompressing the whole blob before walking the prefixes
+    // Block-size autotune sweep (make parallel-autotune) and the placement options, on all
+    // CPUs. "cache" is the size parallel_cache_block_size() derives for this machine
+    void add_parallel_tuning_cases() {
+        size_t size = quick_ ? 2 * 1024 * 1024 : 8 * 1024 * 1024;
+        size_t cache_block = parallel_cache_block_size();
+        std::vector<std::pair<std::string, size_t>> blocks;
+        for (size_t block = 64 * 1024; block <= 4 * 1024 * 1024; block *= 2) {
+            blocks.emplace_back("b" + size_label(block), block);
+        }
+        blocks.emplace_back("cache-b" + size_label(cache_block), cache_block);
+        for (const CodecInfo& codec : kCodecs) {
+            int id = codec.id, level = codec_default_level(id);
+            std::string input = make_pattern("logs", size, 5);
+            for (const auto& b : blocks) {
+                add_parallel_pair("parallel_blocks", codec.name, "logs-" + b.first, input, id, level, b.second, 0);
+            }
+            add_parallel_pair("parallel_placement", codec.name, "logs-shared", input, id, level, cache_block, 0);
+            add_parallel_pair("parallel_placement", codec.name, "logs-pinned-local", input, id, level, cache_block,
+                              PARALLEL_PIN_WORKERS | PARALLEL_LOCAL_BLOCKS);
+        }
+    }
+
+    // parallel_compress/decompress cases run with the given placement flags
+    void add_parallel_pair(const std::string& group, const char* codec, const std::string& pattern,
+                           const std::string& input, int id, int level, size_t block, int flags) {
+        Fixture& f = fixture();
+        f.input = input;
+        f.container.resize(compress_parallel_bound(id, input.size(), block));
+        check(compress_parallel_into(id, level, 0, block, f.input.data(), f.input.size(), f.container.data(),
+                                     f.container.size(), &f.container_len),
+              "compress_parallel_into");
+        f.compressed.resize(f.container.size());
+        f.out.resize(input.size());
+        add(group + "_compress", codec, pattern, input.size(), [&f, id, level, block, flags] {
+            size_t len;
+            check(set_parallel_options(flags, 0), "set_parallel_options");
+            check(compress_parallel_into(id, level, 0, block, f.input.data(), f.input.size(), f.compressed.data(),
+                                         f.compressed.size(), &len),
+                  "compress_parallel_into");
+            check(set_parallel_options(0, 0), "set_parallel_options");
+        });
+        add(group + "_decompress", codec, pattern, input.size(), [&f, flags] {
+            size_t len;
+            check(set_parallel_options(flags, 0), "set_parallel_options");
+            check(decompress_parallel_into(0, f.container.data(), f.container_len, f.out.data(), f.out.size(), &len),
+                  "decompress_parallel_into");
+            check(set_parallel_options(0, 0), "set_parallel_options");
+        });
+    }
+
+    void add_record_cases() {
+        size_t target = quick_ ? 1024 * 1024 : 8 * 1024 * 1024;
+        std::string records;
+        size_t first100 = 0;
+        char prefix[10];
+        for (uint32_t i = 0; records.size() < target; ++i) {
+            std::string m = make_pattern("json", 120 + (i * 37) % 200, 9000 + i);
+            records.append(prefix, static_cast<size_t>(encode_varint(m.size(), prefix)));
+            records += m;
+            if (i == 99) first100 = records.size();
+        }
+        std::string label = "json-records-" + size_label(target);
+        for (const CodecInfo& codec : kCodecs) {
+            Fixture& f = fixture();
+            f.input = records;
+            f.compressed.resize(codec_compress_bound(codec.id, records.size()));
+            check(codec.compress_into(records.data(), records.size(), f.compressed.data(), f.compressed.size(),
+                                      &f.compressed_len),
+                  "compress_into");
+            f.out.resize(records.size() + 1);
+            int id = codec.id;
+            add("record_reader_first100", codec.name, label, first100, [&f, id] {
+                record_reader* r = record_reader_open(id, f.compressed.data(), f.compressed_len, 0);
+                const char* record;
+                size_t len;
+                for (int i = 0; i < 100; ++i) {
+                    check(record_reader_next(r, &record, &len), "record_reader_next");
+                }
+                record_reader_close(r);
+            });
+            add("record_reader_scan", codec.name, label, records.size(), [&f, id] {
+                record_reader* r = record_reader_open(id, f.compressed.data(), f.compressed_len, 0);
+                const char* record;
+                size_t len;
+                int rc;
+                while ((rc = record_reader_next(r, &record, &len)) == CODEC_OK) {
+                }
+                check(rc == RECORD_END ? CODEC_OK : rc, "record_reader_next");
+                record_reader_close(r);
+            });
+            const CodecInfo* info = &codec;
+            add("record_decompress_walk", codec.name, label, records.size(), [&f, info] {
+                size_t out_len;
+                check(info->decompress_into(f.compressed.data(), f.compressed_len, f.out.data(), f.out.size(), &out_len),
+                      "decompress_into");
+                for (size_t pos = 0; pos < out_len;) {
+                    unsigned long len;
+                    size_t left = out_len - pos;
+                    pos += static_cast<size_t>(decode_varint(f.out.data() + pos, left < 10 ? static_cast<int32_t>(left) : 10,
+                                                             &len)) + len;
+                }
+            });
+        }
+    }
+
+    // Batched small messages, and dictionary compression of the same messages
+    void add_batch_and_dict_cases() {
+        std::vector<std::string>& msgs = messages_;
+        for (int i = 0; i < 256; ++i) {
+            msgs.push_back(make_pattern("json", 120 + (i * 37) % 200, 1000 + i));
+        }
+        for (const std::string& m : msgs) {
+            msg_ptrs_.push_back(m.data());
+            msg_lens_.push_back(m.size());
+        }
+        size_t total = 0;
+        for (size_t n : msg_lens_) {
+            total += n;
+        }
+
+        std::string samples;
+        std::vector<size_t> sample_lens;
+        for (int i = 0; i < 2000; ++i) {
+            std::string s = make_pattern("json", 120 + (i * 53) % 200, 5000 + i);
+            samples += s;
+            sample_lens.push_back(s.size());
+        }
+        dict_.resize(16 * 1024);
+        size_t dict_len = 0;
+        check(dict_train(samples.data(), sample_lens.data(), sample_lens.size(), dict_.data(), dict_.size(), &dict_len),
+              "dict_train");
+        dict_.resize(dict_len);
+        add("dict_train", "-", "json-2000-samples", samples.size(), [samples, sample_lens] {
+            std::vector<char> out(16 * 1024);
+            size_t len;
+            check(dict_train(samples.data(), sample_lens.data(), sample_lens.size(), out.data(), out.size(), &len),
+                  "dict_train");
+        });
+
+        for (const CodecInfo& codec : kCodecs) {
+            int id = codec.id;
+            codec_ctx* ctx = codec_ctx_create(id);
+            contexts_.push_back(ctx);
+            Fixture& f = fixture();
+            f.compressed.resize(codec_batch_compress_bound(id, msg_lens_.data(), msg_lens_.size()));
+            f.out.resize(total);
+            batch_offsets_.emplace_back(new std::vector<size_t>(msgs.size() + 1));
+            std::vector<size_t>& offsets = *batch_offsets_.back();
+            check(codec_batch_compress(ctx, msg_ptrs_.data(), msg_lens_.data(), msgs.size(), f.compressed.data(),
+                                       f.compressed.size(), offsets.data()),
+                  "codec_batch_compress");
+            // Inputs for the decompress side: pointers into the compressed arena
+            batch_inputs_.emplace_back(new std::vector<const char*>());
+            batch_input_lens_.emplace_back(new std::vector<size_t>());
+            std::vector<const char*>& in_ptrs = *batch_inputs_.back();
+            std::vector<size_t>& in_lens = *batch_input_lens_.back();
+            for (size_t i = 0; i < msgs.size(); ++i) {
+                in_ptrs.push_back(f.compressed.data() + offsets[i]);
+                in_lens.push_back(offsets[i + 1] - offsets[i]);
+            }
+            f.container.assign(f.compressed.begin(), f.compressed.end()); // arena the compress case overwrites
+            for (size_t i = 0; i < msgs.size(); ++i) {
+                in_ptrs[i] = f.container.data() + offsets[i];
+            }
+            std::string pattern = "json-256-msgs";
+            add("batch_compress", codec.name, pattern, total, [this, &f, ctx] {
+                std::vector<size_t>& offs = scratch_offsets_;
+                offs.resize(msg_ptrs_.size() + 1);
+                check(codec_batch_compress(ctx, msg_ptrs_.data(), msg_lens_.data(), msg_ptrs_.size(), f.compressed.data(),
+                                           f.compressed.size(), offs.data()),
+                      "codec_batch_compress");
+            });
+            add("batch_decompress", codec.name, pattern, total, [this, &f, ctx, &in_ptrs, &in_lens] {
+                std::vector<size_t>& offs = scratch_offsets_;
+                offs.resize(in_ptrs.size() + 1);
+                check(codec_batch_decompress(ctx, in_ptrs.data(), in_lens.data(), in_ptrs.size(), f.out.data(),
+                                             f.out.size(), offs.data()),
+                      "codec_batch_decompress");
+            });
+
+            // The same messages one at a time through a dictionary-primed context
+            codec_dict* dict = codec_dict_create(id, codec_default_level(id), dict_.data(), dict_.size());
+            dicts_.push_back(dict);
+            codec_ctx* dctx = codec_ctx_create(id);
+            contexts_.push_back(dctx);
+            check(codec_ctx_set_dict(dctx, dict), "codec_ctx_set_dict");
+            Fixture& d = fixture();
+            d.compressed.resize(codec_compress_bound(id, 4096));
+            d.out.resize(4096);
+            std::shared_ptr<size_t> next = std::make_shared<size_t>(0);
+            add("dict_compress", codec.name, "json-msg", 220, [this, &d, dctx, next] {
+                const std::string& m = messages_[(*next)++ % messages_.size()];
+                size_t len;
+                check(codec_ctx_compress(dctx, m.data(), m.size(), d.compressed.data(), d.compressed.size(), &len),
+                      "codec_ctx_compress with dictionary");
+            });
+            d.frame.resize(codec_compress_bound(id, 4096));
+            check(codec_ctx_compress(dctx, msgs[0].data(), msgs[0].size(), d.frame.data(), d.frame.size(), &d.frame_len),
+                  "codec_ctx_compress with dictionary");
+            add("dict_decompress", codec.name, "json-msg", msgs[0].size(), [&d, dctx] {
+                size_t len;
+                check(codec_ctx_decompress(dctx, d.frame.data(), d.frame_len, d.out.data(), d.out.size(), &len),
+                      "codec_ctx_decompress with dictionary");
+            });
+        }
+    }
+
+    // Header parsing, context setup and the allocator/arena hooks
+    void add_header_cases() {
+        Fixture& f = fixture();
+        f.input = make_pattern("json", 1024, 3);
+        f.compressed.resize(codec_compress_bound(CODEC_ZSTD, 1024));
+        check(compress_string_zstd_into(f.input.data(), 1024, f.compressed.data(), f.compressed.size(), &f.compressed_len),
+              "compress_string_zstd_into");
+        f.frame.resize(frame_compress_bound(CODEC_ZSTD, 1024));
+        check(compress_frame_into(CODEC_ZSTD, 3, FRAME_CHECKSUM, f.input.data(), 1024, f.frame.data(), f.frame.size(),
+                                  &f.frame_len),
+              "compress_frame_into");
+        add("decompressed_length", "-", "zstd-1K", f.compressed_len, [&f] {
+            size_t n;
+            check(decompressed_length(f.compressed.data(), f.compressed_len, &n), "decompressed_length");
+        });
+        add("frame_header_info", "-", "zstd-1K", f.frame_len, [&f] {
+            FrameInfo info;
+            check(frame_header_info(f.frame.data(), f.frame_len, &info), "frame_header_info");
+        });
+        add("frame_length", "-", "zstd-1K", f.frame_len, [&f] {
+            size_t n;
+            check(frame_length(f.frame.data(), f.frame_len, &n), "frame_length");
+        });
+        add("auto_decompressed_length", "-", "zstd-1K", f.frame_len, [&f] {
+            size_t n;
+            check(auto_decompressed_length(f.frame.data(), f.frame_len, &n), "auto_decompressed_length");
+        });
+        for (const CodecInfo& codec : kCodecs) {
+            int id = codec.id;
+            add("ctx_create_destroy", codec.name, "first-compress-1K", 1024, [&f, id] {
+                codec_ctx* ctx = codec_ctx_create(id);
+                size_t len;
+                std::vector<char>& out = f.out;
+                out.resize(codec_compress_bound(id, 1024));
+                check(codec_ctx_compress(ctx, f.input.data(), 1024, out.data(), out.size(), &len), "codec_ctx_compress");
+                codec_ctx_destroy(ctx);
+            });
+        }
+        codec_arena* arena = codec_arena_create(1 << 20);
+        arena_ = arena;
+        add("arena_alloc_free", "-", "256B", 256, [arena] {
+            void* p = codec_arena_alloc(arena, 256);
+            codec_arena_free(arena, p);
+        });
+        add("arena_compress", "zstd", "json-msg", 1024, [&f, arena] {
+            check(set_thread_allocator(codec_arena_alloc, codec_arena_free, arena), "set_thread_allocator");
+            CompressedData d = compress_string_zstd(f.input.data(), f.input.size());
+            free_compressed_data(d);
+            set_thread_allocator(nullptr, nullptr, nullptr);
+            codec_arena_reset(arena);
+        });
+    }
+
+    // LEB128 and Stream-VByte integer coding
+    void add_varint_cases() {
+        const size_t n = 4096;
+        std::mt19937_64 rng(42);
+        values64_.resize(n);
+        values32_.resize(n);
+        uint32_t sorted = 0;
+        for (size_t i = 0; i < n; ++i) {
+            values64_[i] = rng() >> (rng() % 64); // Mixed lengths, 1..10 bytes
+            sorted += static_cast<uint32_t>(rng() % 1000);
+            values32_[i] = sorted;
+        }
+        varint_buf_.resize(varint_array_bound(n));
+        varint_len_ = encode_varint_array(values64_.data(), n, varint_buf_.data());
+        svb_buf_.resize(streamvbyte_bound(n));
+        svb_len_ = streamvbyte_encode(values32_.data(), n, svb_buf_.data(), STREAMVBYTE_DELTA);
+        decoded64_.resize(n);
+        decoded32_.resize(n);
+
+        add("encode_varint", "-", "u64-mixed-x4096", n * 8, [this] {
+            char* out = varint_buf_.data();
+            for (uint64_t v : values64_) {
+                out += encode_varint(static_cast<unsigned long>(v), out);
+            }
+        });
+        add("decode_varint", "-", "u64-mixed-x4096", n * 8, [this] {
+            const char* in = varint_buf_.data();
+            const char* end = in + varint_len_;
+            unsigned long v;
+            while (in < end) {
+                in += decode_varint(in, static_cast<int32_t>(std::min<ptrdiff_t>(end - in, 10)), &v);
+            }
+        });
+        add("encode_varint_array", "-", "u64-mixed-x4096", n * 8, [this] {
+            encode_varint_array(values64_.data(), values64_.size(), varint_buf_.data());
+        });
+        add("encode_varint_array_scalar", "-", "u64-mixed-x4096", n * 8, [this] {
+            encode_varint_array_scalar(values64_.data(), values64_.size(), varint_buf_.data());
+        });
+        add("decode_varint_array", "-", "u64-mixed-x4096", n * 8, [this] {
+            size_t read;
+            check(decode_varint_array(varint_buf_.data(), varint_len_, decoded64_.data(), decoded64_.size(), &read),
+                  "decode_varint_array");
+        });
+        add("decode_varint_array_scalar", "-", "u64-mixed-x4096", n * 8, [this] {
+            size_t read;
+            check(decode_varint_array_scalar(varint_buf_.data(), varint_len_, decoded64_.data(), decoded64_.size(), &read),
+                  "decode_varint_array_scalar");
+        });
+        add("streamvbyte_encode", "-", "u32-sorted-delta-x4096", n * 4, [this] {
+            std::vector<char>& out = svb_scratch_;
+            out.resize(svb_buf_.size());
+            streamvbyte_encode(values32_.data(), values32_.size(), out.data(), STREAMVBYTE_DELTA);
+        });
+        add("streamvbyte_decode", "-", "u32-sorted-delta-x4096", n * 4, [this] {
+            size_t read;
+            check(streamvbyte_decode(svb_buf_.data(), svb_len_, decoded32_.data(), decoded32_.size(), STREAMVBYTE_DELTA,
+                                     &read),
+                  "streamvbyte_decode");
+        });
+        add("streamvbyte_decode_scalar", "-", "u32-sorted-delta-x4096", n * 4, [this] {
+            size_t read;
+            check(streamvbyte_decode_scalar(svb_buf_.data(), svb_len_, decoded32_.data(), decoded32_.size(),
+                                            STREAMVBYTE_DELTA, &read),
+                  "streamvbyte_decode_scalar");
+        });
+    }
+
+public:
+    ~Suite() {
+        for (codec_ctx* ctx : contexts_) codec_ctx_destroy(ctx);
+        for (range_reader* r : readers_) range_reader_close(r);
+        for (codec_dict* d : dicts_) codec_dict_destroy(d);
+        codec_arena_destroy(arena_);
+    }
+
+private:
+    bool quick_;
+    std::vector<Case> cases_;
+    std::vector<std::unique_ptr<Fixture>> fixtures_;
+    std::vector<codec_ctx*> contexts_;
+    std::vector<range_reader*> readers_;
+    std::vector<codec_dict*> dicts_;
+    codec_arena* arena_ = nullptr;
+    std::vector<char> stream_chunk_ = std::vector<char>(64 * 1024);
+
+    std::vector<std::string> messages_;
+    std::vector<const char*> msg_ptrs_;
+    std::vector<size_t> msg_lens_;
+    std::vector<std::unique_ptr<std::vector<size_t>>> batch_offsets_;
+    std::vector<std::unique_ptr<std::vector<const char*>>> batch_inputs_;
+    std::vector<std::unique_ptr<std::vector<size_t>>> batch_input_lens_;
+    std::vector<size_t> scratch_offsets_;
+    std::vector<char> dict_;
+
+    std::vector<uint64_t> values64_, decoded64_;
+    std::vector<uint32_t> values32_, decoded32_;
+    std::vector<char> varint_buf_, svb_buf_, svb_scratch_;
+    size_t varint_len_ = 0, svb_len_ = 0;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const char* quick_help = "Skip the 4 MiB inputs and use 1 MiB containers";
+    bench::Options opts;
+    int status = bench::parse_options(argc, argv, quick_help, opts);
+    if (status >= 0) {
+        return status;
+    }
+    bench::install_counting_allocator();
+    Suite suite(opts.quick);
+    return bench::run_cases(suite.build(), opts, "cpp_bench");
+}
@@ -0,0 +1,555 @@
+// Timing harness shared by cpp_bench (bench.cpp) and corpus_bench (corpus_bench.cpp)
+//
+// Each case reports ns/op, MB/s of input, p50/p99 latency and library allocations per op.
+// Latency samples are batches of back-to-back calls sized to ~20 us, so clock overhead
+// does not dominate the small cases; p50/p99 are over the per-op average of each batch.
+// Allocations are counted through set_allocator, so they cover everything the library
+// allocates except LZ4 frame streams (liblz4 allocates those itself).
+//
+// With --baseline, each case is also compared against an earlier --json run by p50
+// latency (less sensitive to a preempted batch than the mean), with the geometric mean
+// at the end. --max-regression turns that into a gate: cases whose p50 throughput or
+// compression ratio dropped by more than the limits are listed and the exit status is 3.
+
+#ifndef BENCH_HARNESS_HPP
+#define BENCH_HARNESS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../rust_ffi_example/rust_ffi_example.h"
+
+namespace bench {
+
+// Bumped whenever a make_pattern generator changes, so old baselines are not compared
+// against different input
+constexpr int kCorpusVersion = 1;
+
+// Allocation counting hooks, installed process-wide for the whole run
+inline std::atomic<uint64_t> g_allocs{0};
+inline std::atomic<uint64_t> g_alloc_bytes{0};
+
+inline void* counting_alloc(void*, size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size);
+}
+
+inline void counting_free(void*, void* ptr) {
+    std::free(ptr);
+}
+
+// Abort the run on an unexpected library error, so a broken case is never timed
+inline void check(int rc, const std::string& what) {
+    if (rc != CODEC_OK) {
+        std::cerr << "Error: " << what << " failed with code " << rc << std::endl;
+        std::exit(1);
+    }
+}
+
+inline std::string size_label(size_t n) {
+    if (n >= (1u << 20) && n % (1u << 20) == 0) return std::to_string(n >> 20) + "M";
+    if (n >= 1024 && n % 1024 == 0) return std::to_string(n >> 10) + "K";
+    return std::to_string(n);
+}
+
+struct Case {
+    std::string group;   // e.g. "compress_into"
+    std::string codec;   // "zlib", "lz4", "zstd" or "-" for codec-independent cases
+    std::string pattern; // corpus pattern, or a description of the input
+    size_t size;         // input bytes per op (for MB/s)
+    std::function<void()> op;
+    int threads = 0;     // worker threads, for cases that take a thread count
+    double ratio = 0;    // input / compressed size, for compression cases
+
+    std::string name() const {
+        std::string n = group;
+        if (codec != "-") {
+            n += "/" + codec;
+        }
+        n += "/" + pattern + "/" + size_label(size);
+        return threads > 0 ? n + "/t" + std::to_string(threads) : n;
+    }
+};
+
+struct Result {
+    std::string name;
+    const Case* c;
+    uint64_t iterations;
+    double ns_per_op, mb_per_s, p50_ns, p99_ns, allocs_per_op, alloc_bytes_per_op;
+};
+
+inline double now_ns() {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline Result measure(const Case& c, double min_time) {
+    // Warm up caches, thread-local contexts and lazily built tables
+    double warm_end = now_ns() + min_time * 1e9 / 10;
+    int warm = 0;
+    do {
+        c.op();
+    } while (++warm < 3 || now_ns() < warm_end);
+
+    double t0 = now_ns();
+    c.op();
+    double single = std::max(now_ns() - t0, 1.0);
+    uint64_t batch = std::max<uint64_t>(1, static_cast<uint64_t>(20000 / single));
+
+    std::vector<double> samples;
+    uint64_t ops = 0;
+    double total = 0;
+    uint64_t allocs0 = g_allocs.load(), bytes0 = g_alloc_bytes.load();
+    while ((total < min_time * 1e9 || samples.size() < 10) && samples.size() < 1000000) {
+        double start = now_ns();
+        for (uint64_t i = 0; i < batch; ++i) {
+            c.op();
+        }
+        double elapsed = now_ns() - start;
+        samples.push_back(elapsed / batch);
+        total += elapsed;
+        ops += batch;
+    }
+    uint64_t allocs = g_allocs.load() - allocs0, bytes = g_alloc_bytes.load() - bytes0;
+
+    std::sort(samples.begin(), samples.end());
+    auto pct = [&](double p) {
+        return samples[std::min(samples.size() - 1, static_cast<size_t>(p * (samples.size() - 1) + 0.5))];
+    };
+    Result r;
+    r.name = c.name();
+    r.c = &c;
+    r.iterations = ops;
+    r.ns_per_op = total / ops;
+    r.mb_per_s = c.size / r.ns_per_op * 1e3; // bytes/ns * 1e9 / 1e6
+    r.p50_ns = pct(0.50);
+    r.p99_ns = pct(0.99);
+    r.allocs_per_op = static_cast<double>(allocs) / ops;
+    r.alloc_bytes_per_op = static_cast<double>(bytes) / ops;
+    return r;
+}
+
+// Corpus
+//
+// Every pattern is generated from a seeded mt19937, whose output the standard fixes, and
+// draws its random numbers in statement order, so a (pattern, size, seed) triple is the
+// same input on every platform and compiler.
+
+inline void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+// Access-log lines with some application warnings mixed in
+inline void make_logs(std::mt19937& rng, size_t size, std::string& out) {
+    static const char* methods[] = {"GET", "GET", "GET", "POST", "PUT", "DELETE"};
+    static const char* paths[] = {"/api/v1/users", "/api/v1/orders", "/api/v1/search", "/api/v1/items",
+                                  "/static/app.js", "/static/style.css", "/health", "/login"};
+    static const int statuses[] = {200, 200, 200, 200, 200, 200, 304, 201, 404, 500};
+    static const char* agents[] = {
+        "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36",
+        "Mozilla/5.0 (Macintosh; Intel Mac OS X 14_1) AppleWebKit/605.1.15 (KHTML, like Gecko) Version/17.1",
+        "curl/8.4.0", "Go-http-client/1.1"};
+    unsigned long long t = 1700000000;
+    char line[512];
+    while (out.size() < size) {
+        t += rng() % 3;
+        if (rng() % 20 == 0) {
+            unsigned worker = rng() % 16, host = rng() % 8, delay = 50u << (rng() % 5), attempt = 1 + rng() % 3;
+            std::snprintf(line, sizeof(line), "%llu WARN worker-%u: retrying upstream db-%u after %u ms (attempt %u)\n",
+                          t, worker, host, delay, attempt);
+        } else {
+            unsigned a = rng() % 256, b = rng() % 256, c = rng() % 256;
+            const char* method = methods[rng() % 6];
+            const char* path = paths[rng() % 8];
+            unsigned id = rng() % 100000;
+            int status = statuses[rng() % 10];
+            unsigned bytes = rng() % 50000, ms = rng() % 5000;
+            const char* agent = agents[rng() % 4];
+            std::snprintf(line, sizeof(line), "10.%u.%u.%u - - [%llu] \"%s %s?id=%u HTTP/1.1\" %d %u %u.%03u \"%s\"\n",
+                          a, b, c, t, method, path, id, status, bytes, ms / 1000, ms % 1000, agent);
+        }
+        out += line;
+    }
+}
+
+// Length-delimited protobuf messages (writeDelimitedTo framing) of the shape
+//   message Event { uint64 id = 1; string name = 2; fixed64 time_ms = 3;
+//                   repeated uint32 tags = 4 [packed]; Point at = 5; bytes trace = 6;
+//                   sint32 delta = 7; }   message Point { float x = 1; float y = 2; }
+inline void make_protobuf(std::mt19937& rng, size_t size, std::string& out) {
+    static const char* names[] = {"checkout", "page_view", "add_to_cart", "search", "signup", "logout"};
+    uint64_t time_ms = 1700000000000ull;
+    for (uint64_t id = 1; out.size() < size; ++id) {
+        std::string msg;
+        put_varint(msg, 1 << 3 | 0);
+        put_varint(msg, id);
+        const char* name = names[rng() % 6];
+        put_varint(msg, 2 << 3 | 2);
+        put_varint(msg, std::strlen(name));
+        msg += name;
+        time_ms += rng() % 2000;
+        put_varint(msg, 3 << 3 | 1);
+        for (int i = 0; i < 8; ++i) msg.push_back(static_cast<char>(time_ms >> (8 * i)));
+        std::string tags;
+        unsigned tag_count = rng() % 6;
+        for (unsigned i = 0; i < tag_count; ++i) put_varint(tags, rng() % 1000);
+        put_varint(msg, 4 << 3 | 2);
+        put_varint(msg, tags.size());
+        msg += tags;
+        float xy[2] = {static_cast<float>(rng() % 36000) / 100.0f, static_cast<float>(rng() % 18000) / 100.0f};
+        put_varint(msg, 5 << 3 | 2);
+        put_varint(msg, 10);
+        for (int f = 0; f < 2; ++f) {
+            uint32_t bits;
+            std::memcpy(&bits, &xy[f], 4);
+            put_varint(msg, static_cast<uint64_t>(f + 1) << 3 | 5);
+            for (int i = 0; i < 4; ++i) msg.push_back(static_cast<char>(bits >> (8 * i)));
+        }
+        put_varint(msg, 6 << 3 | 2);
+        put_varint(msg, 16);
+        for (int i = 0; i < 16; ++i) msg.push_back(static_cast<char>(rng()));
+        int32_t delta = static_cast<int32_t>(rng() % 2001) - 1000;
+        put_varint(msg, 7 << 3 | 0);
+        put_varint(msg, static_cast<uint32_t>((delta << 1) ^ (delta >> 31)));
+        put_varint(out, msg.size());
+        out += msg;
+    }
+}
+
+// C-like source: commented functions with loops, branches and calls
+inline void make_code(std::mt19937& rng, size_t size, std::string& out) {
+    static const char* verbs[] = {"parse", "encode", "flush", "reset", "update", "find", "copy", "check"};
+    static const char* nouns[] = {"buffer", "header", "entry", "stream", "block", "table", "frame", "index"};
+    static const char* types[] = {"size_t", "int", "uint32_t", "uint64_t", "const char *"};
+    for (unsigned n = 0; out.size() < size; ++n) {
+        std::string verb = verbs[rng() % 8], noun = nouns[rng() % 8], other = nouns[rng() % 8];
+        std::string type = types[rng() % 5];
+        unsigned limit = 1 + rng() % 64, shift = rng() % 16;
+        out += "// " + verb + " the " + noun + " of an " + other + ", returning -1 on failure\n";
+        out += "static int " + verb + "_" + noun + "_" + std::to_string(n) + "(struct " + other + " *" + other[0] +
+               ", " + type + " len) {\n";
+        out += std::string("    if (") + other[0] + " == NULL || len > " + std::to_string(limit * 1024) + ") {\n";
+        out += "        return -1;\n    }\n";
+        out += "    for (size_t i = 0; i < (size_t)len; i++) {\n";
+        if (rng() % 2) {
+            out += std::string("        ") + other[0] + "->" + noun + "s[i] = " + verb + "_one(" + other[0] + "->" +
+                   noun + "s[i], " + std::to_string(shift) + ");\n";
+        } else {
+            out += std::string("        if (") + other[0] + "->" + noun + "s[i] & (1u << " + std::to_string(shift) +
+                   ")) {\n            " + other[0] + "->count++;\n        }\n";
+        }
+        out += "    }\n    return 0;\n}\n\n";
+    }
+}
+
+inline std::string make_pattern(const std::string& pattern, size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::string out;
+    out.reserve(size + 512);
+    if (pattern == "random") {
+        while (out.size() < size) {
+            out.push_back(static_cast<char>(rng()));
+        }
+    } else if (pattern == "repetitive") {
+        while (out.size() < size) {
+            out += "AAAAAAAAAABBBBBBBBBB0123456789";
+        }
+    } else if (pattern == "json") {
+        static const char* events[] = {"click", "view", "purchase", "scroll", "login"};
+        for (uint32_t i = 0; out.size() < size; ++i) {
+            uint32_t user = rng() % 5000;
+            const char* event = events[rng() % 5];
+            uint32_t item = rng() % 300;
+            bool ok = rng() % 10 != 0;
+            out += "{\"id\":" + std::to_string(i) + ",\"user\":" + std::to_string(user) + ",\"event\":\"" + event +
+                   "\",\"path\":\"/item/" + std::to_string(item) + "\",\"ok\":" + (ok ? "true" : "false") + "}\n";
+        }
+    } else if (pattern == "logs") {
+        make_logs(rng, size, out);
+    } else if (pattern == "protobuf") {
+        make_protobuf(rng, size, out);
+    } else if (pattern == "code") {
+        make_code(rng, size, out);
+    } else { // text
+        static const char* words[] = {"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+                                      "compression", "library", "buffer", "stream", "context", "frame",
+                                      "of", "and", "to", "in", "is", "for"};
+        while (out.size() < size) {
+            out += words[rng() % 20];
+            out += rng() % 12 ? " " : ".\n";
+        }
+    }
+    out.resize(size);
+    return out;
+}
+
+// Results
+
+inline std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+inline void write_json(std::ostream& os, const std::vector<Result>& results, double min_time, const char* suite) {
+    std::time_t t = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&t));
+    os << "{\n  \"context\": {\n"
+       << "    \"date\": \"" << date << "\",\n"
+       << "    \"suite\": \"" << suite << "\",\n"
+       << "    \"corpus_version\": " << kCorpusVersion << ",\n"
+       << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+       << "    \"min_time_s\": " << min_time << ",\n"
+       << "    \"varint_array_kernel\": \"" << varint_array_kernel() << "\",\n"
+       << "    \"streamvbyte_kernel\": \"" << streamvbyte_kernel() << "\"\n"
+       << "  },\n  \"benchmarks\": [\n";
+    os << std::setprecision(6);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        os << "    {\"name\": \"" << json_escape(r.name) << "\", \"group\": \"" << r.c->group << "\", \"codec\": \""
+           << r.c->codec << "\", \"pattern\": \"" << json_escape(r.c->pattern) << "\", \"size\": " << r.c->size
+           << ", \"threads\": " << r.c->threads << ", \"iterations\": " << r.iterations
+           << ", \"ns_per_op\": " << r.ns_per_op << ", \"mb_per_s\": " << r.mb_per_s << ", \"p50_ns\": " << r.p50_ns
+           << ", \"p99_ns\": " << r.p99_ns << ", \"allocs_per_op\": " << r.allocs_per_op
+           << ", \"alloc_bytes_per_op\": " << r.alloc_bytes_per_op << ", \"ratio\": " << r.c->ratio << "}"
+           << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+struct BaselineCase {
+    double ns_per_op = 0, p50_ns = 0, ratio = 0;
+};
+
+struct Baseline {
+    int corpus_version = 0; // 0 for files written before the field existed
+    std::map<std::string, BaselineCase> cases;
+};
+
+// Reads a write_json file back (one benchmark object per line)
+inline bool load_baseline(const std::string& path, Baseline& baseline) {
+    std::ifstream in(path);
+    if (!in) return false;
+    const std::string name_key = "{\"name\": \"", version_key = "\"corpus_version\": ";
+    auto number = [](const std::string& line, const char* key) {
+        size_t at = line.find(key);
+        return at == std::string::npos ? 0.0 : std::atof(line.c_str() + at + std::strlen(key));
+    };
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t at = line.find(name_key);
+        if (at == std::string::npos) {
+            if (line.find(version_key) != std::string::npos) {
+                baseline.corpus_version = static_cast<int>(number(line, version_key.c_str()));
+            }
+            continue;
+        }
+        std::string name;
+        for (size_t i = at + name_key.size(); i < line.size() && line[i] != '"'; ++i) {
+            if (line[i] == '\\' && i + 1 < line.size()) ++i;
+            name += line[i];
+        }
+        BaselineCase& c = baseline.cases[name];
+        c.ns_per_op = number(line, "\"ns_per_op\": ");
+        c.p50_ns = number(line, "\"p50_ns\": ");
+        c.ratio = number(line, "\"ratio\": ");
+    }
+    return true;
+}
+
+// Command line
+
+struct Options {
+    std::string filter, json_path, baseline_path;
+    double min_time = 0.1;
+    double max_regression = -1;      // percent; < 0 reports without gating
+    double max_ratio_regression = 1; // percent
+    bool quick = false, list = false;
+    Baseline baseline;
+};
+
+inline void print_usage(const char* program, const char* quick_help) {
+    std::cerr << "Usage: " << program << " [--filter SUBSTR] [--min-time SEC] [--quick] [--json FILE]" << std::endl;
+    std::cerr << "       [--baseline FILE [--max-regression PCT] [--max-ratio-regression PCT]]" << std::endl;
+    std::cerr << "  --filter SUBSTR  Only run cases whose name contains SUBSTR (e.g. zstd/json)" << std::endl;
+    std::cerr << "  --min-time SEC   Measuring time per case (default 0.1)" << std::endl;
+    std::cerr << "  --quick          " << quick_help << std::endl;
+    std::cerr << "  --json FILE      Also write the results as JSON ('-' for stdout)" << std::endl;
+    std::cerr << "  --baseline FILE  Compare p50 latency against an earlier --json run (speedup column)" << std::endl;
+    std::cerr << "  --max-regression PCT" << std::endl;
+    std::cerr << "                   Exit with status 3 if a case's p50 throughput fell by more than PCT" << std::endl;
+    std::cerr << "  --max-ratio-regression PCT" << std::endl;
+    std::cerr << "                   ... or its compression ratio by more than PCT (default 1)" << std::endl;
+    std::cerr << "  --list           Print the case names and exit" << std::endl;
+}
+
+// Parses argv into opts and loads the baseline. Returns -1 to go on, else the exit status
+inline int parse_options(int argc, char* argv[], const char* quick_help, Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--filter" && has_value) {
+            opts.filter = argv[++i];
+        } else if (arg == "--min-time" && has_value) {
+            opts.min_time = std::atof(argv[++i]);
+            if (!(opts.min_time > 0)) {
+                std::cerr << "Error: Invalid --min-time '" << argv[i] << "'." << std::endl;
+                return 1;
+            }
+        } else if ((arg == "--max-regression" || arg == "--max-ratio-regression") && has_value) {
+            char* end = nullptr;
+            double pct = std::strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || !(pct >= 0)) {
+                std::cerr << "Error: Invalid " << arg << " '" << argv[i] << "'." << std::endl;
+                return 1;
+            }
+            (arg == "--max-regression" ? opts.max_regression : opts.max_ratio_regression) = pct;
+        } else if (arg == "--json" && has_value) {
+            opts.json_path = argv[++i];
+        } else if (arg == "--baseline" && has_value) {
+            opts.baseline_path = argv[++i];
+        } else if (arg == "--quick") {
+            opts.quick = true;
+        } else if (arg == "--list") {
+            opts.list = true;
+        } else {
+            print_usage(argv[0], quick_help);
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+    if (opts.max_regression >= 0 && opts.baseline_path.empty()) {
+        std::cerr << "Error: --max-regression needs --baseline." << std::endl;
+        return 1;
+    }
+    if (!opts.baseline_path.empty()) {
+        if (!load_baseline(opts.baseline_path, opts.baseline)) {
+            std::cerr << "Error: Failed to read '" << opts.baseline_path << "'." << std::endl;
+            return 1;
+        }
+        if (opts.baseline.corpus_version != 0 && opts.baseline.corpus_version != kCorpusVersion) {
+            std::cerr << "Error: '" << opts.baseline_path << "' was recorded on corpus version "
+                      << opts.baseline.corpus_version << ", this build generates version " << kCorpusVersion
+                      << "; record a new baseline." << std::endl;
+            return 1;
+        }
+    }
+    return -1;
+}
+
+// Installs the counting allocator; call it before creating contexts for the cases
+inline void install_counting_allocator() {
+    check(set_allocator(counting_alloc, counting_free, nullptr), "set_allocator");
+}
+
+// Runs (or lists) the cases matching the filter, prints the table, the baseline
+// comparison and any regressions, and writes the JSON. Returns the exit status
+inline int run_cases(const std::vector<Case>& cases, const Options& opts, const char* suite) {
+    std::vector<Result> results;
+    double log_speedup = 0;
+    int compared = 0;
+    std::vector<std::string> regressions;
+    const bool has_baseline = !opts.baseline.cases.empty();
+    std::ostream& table = opts.json_path == "-" ? std::cerr : std::cout;
+    if (!opts.list) {
+        table << std::left << std::setw(52) << "case" << std::right << std::setw(12) << "ns/op" << std::setw(10)
+              << "MB/s" << std::setw(12) << "p50 ns" << std::setw(12) << "p99 ns" << std::setw(10) << "allocs"
+              << (has_baseline ? "   vs base" : "") << std::endl;
+    }
+    for (const Case& c : cases) {
+        std::string name = c.name();
+        if (!opts.filter.empty() && name.find(opts.filter) == std::string::npos) {
+            continue;
+        }
+        if (opts.list) {
+            std::cout << name << std::endl;
+            continue;
+        }
+        Result r = measure(c, opts.min_time);
+        table << std::left << std::setw(52) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << r.ns_per_op << std::setw(10) << std::setprecision(0) << r.mb_per_s
+              << std::setw(12) << std::setprecision(1) << r.p50_ns << std::setw(12) << r.p99_ns << std::setw(10)
+              << std::setprecision(2) << r.allocs_per_op;
+        auto base = opts.baseline.cases.find(name);
+        if (base != opts.baseline.cases.end()) {
+            const BaselineCase& b = base->second;
+            // Files from before p50 was compared only have a meaningful ns/op for old runs
+            double speedup = b.p50_ns > 0 && r.p50_ns > 0 ? b.p50_ns / r.p50_ns
+                             : b.ns_per_op > 0         ? b.ns_per_op / r.ns_per_op
+                                                       : 0;
+            if (speedup > 0) {
+                table << std::setw(11) << speedup << "x";
+                log_speedup += std::log(speedup);
+                ++compared;
+            }
+            std::ostringstream why;
+            why << std::fixed << std::setprecision(1);
+            if (opts.max_regression >= 0 && speedup > 0 && (1 - speedup) * 100 > opts.max_regression) {
+                why << "throughput " << (speedup - 1) * 100 << "%";
+            } else if (opts.max_regression >= 0 && b.ratio > 0 && c.ratio > 0 &&
+                       (1 - c.ratio / b.ratio) * 100 > opts.max_ratio_regression) {
+                why << std::setprecision(3) << "ratio " << b.ratio << " -> " << c.ratio;
+            }
+            if (!why.str().empty()) {
+                regressions.push_back(name + ": " + why.str());
+            }
+        }
+        table << std::endl;
+        results.push_back(r);
+    }
+    if (compared > 0) {
+        table << "geomean speedup vs " << opts.baseline_path << " over " << compared << " cases: " << std::fixed
+              << std::setprecision(3) << std::exp(log_speedup / compared) << "x" << std::endl;
+    }
+    if (!opts.list && !opts.json_path.empty()) {
+        if (opts.json_path == "-") {
+            write_json(std::cout, results, opts.min_time, suite);
+        } else {
+            std::ofstream out(opts.json_path);
+            write_json(out, results, opts.min_time, suite);
+            if (!out) {
+                std::cerr << "Error: Failed to write '" << opts.json_path << "'." << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (opts.max_regression >= 0) {
+        for (const std::string& r : regressions) {
+            table << "REGRESSION " << r << std::endl;
+        }
+        table << std::setprecision(1) << regressions.size() << " regression(s) beyond " << opts.max_regression << "% throughput / "
+              << opts.max_ratio_regression << "% ratio vs " << opts.baseline_path << std::endl;
+        if (!regressions.empty()) {
+            return 3;
+        }
+    }
+    return 0;
+}
+
+} // namespace bench
+
+#endif // BENCH_HARNESS_HPP
@@ -0,0 +1,157 @@
+// Fixed-corpus benchmark for regression gating
+//
+// Runs every codec over a deterministic corpus of realistic inputs (access logs, JSON
+// events, length-delimited protobufs, C-like source and incompressible bytes) at several
+// sizes, plus the block-parallel engine at several thread counts. Compression cases also
+// record the compression ratio, so a --baseline comparison catches ratio regressions as
+// well as throughput ones.
+//
+// Only the long-standing codec_ctx_* and *_parallel_into entry points are used, so the
+// same harness builds against an older library to produce the baseline (see `make
+// corpus-check` and .github/workflows/perf_gate.yml).
+//
+// Usage: corpus_bench [--filter SUBSTR] [--min-time SEC] [--quick] [--json FILE]
+//                     [--baseline FILE [--max-regression PCT] [--max-ratio-regression PCT]]
+
+#include <memory>
+
+#include "bench_harness.hpp"
+
+namespace {
+
+using bench::Case;
+using bench::check;
+
+struct CodecInfo {
+    int id;
+    const char* name;
+};
+
+const CodecInfo kCodecs[] = {{CODEC_ZLIB, "zlib"}, {CODEC_LZ4, "lz4"}, {CODEC_ZSTD, "zstd"}};
+const char* const kCorpora[] = {"logs", "json", "protobuf", "code", "random"};
+const size_t kParallelBlock = 256 * 1024;
+const int kThreadCounts[] = {1, 2, 4};
+
+struct Fixture {
+    std::string input;
+    std::vector<char> compressed, out;
+    size_t compressed_len = 0;
+};
+
+class CorpusSuite {
+public:
+    explicit CorpusSuite(bool quick) : quick_(quick) {}
+
+    std::vector<Case>& build() {
+        std::vector<size_t> sizes = {4 * 1024, 64 * 1024, 1024 * 1024};
+        if (!quick_) {
+            sizes.push_back(8 * 1024 * 1024);
+        }
+        size_t parallel_size = quick_ ? 2 * 1024 * 1024 : 8 * 1024 * 1024;
+        for (const char* corpus : kCorpora) {
+            // Each size is a prefix of one generated input, so sizes differ only in length
+            std::string input = bench::make_pattern(corpus, std::max(sizes.back(), parallel_size), 2024);
+            for (const CodecInfo& codec : kCodecs) {
+                for (size_t size : sizes) {
+                    add_codec_cases(codec, corpus, input.substr(0, size));
+                }
+                add_parallel_cases(codec, corpus, input.substr(0, parallel_size));
+            }
+        }
+        return cases_;
+    }
+
+    ~CorpusSuite() {
+        for (codec_ctx* ctx : contexts_) codec_ctx_destroy(ctx);
+    }
+
+private:
+    Fixture& fixture() {
+        fixtures_.emplace_back(new Fixture());
+        return *fixtures_.back();
+    }
+
+    Case& add(const std::string& group, const char* codec, const std::string& pattern, size_t size,
+              std::function<void()> op) {
+        cases_.push_back({group, codec, pattern, size, std::move(op)});
+        return cases_.back();
+    }
+
+    static double ratio(const Fixture& f) {
+        return f.compressed_len > 0 ? static_cast<double>(f.input.size()) / f.compressed_len : 0;
+    }
+
+    void add_codec_cases(const CodecInfo& codec, const char* corpus, std::string input) {
+        Fixture& f = fixture();
+        f.input = std::move(input);
+        codec_ctx* ctx = codec_ctx_create(codec.id);
+        if (ctx == nullptr) {
+            check(CODEC_ERR_ALLOC, "codec_ctx_create");
+        }
+        contexts_.push_back(ctx);
+        size_t size = f.input.size();
+        f.compressed.resize(codec_compress_bound(codec.id, size));
+        f.out.resize(size);
+        check(codec_ctx_compress(ctx, f.input.data(), size, f.compressed.data(), f.compressed.size(), &f.compressed_len),
+              "codec_ctx_compress");
+
+        add("compress", codec.name, corpus, size, [&f, ctx] {
+            size_t len;
+            check(codec_ctx_compress(ctx, f.input.data(), f.input.size(), f.compressed.data(), f.compressed.size(), &len),
+                  "codec_ctx_compress");
+        }).ratio = ratio(f);
+        add("decompress", codec.name, corpus, size, [&f, ctx] {
+            size_t len;
+            check(codec_ctx_decompress(ctx, f.compressed.data(), f.compressed_len, f.out.data(), f.out.size(), &len),
+                  "codec_ctx_decompress");
+        });
+    }
+
+    void add_parallel_cases(const CodecInfo& codec, const char* corpus, std::string input) {
+        Fixture& f = fixture();
+        f.input = std::move(input);
+        size_t size = f.input.size();
+        int level = codec_default_level(codec.id);
+        f.compressed.resize(compress_parallel_bound(codec.id, size, kParallelBlock));
+        f.out.resize(size);
+        check(compress_parallel_into(codec.id, level, 1, kParallelBlock, f.input.data(), size, f.compressed.data(),
+                                     f.compressed.size(), &f.compressed_len),
+              "compress_parallel_into");
+
+        for (int threads : kThreadCounts) {
+            Case& c = add("parallel_compress", codec.name, corpus, size, [&f, codec, level, threads] {
+                size_t len;
+                check(compress_parallel_into(codec.id, level, threads, kParallelBlock, f.input.data(), f.input.size(),
+                                             f.compressed.data(), f.compressed.size(), &len),
+                      "compress_parallel_into");
+            });
+            c.threads = threads;
+            c.ratio = ratio(f);
+            add("parallel_decompress", codec.name, corpus, size, [&f, threads] {
+                size_t len;
+                check(decompress_parallel_into(threads, f.compressed.data(), f.compressed_len, f.out.data(),
+                                               f.out.size(), &len),
+                      "decompress_parallel_into");
+            }).threads = threads;
+        }
+    }
+
+    bool quick_;
+    std::vector<Case> cases_;
+    std::vector<std::unique_ptr<Fixture>> fixtures_;
+    std::vector<codec_ctx*> contexts_;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const char* quick_help = "Drop the 8 MiB inputs and run the parallel cases on 2 MiB";
+    bench::Options opts;
+    int status = bench::parse_options(argc, argv, quick_help, opts);
+    if (status >= 0) {
+        return status;
+    }
+    bench::install_counting_allocator();
+    CorpusSuite suite(opts.quick);
+    return bench::run_cases(suite.build(), opts, "corpus_bench");
+}
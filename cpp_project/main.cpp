@@ -6,27 +6,1328 @@
 #include <cstring> // For strcmp, strlen
 #include <algorithm> // For std::min
 #include <sstream> // Added for std::stringstream
+#include <cstdint> // For INT32_MIN, UINT32_MAX
+#include <cstdlib> // For strtoull
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 // For isatty and fileno
 #include <unistd.h> // For isatty (on POSIX systems like Linux)
 #include <cstdio>   // For fileno (on POSIX systems like Linux)
+#include <cerrno>
+#include <fcntl.h>    // For open
+#include <sys/mman.h> // For mmap/madvise
+#include <sys/stat.h> // For fstat
+#include <sys/socket.h>
+#include <sys/un.h>    // For sockaddr_un (serve --socket)
+#include <csignal>
 
 
 // Adjust the path based on the final location of the header file
-#include "../rust_ffi_example/rust_ffi_example.h"
+#include "../rust_ffi_example/rust_ffi_example.hpp"
+
+// --codec auto without --min-speed keeps the best ratio among settings compressing at
+// least this many MB/s, which leaves out the slow zstd levels; --min-speed 0 allows them
+const double kAutoMinSpeed = 100;
 
 void print_usage(const char* program_name) {
     std::cerr << "Usage:" << std::endl;
-    std::cerr << "  " << program_name << " compress [text]              - Compress text (or from stdin)" << std::endl;
-    std::cerr << "  " << program_name << " decompress <file>            - Decompress binary file" << std::endl;
+    std::cerr << "  " << program_name << " compress [options] [text]    - Compress text (or from stdin)" << std::endl;
+    std::cerr << "  " << program_name << " decompress [--codec C] [-j N] [--dict F] <file> - Decompress binary file" << std::endl;
+    std::cerr << "  " << program_name << " decompress --pipeline [-j N] [-o F] [file] - Decompress a frame sequence" << std::endl;
+    std::cerr << "  " << program_name << " decompress --stream [--codec C] - Decompress a stream from stdin to stdout" << std::endl;
     std::cerr << "  " << program_name << " encode-varint <number>         - Encode a u64 number into varint format (output as hex)" << std::endl;
     std::cerr << "  " << program_name << " decode-varint <hex_bytes>      - Decode varint hex bytes into a u64 number" << std::endl;
+    std::cerr << "  " << program_name << " encode-varint --format streamvbyte [--delta] [--zigzag] <n...>" << std::endl;
+    std::cerr << "                                         - Encode u32 values (i32 with --zigzag) as Stream-VByte hex" << std::endl;
+    std::cerr << "  " << program_name << " decode-varint --format streamvbyte --count N [--delta] [--zigzag] <hex>" << std::endl;
+    std::cerr << "  " << program_name << " compress-batch [--codec C|auto] [--level N] [-j N] [--suffix S] <files...>" << std::endl;
+    std::cerr << "                                         - Compress each file to FILE.rff (a frame per --block-size" << std::endl;
+    std::cerr << "                                           chunk) on a pool of workers; --files-from F reads the list" << std::endl;
+    std::cerr << "  " << program_name << " decompress-batch [-j N] [--suffix S] <files...>" << std::endl;
+    std::cerr << "                                         - Decompress each frame sequence, frame or -j container," << std::endl;
+    std::cerr << "                                           writing FILE.rff to FILE (other names to NAME.out)" << std::endl;
+    std::cerr << "  " << program_name << " extract --offset N --len N [-o F] <file> - Decode one byte range of a -j container" << std::endl;
+    std::cerr << "  " << program_name << " train-dict [--max-size N] [-o dict.bin] [samples...]" << std::endl;
+    std::cerr << "                                         - Train a dictionary (one sample per file, or per stdin line)" << std::endl;
+    std::cerr << "  " << program_name << " serve [--socket PATH] [--max-message N] [--min-speed MBPS]" << std::endl;
+    std::cerr << "                                         - Answer length-prefixed compress/decompress/varint requests" << std::endl;
+    std::cerr << "                                           on stdin/stdout or a Unix socket with warm contexts" << std::endl;
+    std::cerr << "  " << program_name << " stats [--format text|prometheus] [--stats-file F] <command> [args...]" << std::endl;
+    std::cerr << "                                         - Run a command, then dump the library's call, byte, latency" << std::endl;
+    std::cerr << "                                           and error counters (to stderr or F)" << std::endl;
+    std::cerr << "\nCompress options:" << std::endl;
+    std::cerr << "  --codec zlib|lz4|zstd   Codec to use (default: zlib)" << std::endl;
+    std::cerr << "  --codec auto            Pick LZ4, a zstd level or stored (uncompressed) per input from a" << std::endl;
+    std::cerr << "                          sample; the choice is recorded in the frame header" << std::endl;
+    std::cerr << "  --min-speed MBPS        With --codec auto: best ratio among settings compressing at least" << std::endl;
+    std::cerr << "                          MBPS MB/s on this machine (default 100; 0 = best ratio at any speed)" << std::endl;
+    std::cerr << "  --level N               Level: zlib -1..9, lz4 <0 = acceleration, 3..12 = LZ4HC," << std::endl;
+    std::cerr << "                          zstd negative (fast) .. 19+ (small)" << std::endl;
+    std::cerr << "  -j N                    Compress 1 MiB blocks on N threads (0 = all CPUs) into a" << std::endl;
+    std::cerr << "                          block-parallel container; decompress -j N reads it in parallel" << std::endl;
+    std::cerr << "  --block-size N          Block size of the -j container (default 1M; K/M/G suffixes)." << std::endl;
+    std::cerr << "                          Smaller blocks make extract cheaper; implies -j 0" << std::endl;
+    std::cerr << "  --pipeline              Overlap reading, compression on -j workers (default: all CPUs)" << std::endl;
+    std::cerr << "                          and writing; writes one frame per --block-size chunk (default 1M)." << std::endl;
+    std::cerr << "                          decompress --pipeline reads such frame sequences the same way" << std::endl;
+    std::cerr << "  --stream                Stream stdin to stdout in constant memory (native codec" << std::endl;
+    std::cerr << "                          frame, not readable by the non-stream decompress)" << std::endl;
+    std::cerr << "  --dict FILE             Compress with a trained dictionary (decompress needs the same one)" << std::endl;
+    std::cerr << "  --no-frame              Write the bare [length][payload] format without the frame header" << std::endl;
+    std::cerr << "                          (codec ID + CRC32C); decompress then needs --codec" << std::endl;
+    std::cerr << "\nDecompress options:" << std::endl;
+    std::cerr << "  --max-output N          Refuse inputs whose headers declare more than N decoded bytes" << std::endl;
+    std::cerr << "                          (default 64G; decompress and decompress-batch)" << std::endl;
+    std::cerr << "\nFile options (compress and decompress):" << std::endl;
+    std::cerr << "  -i FILE                 Read the input from FILE (mmap'ed, no copy into memory)" << std::endl;
+    std::cerr << "  -o FILE                 Write to FILE instead of compressed_output.bin /" << std::endl;
+    std::cerr << "                          decompressed_output.txt; the codec writes into it directly" << std::endl;
     std::cerr << "\nExamples:" << std::endl;
     std::cerr << "  " << program_name << " compress \"hello world\"" << std::endl;
     std::cerr << "  echo \"hello from pipe\" | " << program_name << " compress" << std::endl;
+    std::cerr << "  " << program_name << " compress --codec zstd --level 19 \"archive me\"" << std::endl;
+    std::cerr << "  " << program_name << " compress -j 0 < big.log" << std::endl;
+    std::cerr << "  " << program_name << " compress --codec lz4 -i big.log -o big.log.rff" << std::endl;
+    std::cerr << "  " << program_name << " compress --pipeline --codec zstd -j 8 -i huge.log -o huge.log.rff" << std::endl;
+    std::cerr << "  " << program_name << " compress --codec auto --min-speed 200 -i blob.bin -o blob.rff" << std::endl;
+    std::cerr << "  " << program_name << " decompress -i big.log.rff -o big.log" << std::endl;
+    std::cerr << "  " << program_name << " compress --block-size 64K -i big.log -o big.rfpb" << std::endl;
+    std::cerr << "  " << program_name << " extract --offset 1G --len 4K big.rfpb > record.bin" << std::endl;
     std::cerr << "  " << program_name << " decompress compressed_output.bin" << std::endl;
+    std::cerr << "  " << program_name << " compress --stream --codec zstd < big.log > big.log.zst" << std::endl;
+    std::cerr << "  " << program_name << " decompress --stream --codec zstd < big.log.zst > big.log" << std::endl;
     std::cerr << "  " << program_name << " encode-varint 12345" << std::endl;
     std::cerr << "  " << program_name << " decode-varint c96001" << std::endl;
+    std::cerr << "  " << program_name << " encode-varint --format streamvbyte --delta 100 105 230 231" << std::endl;
+    std::cerr << "  " << program_name << " train-dict -o events.dict < sample_events.jsonl" << std::endl;
+    std::cerr << "  " << program_name << " compress --codec zstd --dict events.dict '{\"id\":1}'" << std::endl;
+}
+
+// Map a --codec name to its CODEC_* identifier, or -1 if unknown
+int parse_codec(const std::string& name) {
+    if (name == "zlib") return CODEC_ZLIB;
+    if (name == "lz4") return CODEC_LZ4;
+    if (name == "zstd") return CODEC_ZSTD;
+    return -1;
+}
+
+// Name of a CODEC_* identifier as accepted by --codec (or shown for stored frames)
+const char* codec_name(int codec) {
+    switch (codec) {
+        case CODEC_ZLIB: return "zlib";
+        case CODEC_LZ4: return "lz4";
+        case CODEC_ZSTD: return "zstd";
+        case CODEC_STORED: return "stored";
+        default: return "unknown";
+    }
+}
+
+// Pipe stdin to stdout through a codec_stream in fixed-size chunks, so memory use
+// stays constant regardless of input size. Progress/errors go to stderr.
+int run_stream(int codec, int mode, int level) {
+    const size_t chunk_size = 64 * 1024;
+    rffi::Stream stream(codec, mode, level);
+    if (!stream) {
+        std::cerr << "Error: Failed to start stream (check codec and level)." << std::endl;
+        return 1;
+    }
+    std::vector<char> in_buf(chunk_size);
+    std::vector<char> out_buf(chunk_size);
+    size_t total_in = 0, total_out = 0;
+    int rc = CODEC_OK;
+    bool frame_done = false;
+
+    while (!frame_done) {
+        size_t n = fread(in_buf.data(), 1, in_buf.size(), stdin);
+        if (n == 0) {
+            break;
+        }
+        total_in += n;
+        size_t offset = 0;
+        do {
+            size_t consumed = 0, produced = 0;
+            rc = stream.update(rffi::ByteView(in_buf).subview(offset, n - offset), consumed, out_buf, produced);
+            offset += consumed;
+            if (produced > 0 && fwrite(out_buf.data(), 1, produced, stdout) != produced) {
+                std::cerr << "Error: Failed writing to stdout." << std::endl;
+                return 1;
+            }
+            total_out += produced;
+        } while (rc == STREAM_OUTPUT_FULL);
+        if (rc < 0) {
+            break;
+        }
+        if (rc == STREAM_FRAME_END) {
+            frame_done = true;
+            if (offset < n || fread(in_buf.data(), 1, 1, stdin) > 0) {
+                std::cerr << "Warning: Ignoring data after the end of the compressed stream." << std::endl;
+            }
+        }
+    }
+    if (ferror(stdin)) {
+        std::cerr << "Error: Failed reading from stdin." << std::endl;
+        return 1;
+    }
+
+    if (rc >= 0) {
+        do {
+            size_t produced = 0;
+            rc = stream.end(out_buf, produced);
+            if (produced > 0 && fwrite(out_buf.data(), 1, produced, stdout) != produced) {
+                std::cerr << "Error: Failed writing to stdout." << std::endl;
+                return 1;
+            }
+            total_out += produced;
+        } while (rc == STREAM_OUTPUT_FULL);
+    }
+    fflush(stdout);
+
+    if (rc < 0) {
+        std::cerr << (mode == STREAM_COMPRESS ? "Compression" : "Decompression")
+                  << " failed! Error code: " << rc << std::endl;
+        return 1;
+    }
+    std::cerr << (mode == STREAM_COMPRESS ? "Compressed " : "Decompressed ") << total_in
+              << " bytes into " << total_out << " bytes." << std::endl;
+    return 0;
+}
+
+// Read a whole binary file into out; returns false (after reporting) on failure
+bool read_binary_file(const std::string& path, std::vector<char>& out) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "Error reading file '" << path << "'" << std::endl;
+        return false;
+    }
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    out.resize(static_cast<size_t>(size));
+    if (size > 0 && !file.read(out.data(), size)) {
+        std::cerr << "Error reading file content from '" << path << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Load a --dict file and digest it for the codec; returns an empty dictionary (after
+// reporting) on failure
+rffi::Dictionary load_dictionary(const std::string& path, int codec, int level) {
+    std::vector<char> content;
+    if (!read_binary_file(path, content)) {
+        return rffi::Dictionary();
+    }
+    rffi::Dictionary dict(codec, level, content);
+    if (!dict) {
+        std::cerr << "Error: Could not load dictionary '" << path << "' (empty file or bad level)." << std::endl;
+    }
+    return dict;
+}
+
+// train-dict [--max-size N] [-o FILE] [samples...]
+// Each sample file is one training sample; without files, each stdin line is one
+int run_train_dict(int argc, char* argv[]) {
+    size_t max_size = 112 * 1024; // zstd's default dictionary size
+    std::string output_file = "dictionary.bin";
+    std::vector<std::string> sample_files;
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--max-size" && i + 1 < argc) {
+            try {
+                max_size = std::stoul(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid size '" << argv[i] << "'." << std::endl;
+                return 1;
+            }
+        } else if (arg == "-o" && i + 1 < argc) {
+            output_file = argv[++i];
+        } else {
+            sample_files.push_back(arg);
+        }
+    }
+
+    std::string samples;
+    std::vector<size_t> sample_lens;
+    if (sample_files.empty()) {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            samples += line;
+            sample_lens.push_back(line.size());
+        }
+    } else {
+        std::vector<char> content;
+        for (const std::string& path : sample_files) {
+            if (!read_binary_file(path, content)) {
+                return 1;
+            }
+            samples.append(content.data(), content.size());
+            sample_lens.push_back(content.size());
+        }
+    }
+    if (sample_lens.empty()) {
+        std::cerr << "Error: train-dict needs sample files or sample lines on stdin." << std::endl;
+        return 1;
+    }
+
+    std::vector<char> dict(max_size);
+    size_t dict_len = 0;
+    if (dict_train(samples.data(), sample_lens.data(), sample_lens.size(), dict.data(), dict.size(), &dict_len) != CODEC_OK) {
+        std::cerr << "Error: Training failed; provide more samples (hundreds, ideally) or a smaller --max-size." << std::endl;
+        return 1;
+    }
+    std::ofstream outfile(output_file, std::ios::binary);
+    if (!outfile.is_open()) {
+        std::cerr << "Error opening output file: " << output_file << std::endl;
+        return 1;
+    }
+    outfile.write(dict.data(), dict_len);
+    outfile.close();
+    std::cout << "Trained a " << dict_len << " byte dictionary from " << sample_lens.size() << " samples ("
+              << samples.size() << " bytes)." << std::endl;
+    std::cout << "Dictionary written to: " << output_file << std::endl;
+    return 0;
+}
+
+// Read everything from fd into out (for pipes and other files that cannot be mapped)
+bool read_all(int fd, std::vector<char>& out) {
+    const size_t chunk_size = 64 * 1024;
+    out.clear();
+    for (;;) {
+        size_t used = out.size();
+        out.resize(used + chunk_size);
+        ssize_t n = ::read(fd, out.data() + used, chunk_size);
+        if (n < 0 && errno == EINTR) {
+            out.resize(used);
+            continue;
+        }
+        if (n <= 0) {
+            out.resize(used);
+            return n == 0;
+        }
+        out.resize(used + static_cast<size_t>(n));
+    }
+}
+
+// Read-only view of an input file. Regular files are mmap'ed with MADV_SEQUENTIAL (the
+// codecs read front to back), so the data is neither copied nor sent through iostreams;
+// pipes and other special files fall back to a heap buffer.
+class InputFile {
+public:
+    InputFile() = default;
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+    ~InputFile() {
+        if (mapped_ != nullptr) {
+            munmap(mapped_, size_);
+        }
+    }
+
+    // fd < 0 opens path; returns false (after reporting) on failure
+    bool open(const std::string& path, int fd = -1) {
+        bool own_fd = fd < 0;
+        if (own_fd && (fd = ::open(path.c_str(), O_RDONLY)) < 0) {
+            std::cerr << "Error reading file '" << path << "': " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                mapped_ = p;
+                size_ = static_cast<size_t>(st.st_size);
+                data_ = static_cast<const char*>(p);
+            }
+        }
+        bool ok = true;
+        if (mapped_ == nullptr) {
+            ok = read_all(fd, buffer_);
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+            if (!ok) {
+                std::cerr << "Error reading file content from '" << path << "': " << std::strerror(errno) << std::endl;
+            }
+        }
+        if (own_fd) {
+            ::close(fd);
+        }
+        return ok;
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    void* mapped_ = nullptr;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<char> buffer_;
+};
+
+// Output file the codec writes into directly. A regular file is extended to the
+// worst-case size and mmap'ed, then truncated to the real length on commit(); other
+// targets (pipes, /dev/stdout) get a heap buffer that commit() writes out.
+// Without commit() the file is removed again.
+class OutputFile {
+public:
+    OutputFile() = default;
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+    ~OutputFile() {
+        if (fd_ >= 0) {
+            unmap();
+            ::close(fd_);
+            if (regular_) {
+                unlink(path_.c_str());
+            }
+        }
+    }
+
+    // Open path with room for capacity bytes; returns false (after reporting) on failure
+    bool open(const std::string& path, size_t capacity) {
+        path_ = path;
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644); // e.g. a write-only pipe
+        }
+        if (fd_ < 0) {
+            std::cerr << "Error opening output file '" << path << "': " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        struct stat st;
+        regular_ = fstat(fd_, &st) == 0 && S_ISREG(st.st_mode);
+        if (regular_ && capacity > 0 && ftruncate(fd_, static_cast<off_t>(capacity)) == 0) {
+            void* p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if (p != MAP_FAILED) {
+                mapped_ = p;
+                capacity_ = capacity;
+                data_ = static_cast<char*>(p);
+                return true;
+            }
+        }
+        try {
+            buffer_.resize(capacity);
+        } catch (const std::exception&) { // std::bad_alloc or std::length_error
+            std::cerr << "Error: Cannot allocate " << capacity << " bytes for output file '" << path << "'." << std::endl;
+            return false;
+        }
+        capacity_ = capacity;
+        data_ = buffer_.data();
+        return true;
+    }
+
+    char* data() { return data_; }
+    size_t capacity() const { return capacity_; }
+
+    // Keep the first len bytes; returns false (after reporting) if they could not be written
+    bool commit(size_t len) {
+        bool ok = true;
+        if (mapped_ != nullptr) {
+            unmap();
+            ok = ftruncate(fd_, static_cast<off_t>(len)) == 0;
+        } else {
+            for (size_t done = 0; ok && done < len;) {
+                ssize_t n = regular_ ? pwrite(fd_, data_ + done, len - done, static_cast<off_t>(done))
+                                     : ::write(fd_, data_ + done, len - done);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                ok = n > 0;
+                done += ok ? static_cast<size_t>(n) : 0;
+            }
+        }
+        ok = ::close(fd_) == 0 && ok;
+        fd_ = -1;
+        if (!ok) {
+            std::cerr << "Error writing output file '" << path_ << "': " << std::strerror(errno) << std::endl;
+        }
+        return ok;
+    }
+
+private:
+    void unmap() {
+        if (mapped_ != nullptr) {
+            munmap(mapped_, capacity_);
+            mapped_ = nullptr;
+        }
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    bool regular_ = false;
+    void* mapped_ = nullptr;
+    char* data_ = nullptr;
+    size_t capacity_ = 0;
+    std::vector<char> buffer_;
+};
+
+// True if both paths name the same existing file (writing would truncate the input)
+bool same_file(const std::string& a, const std::string& b) {
+    struct stat sa, sb;
+    return stat(a.c_str(), &sa) == 0 && stat(b.c_str(), &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
+// Parse a -j thread count; returns false (after reporting) if it is not a number >= 0
+bool parse_threads(const char* text, int& threads) {
+    try {
+        threads = std::stoi(text);
+    } catch (const std::exception& e) {
+        threads = -1;
+    }
+    if (threads < 0) {
+        std::cerr << "Error: Invalid thread count '" << text << "'." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Parse a byte count with an optional K/M/G suffix (powers of 1024); returns false
+// (after reporting) if it is not a number
+bool parse_size(const char* text, size_t& value) {
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long n = std::strtoull(text, &end, 10);
+    unsigned shift = 0;
+    if (end != text && *end != '\0' && end[1] == '\0') {
+        switch (*end) {
+            case 'K': case 'k': shift = 10; ++end; break;
+            case 'M': case 'm': shift = 20; ++end; break;
+            case 'G': case 'g': shift = 30; ++end; break;
+        }
+    }
+    if (end == text || *end != '\0' || errno != 0 || text[0] == '-' || (n << shift >> shift) != n) {
+        std::cerr << "Error: Invalid size '" << text << "'." << std::endl;
+        return false;
+    }
+    value = static_cast<size_t>(n << shift);
+    return true;
+}
+
+// Decoded sizes come from headers in the (untrusted) input, so they are checked before
+// any output is sized: no codec here expands data more than about 32768:1 (zstd RLE
+// blocks), so a header declaring more than kMaxExpansion bytes per input byte is lying,
+// and --max-output caps legitimate but unexpectedly large outputs
+const size_t kMaxExpansion = 65536;
+size_t g_max_output = size_t(64) << 30; // --max-output
+
+// Returns an empty string if in_len bytes of input may decode to declared bytes, else why not
+std::string check_declared_size(size_t declared, size_t in_len) {
+    if (declared > g_max_output) {
+        return "declared output of " + std::to_string(declared) + " bytes exceeds --max-output (" +
+               std::to_string(g_max_output) + " bytes)";
+    }
+    if (declared / kMaxExpansion > in_len) {
+        return "declared output of " + std::to_string(declared) + " bytes cannot come from " +
+               std::to_string(in_len) + " bytes of input (corrupt header)";
+    }
+    return "";
+}
+
+// Original length of a -j container, or the sum over a sequence of one or more frames
+// that exactly fills in_len. On failure *bad_offset is the offset of the frame at fault:
+// the frame_header_info error comes back as is, a frame running past the end (or a sum
+// that overflows) as CODEC_ERR_CORRUPT.
+int framed_length(const char* in, size_t in_len, size_t* original, size_t* bad_offset) {
+    *bad_offset = 0;
+    if (parallel_decompressed_length(in, in_len, original) == CODEC_OK) {
+        return CODEC_OK;
+    }
+    *original = 0;
+    size_t pos = 0;
+    do {
+        *bad_offset = pos;
+        FrameInfo frame;
+        int rc = frame_header_info(in + pos, in_len - pos, &frame);
+        if (rc != CODEC_OK) {
+            return rc;
+        }
+        if (frame.frame_len > in_len - pos || frame.original_len > SIZE_MAX - *original) {
+            return CODEC_ERR_CORRUPT;
+        }
+        *original += frame.original_len;
+        pos += frame.frame_len;
+    } while (pos < in_len);
+    return CODEC_OK;
+}
+
+// Decodes a -j container (on threads workers, <= 0 = one per CPU) or a frame sequence
+// into out. Each frame is delimited again, so out_cap bounds the output whatever the
+// headers said when it was sized.
+int decompress_framed(int threads, const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len) {
+    *out_len = 0;
+    size_t total = 0;
+    if (parallel_decompressed_length(in, in_len, &total) == CODEC_OK) {
+        return decompress_parallel_into(threads, in, in_len, out, out_cap, out_len);
+    }
+    for (size_t pos = 0; pos < in_len;) {
+        size_t frame_len = 0, n = 0;
+        int rc = frame_length(in + pos, in_len - pos, &frame_len);
+        if (rc != CODEC_OK) {
+            return rc;
+        }
+        if (frame_len == 0 || frame_len > in_len - pos) {
+            return CODEC_ERR_CORRUPT;
+        }
+        rc = decompress_auto_into(in + pos, frame_len, out + *out_len, out_cap - *out_len, &n);
+        if (rc != CODEC_OK) {
+            return rc;
+        }
+        *out_len += n;
+        pos += frame_len;
+    }
+    return CODEC_OK;
+}
+
+// Pipelined compress/decompress (--pipeline)
+//
+// A reader thread fills a bounded ring of reusable chunk buffers, a pool of workers runs
+// the codec on them, and the calling thread writes the results out in order, so reading
+// chunk n + 1, coding chunk n and writing chunk n - 1 overlap and throughput approaches
+// the slower of disk and codec rather than their sum. Compression writes one
+// self-describing frame per chunk; decompression reads any concatenation of frames.
+// Memory use is fixed by the ring, whatever the input size.
+class ChunkPipeline {
+public:
+    // min_speed >= 0 selects the codec once, on the first chunk (--codec auto)
+    ChunkPipeline(bool compressing, int codec, int level, double min_speed, size_t chunk_size, int workers)
+        : compressing_(compressing), codec_(codec), level_(level), min_speed_(min_speed),
+          chunk_size_(chunk_size), workers_(workers), slots_(static_cast<size_t>(workers) * 2 + 2) {}
+
+    // Stream in_fd to out_fd; returns false (after reporting) on failure
+    bool run(int in_fd, int out_fd) {
+        posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        if (compressing_) {
+            size_t bound = frame_compress_bound(min_speed_ >= 0 ? CODEC_AUTO : codec_, chunk_size_);
+            for (Slot& slot : slots_) {
+                slot.in.resize(chunk_size_);
+                slot.out.resize(bound);
+            }
+        }
+        std::thread reader(&ChunkPipeline::read_loop, this, in_fd);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < workers_; ++i) {
+            workers.emplace_back(&ChunkPipeline::code_loop, this);
+        }
+        bool ok = write_loop(out_fd);
+        reader.join();
+        for (std::thread& t : workers) {
+            t.join();
+        }
+        if (!error_.empty()) {
+            std::cerr << "Error: " << error_ << std::endl;
+        }
+        return ok && error_.empty();
+    }
+
+    size_t bytes_in() const { return bytes_in_; }
+    size_t bytes_out() const { return bytes_out_; }
+    size_t chunks() const { return write_seq_; }
+
+private:
+    static constexpr size_t kMaxFrame = size_t(1) << 30; // Per slot, compressed and decoded
+
+    enum class State { Empty, Filled, Coded };
+    struct Slot {
+        std::vector<char> in, out;
+        size_t in_len = 0, out_len = 0;
+        int rc = CODEC_OK;
+        State state = State::Empty;
+    };
+
+    Slot& slot(size_t seq) { return slots_[seq % slots_.size()]; }
+
+    // Record the first failure and wake every stage so they can exit
+    void fail(const std::string& message) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_.empty()) {
+            error_ = message;
+        }
+        cv_.notify_all();
+    }
+
+    // Read up to len bytes, retrying short reads; returns the count, or -1 on error
+    static ssize_t read_full(int fd, char* dst, size_t len) {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = ::read(fd, dst + done, len - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                return -1;
+            }
+            if (n == 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return static_cast<ssize_t>(done);
+    }
+
+    // Read the next frame into slot.in; false at a clean end of input or after fail()
+    bool read_frame(int fd, Slot& s) {
+        size_t have = 0, need = 0;
+        int rc;
+        while ((rc = frame_length(s.in.data(), have, &need)) == CODEC_ERR_BUFFER_TOO_SMALL || rc == CODEC_OK) {
+            if (need > kMaxFrame) {
+                fail("Frame of " + std::to_string(need) + " bytes is too large for --pipeline.");
+                return false;
+            }
+            if (s.in.size() < need) {
+                try {
+                    s.in.resize(need);
+                } catch (const std::exception&) {
+                    fail("Cannot allocate " + std::to_string(need) + " bytes for a frame.");
+                    return false;
+                }
+            }
+            ssize_t n = read_full(fd, s.in.data() + have, need - have);
+            if (n < 0) {
+                fail(std::string("Failed reading input: ") + std::strerror(errno));
+                return false;
+            }
+            if (n == 0 && have == 0) {
+                return false; // End of the concatenation
+            }
+            have += static_cast<size_t>(n);
+            if (have < need) {
+                fail("Input ends in the middle of a frame.");
+                return false;
+            }
+            if (rc == CODEC_OK) {
+                s.in_len = have;
+                return true;
+            }
+        }
+        fail("Input is not a sequence of frames.");
+        return false;
+    }
+
+    void read_loop(int fd) {
+        for (size_t seq = 0;; ++seq) {
+            Slot& s = slot(seq);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&] { return s.state == State::Empty || !error_.empty(); });
+                if (!error_.empty()) {
+                    break;
+                }
+            }
+            // The slot is ours until it is marked Filled
+            bool more;
+            if (compressing_) {
+                ssize_t n = read_full(fd, s.in.data(), chunk_size_);
+                if (n < 0) {
+                    fail(std::string("Failed reading input: ") + std::strerror(errno));
+                    break;
+                }
+                s.in_len = static_cast<size_t>(n);
+                more = n > 0;
+                // Workers read codec_ and level_ only after this slot is marked Filled
+                int rc = more && seq == 0 && min_speed_ >= 0
+                             ? codec_auto_select(s.in.data(), s.in_len, min_speed_, &codec_, &level_)
+                             : CODEC_OK;
+                if (rc != CODEC_OK) {
+                    fail("Codec selection failed! Error code: " + std::to_string(rc));
+                    break;
+                }
+            } else {
+                more = read_frame(fd, s);
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!more) {
+                read_done_ = true;
+                cv_.notify_all();
+                break;
+            }
+            bytes_in_ += s.in_len;
+            s.state = State::Filled;
+            read_seq_ = seq + 1;
+            cv_.notify_all();
+        }
+    }
+
+    void code(Slot& s) {
+        if (compressing_) {
+            s.rc = compress_frame_into(codec_, level_, FRAME_CHECKSUM, s.in.data(), s.in_len, s.out.data(),
+                                       s.out.size(), &s.out_len);
+            return;
+        }
+        FrameInfo info;
+        s.rc = frame_header_info(s.in.data(), s.in_len, &info);
+        if (s.rc != CODEC_OK) {
+            return;
+        }
+        // Runs on a worker thread: a lying header must fail the pipeline, not throw
+        std::string why = info.original_len > kMaxFrame
+                              ? "declared output of " + std::to_string(info.original_len) +
+                                    " bytes is too large for a --pipeline frame"
+                              : check_declared_size(info.original_len, s.in_len);
+        if (why.empty() && s.out.size() < info.original_len) {
+            try {
+                s.out.resize(info.original_len);
+            } catch (const std::exception&) {
+                why = "cannot allocate " + std::to_string(info.original_len) + " bytes";
+            }
+        }
+        if (!why.empty()) {
+            s.rc = CODEC_ERR_TOO_LARGE;
+            fail("Decompression failed! Frame " + why + ".");
+            return;
+        }
+        s.rc = decompress_auto_into(s.in.data(), s.in_len, s.out.data(), s.out.size(), &s.out_len);
+    }
+
+    void code_loop() {
+        for (;;) {
+            size_t seq;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&] { return code_seq_ < read_seq_ || read_done_ || !error_.empty(); });
+                if (!error_.empty() || code_seq_ >= read_seq_) {
+                    return;
+                }
+                seq = code_seq_++;
+            }
+            Slot& s = slot(seq);
+            code(s);
+            std::lock_guard<std::mutex> lock(mutex_);
+            s.state = State::Coded;
+            cv_.notify_all();
+        }
+    }
+
+    bool write_loop(int fd) {
+        for (;;) {
+            Slot& s = slot(write_seq_);
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&] {
+                    return s.state == State::Coded || (read_done_ && write_seq_ == read_seq_) || !error_.empty();
+                });
+                if (!error_.empty()) {
+                    return false;
+                }
+                if (s.state != State::Coded) {
+                    return true; // Everything read has been written
+                }
+            }
+            if (s.rc != CODEC_OK) {
+                fail(std::string(compressing_ ? "Compression" : "Decompression") + " of chunk " +
+                     std::to_string(write_seq_) + " failed! Error code: " + std::to_string(s.rc) +
+                     (s.rc == CODEC_ERR_CHECKSUM ? " (checksum mismatch)" : "") +
+                     (s.rc == CODEC_ERR_DICT_MISMATCH ? " (frames with a dictionary are not supported)" : ""));
+                return false;
+            }
+            for (size_t done = 0; done < s.out_len;) {
+                ssize_t n = ::write(fd, s.out.data() + done, s.out_len - done);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    fail(std::string("Failed writing output: ") + std::strerror(errno));
+                    return false;
+                }
+                done += static_cast<size_t>(n);
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            bytes_out_ += s.out_len;
+            s.state = State::Empty;
+            ++write_seq_;
+            cv_.notify_all();
+        }
+    }
+
+    const bool compressing_;
+    int codec_, level_; // Set by the reader before the first chunk under --codec auto
+    const double min_speed_;
+    const size_t chunk_size_;
+    const int workers_;
+    std::vector<Slot> slots_;
+
+    // Guarded by mutex_: slot states, sequence counters, read_done_ and error_
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t read_seq_ = 0;  // Chunks filled by the reader
+    size_t code_seq_ = 0;  // Chunks claimed by a worker
+    size_t write_seq_ = 0; // Chunks written out
+    bool read_done_ = false;
+    std::string error_;
+    size_t bytes_in_ = 0, bytes_out_ = 0;
+};
+
+// Run a ChunkPipeline from input_path (or stdin when empty) to output_path; status goes
+// to stderr so the output may be /dev/stdout. A partial output file is removed on failure.
+int run_pipeline(bool compressing, int codec, int level, double min_speed, size_t chunk_size, int threads,
+                 const std::string& input_path, const std::string& output_path) {
+    int in_fd = STDIN_FILENO;
+    if (!input_path.empty() && (in_fd = ::open(input_path.c_str(), O_RDONLY)) < 0) {
+        std::cerr << "Error reading file '" << input_path << "': " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    if (!input_path.empty() && same_file(input_path, output_path)) {
+        std::cerr << "Error: Output file '" << output_path << "' is the input file." << std::endl;
+        ::close(in_fd);
+        return 1;
+    }
+    int out_fd = ::open(output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        std::cerr << "Error opening output file '" << output_path << "': " << std::strerror(errno) << std::endl;
+        if (in_fd != STDIN_FILENO) {
+            ::close(in_fd);
+        }
+        return 1;
+    }
+    struct stat st;
+    bool regular = fstat(out_fd, &st) == 0 && S_ISREG(st.st_mode);
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ChunkPipeline pipeline(compressing, codec, level, min_speed, chunk_size, threads);
+    bool ok = pipeline.run(in_fd, out_fd);
+    if (in_fd != STDIN_FILENO) {
+        ::close(in_fd);
+    }
+    if (::close(out_fd) != 0 && ok) {
+        std::cerr << "Error writing output file '" << output_path << "': " << std::strerror(errno) << std::endl;
+        ok = false;
+    }
+    if (!ok) {
+        if (regular) {
+            unlink(output_path.c_str());
+        }
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << (compressing ? "Compressed " : "Decompressed ") << pipeline.bytes_in() << " bytes into "
+              << pipeline.bytes_out() << " bytes (" << pipeline.chunks() << (compressing ? " frames" : " chunks")
+              << ", " << threads << " workers) in " << std::fixed << std::setprecision(2) << seconds << " s";
+    if (seconds > 0) {
+        size_t plain = compressing ? pipeline.bytes_in() : pipeline.bytes_out();
+        std::cerr << ", " << std::setprecision(0) << plain / seconds / 1e6 << " MB/s";
+    }
+    std::cerr << std::endl;
+    std::cerr << (compressing ? "Compressed" : "Decompressed") << " data written to: " << output_path << std::endl;
+    return 0;
+}
+
+// Batch compress/decompress (compress-batch / decompress-batch)
+//
+// One process handles any number of files on a pool of workers, instead of one process
+// per file. Workers claim files from a shared atomic index (largest first, so a big file
+// claimed late cannot leave one worker busy after the rest are done), keep their codec
+// context warm across files and write each result next to its input. Compression writes
+// the --pipeline format, one checksummed frame per --block-size chunk, so files of any
+// size work; decompression reads such frame sequences, single frames and -j containers.
+struct BatchOptions {
+    bool compressing = true;
+    int codec = CODEC_ZLIB;
+    int level = 0;
+    double min_speed = -1; // >= 0 selects the codec once per file (--codec auto)
+    size_t block_size = 1024 * 1024;
+    int threads = 0;
+    std::string suffix = ".rff";
+};
+
+class BatchRunner {
+public:
+    BatchRunner(const BatchOptions& options, std::vector<std::string> paths)
+        : options_(options), paths_(std::move(paths)), progress_(isatty(STDERR_FILENO) != 0) {}
+
+    // Process every file; returns the number that failed
+    size_t run() {
+        // Largest first: stat sizes up front (files that cannot be stat'ed fail later)
+        std::vector<std::pair<off_t, size_t>> by_size;
+        for (size_t i = 0; i < paths_.size(); ++i) {
+            struct stat st;
+            by_size.emplace_back(stat(paths_[i].c_str(), &st) == 0 ? st.st_size : 0, i);
+        }
+        std::stable_sort(by_size.begin(), by_size.end(),
+                         [](const std::pair<off_t, size_t>& a, const std::pair<off_t, size_t>& b) { return a.first > b.first; });
+        for (const auto& entry : by_size) {
+            order_.push_back(entry.second);
+        }
+
+        int workers = options_.threads > 0 ? options_.threads
+                                           : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        workers = static_cast<int>(std::min<size_t>(static_cast<size_t>(workers), std::max<size_t>(paths_.size(), 1)));
+        start_ = std::chrono::steady_clock::now();
+        std::vector<std::thread> pool;
+        for (int i = 0; i < workers; ++i) {
+            pool.emplace_back(&BatchRunner::work_loop, this);
+        }
+        if (progress_) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (done_ < paths_.size()) {
+                cv_.wait_for(lock, std::chrono::milliseconds(200));
+                print_progress();
+            }
+            std::cerr << "\r\033[K";
+        }
+        for (std::thread& t : pool) {
+            t.join();
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        size_t plain = options_.compressing ? bytes_in_ : bytes_out_;
+        std::cerr << (options_.compressing ? "Compressed " : "Decompressed ") << paths_.size() - failed_ << " of "
+                  << paths_.size() << " files: " << bytes_in_ << " bytes into " << bytes_out_ << " bytes ("
+                  << workers << " workers) in " << std::fixed << std::setprecision(2) << seconds << " s";
+        if (seconds > 0) {
+            double files_per_second = paths_.size() / seconds;
+            std::cerr << ", " << std::setprecision(0) << plain / seconds / 1e6 << " MB/s, " << std::setprecision(1);
+            // Slow runs (large files or a single one) read better as seconds per file
+            if (files_per_second >= 1) {
+                std::cerr << files_per_second << " files/s";
+            } else {
+                std::cerr << seconds / paths_.size() << " s/file";
+            }
+        }
+        std::cerr << std::endl;
+        return failed_;
+    }
+
+private:
+    void work_loop() {
+        rffi::Context ctx;
+        if (options_.compressing && options_.min_speed < 0) {
+            ctx = rffi::Context(options_.codec);
+            ctx.set_level(options_.level); // Validated by the caller
+        }
+        for (;;) {
+            size_t claimed = next_.fetch_add(1, std::memory_order_relaxed);
+            if (claimed >= order_.size()) {
+                break;
+            }
+            const std::string& path = paths_[order_[claimed]];
+            size_t in_len = 0, out_len = 0;
+            std::string error;
+            bool ok = options_.compressing ? compress_file(path, ctx, in_len, out_len, error)
+                                           : decompress_file(path, in_len, out_len, error);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (ok) {
+                bytes_in_ += in_len;
+                bytes_out_ += out_len;
+            } else {
+                ++failed_;
+                if (!error.empty()) {
+                    std::cerr << (progress_ ? "\r\033[K" : "") << "Error: " << path << ": " << error << std::endl;
+                }
+            }
+            ++done_;
+            cv_.notify_one();
+        }
+    }
+
+    void print_progress() {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        size_t plain = options_.compressing ? bytes_in_ : bytes_out_;
+        std::cerr << "\r" << done_ << "/" << paths_.size() << " files, " << std::fixed << std::setprecision(1)
+                  << plain / 1e6 << " MB";
+        if (seconds > 0) {
+            std::cerr << ", " << plain / seconds / 1e6 << " MB/s";
+        }
+        if (failed_ > 0) {
+            std::cerr << ", " << failed_ << " failed";
+        }
+        std::cerr << "\033[K" << std::flush;
+    }
+
+    // Errors from InputFile/OutputFile are reported by them and leave error empty
+    bool compress_file(const std::string& path, rffi::Context& ctx, size_t& in_len, size_t& out_len,
+                       std::string& error) {
+        std::string out_path = path + options_.suffix;
+        if (same_file(path, out_path)) {
+            error = "output is the input file";
+            return false;
+        }
+        InputFile input;
+        if (!input.open(path)) {
+            return false;
+        }
+        in_len = input.size();
+        size_t block = options_.block_size, blocks = in_len == 0 ? 1 : (in_len + block - 1) / block;
+        size_t last = in_len - (blocks - 1) * block;
+        // --codec auto picks once for the whole file (sampled across it), not per chunk
+        int codec = options_.codec, level = options_.level;
+        bool automatic = options_.min_speed >= 0;
+        if (automatic) {
+            int rc = codec_auto_select(input.data(), in_len, options_.min_speed, &codec, &level);
+            if (rc != CODEC_OK) {
+                error = "codec selection failed (error " + std::to_string(rc) + ")";
+                return false;
+            }
+        }
+        size_t full_bound = blocks > 1 ? frame_compress_bound(codec, block) : 0;
+        size_t last_bound = frame_compress_bound(codec, last);
+        if ((blocks > 1 && full_bound == 0) || last_bound == 0 ||
+            (blocks > 1 && (blocks - 1) > (SIZE_MAX - last_bound) / full_bound)) {
+            error = "too large for the codec (try a smaller --block-size)";
+            return false;
+        }
+        OutputFile output;
+        if (!output.open(out_path, (blocks - 1) * full_bound + last_bound)) {
+            return false;
+        }
+        out_len = 0;
+        for (size_t i = 0; i < blocks; ++i) {
+            rffi::ByteView chunk(input.data() + i * block, i + 1 < blocks ? block : last);
+            rffi::MutableByteView dst(output.data() + out_len, output.capacity() - out_len);
+            size_t frame_len = 0;
+            int rc = automatic ? compress_frame_into(codec, level, FRAME_CHECKSUM, chunk.data(), chunk.size(),
+                                                     dst.data(), dst.size(), &frame_len)
+                               : ctx.compress_frame(FRAME_CHECKSUM, chunk, dst, frame_len);
+            if (rc != CODEC_OK) {
+                error = "compression failed (error " + std::to_string(rc) + ")";
+                return false;
+            }
+            out_len += frame_len;
+        }
+        return output.commit(out_len);
+    }
+
+    bool decompress_file(const std::string& path, size_t& in_len, size_t& out_len, std::string& error) {
+        const std::string& suffix = options_.suffix;
+        bool has_suffix = path.size() > suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+        std::string out_path = has_suffix ? path.substr(0, path.size() - suffix.size()) : path + ".out";
+        if (same_file(path, out_path)) {
+            error = "output is the input file";
+            return false;
+        }
+        InputFile input;
+        if (!input.open(path)) {
+            return false;
+        }
+        const char* in = input.data();
+        in_len = input.size();
+
+        // A -j container, or a sequence of frames whose lengths add up to the file size
+        if (in_len == 0) {
+            error = "empty file";
+            return false;
+        }
+        size_t total = 0, bad_offset = 0;
+        if (framed_length(in, in_len, &total, &bad_offset) != CODEC_OK) {
+            error = bad_offset == 0 ? "not a frame or -j container (bare output needs decompress --codec)"
+                                    : "corrupt frame at offset " + std::to_string(bad_offset);
+            return false;
+        }
+        error = check_declared_size(total, in_len);
+        if (!error.empty()) {
+            return false;
+        }
+        OutputFile output;
+        if (!output.open(out_path, std::max<size_t>(total, 1))) {
+            return false;
+        }
+        // The files already keep every worker busy
+        int rc = decompress_framed(1, in, in_len, output.data(), output.capacity(), &out_len);
+        if (rc != CODEC_OK) {
+            error = rc == CODEC_ERR_CHECKSUM        ? "checksum mismatch, the file is corrupt"
+                    : rc == CODEC_ERR_DICT_MISMATCH ? "compressed with a dictionary (use decompress --dict)"
+                                                    : "decompression failed (error " + std::to_string(rc) + ")";
+            return false;
+        }
+        return output.commit(out_len);
+    }
+
+    BatchOptions options_;
+    std::vector<std::string> paths_;
+    std::vector<size_t> order_;
+    bool progress_;
+    std::chrono::steady_clock::time_point start_;
+    std::atomic<size_t> next_{0};
+    std::mutex mutex_; // Guards the counters below and stderr
+    std::condition_variable cv_;
+    size_t done_ = 0, failed_ = 0, bytes_in_ = 0, bytes_out_ = 0;
+};
+
+// compress-batch [--codec C|auto] [--level N] [--min-speed MBPS] [--block-size N] [-j N]
+//                [--suffix S] [--files-from F] files...
+// decompress-batch [-j N] [--suffix S] [--files-from F] [--max-output N] files...
+// --files-from reads one path per line (- for stdin), for lists too long for argv
+int run_batch(bool compressing, int argc, char* argv[]) {
+    BatchOptions options;
+    options.compressing = compressing;
+    bool level_set = false;
+    std::vector<std::string> paths;
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            if (!parse_threads(argv[++i], options.threads)) {
+                return 1;
+            }
+        } else if (arg == "--suffix" && i + 1 < argc) {
+            options.suffix = argv[++i];
+            if (options.suffix.empty()) {
+                std::cerr << "Error: --suffix must not be empty." << std::endl;
+                return 1;
+            }
+        } else if (arg == "--files-from" && i + 1 < argc) {
+            std::string list = argv[++i];
+            std::ifstream file;
+            if (list != "-") {
+                file.open(list);
+                if (!file) {
+                    std::cerr << "Error: Cannot open file list '" << list << "'." << std::endl;
+                    return 1;
+                }
+            }
+            std::istream& in = list == "-" ? std::cin : file;
+            for (std::string line; std::getline(in, line);) {
+                if (!line.empty()) {
+                    paths.push_back(line);
+                }
+            }
+        } else if (compressing && arg == "--codec" && i + 1 < argc) {
+            bool automatic = std::string(argv[++i]) == "auto";
+            options.codec = automatic ? CODEC_ZLIB : parse_codec(argv[i]);
+            if (options.codec < 0) {
+                std::cerr << "Error: Unknown codec '" << argv[i] << "'." << std::endl;
+                return 1;
+            }
+            options.min_speed = automatic ? (options.min_speed >= 0 ? options.min_speed : kAutoMinSpeed) : -1;
+        } else if (compressing && arg == "--min-speed" && i + 1 < argc) {
+            try {
+                options.min_speed = std::stod(argv[++i]);
+            } catch (const std::exception& e) {
+                options.min_speed = -1;
+            }
+            if (!(options.min_speed >= 0)) {
+                std::cerr << "Error: Invalid speed '" << argv[i] << "' (MB/s, 0 or more)." << std::endl;
+                return 1;
+            }
+        } else if (compressing && arg == "--level" && i + 1 < argc) {
+            try {
+                options.level = std::stoi(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid level '" << argv[i] << "'." << std::endl;
+                return 1;
+            }
+            level_set = true;
+        } else if (compressing && arg == "--block-size" && i + 1 < argc) {
+            if (!parse_size(argv[++i], options.block_size) || options.block_size == 0) {
+                return 1;
+            }
+        } else if (!compressing && arg == "--max-output" && i + 1 < argc) {
+            if (!parse_size(argv[++i], g_max_output)) {
+                return 1;
+            }
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Error: Unknown option '" << arg << "'." << std::endl;
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        std::cerr << "Error: " << (compressing ? "compress-batch" : "decompress-batch") << " requires files." << std::endl;
+        return 1;
+    }
+    if (compressing) {
+        // --min-speed given before --codec still needs --codec auto to take effect
+        bool automatic = options.min_speed >= 0;
+        int min_level = 0, max_level = 0;
+        codec_level_range(options.codec, &min_level, &max_level);
+        if (level_set && (automatic || options.level < min_level || options.level > max_level)) {
+            std::cerr << "Error: Level " << options.level << " is out of range (" << min_level << ".." << max_level
+                      << ")" << (automatic ? " or combined with --codec auto." : ".") << std::endl;
+            return 1;
+        }
+        if (!level_set) {
+            options.level = codec_default_level(options.codec);
+        }
+    }
+    BatchRunner runner(options, std::move(paths));
+    return runner.run() == 0 ? 0 : 1;
+}
+
+// extract --offset N --len N [-o FILE] <file>
+// Decodes only the blocks of a block-parallel container (compress -j) that overlap the
+// range. The bytes go to FILE or, by default, raw to stdout; status goes to stderr.
+int run_extract(int argc, char* argv[]) {
+    size_t offset = 0, len = 0;
+    bool len_set = false;
+    std::string file_path, output_file;
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--offset" && i + 1 < argc) {
+            if (!parse_size(argv[++i], offset)) {
+                return 1;
+            }
+        } else if (arg == "--len" && i + 1 < argc) {
+            if (!parse_size(argv[++i], len)) {
+                return 1;
+            }
+            len_set = true;
+        } else if (arg == "-o" && i + 1 < argc) {
+            output_file = argv[++i];
+        } else if (arg == "-i" && i + 1 < argc) {
+            file_path = argv[++i];
+        } else {
+            file_path = arg;
+        }
+    }
+    if (file_path.empty() || !len_set) {
+        std::cerr << "Error: extract requires --len and a file path." << std::endl;
+        return 1;
+    }
+    InputFile input;
+    if (!input.open(file_path)) {
+        return 1;
+    }
+    rffi::RangeReader reader(rffi::ByteView(input.data(), input.size()));
+    if (!reader) {
+        std::cerr << "Error: '" << file_path << "' is not a block-parallel container; create it with compress -j"
+                  << " (and --block-size to control the read granularity)." << std::endl;
+        return 1;
+    }
+    size_t total = reader.size();
+    std::string implausible = check_declared_size(total, input.size());
+    if (!implausible.empty()) {
+        std::cerr << "Error: '" << file_path << "': the " << implausible << "." << std::endl;
+        return 1;
+    }
+    if (offset > total) {
+        std::cerr << "Error: Offset " << offset << " is past the end of the data (" << total << " bytes)." << std::endl;
+        return 1;
+    }
+    len = std::min(len, total - offset);
+
+    // stdout is written with fwrite so redirects like >> keep their semantics
+    OutputFile output;
+    std::vector<char> stdout_buffer;
+    char* dst;
+    if (output_file.empty()) {
+        stdout_buffer.resize(len);
+        dst = stdout_buffer.data();
+    } else if (output.open(output_file, len)) {
+        dst = output.data();
+    } else {
+        return 1;
+    }
+    size_t out_len = 0;
+    int rc = reader.read(offset, len, rffi::MutableByteView(dst, len), out_len);
+    if (rc != CODEC_OK) {
+        std::cerr << "Extraction failed! Error code: " << rc << std::endl;
+        return 1;
+    }
+    if (output_file.empty()) {
+        if (fwrite(dst, 1, out_len, stdout) != out_len || fflush(stdout) != 0) {
+            std::cerr << "Error: Failed writing to stdout." << std::endl;
+            return 1;
+        }
+    } else if (!output.commit(out_len)) {
+        return 1;
+    }
+    std::cerr << "Extracted " << out_len << " bytes at offset " << offset << " of " << total << "." << std::endl;
+    return 0;
 }
 
 // Helper function to convert byte vector to hex string
@@ -55,34 +1356,232 @@ std::vector<char> hex_string_to_bytes(const std::string& hex) {
         } catch (const std::out_of_range& e) {
             std::cerr << "Warning: Hex character sequence '" << byteString << "' out of range, skipped." << std::endl;
         }
-    }
-    return bytes;
-}
-
-
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        print_usage(argv[0]);
-        return 1;
-    }
-
-    std::string operation = argv[1];
+    }
+    return bytes;
+}
+
+
+// encode-varint / decode-varint --format streamvbyte [--delta] [--zigzag] [--count N] <args>
+// Encoding takes the values as separate arguments (signed when --zigzag is given)
+int run_streamvbyte(bool encode, int argc, char* argv[]) {
+    int flags = 0;
+    size_t count = 0;
+    bool count_set = false;
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--delta") {
+            flags |= STREAMVBYTE_DELTA;
+        } else if (arg == "--zigzag") {
+            flags |= STREAMVBYTE_ZIGZAG;
+        } else if (arg == "--count" && i + 1 < argc) {
+            try {
+                count = std::stoul(argv[++i]);
+                count_set = true;
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid count '" << argv[i] << "'." << std::endl;
+                return 1;
+            }
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (encode) {
+        if (args.empty()) {
+            std::cerr << "Error: encode-varint requires at least one number." << std::endl;
+            return 1;
+        }
+        std::vector<uint32_t> values;
+        for (const std::string& arg : args) {
+            try {
+                long long v = std::stoll(arg);
+                bool ok = (flags & STREAMVBYTE_ZIGZAG) ? (v >= INT32_MIN && v <= INT32_MAX) : (v >= 0 && v <= UINT32_MAX);
+                if (!ok) {
+                    throw std::out_of_range(arg);
+                }
+                values.push_back(static_cast<uint32_t>(v));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid value '" << arg << "' (expected a "
+                          << ((flags & STREAMVBYTE_ZIGZAG) ? "signed" : "unsigned") << " 32-bit integer)." << std::endl;
+                return 1;
+            }
+        }
+        std::vector<char> out(streamvbyte_bound(values.size()));
+        size_t written = streamvbyte_encode(values.data(), values.size(), out.data(), flags);
+        std::cout << bytes_to_hex_string(out.data(), written) << std::endl;
+        std::cerr << values.size() << " values in " << written << " bytes" << std::endl;
+        return 0;
+    }
+
+    if (args.size() != 1 || !count_set) {
+        std::cerr << "Error: decode-varint --format streamvbyte requires --count N and one hex string." << std::endl;
+        return 1;
+    }
+    std::vector<char> bytes = hex_string_to_bytes(args[0]);
+    std::vector<uint32_t> values(count);
+    size_t bytes_read = 0;
+    if (bytes.size() < count ||
+        streamvbyte_decode(bytes.data(), bytes.size(), values.data(), count, flags, &bytes_read) != CODEC_OK) {
+        std::cerr << "Error decoding Stream-VByte data (too short for " << count << " values)." << std::endl;
+        return 1;
+    }
+    std::cout << "Decoded numbers:";
+    for (uint32_t v : values) {
+        if (flags & STREAMVBYTE_ZIGZAG) {
+            std::cout << " " << static_cast<int32_t>(v);
+        } else {
+            std::cout << " " << v;
+        }
+    }
+    std::cout << std::endl;
+    std::cout << "Bytes read: " << bytes_read << std::endl;
+    return 0;
+}
+
+int run_serve(int argc, char* argv[]);
+
+// Run one cpp_app command; argv[1] is the operation
+int run_operation(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::string operation = argv[1];
+
+    if (operation == "compress") {
+        int codec = CODEC_ZLIB;
+        bool level_set = false;
+        int level = 0;
+        bool auto_codec = false;
+        double min_speed = -1; // -1 = not given
+        bool have_text = false;
+        bool stream_mode = false;
+        bool pipeline = false;
+        bool framed = true;
+        int threads = -1; // -1 = single-shot format, otherwise block-parallel container
+        size_t block_size = 0; // 0 = library default (1 MiB)
+        std::string dict_path;
+        std::string input_path;
+        std::string output_file = "compressed_output.bin";
+        std::string input_data;
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--stream") {
+                stream_mode = true;
+            } else if (arg == "--pipeline") {
+                pipeline = true;
+            } else if (arg == "--no-frame") {
+                framed = false;
+            } else if (arg == "--dict" && i + 1 < argc) {
+                dict_path = argv[++i];
+            } else if (arg == "-i" && i + 1 < argc) {
+                input_path = argv[++i];
+            } else if (arg == "-o" && i + 1 < argc) {
+                output_file = argv[++i];
+            } else if (arg == "-j" && i + 1 < argc) {
+                if (!parse_threads(argv[++i], threads)) {
+                    return 1;
+                }
+            } else if (arg == "--block-size" && i + 1 < argc) {
+                if (!parse_size(argv[++i], block_size) || block_size == 0) {
+                    return 1;
+                }
+            } else if (arg == "--codec" && i + 1 < argc) {
+                auto_codec = std::string(argv[++i]) == "auto";
+                codec = auto_codec ? CODEC_ZLIB : parse_codec(argv[i]);
+                if (codec < 0) {
+                    std::cerr << "Error: Unknown codec '" << argv[i] << "'." << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--min-speed" && i + 1 < argc) {
+                try {
+                    min_speed = std::stod(argv[++i]);
+                } catch (const std::exception& e) {
+                    min_speed = -1;
+                }
+                if (!(min_speed >= 0)) {
+                    std::cerr << "Error: Invalid speed '" << argv[i] << "' (MB/s, 0 or more)." << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--level" && i + 1 < argc) {
+                try {
+                    level = std::stoi(argv[++i]);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: Invalid level '" << argv[i] << "'." << std::endl;
+                    return 1;
+                }
+                level_set = true;
+            } else {
+                input_data = arg;
+                have_text = true;
+            }
+        }
+        if (min_speed >= 0 && !auto_codec) {
+            std::cerr << "Error: --min-speed needs --codec auto." << std::endl;
+            return 1;
+        }
+        if (pipeline) {
+            if (stream_mode || !dict_path.empty() || !framed || have_text) {
+                std::cerr << "Error: --pipeline reads -i FILE or stdin and writes frames; it cannot be combined" << std::endl;
+                std::cerr << "       with --stream, --dict, --no-frame or text arguments." << std::endl;
+                return 1;
+            }
+            int min_level = 0, max_level = 0;
+            codec_level_range(codec, &min_level, &max_level);
+            if (level_set && (auto_codec || level < min_level || level > max_level)) {
+                std::cerr << "Error: Level " << level << " is out of range (" << min_level << ".." << max_level << ")." << std::endl;
+                return 1;
+            }
+            if (input_path.empty() && isatty(fileno(stdin))) {
+                std::cerr << "Error: --pipeline needs -i FILE or data piped from stdin." << std::endl;
+                return 1;
+            }
+            return run_pipeline(true, codec, level_set ? level : codec_default_level(codec),
+                                auto_codec ? (min_speed >= 0 ? min_speed : kAutoMinSpeed) : -1,
+                                block_size > 0 ? block_size : 1024 * 1024, std::max(threads, 0),
+                                input_path, output_file);
+        }
+        if (auto_codec && (level_set || stream_mode || threads >= 0 || block_size > 0 || !dict_path.empty() || !framed)) {
+            std::cerr << "Error: --codec auto picks the level itself and writes a single frame;" << std::endl;
+            std::cerr << "       it cannot be combined with --level, --stream, -j, --block-size, --dict or --no-frame." << std::endl;
+            return 1;
+        }
+        if (!level_set) {
+            level = codec_default_level(codec);
+        }
+        if (block_size > 0 && threads < 0) {
+            threads = 0; // --block-size only applies to the block-parallel container
+        }
+        if (!dict_path.empty() && (stream_mode || threads >= 0)) {
+            std::cerr << "Error: --dict cannot be combined with --stream or -j." << std::endl;
+            return 1;
+        }
+        if (stream_mode) {
+            if (have_text || !input_path.empty()) {
+                std::cerr << "Error: --stream reads its input from stdin." << std::endl;
+                return 1;
+            }
+            return run_stream(codec, STREAM_COMPRESS, level);
+        }
 
-    if (operation == "compress") {
-        std::string input_data;
-        if (argc > 2) {
-            input_data = argv[2];
-        } else {
+        InputFile input_file;
+        if (!input_path.empty()) {
+            if (have_text) {
+                std::cerr << "Error: Give either text or -i, not both." << std::endl;
+                return 1;
+            }
+            if (!input_file.open(input_path)) {
+                return 1;
+            }
+        } else if (!have_text) {
             // Check if stdin is coming from a pipe or redirect
             if (!isatty(fileno(stdin))) {
-                 std::cerr << "Reading from stdin..." << std::endl;
-                std::string line;
-                while (std::getline(std::cin, line)) {
-                    input_data += line + "\n";
-                }
-                // Remove the last newline if it was added by the loop and input wasn't empty
-                if (!input_data.empty() && input_data.back() == '\n') {
-                    input_data.pop_back();
+                std::cerr << "Reading from stdin..." << std::endl;
+                // The bytes are compressed verbatim; a redirected file is mapped like -i
+                if (!input_file.open("stdin", STDIN_FILENO)) {
+                    return 1;
                 }
             } else {
                  // No argument and not a pipe, print usage
@@ -91,110 +1590,319 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
         }
+        const char* input = have_text ? input_data.data() : input_file.data();
+        size_t input_len = have_text ? input_data.length() : input_file.size();
 
-        if (input_data.empty()) {
+        if (input_len == 0) {
             std::cerr << "No input data provided for compression." << std::endl;
             return 1;
         }
+        if (!input_path.empty() && same_file(input_path, output_file)) {
+            std::cerr << "Error: Output file '" << output_file << "' is the input file." << std::endl;
+            return 1;
+        }
 
-        std::cout << "Original data length: " << input_data.length() << " bytes" << std::endl;
+        std::cout << "Original data length: " << input_len << " bytes" << std::endl;
         // std::cout << "Original data: \"" << input_data << "\"" << std::endl; // Optional: print original data
 
-        CompressedData compressed = compress_string(input_data.c_str(), input_data.length());
-        if (compressed.buffer == nullptr) {
-            std::cerr << "Compression failed! The returned buffer is null." << std::endl;
-            // The Rust side might print more specific errors if compiled with verbose-errors
+        size_t compressed_length = 0;
+        int rc;
+        if (auto_codec) {
+            // Select up front (rather than compress_frame_auto_into) to size and report the choice
+            rc = codec_auto_select(input, input_len, min_speed >= 0 ? min_speed : kAutoMinSpeed, &codec, &level);
+            if (rc != CODEC_OK) {
+                std::cerr << "Codec selection failed! Error code: " << rc << std::endl;
+                return 1;
+            }
+            std::cout << "Auto-selected codec: " << codec_name(codec);
+            if (codec != CODEC_STORED) {
+                std::cout << " level " << level;
+            }
+            std::cout << std::endl;
+        }
+        // The codec writes straight into the (mapped) output file
+        size_t bound = threads >= 0 ? compress_parallel_bound(codec, input_len, block_size)
+                     : framed ? frame_compress_bound(codec, input_len)
+                     : codec_compress_bound(codec, input_len);
+        if (bound == 0) {
+            std::cerr << "Error: Input is too large for this codec (try -j)." << std::endl;
             return 1;
         }
-         if (compressed.length == 0 && !input_data.empty()) {
-            std::cerr << "Compression resulted in zero length, but input was not empty. This might indicate an error." << std::endl;
-            // Potentially free and return, or let it proceed if 0-length is valid for some inputs
+        OutputFile output;
+        if (!output.open(output_file, bound)) {
+            return 1;
+        }
+        if (threads >= 0) {
+            rc = compress_parallel_into(codec, level, threads, block_size, input, input_len,
+                                        output.data(), output.capacity(), &compressed_length);
+        } else if (!dict_path.empty()) {
+            rffi::Dictionary dict = load_dictionary(dict_path, codec, level);
+            if (!dict) {
+                return 1;
+            }
+            rc = rffi::visit_codec(codec, [&](auto tag) {
+                rffi::Compressor<decltype(tag)::value> compressor;
+                int status = compressor.set_level(level);
+                if (status != CODEC_OK) {
+                    return status;
+                }
+                compressor.set_dict(dict);
+                rffi::ByteView in(input, input_len);
+                rffi::MutableByteView out(output.data(), output.capacity());
+                return framed ? compressor.compress_frame(FRAME_CHECKSUM, in, out, compressed_length)
+                              : compressor.compress(in, out, compressed_length);
+            });
+        } else if (framed) {
+            rc = compress_frame_into(codec, level, FRAME_CHECKSUM, input, input_len,
+                                     output.data(), output.capacity(), &compressed_length);
+        } else {
+            rc = compress_string_level_into(codec, level, input, input_len,
+                                            output.data(), output.capacity(), &compressed_length);
+        }
+        if (rc == CODEC_ERR_INVALID_ARG) {
+            int min_level = 0, max_level = 0;
+            codec_level_range(codec, &min_level, &max_level);
+            std::cerr << "Error: Level " << level << " is out of range (" << min_level << ".." << max_level << ")." << std::endl;
+            return 1;
+        }
+        if (rc != CODEC_OK) {
+            std::cerr << "Compression failed! Error code: " << rc << std::endl;
+            // The Rust side might print more specific errors if compiled with verbose-errors
+            return 1;
         }
 
-
-        std::cout << "Compressed data length: " << compressed.length << " bytes" << std::endl;
-        if (input_data.length() > 0) {
+        std::cout << "Compressed data length: " << compressed_length << " bytes" << std::endl;
+        if (input_len > 0) {
             std::cout << "Compression ratio: " << std::fixed << std::setprecision(2)
-                      << (static_cast<double>(compressed.length) / input_data.length()) * 100.0
+                      << (static_cast<double>(compressed_length) / input_len) * 100.0
                       << "%" << std::endl;
         } else {
             std::cout << "Compression ratio: N/A (original data was empty)" << std::endl;
         }
 
 
-        size_t preview_len = std::min(static_cast<size_t>(compressed.length), static_cast<size_t>(16));
+        size_t preview_len = std::min(compressed_length, static_cast<size_t>(16));
         std::cout << "Compressed data (first " << preview_len << " bytes as hex): ";
-        std::cout << bytes_to_hex_string(compressed.buffer, preview_len) << std::endl;
+        std::cout << bytes_to_hex_string(output.data(), preview_len) << std::endl;
 
-        std::string output_file = "compressed_output.bin";
-        std::ofstream outfile(output_file, std::ios::binary);
-        if (!outfile.is_open()) {
-             std::cerr << "Error opening output file: " << output_file << std::endl;
-             free_compressed_data(compressed);
-             return 1;
-        }
-        outfile.write(compressed.buffer, compressed.length);
-        outfile.close();
+        if (!output.commit(compressed_length)) {
+            return 1;
+        }
         std::cout << "Compressed data written to: " << output_file << std::endl;
-        std::cout << "To decompress: " << argv[0] << " decompress " << output_file << std::endl;
-
-        free_compressed_data(compressed);
+        std::cout << "To decompress: " << argv[0] << " decompress";
+        if (threads >= 0) {
+            std::cout << " -j " << threads;
+        } else if (!framed && codec != CODEC_ZLIB) {
+            std::cout << " --codec " << codec_name(codec);
+        }
+        if (!dict_path.empty()) {
+            std::cout << " --dict " << dict_path;
+        }
+        std::cout << " " << output_file << std::endl;
 
     } else if (operation == "decompress") {
-        if (argc < 3) {
+        int codec = CODEC_ZLIB;
+        bool stream_mode = false;
+        bool pipeline = false;
+        int threads = 0;
+        std::string dict_path;
+        std::string file_path;
+        std::string output_file = "decompressed_output.txt";
+        bool output_set = false;
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--stream") {
+                stream_mode = true;
+            } else if (arg == "--pipeline") {
+                pipeline = true;
+            } else if (arg == "--dict" && i + 1 < argc) {
+                dict_path = argv[++i];
+            } else if (arg == "-i" && i + 1 < argc) {
+                file_path = argv[++i];
+            } else if (arg == "-o" && i + 1 < argc) {
+                output_file = argv[++i];
+                output_set = true;
+            } else if (arg == "-j" && i + 1 < argc) {
+                if (!parse_threads(argv[++i], threads)) {
+                    return 1;
+                }
+            } else if (arg == "--codec" && i + 1 < argc) {
+                codec = parse_codec(argv[++i]);
+                if (codec < 0) {
+                    std::cerr << "Error: Unknown codec '" << argv[i] << "'." << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--max-output" && i + 1 < argc) {
+                if (!parse_size(argv[++i], g_max_output)) {
+                    return 1;
+                }
+            } else {
+                file_path = arg;
+            }
+        }
+        if (stream_mode) {
+            if (!file_path.empty() || output_set) {
+                std::cerr << "Error: --stream reads its input from stdin." << std::endl;
+                return 1;
+            }
+            return run_stream(codec, STREAM_DECOMPRESS, 0);
+        }
+        if (pipeline) {
+            if (!dict_path.empty()) {
+                std::cerr << "Error: --pipeline cannot be combined with --dict." << std::endl;
+                return 1;
+            }
+            if (file_path.empty() && isatty(fileno(stdin))) {
+                std::cerr << "Error: --pipeline needs a file or data piped from stdin." << std::endl;
+                return 1;
+            }
+            return run_pipeline(false, codec, 0, -1, 0, threads, file_path, output_file);
+        }
+        if (file_path.empty()) {
             std::cerr << "Error: Decompress requires a file path." << std::endl;
             print_usage(argv[0]);
             return 1;
         }
-        std::string file_path = argv[2];
-        std::ifstream infile(file_path, std::ios::binary | std::ios::ate);
-        if (!infile.is_open()) {
-            std::cerr << "Error reading file '" << file_path << "'" << std::endl;
+        if (same_file(file_path, output_file)) {
+            std::cerr << "Error: Output file '" << output_file << "' is the input file." << std::endl;
             return 1;
         }
-
-        std::streamsize size = infile.tellg();
-        infile.seekg(0, std::ios::beg);
-        std::vector<char> buffer(size);
-        if (!infile.read(buffer.data(), size)) {
-            std::cerr << "Error reading file content from '" << file_path << "'" << std::endl;
-            infile.close();
+        InputFile input_file;
+        if (!input_file.open(file_path)) {
             return 1;
         }
-        infile.close();
+        const char* input = input_file.data();
+        size_t input_len = input_file.size();
 
-        if (buffer.empty()) {
+        if (input_len == 0) {
             std::cerr << "Warning: Input file '" << file_path << "' is empty." << std::endl;
             // Decide if this is an error or should proceed. The Rust lib might handle it.
         }
 
-        std::cout << "Compressed data length: " << buffer.size() << " bytes" << std::endl;
+        std::cout << "Compressed data length: " << input_len << " bytes" << std::endl;
+
+        // Size the output from the header, then decode straight into the (mapped) output file
+        size_t original_length = 0;
+        size_t decompressed_len = 0;
+        FrameInfo frame;
+        bool parallel = parallel_decompressed_length(input, input_len, &original_length) == CODEC_OK;
+        bool framed = !parallel && frame_header_info(input, input_len, &frame) == CODEC_OK;
+        if (framed && frame.frame_len < input_len && dict_path.empty()) {
+            // Concatenated frames, e.g. from compress --pipeline
+            std::cerr << "Input holds several frames; decoding them with --pipeline." << std::endl;
+            return run_pipeline(false, codec, 0, -1, 0, threads, file_path, output_file);
+        }
+        if (framed) {
+            original_length = frame.original_len;
+        } else if (!parallel && decompressed_length(input, input_len, &original_length) != CODEC_OK) {
+            std::cerr << "Decompression failed! Invalid length header." << std::endl;
+            return 1;
+        }
+        std::string implausible = check_declared_size(original_length, input_len);
+        if (!implausible.empty()) {
+            std::cerr << "Decompression failed! The " << implausible << "." << std::endl;
+            return 1;
+        }
+        OutputFile output;
+        if (!output.open(output_file, original_length)) {
+            return 1;
+        }
 
-        DecompressedData decompressed = decompress_data(buffer.data(), buffer.size());
-        if (decompressed.buffer == nullptr) {
-            std::cerr << "Decompression failed! The returned buffer is null." << std::endl;
+        int rc;
+        if (parallel) {
+            // Block-parallel container (compress -j); the codec is recorded inside
+            rc = decompress_parallel_into(threads, input, input_len,
+                                          output.data(), output.capacity(), &decompressed_len);
+        } else if (framed) {
+            // Self-describing frame: the codec comes from the header, --codec is not needed
+            if (frame.flags & FRAME_DICT) {
+                if (dict_path.empty()) {
+                    std::cerr << "Decompression failed! Data was compressed with a dictionary; pass --dict." << std::endl;
+                    return 1;
+                }
+                rffi::Dictionary dict = load_dictionary(dict_path, frame.codec, codec_default_level(frame.codec));
+                if (!dict) {
+                    return 1;
+                }
+                rffi::Context ctx(frame.codec);
+                ctx.set_dict(dict);
+                rc = ctx.decompress_frame(rffi::ByteView(input, input_len),
+                                          rffi::MutableByteView(output.data(), output.capacity()), decompressed_len);
+            } else {
+                rc = decompress_auto_into(input, input_len, output.data(), output.capacity(), &decompressed_len);
+            }
+            if (rc == CODEC_ERR_CHECKSUM) {
+                std::cerr << "Decompression failed! Checksum mismatch, the file is corrupt." << std::endl;
+                return 1;
+            }
+            if (rc == CODEC_ERR_DICT_MISMATCH) {
+                std::cerr << "Decompression failed! Data was compressed with a different dictionary." << std::endl;
+                return 1;
+            }
+        } else {
+            rffi::Dictionary dict;
+            if (!dict_path.empty()) {
+                dict = load_dictionary(dict_path, codec, codec_default_level(codec));
+                if (!dict) {
+                    return 1;
+                }
+            }
+            rc = rffi::visit_codec(codec, [&](auto tag) {
+                using Compressor = rffi::Compressor<decltype(tag)::value>;
+                rffi::ByteView in(input, input_len);
+                rffi::MutableByteView out(output.data(), output.capacity());
+                if (!dict) {
+                    return Compressor::decompress_once(in, out, decompressed_len);
+                }
+                Compressor compressor;
+                compressor.set_dict(dict);
+                return compressor.decompress(in, out, decompressed_len);
+            });
+            if (rc == CODEC_ERR_DICT_MISMATCH) {
+                uint32_t wanted = 0;
+                compressed_dict_id(input, input_len, &wanted);
+                std::cerr << "Decompression failed! Data needs dictionary ID " << wanted << "." << std::endl;
+                return 1;
+            }
+        }
+        if (rc != CODEC_OK) {
+            std::cerr << "Decompression failed! Error code: " << rc << std::endl;
             // The Rust side might print more specific errors
             return 1;
         }
 
-        std::cout << "Decompressed data length: " << decompressed.length << " bytes" << std::endl;
-        std::cout << "Decompressed data: \"";
-        // Ensure null termination for safety if printing directly, or print char by char
-        std::string decompressed_str(decompressed.buffer, decompressed.length);
-        std::cout << decompressed_str << "\"" << std::endl;
-        
-        std::string output_file = "decompressed_output.txt";
-        std::ofstream outfile_text(output_file);
-        if (!outfile_text.is_open()) {
-             std::cerr << "Error opening output file: " << output_file << std::endl;
-             free_decompressed_data(decompressed);
-             return 1;
-        }
-        outfile_text.write(decompressed.buffer, decompressed.length);
-        outfile_text.close();
+        std::cout << "Decompressed data length: " << decompressed_len << " bytes" << std::endl;
+        if (!output_set) {
+            // Only echo the data for the default output; -o is meant for large files
+            std::cout << "Decompressed data: \"";
+            std::cout.write(output.data(), static_cast<std::streamsize>(decompressed_len));
+            std::cout << "\"" << std::endl;
+        }
+        if (!output.commit(decompressed_len)) {
+            return 1;
+        }
         std::cout << "Decompressed data written to: " << output_file << std::endl;
 
-        free_decompressed_data(decompressed);
+    } else if (operation == "extract") {
+        return run_extract(argc - 2, argv + 2);
+
+    } else if (operation == "train-dict") {
+        return run_train_dict(argc - 2, argv + 2);
+
+    } else if (operation == "compress-batch" || operation == "decompress-batch") {
+        return run_batch(operation == "compress-batch", argc - 2, argv + 2);
+
+    } else if (operation == "serve") {
+        return run_serve(argc - 2, argv + 2);
+
+    } else if ((operation == "encode-varint" || operation == "decode-varint") && argc > 3 &&
+               std::string(argv[2]) == "--format") {
+        std::string format = argv[3];
+        if (format != "streamvbyte") {
+            std::cerr << "Error: Unknown format '" << format << "' (expected streamvbyte; omit --format for LEB128)." << std::endl;
+            return 1;
+        }
+        return run_streamvbyte(operation == "encode-varint", argc - 4, argv + 4);
 
     } else if (operation == "encode-varint") {
         if (argc < 3) {
@@ -259,6 +1967,609 @@ int main(int argc, char* argv[]) {
 
     return 0;
 }
+
+// Runtime statistics dump (cpp_app stats)
+
+const char* const kStatsOps[] = {"compress", "decompress"};
+
+// Status names for codec_stats.errors_by_code, indexed by -CODEC_ERR_*
+const char* const kStatsErrorNames[CODEC_STATS_ERROR_CODES] = {
+    "", "invalid_arg", "buffer_too_small", "corrupt", "too_large", "codec",
+    "alloc", "dict_mismatch", "checksum", "wrong_codec",
+};
+
+// Upper edge in ns of the latency bucket holding quantile q, or 0 without calls
+double stats_latency_quantile(const codec_op_stats& op, double q) {
+    uint64_t total = 0;
+    for (uint64_t n : op.latency) {
+        total += n;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1, seen = 0;
+    for (int i = 0; i < CODEC_STATS_BUCKETS; ++i) {
+        seen += op.latency[i];
+        if (seen >= rank) {
+            return std::ldexp(1.0, i + 1);
+        }
+    }
+    return std::ldexp(1.0, CODEC_STATS_BUCKETS);
+}
+
+void write_stats_text(std::ostream& os, const codec_stats& stats) {
+    os << std::left << std::setw(8) << "codec" << std::setw(12) << "op" << std::right << std::setw(10) << "calls"
+       << std::setw(8) << "errors" << std::setw(14) << "bytes_in" << std::setw(14) << "bytes_out" << std::setw(8)
+       << "ratio" << std::setw(12) << "mean_us" << std::setw(10) << "p50<=us" << std::setw(10) << "p99<=us" << std::endl;
+    for (int codec = 0; codec < CODEC_STATS_CODECS; ++codec) {
+        for (int op = 0; op < 2; ++op) {
+            const codec_op_stats& s = stats.ops[codec][op];
+            if (s.calls == 0) {
+                continue;
+            }
+            double ratio = s.bytes_in > 0 ? static_cast<double>(s.bytes_out) / s.bytes_in : 0;
+            os << std::left << std::setw(8) << codec_name(codec) << std::setw(12) << kStatsOps[op] << std::right
+               << std::setw(10) << s.calls << std::setw(8) << s.errors << std::setw(14) << s.bytes_in << std::setw(14)
+               << s.bytes_out << std::fixed << std::setprecision(3) << std::setw(8) << ratio << std::setprecision(1)
+               << std::setw(12) << s.total_ns / 1e3 / s.calls << std::setw(10) << stats_latency_quantile(s, 0.50) / 1e3
+               << std::setw(10) << stats_latency_quantile(s, 0.99) / 1e3 << std::endl;
+        }
+    }
+    os << "errors:";
+    for (int code = 1; code < CODEC_STATS_ERROR_CODES; ++code) {
+        os << " " << kStatsErrorNames[code] << "=" << stats.errors_by_code[code];
+    }
+    os << "\nbad_varint=" << stats.bad_varint << " over_size_cap=" << stats.over_size_cap << std::endl;
+}
+
+// Prometheus text exposition format, e.g. for node_exporter's textfile collector
+void write_stats_prometheus(std::ostream& os, const codec_stats& stats) {
+    struct Counter {
+        const char* name;
+        const char* help;
+        uint64_t codec_op_stats::*field;
+    };
+    const Counter counters[] = {
+        {"calls", "Codec calls, failed ones included", &codec_op_stats::calls},
+        {"call_errors", "Codec calls that returned an error", &codec_op_stats::errors},
+        {"bytes_in", "Input bytes of successful codec calls", &codec_op_stats::bytes_in},
+        {"bytes_out", "Output bytes of successful codec calls", &codec_op_stats::bytes_out},
+    };
+    auto labels = [](int codec, int op) {
+        return std::string("codec=\"") + codec_name(codec) + "\",op=\"" + kStatsOps[op] + "\"";
+    };
+    for (const Counter& c : counters) {
+        os << "# HELP rffi_codec_" << c.name << "_total " << c.help << ".\n";
+        os << "# TYPE rffi_codec_" << c.name << "_total counter\n";
+        for (int codec = 0; codec < CODEC_STATS_CODECS; ++codec) {
+            for (int op = 0; op < 2; ++op) {
+                os << "rffi_codec_" << c.name << "_total{" << labels(codec, op) << "} " << stats.ops[codec][op].*c.field
+                   << "\n";
+            }
+        }
+    }
+    os << "# HELP rffi_codec_latency_seconds Duration of codec calls.\n";
+    os << "# TYPE rffi_codec_latency_seconds histogram\n";
+    for (int codec = 0; codec < CODEC_STATS_CODECS; ++codec) {
+        for (int op = 0; op < 2; ++op) {
+            const codec_op_stats& s = stats.ops[codec][op];
+            uint64_t cumulative = 0;
+            for (int i = 0; i < CODEC_STATS_BUCKETS - 1; ++i) {
+                cumulative += s.latency[i];
+                os << "rffi_codec_latency_seconds_bucket{" << labels(codec, op) << ",le=\""
+                   << std::ldexp(1.0, i + 1) / 1e9 << "\"} " << cumulative << "\n";
+            }
+            os << "rffi_codec_latency_seconds_bucket{" << labels(codec, op) << ",le=\"+Inf\"} " << s.calls << "\n";
+            os << "rffi_codec_latency_seconds_sum{" << labels(codec, op) << "} " << s.total_ns / 1e9 << "\n";
+            os << "rffi_codec_latency_seconds_count{" << labels(codec, op) << "} " << s.calls << "\n";
+        }
+    }
+    os << "# HELP rffi_codec_errors_total Failed calls by status code.\n";
+    os << "# TYPE rffi_codec_errors_total counter\n";
+    for (int code = 1; code < CODEC_STATS_ERROR_CODES; ++code) {
+        os << "rffi_codec_errors_total{reason=\"" << kStatsErrorNames[code] << "\"} " << stats.errors_by_code[code]
+           << "\n";
+    }
+    os << "# HELP rffi_bad_varint_total Varints (e.g. length headers) that failed to decode.\n";
+    os << "# TYPE rffi_bad_varint_total counter\n";
+    os << "rffi_bad_varint_total " << stats.bad_varint << "\n";
+    os << "# HELP rffi_over_size_cap_total Allocating decompressions refused for an original length over 100 MB.\n";
+    os << "# TYPE rffi_over_size_cap_total counter\n";
+    os << "rffi_over_size_cap_total " << stats.over_size_cap << "\n";
+}
+
+// cpp_app stats [--format text|prometheus] [--stats-file FILE] <command> [args...]
+// Runs the command, then dumps the library counters it produced to stderr or FILE.
+// The command's exit code is kept.
+int run_stats(int argc, char* argv[]) {
+    std::string format = "text", stats_file;
+    int i = 2;
+    for (; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            format = argv[++i];
+            if (format != "text" && format != "prometheus") {
+                std::cerr << "Error: Unknown stats format '" << format << "' (expected text or prometheus)." << std::endl;
+                return 1;
+            }
+        } else if (arg == "--stats-file" && i + 1 < argc) {
+            stats_file = argv[++i];
+        } else {
+            break;
+        }
+    }
+    if (i >= argc || std::string(argv[i]) == "stats") {
+        std::cerr << "Error: stats requires a command to run." << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // The command sees argv[0] followed by its own arguments
+    std::vector<char*> command_argv = {argv[0]};
+    command_argv.insert(command_argv.end(), argv + i, argv + argc);
+    command_argv.push_back(nullptr);
+    std::cout.flush();
+    int rc = run_operation(static_cast<int>(command_argv.size()) - 1, command_argv.data());
+    std::cout.flush();
+
+    codec_stats stats;
+    get_codec_stats(&stats);
+    if (!stats.enabled) {
+        std::cerr << "Warning: the library was built without statistics (CODEC_NO_STATS)." << std::endl;
+    }
+    std::ofstream file;
+    if (!stats_file.empty()) {
+        file.open(stats_file);
+        if (!file) {
+            std::cerr << "Error: Cannot open '" << stats_file << "' for writing." << std::endl;
+            return rc != 0 ? rc : 1;
+        }
+    }
+    std::ostream& os = stats_file.empty() ? std::cerr : file;
+    if (format == "prometheus") {
+        write_stats_prometheus(os, stats);
+    } else {
+        write_stats_text(os, stats);
+    }
+    os.flush();
+    if (!os) {
+        std::cerr << "Error: Failed to write statistics." << std::endl;
+        return rc != 0 ? rc : 1;
+    }
+    return rc;
+}
+
+// Server mode (cpp_app serve)
+//
+// A long-lived process answers a stream of small requests, so each one costs the codec
+// call rather than process start-up, context creation and buffer allocation. Messages
+// are length-prefixed (lengths are LEB128 varints, as in the bare codec format):
+//   request:  [op u8][codec u8][level i8][payload length][payload]
+//   response: [status u8][payload length][payload]
+// status is 0 on success, -CODEC_ERR_* for library errors and kServeBadRequest /
+// kServeTooLarge for requests the server refuses; error payloads are a message text.
+
+enum ServeOp : unsigned char {
+    kServeCompress = 1,       // payload -> checksummed frame (codec 0xFF = auto)
+    kServeDecompress = 2,     // frame, frame sequence or -j container -> original bytes
+    kServeCompressRaw = 3,    // payload -> bare [length][payload] format of codec
+    kServeDecompressRaw = 4,  // bare format of codec -> original bytes
+    kServeEncodeVarint = 5,   // little-endian u64 array -> LEB128 varints
+    kServeDecodeVarint = 6,   // LEB128 varints -> little-endian u64 array
+    kServeStats = 7,          // library counters in Prometheus text format
+    kServeEcho = 8,           // payload echoed back (health checks, round-trip timing)
+};
+
+const unsigned char kServeAutoCodec = 0xFF;
+const int kServeDefaultLevel = -128;
+const int kServeBadRequest = 64;
+const int kServeTooLarge = 65;
+
+// One client connection (or stdin/stdout). Keeps a warm context per codec and reuses
+// its request and response buffers, so steady-state requests do not allocate.
+class ServeSession {
+public:
+    ServeSession(int in_fd, int out_fd, size_t max_message, double min_speed)
+        : in_fd_(in_fd), out_fd_(out_fd), max_message_(max_message), min_speed_(min_speed), rbuf_(64 * 1024) {}
+
+    // Answer requests until end of input; returns false on a truncated or unreadable
+    // request stream (which cannot be resynchronised) or a failed write
+    bool run() {
+        for (;;) {
+            unsigned char header[3];
+            bool clean_eof = false;
+            if (!read_exact(reinterpret_cast<char*>(header), 3, &clean_eof)) {
+                return clean_eof;
+            }
+            uint64_t len = 0;
+            if (!read_length(&len)) {
+                respond_error(kServeBadRequest, "malformed or truncated payload length");
+                return false;
+            }
+            if (len > max_message_) {
+                respond_error(kServeTooLarge, "request payload over --max-message");
+                return false;
+            }
+            payload_.resize(len);
+            if (!read_exact(payload_.data(), len, nullptr)) {
+                respond_error(kServeBadRequest, "truncated payload");
+                return false;
+            }
+            if (!handle(header[0], header[1], static_cast<signed char>(header[2]))) {
+                return false;
+            }
+        }
+    }
+
+private:
+    // Room left in front of the response body for the status byte and length varint
+    static const size_t kHeaderRoom = 11;
+
+    // Copy len bytes from the buffered input; *clean_eof is set when the input ends
+    // before the first byte
+    bool read_exact(char* dst, size_t len, bool* clean_eof) {
+        size_t done = 0;
+        while (done < len) {
+            if (rpos_ == rend_) {
+                // Large payloads bypass the buffer
+                char* target = len - done >= rbuf_.size() ? dst + done : rbuf_.data();
+                size_t want = target == rbuf_.data() ? rbuf_.size() : len - done;
+                ssize_t n = ::read(in_fd_, target, want);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    if (clean_eof != nullptr) {
+                        *clean_eof = n == 0 && done == 0;
+                    }
+                    return false;
+                }
+                if (target != rbuf_.data()) {
+                    done += static_cast<size_t>(n);
+                    continue;
+                }
+                rpos_ = 0;
+                rend_ = static_cast<size_t>(n);
+            }
+            size_t take = std::min(len - done, rend_ - rpos_);
+            memcpy(dst + done, rbuf_.data() + rpos_, take);
+            rpos_ += take;
+            done += take;
+        }
+        return true;
+    }
+
+    bool read_length(uint64_t* len) {
+        *len = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            char byte;
+            if (!read_exact(&byte, 1, nullptr)) {
+                return false;
+            }
+            *len |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Size body_ for a response of up to cap bytes; false if that would exceed the limit
+    bool reserve_body(size_t cap) {
+        if (cap == 0 || cap > max_message_) {
+            return false;
+        }
+        if (out_.size() < kHeaderRoom + cap) {
+            out_.resize(kHeaderRoom + cap);
+        }
+        return true;
+    }
+
+    char* body() { return out_.data() + kHeaderRoom; }
+
+    // Send the first len bytes of body() with the given status
+    bool respond(int status, size_t len) {
+        char header[kHeaderRoom];
+        size_t header_len = 0;
+        header[header_len++] = static_cast<char>(status);
+        uint64_t v = len;
+        do {
+            header[header_len] = static_cast<char>(v & 0x7F);
+            v >>= 7;
+            if (v != 0) {
+                header[header_len] |= 0x80;
+            }
+            ++header_len;
+        } while (v != 0);
+        char* start = body() - header_len;
+        memcpy(start, header, header_len);
+        size_t total = header_len + len, done = 0;
+        while (done < total) {
+            ssize_t n = ::write(out_fd_, start + done, total - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool respond_error(int status, const std::string& message) {
+        if (out_.size() < kHeaderRoom + message.size()) {
+            out_.resize(kHeaderRoom + message.size());
+        }
+        memcpy(body(), message.data(), message.size());
+        return respond(status, message.size());
+    }
+
+    bool respond_rc(int rc, size_t len, const char* what) {
+        if (rc == CODEC_OK) {
+            return respond(0, len);
+        }
+        return respond_error(-rc, std::string(what) + " failed (error " + std::to_string(rc) + ")");
+    }
+
+    // Warm context for codec at level (kServeDefaultLevel = codec default), or null if
+    // the codec or level is invalid
+    rffi::Context* context(int codec, int level) {
+        if (codec < CODEC_ZLIB || codec > CODEC_ZSTD) {
+            return nullptr;
+        }
+        rffi::Context& ctx = ctxs_[codec];
+        if (!ctx) {
+            ctx = rffi::Context(codec);
+            levels_[codec] = codec_default_level(codec);
+            if (!ctx) {
+                return nullptr;
+            }
+        }
+        if (level == kServeDefaultLevel) {
+            level = codec_default_level(codec);
+        }
+        if (level != levels_[codec]) {
+            if (ctx.set_level(level) != CODEC_OK) {
+                return nullptr;
+            }
+            levels_[codec] = level;
+        }
+        return &ctx;
+    }
+
+    bool handle(unsigned char op, unsigned char codec, int level) {
+        const char* in = payload_.data();
+        size_t in_len = payload_.size(), out_len = 0;
+        switch (op) {
+            case kServeCompress:
+            case kServeCompressRaw: {
+                bool framed = op == kServeCompress;
+                bool stored = framed && codec == CODEC_STORED;
+                bool automatic = framed && codec == kServeAutoCodec;
+                rffi::Context* ctx = stored || automatic ? nullptr : context(codec, level);
+                if (!stored && !automatic && ctx == nullptr) {
+                    return respond_error(kServeBadRequest, "unknown codec or level out of range");
+                }
+                size_t bound = framed ? frame_compress_bound(automatic ? CODEC_AUTO : codec, in_len)
+                                      : codec_compress_bound(codec, in_len);
+                if (!reserve_body(bound)) {
+                    return respond_error(kServeTooLarge, "compressed bound over --max-message");
+                }
+                int rc;
+                if (automatic) {
+                    rc = compress_frame_auto_into(min_speed_, FRAME_CHECKSUM, in, in_len, body(), bound, &out_len);
+                } else if (stored) {
+                    rc = compress_frame_into(CODEC_STORED, 0, FRAME_CHECKSUM, in, in_len, body(), bound, &out_len);
+                } else if (framed) {
+                    rc = ctx->compress_frame(FRAME_CHECKSUM, payload_, rffi::MutableByteView(body(), bound), out_len);
+                } else {
+                    rc = ctx->compress(payload_, rffi::MutableByteView(body(), bound), out_len);
+                }
+                return respond_rc(rc, out_len, "compress");
+            }
+            case kServeDecompress:
+            case kServeDecompressRaw: {
+                bool framed = op == kServeDecompress;
+                rffi::Context* ctx = framed ? nullptr : context(codec, kServeDefaultLevel);
+                if (!framed && ctx == nullptr) {
+                    return respond_error(kServeBadRequest, "unknown codec");
+                }
+                size_t original = 0, bad_offset = 0;
+                int rc = framed ? framed_length(in, in_len, &original, &bad_offset)
+                                : decompressed_length(in, in_len, &original);
+                if (rc != CODEC_OK) {
+                    return respond_rc(rc, 0, "reading the original length");
+                }
+                if (original > max_message_) {
+                    return respond_error(kServeTooLarge, "original length over --max-message");
+                }
+                reserve_body(std::max<size_t>(original, 1));
+                rc = framed ? decompress_framed(0, in, in_len, body(), original, &out_len)
+                            : ctx->decompress(payload_, rffi::MutableByteView(body(), original), out_len);
+                return respond_rc(rc, out_len, "decompress");
+            }
+            case kServeEncodeVarint: {
+                if (in_len % 8 != 0) {
+                    return respond_error(kServeBadRequest, "payload is not an array of 8-byte integers");
+                }
+                size_t n = in_len / 8;
+                values_.resize(n);
+                for (size_t i = 0; i < n; ++i) {
+                    uint64_t v = 0;
+                    for (int b = 7; b >= 0; --b) {
+                        v = (v << 8) | static_cast<unsigned char>(in[i * 8 + b]);
+                    }
+                    values_[i] = v;
+                }
+                if (!reserve_body(std::max<size_t>(varint_array_bound(n), 1))) {
+                    return respond_error(kServeTooLarge, "encoded bound over --max-message");
+                }
+                return respond(0, encode_varint_array(values_.data(), n, body()));
+            }
+            case kServeDecodeVarint: {
+                // Every varint ends in the one byte of it below 0x80
+                size_t n = 0;
+                for (size_t i = 0; i < in_len; ++i) {
+                    n += (static_cast<unsigned char>(in[i]) & 0x80) == 0;
+                }
+                if (!reserve_body(std::max<size_t>(n * 8, 1))) {
+                    return respond_error(kServeTooLarge, "decoded array over --max-message");
+                }
+                values_.resize(n);
+                size_t bytes_read = 0;
+                int rc = decode_varint_array(in, in_len, values_.data(), n, &bytes_read);
+                if (rc == CODEC_OK && bytes_read != in_len) {
+                    rc = CODEC_ERR_CORRUPT;
+                }
+                if (rc != CODEC_OK) {
+                    return respond_rc(rc, 0, "decode-varint");
+                }
+                char* out = body();
+                for (size_t i = 0; i < n; ++i) {
+                    for (int b = 0; b < 8; ++b) {
+                        out[i * 8 + b] = static_cast<char>(values_[i] >> (8 * b));
+                    }
+                }
+                return respond(0, n * 8);
+            }
+            case kServeStats: {
+                codec_stats stats;
+                get_codec_stats(&stats);
+                std::ostringstream os;
+                write_stats_prometheus(os, stats);
+                std::string text = os.str();
+                if (!reserve_body(text.size())) {
+                    return respond_error(kServeTooLarge, "statistics over --max-message");
+                }
+                memcpy(body(), text.data(), text.size());
+                return respond(0, text.size());
+            }
+            case kServeEcho:
+                reserve_body(std::max<size_t>(in_len, 1));
+                memcpy(body(), in, in_len);
+                return respond(0, in_len);
+            default:
+                return respond_error(kServeBadRequest, "unknown op " + std::to_string(op));
+        }
+    }
+
+    int in_fd_, out_fd_;
+    size_t max_message_;
+    double min_speed_;
+    std::vector<char> rbuf_;
+    size_t rpos_ = 0, rend_ = 0;
+    std::vector<char> payload_, out_;
+    std::vector<uint64_t> values_;
+    rffi::Context ctxs_[CODEC_ZSTD + 1];
+    int levels_[CODEC_ZSTD + 1] = {};
+};
+
+// Socket path to remove when a SIGINT/SIGTERM stops the server
+char g_serve_socket_path[sizeof(sockaddr_un::sun_path)];
+
+extern "C" void serve_stop(int sig) {
+    unlink(g_serve_socket_path);
+    _exit(128 + sig);
+}
+
+// cpp_app serve [--socket PATH] [--max-message N] [--min-speed MBPS]
+// Without --socket, requests are read from stdin and answered on stdout until EOF.
+// With it, each connection is served on its own thread with its own session.
+int run_serve(int argc, char* argv[]) {
+    std::string socket_path;
+    size_t max_message = 256 * 1024 * 1024;
+    double min_speed = kAutoMinSpeed;
+    for (int i = 0; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (arg == "--max-message" && i + 1 < argc) {
+            if (!parse_size(argv[++i], max_message) || max_message == 0) {
+                return 1;
+            }
+        } else if (arg == "--min-speed" && i + 1 < argc) {
+            try {
+                min_speed = std::stod(argv[++i]);
+            } catch (const std::exception& e) {
+                min_speed = -1;
+            }
+            if (!(min_speed >= 0)) {
+                std::cerr << "Error: Invalid speed '" << argv[i] << "' (MB/s, 0 or more)." << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Error: Unknown serve option '" << arg << "'." << std::endl;
+            return 1;
+        }
+    }
+    // A client hanging up mid-response must end its session, not the server
+    signal(SIGPIPE, SIG_IGN);
+
+    if (socket_path.empty()) {
+        ServeSession session(STDIN_FILENO, STDOUT_FILENO, max_message, min_speed);
+        if (!session.run()) {
+            std::cerr << "Error: Request stream ended mid-message or output failed." << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: Socket path '" << socket_path << "' is too long." << std::endl;
+        return 1;
+    }
+    memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Error: Cannot create socket: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    // Replace a socket left behind by a previous run; refuse to delete anything else
+    struct stat st;
+    if (lstat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(socket_path.c_str());
+    }
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 64) != 0) {
+        std::cerr << "Error: Cannot listen on '" << socket_path << "': " << strerror(errno) << std::endl;
+        close(listen_fd);
+        return 1;
+    }
+    memcpy(g_serve_socket_path, addr.sun_path, sizeof(g_serve_socket_path));
+    signal(SIGINT, serve_stop);
+    signal(SIGTERM, serve_stop);
+    std::cerr << "Listening on " << socket_path << std::endl;
+
+    for (;;) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::cerr << "Error: accept failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        std::thread([fd, max_message, min_speed] {
+            {
+                ServeSession session(fd, fd, max_message, min_speed);
+                session.run();
+            }
+            close(fd);
+        }).detach();
+    }
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::string(argv[1]) == "stats") {
+        return run_stats(argc, argv);
+    }
+    return run_operation(argc, argv);
+}
 // Conditional includes for isatty/fileno are already attempted.
 // If the direct includes above don't solve it, the issue might be more subtle.
 // For now, the explicit includes for unistd.h and cstdio are the primary fix.
@@ -1,9 +1,19 @@
 use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
 use std::hint::black_box;
+use std::sync::Barrier;
+use std::time::{Duration, Instant};
 use rust_ffi_example::{
     compress_rust_string, decompress_rust_data,
     compress_rust_string_lz4, decompress_rust_data_lz4,
-    compress_rust_string_zstd, decompress_rust_data_zstd
+    compress_rust_string_zstd, decompress_rust_data_zstd,
+    Codec, CodecContext, compress_with_level,
+    compress_rust_parallel, decompress_rust_parallel, BatchBuffer,
+    compress, decompress, compress_into, decompress_into,
+    train_dictionary, Dictionary,
+    compress_rust_parallel_blocks, RangeReader,
+    compress_rust_frame, compress_rust_frame_auto, Arena,
+    crc32c, crc32c_kernel_name,
+    encode_records, RecordReader, decode_varint_rust
 };
 
 fn generate_test_data(size: usize, pattern: &str) -> String {
@@ -158,6 +168,538 @@ fn bench_real_world_data(c: &mut Criterion) {
     group.finish();
 }
 
+// One-shot calls vs. a reused CodecContext on the same small messages,
+// where per-call context setup dominates.
+fn bench_context_reuse_small_strings(c: &mut Criterion) {
+    let test_cases = vec![
+        ("single_char", "A"),
+        ("small_string", "Hello"),
+        ("medium_string", "The quick brown fox jumps over the lazy dog"),
+        ("json_record", r#"{"id":1234,"name":"John","city":"New York","tags":["a","b"]}"#),
+    ];
+
+    let mut group = c.benchmark_group("context_reuse_small_strings");
+
+    for (name, data) in test_cases {
+        group.bench_function(BenchmarkId::new("zlib_one_shot", name), |b| {
+            b.iter(|| compress_rust_string(black_box(data)).unwrap());
+        });
+        group.bench_function(BenchmarkId::new("lz4_one_shot", name), |b| {
+            b.iter(|| compress_rust_string_lz4(black_box(data)).unwrap());
+        });
+        group.bench_function(BenchmarkId::new("zstd_one_shot", name), |b| {
+            b.iter(|| compress_rust_string_zstd(black_box(data)).unwrap());
+        });
+
+        for (codec_name, codec) in [("zlib_ctx", Codec::Zlib), ("lz4_ctx", Codec::Lz4), ("zstd_ctx", Codec::Zstd)] {
+            let mut ctx = CodecContext::new(codec).unwrap();
+            let mut output = Vec::new();
+            group.bench_function(BenchmarkId::new(codec_name, name), |b| {
+                b.iter(|| ctx.compress_into(black_box(data.as_bytes()), &mut output).unwrap());
+            });
+        }
+    }
+    group.finish();
+}
+
+// Level vs. throughput curves for each codec on the same log-like payload.
+// The compressed size at each level is printed once during setup so ratio can be
+// read alongside criterion's throughput figures.
+fn bench_compression_levels(c: &mut Criterion) {
+    let data = "[2023-01-01 12:00:00] INFO: Application started successfully\n[2023-01-01 12:00:01] DEBUG: Loading configuration file\n[2023-01-01 12:00:02] WARN: Configuration file not found, using defaults\n".repeat(600);
+    let cases = vec![
+        (Codec::Zlib, "zlib", vec![1, 3, 6, 9]),
+        (Codec::Lz4, "lz4", vec![-16, -4, 0, 3, 9, 12]),
+        (Codec::Zstd, "zstd", vec![-5, -1, 1, 3, 9, 19]),
+    ];
+
+    let mut group = c.benchmark_group("compression_levels");
+    group.throughput(Throughput::Bytes(data.len() as u64));
+
+    for (codec, codec_name, levels) in cases {
+        for level in levels {
+            let compressed = compress_with_level(codec, level, data.as_bytes()).unwrap();
+            println!("{} level {}: {} -> {} bytes ({:.2}%)", codec_name, level, data.len(), compressed.len(),
+                     compressed.len() as f64 / data.len() as f64 * 100.0);
+
+            let mut ctx = CodecContext::with_level(codec, level).unwrap();
+            let mut output = Vec::new();
+            group.bench_function(BenchmarkId::new(format!("{}_compress", codec_name), level), |b| {
+                b.iter(|| ctx.compress_into(black_box(data.as_bytes()), &mut output).unwrap());
+            });
+
+            let mut decompressed = Vec::new();
+            group.bench_function(BenchmarkId::new(format!("{}_decompress", codec_name), level), |b| {
+                b.iter(|| ctx.decompress_into(black_box(&compressed), &mut decompressed).unwrap());
+            });
+        }
+    }
+    group.finish();
+}
+
+// Block-parallel container throughput by thread count on an 8 MiB log-like payload.
+// threads = 1 is the single-core baseline for the same container format.
+fn bench_parallel_compression(c: &mut Criterion) {
+    let data = generate_test_data(8 * 1024 * 1024, "[2023-01-01 12:00:00] INFO: request handled in 12ms status=200\n");
+    let max_threads = std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1);
+    let mut thread_counts = vec![1, 2, 4, 8, max_threads];
+    thread_counts.retain(|&t| t <= max_threads);
+    thread_counts.dedup();
+
+    let mut group = c.benchmark_group("parallel_compression");
+    group.throughput(Throughput::Bytes(data.len() as u64));
+    group.sample_size(10);
+
+    for (codec, codec_name) in [(Codec::Zlib, "zlib"), (Codec::Lz4, "lz4"), (Codec::Zstd, "zstd")] {
+        let compressed = compress_rust_parallel(codec, codec.default_level(), 0, data.as_bytes()).unwrap();
+        for &threads in &thread_counts {
+            group.bench_with_input(BenchmarkId::new(format!("{}_compress", codec_name), threads), &threads, |b, &t| {
+                b.iter(|| compress_rust_parallel(codec, codec.default_level(), t, black_box(data.as_bytes())).unwrap());
+            });
+            group.bench_with_input(BenchmarkId::new(format!("{}_decompress", codec_name), threads), &threads, |b, &t| {
+                b.iter(|| decompress_rust_parallel(t, black_box(&compressed)).unwrap());
+            });
+        }
+    }
+    group.finish();
+}
+
+// Thousands of small records per call: the per-item wrapper loop (CString, FFI call,
+// C allocation, copy and free for each record) against one batch call that writes
+// every result into a reused arena.
+fn bench_batch_small_records(c: &mut Criterion) {
+    let records: Vec<String> = (0..2000)
+        .map(|i| format!("{{\"id\":{},\"user\":\"user{}\",\"event\":\"page_view\",\"ms\":{}}}", i, i % 97, i * 7 % 500))
+        .collect();
+    let inputs: Vec<&[u8]> = records.iter().map(|r| r.as_bytes()).collect();
+    let total_bytes: usize = inputs.iter().map(|r| r.len()).sum();
+
+    let mut group = c.benchmark_group("batch_small_records");
+    group.throughput(Throughput::Bytes(total_bytes as u64));
+
+    group.bench_function("zlib_per_item_loop", |b| {
+        b.iter(|| {
+            for r in &records {
+                black_box(compress_rust_string(black_box(r)).unwrap());
+            }
+        });
+    });
+    group.bench_function("lz4_per_item_loop", |b| {
+        b.iter(|| {
+            for r in &records {
+                black_box(compress_rust_string_lz4(black_box(r)).unwrap());
+            }
+        });
+    });
+    group.bench_function("zstd_per_item_loop", |b| {
+        b.iter(|| {
+            for r in &records {
+                black_box(compress_rust_string_zstd(black_box(r)).unwrap());
+            }
+        });
+    });
+
+    for (codec, codec_name) in [(Codec::Zlib, "zlib"), (Codec::Lz4, "lz4"), (Codec::Zstd, "zstd")] {
+        let mut ctx = CodecContext::new(codec).unwrap();
+        let mut compressed = BatchBuffer::new();
+        group.bench_function(format!("{}_batch", codec_name), |b| {
+            b.iter(|| ctx.compress_batch(black_box(&inputs), &mut compressed).unwrap());
+        });
+
+        ctx.compress_batch(&inputs, &mut compressed).unwrap();
+        let items: Vec<Vec<u8>> = compressed.iter().map(|item| item.to_vec()).collect();
+        let item_refs: Vec<&[u8]> = items.iter().map(|item| item.as_slice()).collect();
+        let mut restored = BatchBuffer::new();
+        group.bench_function(format!("{}_batch_decompress", codec_name), |b| {
+            b.iter(|| ctx.decompress_batch(black_box(&item_refs), &mut restored).unwrap());
+        });
+    }
+    group.finish();
+}
+
+// Multi-MB payloads through the copying String wrappers versus the byte-oriented
+// CBuf (no CString, no to_vec, no UTF-8 check) and *_into (reused Vec) wrappers.
+fn bench_zero_copy_large_payload(c: &mut Criterion) {
+    let data = generate_test_data(8 * 1024 * 1024, "[2023-01-01 12:00:00] INFO: payload chunk uploaded id=42 size=65536\n");
+    let compressed = compress_rust_string_lz4(&data).unwrap();
+
+    let mut group = c.benchmark_group("zero_copy_large_payload");
+    group.throughput(Throughput::Bytes(data.len() as u64));
+    group.sample_size(10);
+
+    group.bench_function("lz4_compress_rust_string", |b| {
+        b.iter(|| compress_rust_string_lz4(black_box(&data)).unwrap());
+    });
+    group.bench_function("lz4_compress_cbuf", |b| {
+        b.iter(|| compress(Codec::Lz4, black_box(data.as_bytes())).unwrap());
+    });
+    let mut output = Vec::new();
+    group.bench_function("lz4_compress_into", |b| {
+        b.iter(|| compress_into(Codec::Lz4, black_box(data.as_bytes()), &mut output).unwrap());
+    });
+
+    group.bench_function("lz4_decompress_rust_data", |b| {
+        b.iter(|| decompress_rust_data_lz4(black_box(&compressed)).unwrap());
+    });
+    group.bench_function("lz4_decompress_cbuf", |b| {
+        b.iter(|| decompress(Codec::Lz4, black_box(&compressed)).unwrap());
+    });
+    let mut restored = Vec::new();
+    group.bench_function("lz4_decompress_into", |b| {
+        b.iter(|| decompress_into(Codec::Lz4, black_box(&compressed), &mut restored).unwrap());
+    });
+    group.finish();
+}
+
+// 100-2000 byte JSON messages with and without a trained dictionary. Compressed sizes
+// are printed at setup; the timings include the per-call dictionary setup that the
+// digested CDict/DDict and preloaded LZ4 stream avoid.
+fn bench_dictionary_small_messages(c: &mut Criterion) {
+    let message = |i: usize| {
+        let tags: Vec<String> = (0..i % 40).map(|t| format!("\"tag{}\"", (i + t) % 23)).collect();
+        format!(
+            "{{\"id\":{},\"user\":\"user{}\",\"event\":\"page_view\",\"path\":\"/products/{}\",\"agent\":\"Mozilla/5.0 (X11; Linux x86_64)\",\"tags\":[{}]}}",
+            i, i % 311, i % 53, tags.join(",")
+        )
+        .into_bytes()
+    };
+    let samples: Vec<Vec<u8>> = (0..2000).map(message).collect();
+    let sample_refs: Vec<&[u8]> = samples.iter().map(|s| s.as_slice()).collect();
+    let content = train_dictionary(&sample_refs, 32 * 1024).unwrap();
+    let messages: Vec<Vec<u8>> = (10_000..11_000).map(message).collect();
+    let total_bytes: usize = messages.iter().map(|m| m.len()).sum();
+
+    let mut group = c.benchmark_group("dictionary_small_messages");
+    group.throughput(Throughput::Bytes(total_bytes as u64));
+
+    for (codec, codec_name) in [(Codec::Zlib, "zlib"), (Codec::Lz4, "lz4"), (Codec::Zstd, "zstd")] {
+        let dict = Dictionary::new(codec, codec.default_level(), &content).unwrap();
+        let mut plain = CodecContext::new(codec).unwrap();
+        let mut with_dict = CodecContext::new(codec).unwrap();
+        with_dict.set_dictionary(Some(&dict)).unwrap();
+
+        let plain_out: Vec<Vec<u8>> = messages.iter().map(|m| plain.compress(m).unwrap()).collect();
+        let dict_out: Vec<Vec<u8>> = messages.iter().map(|m| with_dict.compress(m).unwrap()).collect();
+        println!(
+            "{}: {} bytes -> {} without dictionary, {} with",
+            codec_name,
+            total_bytes,
+            plain_out.iter().map(|m| m.len()).sum::<usize>(),
+            dict_out.iter().map(|m| m.len()).sum::<usize>()
+        );
+
+        let mut output = Vec::new();
+        for (label, ctx, compressed) in [("no_dict", &mut plain, &plain_out), ("dict", &mut with_dict, &dict_out)] {
+            group.bench_function(format!("{}_{}_compress", codec_name, label), |b| {
+                b.iter(|| {
+                    for m in &messages {
+                        ctx.compress_into(black_box(m), &mut output).unwrap();
+                    }
+                });
+            });
+            group.bench_function(format!("{}_{}_decompress", codec_name, label), |b| {
+                b.iter(|| {
+                    for m in compressed {
+                        ctx.decompress_into(black_box(m), &mut output).unwrap();
+                    }
+                });
+            });
+        }
+    }
+    group.finish();
+}
+
+// Reading one 4 KiB record from a 16 MiB container: a RangeReader decodes only the
+// block holding it, against decompressing everything and slicing
+fn bench_range_reads(c: &mut Criterion) {
+    let data = generate_test_data(16 * 1024 * 1024, "[2023-01-01 12:00:00] INFO: request handled in 12ms status=200\n");
+    let offset = data.len() / 2 + 1234;
+    let len = 4096;
+
+    let mut group = c.benchmark_group("range_reads");
+    group.throughput(Throughput::Bytes(len as u64));
+    group.sample_size(20);
+
+    for (codec, codec_name) in [(Codec::Zlib, "zlib"), (Codec::Lz4, "lz4"), (Codec::Zstd, "zstd")] {
+        for block_size in [64 * 1024, 1024 * 1024] {
+            let container = compress_rust_parallel_blocks(codec, codec.default_level(), 0, block_size, data.as_bytes()).unwrap();
+            let mut reader = RangeReader::new(&container).unwrap();
+            let mut out = Vec::new();
+            group.bench_function(BenchmarkId::new(format!("{}_range_read", codec_name), block_size), |b| {
+                b.iter(|| reader.read_into(black_box(offset), len, &mut out).unwrap());
+            });
+            if block_size == 1024 * 1024 {
+                group.bench_function(BenchmarkId::new(format!("{}_full_decompress", codec_name), block_size), |b| {
+                    b.iter(|| decompress_rust_parallel(1, black_box(&container)).unwrap()[offset..offset + len].to_vec());
+                });
+            }
+        }
+    }
+    group.finish();
+}
+
+fn bench_auto_codec_selection(c: &mut Criterion) {
+    // Pseudo-random bytes stand in for already-compressed blobs
+    let mut state = 0x9E37_79B9_7F4A_7C15u64;
+    let random: Vec<u8> = (0..1024 * 1024)
+        .map(|_| {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            (state >> 24) as u8
+        })
+        .collect();
+    let logs = generate_test_data(1024 * 1024, "[2023-01-01 12:00:00] INFO: request handled in 12ms status=200\n").into_bytes();
+
+    let mut group = c.benchmark_group("auto_codec_selection");
+    group.sample_size(20);
+    for (name, data) in [("random", &random), ("logs", &logs)] {
+        group.throughput(Throughput::Bytes(data.len() as u64));
+        for min_mb_per_s in [0.0, 200.0] {
+            group.bench_function(BenchmarkId::new(format!("{}_auto", name), min_mb_per_s), |b| {
+                b.iter(|| compress_rust_frame_auto(black_box(data), min_mb_per_s, true).unwrap());
+            });
+        }
+        group.bench_function(BenchmarkId::new(format!("{}_fixed", name), "zstd_3"), |b| {
+            b.iter(|| compress_rust_frame(Codec::Zstd, 3, black_box(data), true).unwrap());
+        });
+    }
+    group.finish();
+}
+
+fn bench_arena_allocator(c: &mut Criterion) {
+    // One batch of short-lived requests: compress and decompress each message once
+    let messages: Vec<Vec<u8>> = (0..1000)
+        .map(|i| format!("{{\"user\":{},\"event\":\"click\",\"page\":\"/item/{}\",\"ok\":true}}", i, i % 37).into_bytes())
+        .collect();
+    let total: usize = messages.iter().map(|m| m.len()).sum();
+    let run_batch = |codec: Codec| {
+        for m in &messages {
+            let compressed = compress(codec, black_box(m)).unwrap();
+            black_box(decompress(codec, &compressed).unwrap());
+        }
+    };
+
+    let mut group = c.benchmark_group("arena_allocator");
+    group.throughput(Throughput::Bytes(total as u64));
+    let mut arena = Arena::new(64 * 1024 * 1024).unwrap();
+    for (codec, codec_name) in [(Codec::Zlib, "zlib"), (Codec::Lz4, "lz4"), (Codec::Zstd, "zstd")] {
+        group.bench_function(BenchmarkId::new("malloc", codec_name), |b| b.iter(|| run_batch(codec)));
+        group.bench_function(BenchmarkId::new("arena", codec_name), |b| {
+            b.iter(|| unsafe {
+                // Every buffer of the batch is dropped inside the scope, so reset is sound
+                arena.scope(|| run_batch(codec));
+                arena.reset();
+            })
+        });
+    }
+    group.finish();
+}
+
+fn bench_large_payload_decompression(c: &mut Criterion) {
+    // 64 MB of log lines: big enough that preparing the output buffer is measurable
+    let mut data = Vec::with_capacity(64 << 20);
+    let mut i = 0u64;
+    while data.len() < 64 << 20 {
+        data.extend_from_slice(format!("2024-01-01T00:00:{:02} INFO request id={} status={} bytes={}\n",
+                                       i % 60, i, 200 + i % 7, (i * 7919) % 65536).as_bytes());
+        i += 1;
+    }
+    data.truncate(64 << 20);
+
+    let mut group = c.benchmark_group("large_payload_decompression");
+    group.sample_size(10);
+    group.throughput(Throughput::Bytes(data.len() as u64));
+    for (codec, codec_name) in [(Codec::Zlib, "zlib"), (Codec::Lz4, "lz4"), (Codec::Zstd, "zstd")] {
+        let compressed = compress(codec, &data).unwrap();
+        // Work done before the codec can write its first byte: zero-filling the output
+        // (what calloc + memset cost) versus taking fresh, untouched memory
+        group.bench_function(BenchmarkId::new("first_byte/zeroed", codec_name), |b| {
+            b.iter_custom(|iters| {
+                let mut elapsed = Duration::ZERO;
+                for _ in 0..iters {
+                    let start = Instant::now();
+                    let mut out: Vec<u8> = Vec::with_capacity(data.len());
+                    out.resize(data.len(), 0);
+                    elapsed += start.elapsed();
+                    black_box(out);
+                }
+                elapsed
+            })
+        });
+        group.bench_function(BenchmarkId::new("first_byte/uninit", codec_name), |b| {
+            b.iter_custom(|iters| {
+                let mut elapsed = Duration::ZERO;
+                for _ in 0..iters {
+                    let start = Instant::now();
+                    let out: Vec<u8> = Vec::with_capacity(data.len());
+                    elapsed += start.elapsed();
+                    black_box(out);
+                }
+                elapsed
+            })
+        });
+        // Whole call, with a fresh output buffer each time
+        group.bench_function(BenchmarkId::new("total/zeroed", codec_name), |b| {
+            b.iter(|| {
+                let mut out = vec![0u8; data.len()];
+                out.fill(black_box(0));
+                decompress_into(codec, black_box(&compressed), &mut out).unwrap();
+                out
+            })
+        });
+        group.bench_function(BenchmarkId::new("total/uninit", codec_name), |b| {
+            b.iter(|| {
+                let mut out = Vec::new();
+                decompress_into(codec, black_box(&compressed), &mut out).unwrap();
+                out
+            })
+        });
+        // Library-allocated output: no zero-fill, huge-page mapping
+        group.bench_function(BenchmarkId::new("total/library", codec_name), |b| {
+            b.iter(|| decompress(codec, black_box(&compressed)).unwrap())
+        });
+    }
+    group.finish();
+}
+
+fn bench_thread_scaling(c: &mut Criterion) {
+    // Each thread round-trips its own ~1 KB JSON message through the plain one-shot API,
+    // which reuses that thread's cached contexts; ideal scaling keeps ops/s per thread flat
+    const OPS_PER_THREAD: u64 = 200;
+    let max_threads = std::thread::available_parallelism().map_or(4, |n| n.get()).min(32);
+    let mut counts: Vec<usize> = std::iter::successors(Some(1usize), |n| Some(n * 2)).take_while(|&n| n < max_threads).collect();
+    counts.push(max_threads);
+    let message = |t: usize| {
+        (0..12)
+            .map(|i| format!("{{\"thread\":{},\"user\":{},\"event\":\"page_view\",\"path\":\"/item/{}\",\"ok\":true}}", t, i * 31, i % 7))
+            .collect::<Vec<_>>()
+            .join(",")
+            .into_bytes()
+    };
+
+    let mut group = c.benchmark_group("thread_scaling");
+    group.sample_size(10);
+    for (codec, codec_name) in [(Codec::Zlib, "zlib"), (Codec::Lz4, "lz4"), (Codec::Zstd, "zstd")] {
+        for &threads in &counts {
+            group.throughput(Throughput::Elements(threads as u64 * OPS_PER_THREAD));
+            group.bench_function(BenchmarkId::new(codec_name, threads), |b| {
+                b.iter_custom(|iters| {
+                    // Threads live for the whole measurement, so their contexts stay warm
+                    let barrier = Barrier::new(threads + 1);
+                    let start = std::thread::scope(|s| {
+                        for t in 0..threads {
+                            let (barrier, data) = (&barrier, message(t));
+                            s.spawn(move || {
+                                barrier.wait();
+                                for _ in 0..iters * OPS_PER_THREAD {
+                                    let compressed = compress(codec, black_box(&data)).unwrap();
+                                    black_box(decompress(codec, &compressed).unwrap());
+                                }
+                            });
+                        }
+                        barrier.wait();
+                        Instant::now()
+                    });
+                    start.elapsed()
+                })
+            });
+        }
+    }
+    group.finish();
+}
+
+// Frame checksums on 16 MB of log lines: decoding with no checksum, with the checksum
+// verified (computed inside the codec loop for zlib, zstd and stored frames), with
+// verification skipped, and decoding followed by a separate checksum pass as callers
+// did before frames carried one
+fn bench_frame_checksums(c: &mut Criterion) {
+    let mut data = Vec::with_capacity(16 << 20);
+    let mut i = 0u64;
+    while data.len() < 16 << 20 {
+        data.extend_from_slice(format!("2024-01-01T00:00:{:02} INFO request id={} status={} bytes={}\n",
+                                       i % 60, i, 200 + i % 7, (i * 7919) % 65536).as_bytes());
+        i += 1;
+    }
+    println!("crc32c kernel: {}", crc32c_kernel_name());
+
+    let mut group = c.benchmark_group("frame_checksums");
+    group.sample_size(10);
+    group.throughput(Throughput::Bytes(data.len() as u64));
+    group.bench_function("crc32c", |b| b.iter(|| crc32c(0, black_box(&data))));
+    for (codec, codec_name) in [(Codec::Zlib, "zlib"), (Codec::Lz4, "lz4"), (Codec::Zstd, "zstd")] {
+        let mut ctx = CodecContext::new(codec).unwrap();
+        let plain = ctx.compress_frame(&data, false).unwrap();
+        let checked = ctx.compress_frame(&data, true).unwrap();
+        group.bench_function(BenchmarkId::new("compress/no_checksum", codec_name), |b| {
+            b.iter(|| ctx.compress_frame(black_box(&data), false).unwrap())
+        });
+        group.bench_function(BenchmarkId::new("compress/checksum", codec_name), |b| {
+            b.iter(|| ctx.compress_frame(black_box(&data), true).unwrap())
+        });
+        group.bench_function(BenchmarkId::new("decompress/no_checksum", codec_name), |b| {
+            b.iter(|| ctx.decompress_frame(black_box(&plain)).unwrap())
+        });
+        group.bench_function(BenchmarkId::new("decompress/separate_pass", codec_name), |b| {
+            b.iter(|| {
+                let out = ctx.decompress_frame(black_box(&plain)).unwrap();
+                crc32c(0, &out)
+            })
+        });
+        group.bench_function(BenchmarkId::new("decompress/verified", codec_name), |b| {
+            b.iter(|| ctx.decompress_frame(black_box(&checked)).unwrap())
+        });
+        ctx.set_verify(false);
+        group.bench_function(BenchmarkId::new("decompress/skip_verify", codec_name), |b| {
+            b.iter(|| ctx.decompress_frame(black_box(&checked)).unwrap())
+        });
+    }
+    group.finish();
+}
+
+// Record scans over 8 MB of varint-length-prefixed JSON records: the lazy reader
+// stopping after the first 100 records, the lazy reader over all of them, and the old
+// path of decompressing the whole blob before walking the prefixes
+fn bench_record_scan(c: &mut Criterion) {
+    let records: Vec<String> = (0..100_000u64)
+        .map(|i| format!("{{\"id\":{},\"user\":\"user{}\",\"status\":{},\"tags\":[\"a{}\",\"b{}\"]}}",
+                         i, i % 977, 200 + i % 7, i % 13, i % 29))
+        .collect();
+    let data = encode_records(&records);
+
+    let mut group = c.benchmark_group("record_scan");
+    group.sample_size(10);
+    for (codec, codec_name) in [(Codec::Zlib, "zlib"), (Codec::Lz4, "lz4"), (Codec::Zstd, "zstd")] {
+        let blob = compress_with_level(codec, codec.default_level(), &data).unwrap();
+        group.bench_function(BenchmarkId::new("reader_first_100", codec_name), |b| {
+            b.iter(|| RecordReader::new(codec, black_box(&blob)).unwrap().take(100).count())
+        });
+        group.bench_function(BenchmarkId::new("reader_all", codec_name), |b| {
+            b.iter(|| {
+                let mut reader = RecordReader::new(codec, black_box(&blob)).unwrap();
+                let mut total = 0;
+                while let Some(record) = reader.next_record() {
+                    total += record.unwrap().len();
+                }
+                total
+            })
+        });
+        group.bench_function(BenchmarkId::new("decompress_then_walk", codec_name), |b| {
+            b.iter(|| {
+                let out = decompress(codec, black_box(&blob)).unwrap();
+                let (mut pos, mut total) = (0, 0);
+                while pos < out.len() {
+                    let (len, n) = decode_varint_rust(&out[pos..]).unwrap();
+                    pos += n + len as usize;
+                    total += len as usize;
+                }
+                total
+            })
+        });
+    }
+    group.finish();
+}
+
 criterion_group!(
     benches,
     bench_compression_by_size,
@@ -192,7 +734,21 @@ criterion_group!(
     bench_zstd_decompression_by_pattern,
     bench_zstd_decompression_small_strings,
     bench_zstd_decompression_edge_cases,
-    bench_zstd_decompression_real_world_data
+    bench_zstd_decompression_real_world_data,
+    // Context reuse
+    bench_context_reuse_small_strings,
+    bench_compression_levels,
+    bench_parallel_compression,
+    bench_batch_small_records,
+    bench_zero_copy_large_payload,
+    bench_dictionary_small_messages,
+    bench_range_reads,
+    bench_auto_codec_selection,
+    bench_arena_allocator,
+    bench_large_payload_decompression,
+    bench_thread_scaling,
+    bench_frame_checksums,
+    bench_record_scan
 );
 criterion_main!(benches);
 
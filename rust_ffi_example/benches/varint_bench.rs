@@ -1,6 +1,14 @@
 use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
 use std::hint::black_box;
 use rust_ffi_example::{encode_varint_rust, decode_varint_rust};
+use rust_ffi_example::{
+    encode_varint_array, decode_varint_array, encode_varint_array_scalar, decode_varint_array_scalar,
+    varint_array_bound, varint_array_kernel_name,
+    streamvbyte_encode_rust, streamvbyte_decode, streamvbyte_decode_scalar, streamvbyte_kernel_name,
+    STREAMVBYTE_DELTA, STREAMVBYTE_ZIGZAG,
+    pfor_encode_rust, pfor_decode, pfor_decode_scalar, pfor_kernel_name, PFOR_DELTA, PFOR_ZIGZAG
+};
+use std::os::raw::c_char;
 
 fn bench_encode_varint_by_value_size(c: &mut Criterion) {
     let test_values = vec![
@@ -214,6 +222,246 @@ fn bench_varint_decode_with_extra_data(c: &mut Criterion) {
     group.finish();
 }
 
+// Bulk array kernels in values/sec: the per-value Rust wrapper loop, the C scalar
+// array loop and the runtime-dispatched kernel, on posting-list-like distributions.
+fn bench_varint_array_kernels(c: &mut Criterion) {
+    const N: usize = 1 << 20;
+    let mut state = 0x2545F4914F6CDD1Du64;
+    let mut next = move || {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        state
+    };
+    let distributions: Vec<(&str, Vec<u64>)> = vec![
+        ("1_byte_deltas", (0..N).map(|_| next() % 128).collect()),
+        ("mostly_small", (0..N).map(|_| { let r = next(); if r % 10 < 9 { r % 128 } else { r % 100_000 } }).collect()),
+        ("2_3_byte", (0..N).map(|_| 128 + next() % 2_000_000).collect()),
+        ("wide_u64", (0..N).map(|_| next() >> (next() % 64)).collect()),
+    ];
+    println!("varint array kernel: {}", varint_array_kernel_name());
+
+    let mut group = c.benchmark_group("varint_array_kernels");
+    group.throughput(Throughput::Elements(N as u64));
+    group.sample_size(10);
+
+    for (name, values) in &distributions {
+        let mut encoded = vec![0u8; unsafe { varint_array_bound(N) }];
+        let len = unsafe { encode_varint_array(values.as_ptr(), N, encoded.as_mut_ptr() as *mut c_char) };
+        encoded.truncate(len);
+        let mut out_buf = vec![0u8; unsafe { varint_array_bound(N) }];
+        let mut decoded = vec![0u64; N];
+
+        group.bench_function(BenchmarkId::new("encode_per_value_rust", name), |b| {
+            b.iter(|| values.iter().map(|&v| encode_varint_rust(black_box(v)).unwrap().len()).sum::<usize>());
+        });
+        group.bench_function(BenchmarkId::new("encode_scalar", name), |b| {
+            b.iter(|| unsafe { encode_varint_array_scalar(black_box(values.as_ptr()), N, out_buf.as_mut_ptr() as *mut c_char) });
+        });
+        group.bench_function(BenchmarkId::new("encode_dispatched", name), |b| {
+            b.iter(|| unsafe { encode_varint_array(black_box(values.as_ptr()), N, out_buf.as_mut_ptr() as *mut c_char) });
+        });
+
+        group.bench_function(BenchmarkId::new("decode_per_value_rust", name), |b| {
+            b.iter(|| {
+                let mut pos = 0;
+                for _ in 0..N {
+                    let (_, used) = decode_varint_rust(black_box(&encoded[pos..])).unwrap();
+                    pos += used;
+                }
+                pos
+            });
+        });
+        group.bench_function(BenchmarkId::new("decode_scalar", name), |b| {
+            b.iter(|| {
+                let mut used = 0usize;
+                let rc = unsafe { decode_varint_array_scalar(black_box(encoded.as_ptr()) as *const c_char, encoded.len(), decoded.as_mut_ptr(), N, &mut used) };
+                assert_eq!(rc, 0);
+                used
+            });
+        });
+        group.bench_function(BenchmarkId::new("decode_dispatched", name), |b| {
+            b.iter(|| {
+                let mut used = 0usize;
+                let rc = unsafe { decode_varint_array(black_box(encoded.as_ptr()) as *const c_char, encoded.len(), decoded.as_mut_ptr(), N, &mut used) };
+                assert_eq!(rc, 0);
+                used
+            });
+        });
+    }
+    group.finish();
+}
+
+// LEB128 arrays versus Stream-VByte on typical columns, in values/sec, with the
+// encoded size printed at setup so density and speed can be compared per column.
+fn bench_integer_formats(c: &mut Criterion) {
+    const N: usize = 1 << 20;
+    let mut state = 0x9E37_79B9u32;
+    let mut next = move || {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        state
+    };
+    let mut sorted: Vec<u32> = (0..N).map(|_| next() % (N as u32 * 16)).collect();
+    sorted.sort_unstable();
+    let columns: Vec<(&str, Vec<u32>, i32)> = vec![
+        ("sorted_ids", sorted, STREAMVBYTE_DELTA),
+        ("small_counts", (0..N).map(|_| next() % 300).collect(), 0),
+        ("wide_u32", (0..N).map(|_| next()).collect(), 0),
+        ("signed_small", (0..N).map(|_| ((next() % 2001) as i32 - 1000) as u32).collect(), STREAMVBYTE_ZIGZAG),
+    ];
+    println!("kernels: varint array {}, stream-vbyte {}", varint_array_kernel_name(), streamvbyte_kernel_name());
+
+    let mut group = c.benchmark_group("integer_formats");
+    group.throughput(Throughput::Elements(N as u64));
+    group.sample_size(10);
+
+    for (name, values, flags) in &columns {
+        let flags = *flags;
+        // LEB128 gets the same transforms so sizes are comparable
+        let mut prev = 0u32;
+        let leb_input: Vec<u64> = values
+            .iter()
+            .map(|&v| {
+                let mut x = v;
+                if flags & STREAMVBYTE_DELTA != 0 {
+                    x = v.wrapping_sub(prev);
+                    prev = v;
+                }
+                if flags & STREAMVBYTE_ZIGZAG != 0 {
+                    x = (x << 1) ^ (((x as i32) >> 31) as u32);
+                }
+                x as u64
+            })
+            .collect();
+        let mut leb = vec![0u8; unsafe { varint_array_bound(N) }];
+        let leb_len = unsafe { encode_varint_array(leb_input.as_ptr(), N, leb.as_mut_ptr() as *mut c_char) };
+        leb.truncate(leb_len);
+        let svb = streamvbyte_encode_rust(values, flags);
+        println!("{}: leb128 {} bytes, stream-vbyte {} bytes", name, leb.len(), svb.len());
+
+        let mut leb_out = vec![0u64; N];
+        let mut svb_out = vec![0u32; N];
+        group.bench_function(BenchmarkId::new("leb128_decode", name), |b| {
+            b.iter(|| {
+                let mut used = 0usize;
+                unsafe { decode_varint_array(black_box(leb.as_ptr()) as *const c_char, leb.len(), leb_out.as_mut_ptr(), N, &mut used) };
+                used
+            });
+        });
+        group.bench_function(BenchmarkId::new("streamvbyte_decode_scalar", name), |b| {
+            b.iter(|| {
+                let mut used = 0usize;
+                unsafe { streamvbyte_decode_scalar(black_box(svb.as_ptr()) as *const c_char, svb.len(), svb_out.as_mut_ptr(), N, flags, &mut used) };
+                used
+            });
+        });
+        group.bench_function(BenchmarkId::new("streamvbyte_decode", name), |b| {
+            b.iter(|| {
+                let mut used = 0usize;
+                unsafe { streamvbyte_decode(black_box(svb.as_ptr()) as *const c_char, svb.len(), svb_out.as_mut_ptr(), N, flags, &mut used) };
+                used
+            });
+        });
+        group.bench_function(BenchmarkId::new("streamvbyte_encode", name), |b| {
+            b.iter(|| streamvbyte_encode_rust(black_box(values), flags));
+        });
+    }
+    group.finish();
+}
+
+// Bit-packed blocks versus LEB128 on 64-bit columns. Throughput is decoded bytes
+// (8 per value) so the report reads as decode GB/s; bytes/value is printed at setup.
+fn bench_pfor_vs_leb128(c: &mut Criterion) {
+    const N: usize = 1 << 20;
+    let mut state = 0x2545F4914F6CDD1Du64;
+    let mut next = move || {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        state
+    };
+    let mut t = 1_700_000_000_000u64;
+    let timestamps: Vec<u64> = (0..N)
+        .map(|i| {
+            t += if i % 1000 == 0 { next() % 60_000_000 } else { 900 + next() % 200 };
+            t
+        })
+        .collect();
+    let mut ids: Vec<u64> = (0..N).map(|_| next() % (N as u64 * 8)).collect();
+    ids.sort_unstable();
+    let columns: Vec<(&str, Vec<u64>, i32)> = vec![
+        ("timestamps_ms", timestamps, PFOR_DELTA),
+        ("sorted_ids", ids, PFOR_DELTA),
+        ("small_counts", (0..N).map(|_| next() % 300).collect(), 0),
+        ("offsets_with_outliers", (0..N).map(|_| { let r = next(); if r % 64 == 0 { r >> 8 } else { r % 4096 } }).collect(), 0),
+        ("signed_small", (0..N).map(|_| ((next() % 2001) as i64 - 1000) as u64).collect(), PFOR_ZIGZAG),
+    ];
+    println!("kernels: varint array {}, pfor {}", varint_array_kernel_name(), pfor_kernel_name());
+
+    let mut group = c.benchmark_group("pfor_vs_leb128");
+    group.throughput(Throughput::Bytes((N * 8) as u64));
+    group.sample_size(10);
+
+    for (name, values, flags) in &columns {
+        let flags = *flags;
+        // LEB128 gets the same transforms so sizes are comparable
+        let mut prev = 0u64;
+        let leb_input: Vec<u64> = values
+            .iter()
+            .map(|&v| {
+                let mut x = v;
+                if flags & PFOR_DELTA != 0 {
+                    x = v.wrapping_sub(prev);
+                    prev = v;
+                }
+                if flags & PFOR_ZIGZAG != 0 {
+                    x = (x << 1) ^ (((x as i64) >> 63) as u64);
+                }
+                x
+            })
+            .collect();
+        let mut leb = vec![0u8; unsafe { varint_array_bound(N) }];
+        let leb_len = unsafe { encode_varint_array(leb_input.as_ptr(), N, leb.as_mut_ptr() as *mut c_char) };
+        leb.truncate(leb_len);
+        let packed = pfor_encode_rust(values, flags);
+        println!(
+            "{}: leb128 {:.3} bytes/value, pfor {:.3} bytes/value",
+            name,
+            leb.len() as f64 / N as f64,
+            packed.len() as f64 / N as f64
+        );
+
+        let mut out = vec![0u64; N];
+        group.bench_function(BenchmarkId::new("leb128_decode", name), |b| {
+            b.iter(|| {
+                let mut used = 0usize;
+                unsafe { decode_varint_array(black_box(leb.as_ptr()) as *const c_char, leb.len(), out.as_mut_ptr(), N, &mut used) };
+                used
+            });
+        });
+        group.bench_function(BenchmarkId::new("pfor_decode_scalar", name), |b| {
+            b.iter(|| {
+                let mut used = 0usize;
+                unsafe { pfor_decode_scalar(black_box(packed.as_ptr()) as *const c_char, packed.len(), out.as_mut_ptr(), N, flags, &mut used) };
+                used
+            });
+        });
+        group.bench_function(BenchmarkId::new("pfor_decode", name), |b| {
+            b.iter(|| {
+                let mut used = 0usize;
+                unsafe { pfor_decode(black_box(packed.as_ptr()) as *const c_char, packed.len(), out.as_mut_ptr(), N, flags, &mut used) };
+                used
+            });
+        });
+        group.bench_function(BenchmarkId::new("pfor_encode", name), |b| {
+            b.iter(|| pfor_encode_rust(black_box(values), flags));
+        });
+    }
+    group.finish();
+}
+
 criterion_group!(
     benches,
     bench_encode_varint_by_value_size,
@@ -221,6 +469,9 @@ criterion_group!(
     bench_varint_roundtrip,
     bench_varint_throughput,
     bench_varint_edge_cases,
-    bench_varint_decode_with_extra_data
+    bench_varint_decode_with_extra_data,
+    bench_varint_array_kernels,
+    bench_integer_formats,
+    bench_pfor_vs_leb128
 );
 criterion_main!(benches); 
\ No newline at end of file
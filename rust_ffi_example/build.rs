@@ -59,6 +59,11 @@ fn main() {
         println!("cargo:warning=Building with verbose error messages enabled (DEBUG_FUZZING=1).");
     }
 
+    // Handle the 'no-stats' feature flag
+    if cfg!(feature = "no-stats") {
+        build.define("CODEC_NO_STATS", "1");
+    }
+
     // Find and configure zlib
     if !find_and_add_library(&mut build, "zlib", "z", "zlib.h") {
         // Panic with instructions if zlib isn't found
@@ -0,0 +1,28 @@
+#![no_main]
+use libfuzzer_sys::fuzz_target;
+use rust_ffi_example::{decode_varint_array, decode_varint_array_scalar};
+use std::os::raw::c_char;
+
+fuzz_target!(|data: &[u8]| {
+    // The dispatched SIMD/word kernels must agree with the byte-at-a-time reference
+    // on arbitrary input, including where they give up, and never read past in_len.
+    if data.is_empty() {
+        return;
+    }
+    let count = data[0] as usize % 64 + (data.len() - 1) / 2;
+    let input = &data[1..];
+    let mut fast = vec![0u64; count];
+    let mut reference = vec![0u64; count];
+    let (mut fast_len, mut ref_len) = (0usize, 0usize);
+    let (rc_fast, rc_ref) = unsafe {
+        (
+            decode_varint_array(input.as_ptr() as *const c_char, input.len(), fast.as_mut_ptr(), count, &mut fast_len),
+            decode_varint_array_scalar(input.as_ptr() as *const c_char, input.len(), reference.as_mut_ptr(), count, &mut ref_len),
+        )
+    };
+    assert_eq!(rc_fast, rc_ref, "kernels disagree on validity");
+    if rc_fast == 0 {
+        assert_eq!(fast, reference, "kernels decoded different values");
+        assert_eq!(fast_len, ref_len, "kernels consumed different byte counts");
+    }
+});
@@ -0,0 +1,36 @@
+#![no_main]
+use libfuzzer_sys::fuzz_target;
+use rust_ffi_example::{auto_decompressed_length, decompress_auto_into, frame_header_info, FrameInfo, CODEC_OK};
+use std::os::raw::c_char;
+
+fuzz_target!(|data: &[u8]| {
+    // Frame headers are untrusted: the codec byte, flags and body length must only ever
+    // select a valid decoder and a body inside the input, and a frame that decodes must
+    // agree with its header.
+    let mut info = FrameInfo::default();
+    let is_frame = unsafe { frame_header_info(data.as_ptr() as *const c_char, data.len(), &mut info) } == CODEC_OK;
+    if is_frame {
+        assert!(info.frame_len <= data.len(), "frame_header_info reported a frame past the input");
+    }
+    let mut original_len = 0usize;
+    let header_ok = unsafe {
+        auto_decompressed_length(data.as_ptr() as *const c_char, data.len(), &mut original_len)
+    } == CODEC_OK;
+
+    let mut out = vec![0u8; 4096];
+    let mut out_len = 0usize;
+    let rc = unsafe {
+        decompress_auto_into(
+            data.as_ptr() as *const c_char,
+            data.len(),
+            out.as_mut_ptr() as *mut c_char,
+            out.len(),
+            &mut out_len,
+        )
+    };
+    if rc == CODEC_OK {
+        assert!(header_ok, "decompress_auto_into accepted data with an invalid header");
+        assert_eq!(out_len, original_len, "decompressed length differs from the header");
+        assert!(out_len <= out.len(), "decompress_auto_into reported more bytes than out_cap");
+    }
+});
@@ -0,0 +1,26 @@
+#![no_main]
+use libfuzzer_sys::fuzz_target;
+use rust_ffi_example::{decompress_data_into, decompress_data_lz4_into, decompress_data_zstd_into, CODEC_OK};
+use std::os::raw::c_char;
+
+fuzz_target!(|data: &[u8]| {
+    // Deliberately small caller buffer: the *_into functions must never write
+    // past out_cap, even when the varint header claims a larger original length.
+    let mut out = vec![0u8; 256];
+
+    for decompress_fn in [decompress_data_into, decompress_data_lz4_into, decompress_data_zstd_into] {
+        let mut out_len = 0usize;
+        let rc = unsafe {
+            decompress_fn(
+                data.as_ptr() as *const c_char,
+                data.len(),
+                out.as_mut_ptr() as *mut c_char,
+                out.len(),
+                &mut out_len,
+            )
+        };
+        if rc == CODEC_OK {
+            assert!(out_len <= out.len(), "decompress_*_into reported more bytes than out_cap");
+        }
+    }
+});
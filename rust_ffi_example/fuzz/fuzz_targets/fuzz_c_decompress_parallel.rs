@@ -0,0 +1,31 @@
+#![no_main]
+use libfuzzer_sys::fuzz_target;
+use rust_ffi_example::{decompress_parallel_into, parallel_decompressed_length, CODEC_OK};
+use std::os::raw::c_char;
+
+fuzz_target!(|data: &[u8]| {
+    // The container header and block index are untrusted: block counts, sizes and
+    // per-block lengths must never lead to reads past the input or writes past out_cap.
+    let mut original_len = 0usize;
+    let header_ok = unsafe {
+        parallel_decompressed_length(data.as_ptr() as *const c_char, data.len(), &mut original_len)
+    } == CODEC_OK;
+
+    let mut out = vec![0u8; 4096];
+    let mut out_len = 0usize;
+    let rc = unsafe {
+        decompress_parallel_into(
+            2,
+            data.as_ptr() as *const c_char,
+            data.len(),
+            out.as_mut_ptr() as *mut c_char,
+            out.len(),
+            &mut out_len,
+        )
+    };
+    if rc == CODEC_OK {
+        assert!(header_ok, "decompress_parallel_into accepted data with an invalid header");
+        assert_eq!(out_len, original_len, "decompressed length differs from the header");
+        assert!(out_len <= out.len(), "decompress_parallel_into reported more bytes than out_cap");
+    }
+});
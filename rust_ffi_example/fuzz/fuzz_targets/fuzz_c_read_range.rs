@@ -0,0 +1,33 @@
+#![no_main]
+use libfuzzer_sys::fuzz_target;
+use rust_ffi_example::{read_range, CODEC_OK};
+use std::os::raw::c_char;
+
+fuzz_target!(|data: &[u8]| {
+    // The first four bytes pick the range, the rest is an untrusted container: offsets
+    // derived from the block index must stay inside the input and the output buffer.
+    if data.len() < 4 {
+        return;
+    }
+    let offset = u16::from_le_bytes([data[0], data[1]]) as usize * 7;
+    let len = u16::from_le_bytes([data[2], data[3]]) as usize;
+    let container = &data[4..];
+
+    let mut out = vec![0u8; 4096];
+    let mut out_len = 0usize;
+    let rc = unsafe {
+        read_range(
+            container.as_ptr() as *const c_char,
+            container.len(),
+            offset,
+            len,
+            out.as_mut_ptr() as *mut c_char,
+            out.len(),
+            &mut out_len,
+        )
+    };
+    if rc == CODEC_OK {
+        assert!(out_len <= len, "read_range returned more than the requested length");
+        assert!(out_len <= out.len(), "read_range reported more bytes than out_cap");
+    }
+});
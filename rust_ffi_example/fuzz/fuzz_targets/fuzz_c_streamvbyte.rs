@@ -0,0 +1,39 @@
+#![no_main]
+use libfuzzer_sys::fuzz_target;
+use rust_ffi_example::{streamvbyte_decode, streamvbyte_decode_scalar, streamvbyte_encode_rust, CODEC_OK};
+use std::os::raw::c_char;
+
+fuzz_target!(|data: &[u8]| {
+    if data.len() < 2 {
+        return;
+    }
+    // First byte picks the flags and value count; the rest is an untrusted stream
+    let flags = (data[0] & 3) as i32;
+    let count = data[1] as usize * 4 + (data[0] >> 2) as usize % 4;
+    let input = &data[2..];
+
+    let mut fast = vec![0u32; count];
+    let mut reference = vec![0u32; count];
+    let (mut fast_len, mut ref_len) = (0usize, 0usize);
+    let (rc_fast, rc_ref) = unsafe {
+        (
+            streamvbyte_decode(input.as_ptr() as *const c_char, input.len(), fast.as_mut_ptr(), count, flags, &mut fast_len),
+            streamvbyte_decode_scalar(input.as_ptr() as *const c_char, input.len(), reference.as_mut_ptr(), count, flags, &mut ref_len),
+        )
+    };
+    assert_eq!(rc_fast, rc_ref, "SIMD and scalar decoders disagree on validity");
+    if rc_fast == CODEC_OK {
+        assert_eq!(fast, reference);
+        assert_eq!(fast_len, ref_len);
+        assert!(fast_len <= input.len());
+        // Decoded values re-encode to a stream that decodes back to them
+        let reencoded = streamvbyte_encode_rust(&fast, flags);
+        let mut again = vec![0u32; count];
+        let mut again_len = 0usize;
+        let rc = unsafe {
+            streamvbyte_decode(reencoded.as_ptr() as *const c_char, reencoded.len(), again.as_mut_ptr(), count, flags, &mut again_len)
+        };
+        assert_eq!(rc, CODEC_OK);
+        assert_eq!(again, fast);
+    }
+});
@@ -2,7 +2,7 @@
 #define RUST_FFI_EXAMPLE_H
 
 #include <stdint.h> // For int32_t
-#include <stddef.h> // For size_t (though unsigned long is used directly)
+#include <stddef.h> // For size_t
 
 // Define structures to match Rust's FFI representation
 typedef struct {
@@ -15,11 +15,123 @@ typedef struct {
     unsigned long length;
 } DecompressedData;
 
+// Status codes returned by the caller-provided buffer (*_into) entry points
+#define CODEC_OK 0
+#define CODEC_ERR_INVALID_ARG -1      // NULL pointer with non-zero length, or NULL out_len
+#define CODEC_ERR_BUFFER_TOO_SMALL -2 // Output does not fit in out_cap
+#define CODEC_ERR_CORRUPT -3          // Malformed header or compressed payload
+#define CODEC_ERR_TOO_LARGE -4        // Input exceeds what the codec can handle
+#define CODEC_ERR_CODEC -5            // Internal codec failure
+#define CODEC_ERR_ALLOC -6            // Memory allocation failed
+#define CODEC_ERR_DICT_MISMATCH -7    // Data names a different dictionary than the context holds
+#define CODEC_ERR_CHECKSUM -8         // Frame checksum does not match the decompressed data
+#define CODEC_ERR_WRONG_CODEC -9      // Frame was written by another codec than the context's
+
+// Codec identifiers used by the context API
+#define CODEC_ZLIB 0
+#define CODEC_LZ4 1
+#define CODEC_ZSTD 2
+#define CODEC_STORED 3  // Frames only: the input is kept uncompressed
+#define CODEC_AUTO (-1) // Frames only: bound covering any codec compress_frame_auto_into picks
+
+// Opaque reusable compression context (see codec_ctx_create)
+typedef struct codec_ctx codec_ctx;
+
+// Opaque pre-digested compression dictionary (see codec_dict_create)
+typedef struct codec_dict codec_dict;
+
+// Opaque random-access reader over a block-parallel container (see range_reader_open)
+typedef struct range_reader range_reader;
+
+// Opaque pull-based reader over varint-length-prefixed records (see record_reader_open)
+typedef struct record_reader record_reader;
+
+// Streaming modes for stream_begin
+#define STREAM_COMPRESS 0
+#define STREAM_DECOMPRESS 1
+
+// Non-error stream_update/stream_end results (besides CODEC_OK)
+#define STREAM_OUTPUT_FULL 1 // Output buffer filled; call again with more space
+#define STREAM_FRAME_END 2   // Decompression reached the end of the frame
+
+// Non-error record_reader_next result (besides CODEC_OK)
+#define RECORD_END 1 // Every record has been read
+
+// Block-parallel placement options (see set_parallel_options)
+#define PARALLEL_PIN_WORKERS 1  // Pin spawned workers to one CPU each, interleaved over NUMA nodes (Linux)
+#define PARALLEL_LOCAL_BLOCKS 2 // Give each worker a fixed contiguous run of blocks instead of claiming them
+#define PARALLEL_CACHE_BLOCKS 4 // block_size 0 selects parallel_cache_block_size()
+
+// Stream-VByte transform flags (see streamvbyte_encode)
+#define STREAMVBYTE_DELTA 1  // Store differences between consecutive values
+#define STREAMVBYTE_ZIGZAG 2 // Zigzag-map signed values (applied after DELTA)
+
+// Bit-packed block transform flags (see pfor_encode)
+#define PFOR_DELTA 1  // Store differences between consecutive values
+#define PFOR_ZIGZAG 2 // Zigzag-map signed values (applied after DELTA)
+
+// Opaque streaming compressor/decompressor (see stream_begin)
+typedef struct codec_stream codec_stream;
+
+// Allocator hooks (see set_allocator)
+typedef void* (*codec_alloc_fn)(void* opaque, size_t size);
+typedef void (*codec_free_fn)(void* opaque, void* ptr);
+
+// Opaque bump allocator, reset per batch (see codec_arena_create)
+typedef struct codec_arena codec_arena;
+
+// Frame flags (see compress_frame_into)
+#define FRAME_CHECKSUM 1 // Store a CRC32C of the original data and verify it on decompression
+#define FRAME_DICT 2     // Set by the library when the body was compressed with a dictionary
+
+// Header fields of a self-describing frame (see frame_header_info)
+typedef struct {
+    int codec;           // CODEC_* that wrote the frame
+    int flags;           // FRAME_* flags
+    size_t original_len; // Decompressed size
+    size_t frame_len;    // Total frame size, i.e. where the next concatenated frame starts
+} FrameInfo;
+
+// Runtime statistics (see get_codec_stats)
+#define CODEC_STATS_CODECS 4       // ops[] rows: CODEC_ZLIB, CODEC_LZ4, CODEC_ZSTD, CODEC_STORED
+#define CODEC_STATS_COMPRESS 0     // ops[codec][CODEC_STATS_COMPRESS]
+#define CODEC_STATS_DECOMPRESS 1   // ops[codec][CODEC_STATS_DECOMPRESS]
+#define CODEC_STATS_BUCKETS 32     // Latency bucket i: calls taking [2^i, 2^(i+1)) ns; the last is open-ended
+#define CODEC_STATS_ERROR_CODES 10 // errors_by_code is indexed by -CODEC_ERR_* (index 0 unused)
+
+// Counters for one codec and direction
+typedef struct {
+    uint64_t calls;     // Calls, failed ones included
+    uint64_t errors;    // Calls that returned a CODEC_ERR_* code
+    uint64_t bytes_in;  // Input bytes of successful calls
+    uint64_t bytes_out; // Output bytes of successful calls
+    uint64_t total_ns;  // Time spent in all calls
+    uint64_t latency[CODEC_STATS_BUCKETS];
+} codec_op_stats;
+
+typedef struct {
+    codec_op_stats ops[CODEC_STATS_CODECS][2];
+    uint64_t errors_by_code[CODEC_STATS_ERROR_CODES]; // Failed calls by status, any codec
+    uint64_t bad_varint;    // Varints (e.g. length headers) that failed to decode
+    uint64_t over_size_cap; // Allocating decompressions refused for an original length over 100 MB
+    int enabled;            // 0 if the library was built with CODEC_NO_STATS
+} codec_stats;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // FFI function declarations
+//
+// Thread safety: every function may be called concurrently from any number of threads.
+// The library has no shared mutable state apart from the allocator set by set_allocator,
+// the atomic statistics counters and parallel options, and lazily initialized read-only tables. Objects are not internally synchronized:
+// a codec_ctx, codec_stream, range_reader or record_reader must be used by one thread at a time.
+// A codec_dict and a codec_arena may be shared freely once created. Input and output
+// buffers passed to concurrent calls must not overlap with each other's output.
+//
+// The plain compress_string*/decompress_data* functions (and their *_into forms) run on
+// a per-thread cached context, so no setup is paid per call; see codec_thread_cache_release.
 
 /**
  * Compresses a string using the default algorithm.
@@ -67,6 +179,566 @@ CompressedData compress_string_zstd(const char* input, unsigned long input_len);
  */
 DecompressedData decompress_data_zstd(const char* input, unsigned long input_len);
 
+// Caller-provided buffer variants
+//
+// These write into memory owned by the caller instead of allocating, so one buffer
+// can be reused across calls. Each returns CODEC_OK and sets *out_len on success,
+// or a negative CODEC_ERR_* code. The output format is identical to the allocating
+// functions above.
+
+/**
+ * Returns the worst-case size of compress_string_into output for in_len input bytes.
+ */
+size_t compress_bound(size_t in_len);
+
+/**
+ * Returns the worst-case size of compress_string_lz4_into output for in_len input bytes,
+ * or 0 if in_len is larger than LZ4 can compress in one call.
+ */
+size_t compress_bound_lz4(size_t in_len);
+
+/**
+ * Returns the worst-case size of compress_string_zstd_into output for in_len input bytes,
+ * or 0 if in_len is too large for zstd.
+ */
+size_t compress_bound_zstd(size_t in_len);
+
+/**
+ * Reads the original length from the varint header of compressed data (any codec),
+ * so the caller can size the buffer passed to decompress_data*_into.
+ * Returns CODEC_OK, or CODEC_ERR_CORRUPT if the header is invalid.
+ */
+int decompressed_length(const char* in, size_t in_len, size_t* original_len);
+
+/**
+ * Compresses with zlib into out. out_cap of compress_bound(in_len) always suffices.
+ */
+int compress_string_into(const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Decompresses zlib data into out. If out_cap is smaller than the original length,
+ * returns CODEC_ERR_BUFFER_TOO_SMALL and sets *out_len to the required size.
+ * Unlike decompress_data, the output is not null-terminated and the 100 MB cap
+ * does not apply (the caller owns the memory).
+ */
+int decompress_data_into(const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Compresses with LZ4 into out. out_cap of compress_bound_lz4(in_len) always suffices.
+ */
+int compress_string_lz4_into(const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Decompresses LZ4 data into out. Same buffer contract as decompress_data_into.
+ */
+int decompress_data_lz4_into(const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Compresses with Zstd into out. out_cap of compress_bound_zstd(in_len) always suffices.
+ */
+int compress_string_zstd_into(const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Decompresses Zstd data into out. Same buffer contract as decompress_data_into.
+ */
+int decompress_data_zstd_into(const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+// Reusable compression contexts
+//
+// A codec_ctx keeps ZSTD_CCtx/ZSTD_DCtx, an LZ4_stream_t or deflate/inflate z_streams
+// alive across calls, so small messages don't pay context setup on every call.
+// Output is byte-compatible with the one-shot functions of the same codec.
+// A context is not thread-safe: use one per thread.
+
+/**
+ * Returns the worst-case codec_ctx_compress output size for the given codec (room for a
+ * dictionary ID included), or 0 for an unknown codec.
+ */
+size_t codec_compress_bound(int codec, size_t in_len);
+
+/**
+ * Returns the level used by the codec's plain compress_string* function.
+ */
+int codec_default_level(int codec);
+
+/**
+ * Reports the accepted compression levels for a codec:
+ * - zlib: -1 (library default) to 9
+ * - LZ4: negative = fast mode with acceleration -level, 0-2 = LZ4_compress_default,
+ *   3-12 = LZ4HC at that level
+ * - zstd: ZSTD_minCLevel() (negative, fastest) to ZSTD_maxCLevel() (19-22, smallest)
+ * Returns CODEC_OK, or CODEC_ERR_INVALID_ARG for an unknown codec.
+ */
+int codec_level_range(int codec, int* min_level, int* max_level);
+
+/**
+ * Creates a context for CODEC_ZLIB, CODEC_LZ4 or CODEC_ZSTD.
+ * Returns NULL for an unknown codec or on allocation failure.
+ * The caller is responsible for freeing it with codec_ctx_destroy.
+ */
+codec_ctx* codec_ctx_create(int codec);
+
+/**
+ * Sets the level used by later codec_ctx_compress calls (see codec_level_range).
+ * New contexts use codec_default_level. Returns CODEC_ERR_INVALID_ARG if out of range.
+ */
+int codec_ctx_set_level(codec_ctx* ctx, int level);
+
+/**
+ * With verify = 0, frames decoded through ctx (codec_ctx_decompress_frame) skip
+ * checksum verification, for trusted paths; 1 (the default) verifies again.
+ * Returns CODEC_ERR_INVALID_ARG for a NULL ctx.
+ */
+int codec_ctx_set_verify(codec_ctx* ctx, int verify);
+
+/**
+ * Compresses into out using the context's codec. Same contract as compress_string_into,
+ * except that with a dictionary set the output also carries its ID: size out with
+ * codec_compress_bound(codec, in_len), not the per-codec compress_bound*.
+ */
+int codec_ctx_compress(codec_ctx* ctx, const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Decompresses into out using the context's codec. Same contract as decompress_data_into.
+ */
+int codec_ctx_decompress(codec_ctx* ctx, const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Frees a context and all codec state it holds. NULL is ignored.
+ */
+void codec_ctx_destroy(codec_ctx* ctx);
+
+/**
+ * Frees the calling thread's cached contexts; the plain compress_string* and
+ * decompress_data* functions recreate them on demand. They are also freed automatically at thread exit.
+ * The cache is not used while a set_thread_allocator override is installed.
+ * Returns the number of contexts released.
+ */
+int codec_thread_cache_release(void);
+
+// Dictionaries
+//
+// A dictionary trained on sample messages primes the codec with their shared content,
+// which restores the ratio on messages of a few hundred bytes. A codec_dict is digested
+// once (ZSTD_CDict/ZSTD_DDict, a preloaded LZ4 stream; zlib uses the raw bytes) and can
+// be attached to any number of contexts, including from several threads.
+
+/**
+ * Trains a dictionary of at most dict_cap bytes (ZDICT_trainFromBuffer) from count
+ * samples stored back to back in samples, sample i being sample_lens[i] bytes.
+ * The result can be used with every codec. Returns CODEC_OK and sets *dict_len,
+ * or CODEC_ERR_CODEC if there are too few samples to train on.
+ */
+int dict_train(const char* samples, const size_t* sample_lens, size_t count, char* dict, size_t dict_cap, size_t* dict_len);
+
+/**
+ * Digests a dictionary for one codec (the bytes are copied). level is used by zstd only,
+ * whose digested dictionary fixes the level contexts compress at.
+ * Returns NULL for an unknown codec, an out-of-range level, an empty dictionary or on
+ * allocation failure. The caller is responsible for freeing it with codec_dict_destroy.
+ */
+codec_dict* codec_dict_create(int codec, int level, const char* dict, size_t dict_len);
+
+/**
+ * Returns the non-zero ID written into data compressed with the dictionary: the zstd
+ * dictionary ID for trained dictionaries, otherwise the adler32 of the content.
+ */
+uint32_t codec_dict_id(const codec_dict* dict);
+
+/**
+ * Frees a dictionary. NULL is ignored. No context may still be using it.
+ */
+void codec_dict_destroy(codec_dict* dict);
+
+/**
+ * Attaches a dictionary of the context's codec to later codec_ctx_compress/decompress
+ * (and batch) calls, or detaches it with NULL. The dictionary must outlive its use.
+ * Compressed output then becomes [varint original length][varint dict ID][payload];
+ * decompression returns CODEC_ERR_DICT_MISMATCH for data naming another dictionary.
+ */
+int codec_ctx_set_dict(codec_ctx* ctx, const codec_dict* dict);
+
+/**
+ * Reads the dictionary ID from data compressed with a dictionary, so the caller can
+ * pick the dictionary to decompress it with. Returns CODEC_OK or CODEC_ERR_CORRUPT.
+ */
+int compressed_dict_id(const char* in, size_t in_len, uint32_t* dict_id);
+
+/**
+ * One-shot compression at an explicit level (see codec_level_range) into out.
+ * Output format is the same as the codec's compress_string* function, so the
+ * existing decompressors read it. out_cap of codec_compress_bound() always suffices.
+ */
+int compress_string_level_into(int codec, int level, const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Allocating variant of compress_string_level_into.
+ * The caller is responsible for freeing the returned CompressedData using free_compressed_data.
+ */
+CompressedData compress_string_level(int codec, int level, const char* input, unsigned long input_len);
+
+/**
+ * Worst-case arena size for codec_batch_compress over items of the given lengths,
+ * or 0 if any item is too large for the codec.
+ */
+size_t codec_batch_compress_bound(int codec, const size_t* in_lens, size_t count);
+
+/**
+ * Sums the original lengths recorded in each item's varint header, i.e. the arena
+ * size codec_batch_decompress needs. Returns CODEC_OK or a negative CODEC_ERR_* code.
+ */
+int codec_batch_decompressed_size(const char* const* inputs, const size_t* in_lens, size_t count, size_t* total_len);
+
+/**
+ * Compresses count items with the context's codec and level into one arena.
+ * Item i is written to arena[offsets[i] .. offsets[i + 1]]; offsets must hold count + 1
+ * entries. Each item has the same format as codec_ctx_compress output.
+ * Returns CODEC_OK, or the negative CODEC_ERR_* code of the first failing item.
+ */
+int codec_batch_compress(codec_ctx* ctx, const char* const* inputs, const size_t* in_lens, size_t count, char* arena, size_t arena_cap, size_t* offsets);
+
+/**
+ * Decompresses count items into one arena, laid out like codec_batch_compress.
+ * Returns CODEC_OK, or the negative CODEC_ERR_* code of the first failing item.
+ */
+int codec_batch_decompress(codec_ctx* ctx, const char* const* inputs, const size_t* in_lens, size_t count, char* arena, size_t arena_cap, size_t* offsets);
+
+/**
+ * Starts a streaming compressor (STREAM_COMPRESS) or decompressor (STREAM_DECOMPRESS).
+ * Streams use the codec's native self-terminating frame (zstd frame with checksum,
+ * LZ4 frame, zlib stream) without the varint length header, so they are not
+ * interchangeable with compress_string* output and have no size limit.
+ * level follows codec_level_range and is ignored when decompressing.
+ * Returns NULL for invalid arguments or on allocation failure.
+ * The caller is responsible for freeing it with stream_destroy.
+ */
+codec_stream* stream_begin(int codec, int mode, int level);
+
+/**
+ * Feeds in to the stream and writes as much output as fits in out.
+ * *in_consumed and *out_len report the bytes used from in and written to out.
+ * Returns CODEC_OK once all input is consumed, STREAM_OUTPUT_FULL if out filled up
+ * first (call again with the rest of in), STREAM_FRAME_END when decompression has
+ * finished the frame (trailing input is left unconsumed), or a negative CODEC_ERR_* code.
+ */
+int stream_update(codec_stream* s, const char* in, size_t in_len, size_t* in_consumed, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Finishes the stream. When compressing, writes the frame epilogue and returns
+ * STREAM_OUTPUT_FULL until it has all been written, then CODEC_OK. When decompressing,
+ * returns CODEC_OK if the frame was complete or CODEC_ERR_CORRUPT if input ended early.
+ */
+int stream_end(codec_stream* s, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Frees a stream and its codec state. NULL is ignored.
+ */
+void stream_destroy(codec_stream* s);
+
+/**
+ * Worst-case size of a block-parallel container (see compress_parallel_into), or 0
+ * if the input is too large for the codec. block_size of 0 selects the default
+ * (parallel_default_block_size(), 1 MiB unless set_parallel_options changed it).
+ */
+size_t compress_parallel_bound(int codec, size_t in_len, size_t block_size);
+
+/**
+ * Splits in into block_size blocks (0 = parallel_default_block_size()), compresses
+ * them independently on `threads` worker threads (<= 0 = one per online CPU) and
+ * writes a container:
+ * "RFPB", version, codec, varint original length, varint block size, varint block
+ * count, a varint compressed length per block, then the blocks. Each block has the
+ * codec's compress_string* format. out_cap must be at least compress_parallel_bound().
+ * Returns CODEC_OK or a negative CODEC_ERR_* code.
+ */
+int compress_parallel_into(int codec, int level, int threads, size_t block_size, const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Reads the original length from a block-parallel container header.
+ * Returns CODEC_OK, or CODEC_ERR_CORRUPT if in is not a container.
+ */
+int parallel_decompressed_length(const char* in, size_t in_len, size_t* original_len);
+
+/**
+ * Decompresses a block-parallel container, spreading blocks over `threads` workers
+ * (<= 0 = one per online CPU). The codec is read from the container.
+ * On CODEC_ERR_BUFFER_TOO_SMALL, *out_len is set to the required size.
+ */
+int decompress_parallel_into(int threads, const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Allocating variant of compress_parallel_into with the default block size.
+ * The caller is responsible for freeing the returned CompressedData using free_compressed_data.
+ */
+CompressedData compress_parallel(int codec, int level, int threads, const char* input, unsigned long input_len);
+
+/**
+ * Allocating variant of decompress_parallel_into (limited to 100 MB like the other
+ * allocating decompressors).
+ * The caller is responsible for freeing the returned DecompressedData using free_decompressed_data.
+ */
+DecompressedData decompress_parallel(int threads, const char* input, unsigned long input_len);
+
+/**
+ * Sets process-wide placement options for the block-parallel calls, which each call
+ * reads once when it starts. flags is a combination of PARALLEL_*; block_size is the
+ * size a block_size argument of 0 selects (0 = 1 MiB, and must be 0 with
+ * PARALLEL_CACHE_BLOCKS). Linux places pages on the NUMA node of the thread that first
+ * writes them: PARALLEL_PIN_WORKERS keeps worker contexts node-local, and with
+ * PARALLEL_LOCAL_BLOCKS the output blocks a worker first-touches are the ones it
+ * writes again whenever the buffer is reused. The calling thread takes part unpinned,
+ * and inputs stay wherever the caller placed them. The output does not depend on flags.
+ * Returns CODEC_OK, or CODEC_ERR_INVALID_ARG for unknown flags or a block_size with
+ * PARALLEL_CACHE_BLOCKS.
+ */
+int set_parallel_options(int flags, size_t block_size);
+
+/**
+ * The block size a block_size argument of 0 currently selects.
+ */
+size_t parallel_default_block_size(void);
+
+/**
+ * Power-of-two block size from 256 KiB to 4 MiB whose input and worst-case output fit
+ * in half of a core's cache budget (the larger of L2 and an even share of the LLC); 1 MiB
+ * where the cache sizes are unknown. `make parallel-autotune` measures the alternatives.
+ */
+size_t parallel_cache_block_size(void);
+
+/**
+ * Number of NUMA nodes PARALLEL_PIN_WORKERS spreads workers over (1 without NUMA
+ * information), or 0 where pinning is not supported.
+ */
+int parallel_numa_nodes(void);
+
+// Random access: blocks of a block-parallel container are independent, so a byte range
+// of the original data is served by decoding only the blocks that overlap it. Smaller
+// block sizes make range reads cheaper at some cost in ratio.
+
+/**
+ * Opens a reader over a block-parallel container, resolving its block index once.
+ * in must stay valid until range_reader_close. Returns NULL if in is not a valid container.
+ */
+range_reader* range_reader_open(const char* in, size_t in_len);
+
+/**
+ * Original (decompressed) size of the container.
+ */
+size_t range_reader_size(const range_reader* r);
+
+/**
+ * Decompresses original bytes [offset, offset + len) into out. A range past the end is
+ * cut short (see *out_len); an offset past the end returns CODEC_ERR_INVALID_ARG.
+ * On CODEC_ERR_BUFFER_TOO_SMALL, *out_len is set to the required size.
+ */
+int range_reader_read(range_reader* r, size_t offset, size_t len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Frees a reader. NULL is ignored.
+ */
+void range_reader_close(range_reader* r);
+
+/**
+ * One-shot range_reader_read. Parses the block index on every call, so keep a
+ * range_reader open for repeated reads.
+ */
+int read_range(const char* in, size_t in_len, size_t offset, size_t len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Opens a pull-based reader over compress_string* / codec_ctx_compress output of codec
+ * (without a dictionary) whose original data is a sequence of records, each prefixed
+ * with its encode_varint length. The payload is decompressed on demand into a window
+ * of `window` bytes (0 = 64 KiB) that grows only to fit a larger record, so stopping
+ * after the first records skips decoding the rest. LZ4 blocks cannot be resumed, so
+ * for LZ4 the window holds the decoded prefix and grows fourfold as reading goes on.
+ * in must stay valid until record_reader_close. Returns NULL if codec is not zlib,
+ * LZ4 or zstd, the length header is malformed or allocation fails.
+ */
+record_reader* record_reader_open(int codec, const char* in, size_t in_len, size_t window);
+
+/**
+ * Sets *record / *record_len to the next record. The pointer is into the reader's
+ * window and stays valid until the next call or record_reader_close.
+ * Returns CODEC_OK, RECORD_END after the last record (once the payload has been checked
+ * to end there), or a negative CODEC_ERR_* code. After anything but CODEC_OK, every
+ * further call returns the same value.
+ */
+int record_reader_next(record_reader* r, const char** record, size_t* record_len);
+
+/**
+ * Frees a reader; stopping before RECORD_END is fine. NULL is ignored.
+ */
+void record_reader_close(record_reader* r);
+
+// Self-describing frames: "RFFR", version, codec ID, flags, varint body length, an
+// optional CRC32C, then a regular codec_ctx_compress body. Readers pick the decoder
+// from the header instead of tracking the codec out of band. CODEC_STORED frames hold
+// the data uncompressed and can be read by any context; every codec writes one instead
+// for input under 64 bytes (unless a dictionary is attached) or input it would expand.
+
+/**
+ * Worst-case size of compress_frame_into output, or 0 if the input is too large for the codec.
+ * Pass CODEC_AUTO to size the output of compress_frame_auto_into.
+ */
+size_t frame_compress_bound(int codec, size_t in_len);
+
+/**
+ * Compresses in at `level` into a self-describing frame. flags may contain FRAME_CHECKSUM.
+ * CODEC_STORED copies the input and ignores level. The other codecs fall back to a stored
+ * frame for tiny or incompressible input, also when out_cap only fits the stored frame
+ * (frame_compress_bound(CODEC_STORED, in_len)).
+ * Returns CODEC_OK or a negative CODEC_ERR_* code.
+ */
+int compress_frame_into(int codec, int level, int flags, const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Frame variant of codec_ctx_compress, using the context's level and dictionary.
+ */
+int codec_ctx_compress_frame(codec_ctx* ctx, int flags, const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Reads the header of the frame at the start of in. Bytes after info->frame_len
+ * (e.g. further concatenated frames) are ignored.
+ * Returns CODEC_OK, or CODEC_ERR_CORRUPT if in does not start with a frame.
+ */
+int frame_header_info(const char* in, size_t in_len, FrameInfo* info);
+
+/**
+ * Sets *frame_len to the total size of the frame starting at in, reading only its header,
+ * for readers that pull concatenated frames off a stream. in_len may be anything from 0.
+ * Returns CODEC_OK; CODEC_ERR_BUFFER_TOO_SMALL with *frame_len the number of bytes needed
+ * to continue (retry with at least that many); or CODEC_ERR_CORRUPT if in cannot start a frame.
+ */
+int frame_length(const char* in, size_t in_len, size_t* frame_len);
+
+/**
+ * Reads the original length of a frame or block-parallel container.
+ */
+int auto_decompressed_length(const char* in, size_t in_len, size_t* original_len);
+
+/**
+ * Decompresses a frame or block-parallel container with the codec named in its header,
+ * verifying the checksum if present (computed while decoding for stored, zlib and zstd bodies). Frames written with a dictionary return
+ * CODEC_ERR_DICT_MISMATCH (use codec_ctx_decompress_frame), and headerless
+ * compress_string* output returns CODEC_ERR_CORRUPT.
+ * Same buffer contract as decompress_data_into.
+ */
+int decompress_auto_into(const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Frame variant of codec_ctx_decompress. Returns CODEC_ERR_WRONG_CODEC if the frame was
+ * written by another codec and CODEC_ERR_DICT_MISMATCH if it needs another dictionary.
+ */
+int codec_ctx_decompress_frame(codec_ctx* ctx, const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Zero-copy read of a CODEC_STORED frame spanning in: points *data at the original bytes
+ * inside in, after verifying the checksum if present.
+ * Returns CODEC_OK, CODEC_ERR_WRONG_CODEC if the frame is compressed (decompress it
+ * instead), CODEC_ERR_CHECKSUM, or CODEC_ERR_CORRUPT if in is not exactly one frame.
+ */
+int frame_stored_view(const char* in, size_t in_len, const char** data, size_t* data_len);
+
+/**
+ * Updates a CRC32C (the frame checksum) with len more bytes of data; start from crc = 0,
+ * chaining like zlib's crc32. Uses SSE4.2 or the ARMv8 CRC instructions where available.
+ */
+uint32_t checksum_crc32c(uint32_t crc, const char* data, size_t len);
+
+/**
+ * Name of the CRC32C kernel selected for this CPU ("sse4.2", "armv8-crc" or "slice8").
+ */
+const char* checksum_crc32c_kernel(void);
+
+/**
+ * Picks a codec and level for in: CODEC_STORED for tiny or incompressible input, else the
+ * LZ4 or zstd setting with the best ratio on a sample among those compressing at least
+ * min_mb_per_s MB/s (0 for no speed floor). Trial timings are measured on this machine.
+ * Returns CODEC_OK or a negative CODEC_ERR_* code.
+ */
+int codec_auto_select(const char* in, size_t in_len, double min_mb_per_s, int* codec, int* level);
+
+/**
+ * compress_frame_into with the codec and level chosen by codec_auto_select. The choice
+ * is recorded in the frame header (see frame_header_info).
+ * out_cap of frame_compress_bound(CODEC_AUTO, in_len) always suffices.
+ */
+int compress_frame_auto_into(double min_mb_per_s, int flags, const char* in, size_t in_len, char* out, size_t out_cap, size_t* out_len);
+
+/**
+ * Allocating variant of compress_frame_into.
+ * The caller is responsible for freeing the returned CompressedData using free_compressed_data.
+ */
+CompressedData compress_frame(int codec, int level, int flags, const char* input, unsigned long input_len);
+
+/**
+ * Allocating variant of decompress_auto_into (limited to 100 MB).
+ * The caller is responsible for freeing the returned DecompressedData using free_decompressed_data.
+ */
+DecompressedData decompress_auto(const char* input, unsigned long input_len);
+
+// Allocator hooks: returned buffers, contexts, dictionaries, streams, scratch space and
+// the zstd/zlib internal state are allocated through the calling thread's allocator
+// (set_thread_allocator), else the process-wide one (set_allocator), else malloc/free.
+// LZ4 streams (stream_begin with CODEC_LZ4) always use malloc. Objects and returned
+// buffers remember their allocator and are freed through it. Returned buffers are not
+// zero-filled; with the default allocator, those of 2 MiB and up are mmap'ed directly
+// with MADV_HUGEPAGE.
+
+/**
+ * Installs the process-wide allocator; two NULL functions restore malloc/free.
+ * Not synchronized: call it before other threads use the library.
+ * Returns CODEC_ERR_INVALID_ARG if only one function is NULL.
+ */
+int set_allocator(codec_alloc_fn alloc_fn, codec_free_fn free_fn, void* opaque);
+
+/**
+ * Overrides the allocator for the calling thread (and the worker threads of its
+ * *_parallel calls); two NULL functions remove the override.
+ */
+int set_thread_allocator(codec_alloc_fn alloc_fn, codec_free_fn free_fn, void* opaque);
+
+/**
+ * Creates a bump allocator over one capacity-byte block, or NULL on allocation failure.
+ * Install it with set_thread_allocator(codec_arena_alloc, codec_arena_free, arena).
+ * Freeing the most recent allocation returns its space (so a one-shot call keeps only
+ * the buffer it returns); other frees wait for codec_arena_reset. Requests that no
+ * longer fit fall back to malloc. Allocation is lock-free and thread-safe.
+ */
+codec_arena* codec_arena_create(size_t capacity);
+void* codec_arena_alloc(void* opaque, size_t size);
+void codec_arena_free(void* opaque, void* ptr);
+
+/**
+ * Bytes handed out since the last reset (for sizing the arena).
+ */
+size_t codec_arena_used(const codec_arena* arena);
+
+/**
+ * Reclaims the whole arena. Nothing allocated from it - buffers, contexts, streams -
+ * may still be in use.
+ */
+void codec_arena_reset(codec_arena* arena);
+void codec_arena_destroy(codec_arena* arena);
+
+// Statistics: every block compression or decompression (one-shot, _into, context, and
+// each item or block of the batch, frame, parallel and range calls) and every
+// stream_update/stream_end call is counted under its codec and direction. The counters
+// are process-wide and cost two clock reads per call; build with CODEC_NO_STATS (cargo
+// feature no-stats) to remove them.
+
+/**
+ * Fills *stats with the counters summed over all threads. The counters keep moving while
+ * they are read, so one snapshot may include part of the calls in flight.
+ * Returns CODEC_ERR_INVALID_ARG if stats is NULL.
+ */
+int get_codec_stats(codec_stats* stats);
+
+/**
+ * Zeroes all counters.
+ */
+void reset_codec_stats(void);
+
 /**
  * Encodes an unsigned long value into a VarInt format.
  * buffer must be large enough to hold the encoded VarInt (max 10 bytes for u64).
@@ -83,6 +755,104 @@ int32_t encode_varint(unsigned long value, char* buffer);
  */
 int32_t decode_varint(const char* buffer, int32_t max_bytes, unsigned long* value);
 
+/**
+ * Worst-case output size of encode_varint_array for n values (10 bytes each),
+ * or 0 on overflow.
+ */
+size_t varint_array_bound(size_t n);
+
+/**
+ * Encodes n values back to back in the same format as encode_varint.
+ * out must have room for varint_array_bound(n) bytes; the fast kernels use 8-byte
+ * stores, so bytes past the returned length may be overwritten.
+ * Returns the number of bytes written.
+ */
+size_t encode_varint_array(const uint64_t* values, size_t n, char* out);
+
+/**
+ * Decodes exactly n varints from in into values, using a SIMD kernel picked at
+ * runtime for the CPU. *bytes_read is set to the number of input bytes consumed.
+ * Returns CODEC_OK, CODEC_ERR_CORRUPT if a value is malformed or in ends early,
+ * or CODEC_ERR_INVALID_ARG for NULL arguments.
+ */
+int decode_varint_array(const char* in, size_t in_len, uint64_t* values, size_t n, size_t* bytes_read);
+
+/**
+ * Byte-at-a-time reference versions of encode_varint_array / decode_varint_array.
+ */
+size_t encode_varint_array_scalar(const uint64_t* values, size_t n, char* out);
+int decode_varint_array_scalar(const char* in, size_t in_len, uint64_t* values, size_t n, size_t* bytes_read);
+
+/**
+ * Name of the bulk varint kernel selected for this CPU:
+ * "avx2+bmi2", "sse2", "neon" or "word" (portable).
+ */
+const char* varint_array_kernel(void);
+
+/**
+ * Worst-case output size of streamvbyte_encode for n values, or 0 on overflow.
+ */
+size_t streamvbyte_bound(size_t n);
+
+/**
+ * Encodes n 32-bit values in Stream-VByte format: ceil(n / 4) control bytes (a 2-bit
+ * byte length per value) followed by the values in 1-4 little-endian bytes each.
+ * flags may combine STREAMVBYTE_DELTA (store differences, for sorted input) and
+ * STREAMVBYTE_ZIGZAG (signed input passed as uint32_t; small negatives stay short).
+ * out must hold streamvbyte_bound(n) bytes. Returns the number of bytes written.
+ */
+size_t streamvbyte_encode(const uint32_t* values, size_t n, char* out, int flags);
+
+/**
+ * Decodes exactly n values encoded with the same flags, using an SSSE3/NEON shuffle
+ * kernel where available. *bytes_read is set to the size of the encoded stream.
+ * Returns CODEC_OK, CODEC_ERR_CORRUPT if in is too short, or CODEC_ERR_INVALID_ARG.
+ */
+int streamvbyte_decode(const char* in, size_t in_len, uint32_t* values, size_t n, int flags, size_t* bytes_read);
+
+/**
+ * Scalar reference version of streamvbyte_decode.
+ */
+int streamvbyte_decode_scalar(const char* in, size_t in_len, uint32_t* values, size_t n, int flags, size_t* bytes_read);
+
+/**
+ * Name of the Stream-VByte decode kernel selected for this CPU ("ssse3", "neon" or "scalar").
+ */
+const char* streamvbyte_kernel(void);
+
+/**
+ * Worst-case output size of pfor_encode for n values, or 0 on overflow.
+ */
+size_t pfor_bound(size_t n);
+
+/**
+ * Encodes n 64-bit values as bit-packed blocks of 128: each block stores its minimum
+ * (frame of reference), a bit width b and the low b bits of every value - minimum,
+ * with the few values that need more bits patched in from an exception list (PFor).
+ * A partial last block is stored as LEB128 varints. flags may combine PFOR_DELTA
+ * and PFOR_ZIGZAG as for Stream-VByte. out must hold pfor_bound(n) bytes.
+ * Returns the number of bytes written.
+ */
+size_t pfor_encode(const uint64_t* values, size_t n, char* out, int flags);
+
+/**
+ * Decodes exactly n values encoded with the same flags, unpacking four values per
+ * SSE2/NEON step. *bytes_read is set to the size of the encoded stream.
+ * Returns CODEC_OK, CODEC_ERR_CORRUPT if a block is malformed or in is too short,
+ * or CODEC_ERR_INVALID_ARG.
+ */
+int pfor_decode(const char* in, size_t in_len, uint64_t* values, size_t n, int flags, size_t* bytes_read);
+
+/**
+ * Scalar reference version of pfor_decode.
+ */
+int pfor_decode_scalar(const char* in, size_t in_len, uint64_t* values, size_t n, int flags, size_t* bytes_read);
+
+/**
+ * Name of the bit-unpacking kernel selected for this CPU ("sse2", "neon" or "scalar").
+ */
+const char* pfor_kernel(void);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
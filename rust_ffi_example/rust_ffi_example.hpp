@@ -0,0 +1,366 @@
+#ifndef RUST_FFI_EXAMPLE_HPP
+#define RUST_FFI_EXAMPLE_HPP
+
+// Header-only C++17 wrapper around rust_ffi_example.h
+//
+// Owning handles (Context, Dictionary, Stream, RangeReader and the buffers returned by
+// the allocating functions) are move-only std::unique_ptr wrappers, so every create is
+// paired with its destroy and nothing is copied by accident. Compressor<C> fixes the
+// codec at compile time; per-codec entry points are picked with if constexpr, so the
+// codec dispatch of the caller compiles away. Status codes are those of the C API:
+// CODEC_OK or a negative CODEC_ERR_* value.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "rust_ffi_example.h"
+
+namespace rffi {
+
+enum class Codec : int {
+    Zlib = CODEC_ZLIB,
+    Lz4 = CODEC_LZ4,
+    Zstd = CODEC_ZSTD,
+    Stored = CODEC_STORED, // Frames only
+};
+
+namespace detail {
+
+// True for contiguous containers of byte-sized elements (std::string, std::vector<char>, ...)
+template <typename T, typename = void>
+struct is_byte_container : std::false_type {};
+
+template <typename T>
+struct is_byte_container<T, std::void_t<decltype(std::declval<T&>().data()), decltype(std::declval<T&>().size())>>
+    : std::bool_constant<sizeof(*std::declval<T&>().data()) == 1> {};
+
+template <typename Data, void (*Free)(Data)>
+struct ResultDeleter {
+    unsigned long length = 0;
+    void operator()(char* p) const noexcept { Free(Data{p, length}); }
+};
+
+template <typename T, void (*Destroy)(T*)>
+struct HandleDeleter {
+    void operator()(T* p) const noexcept { Destroy(p); }
+};
+
+} // namespace detail
+
+// Read-only byte range; a std::span<const char> stand-in for C++17
+class ByteView {
+public:
+    constexpr ByteView() noexcept = default;
+    constexpr ByteView(const char* data, size_t size) noexcept : data_(data), size_(size) {}
+
+    template <typename T, typename = std::enable_if_t<detail::is_byte_container<const T>::value>>
+    ByteView(const T& bytes) noexcept : data_(reinterpret_cast<const char*>(bytes.data())), size_(bytes.size()) {}
+
+    constexpr const char* data() const noexcept { return data_; }
+    constexpr size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+
+    // Bytes [offset, offset + len), clamped to the view
+    constexpr ByteView subview(size_t offset, size_t len = SIZE_MAX) const noexcept {
+        offset = offset < size_ ? offset : size_;
+        return ByteView(data_ + offset, len < size_ - offset ? len : size_ - offset);
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Writable byte range used as an output buffer; its size is the capacity
+class MutableByteView {
+public:
+    constexpr MutableByteView() noexcept = default;
+    constexpr MutableByteView(char* data, size_t size) noexcept : data_(data), size_(size) {}
+
+    template <typename T, typename = std::enable_if_t<detail::is_byte_container<T>::value &&
+                                                      !std::is_const<std::remove_pointer_t<decltype(std::declval<T&>().data())>>::value>>
+    MutableByteView(T& bytes) noexcept : data_(reinterpret_cast<char*>(bytes.data())), size_(bytes.size()) {}
+
+    constexpr char* data() const noexcept { return data_; }
+    constexpr size_t size() const noexcept { return size_; }
+    constexpr operator ByteView() const noexcept { return ByteView(data_, size_); }
+
+private:
+    char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Move-only owner of a buffer returned by the allocating functions (compress_string, ...)
+template <typename Data, void (*Free)(Data)>
+class LibraryBuffer {
+public:
+    LibraryBuffer() noexcept = default;
+    explicit LibraryBuffer(Data data) noexcept : ptr_(data.buffer, detail::ResultDeleter<Data, Free>{data.length}) {}
+
+    const char* data() const noexcept { return ptr_.get(); }
+    size_t size() const noexcept { return ptr_ ? ptr_.get_deleter().length : 0; }
+    // False if the call that produced the buffer failed
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+    operator ByteView() const noexcept { return ByteView(data(), size()); }
+
+private:
+    std::unique_ptr<char, detail::ResultDeleter<Data, Free>> ptr_;
+};
+
+using CompressedBuffer = LibraryBuffer<CompressedData, free_compressed_data>;
+using DecompressedBuffer = LibraryBuffer<DecompressedData, free_decompressed_data>;
+
+// Pre-digested dictionary; may be shared by any number of contexts once created
+class Dictionary {
+public:
+    Dictionary() noexcept = default;
+    Dictionary(int codec, int level, ByteView content) noexcept
+        : ptr_(codec_dict_create(codec, level, content.data(), content.size())) {}
+
+    const codec_dict* get() const noexcept { return ptr_.get(); }
+    uint32_t id() const noexcept { return codec_dict_id(ptr_.get()); }
+    // False if codec_dict_create failed (empty content or bad level)
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+private:
+    std::unique_ptr<codec_dict, detail::HandleDeleter<codec_dict, codec_dict_destroy>> ptr_;
+};
+
+// Reusable compression context for a codec chosen at run time (see Compressor for a
+// compile-time one). Default-constructed contexts are empty; calls on them fail with
+// CODEC_ERR_INVALID_ARG.
+class Context {
+public:
+    Context() noexcept = default;
+    explicit Context(int codec) noexcept : ptr_(codec_ctx_create(codec)) {}
+
+    codec_ctx* get() const noexcept { return ptr_.get(); }
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+    int set_level(int level) noexcept { return codec_ctx_set_level(ptr_.get(), level); }
+    // false skips checksum verification of frames decoded through this context
+    int set_verify(bool verify) noexcept { return codec_ctx_set_verify(ptr_.get(), verify ? 1 : 0); }
+    // The dictionary must outlive its use by this context
+    int set_dict(const Dictionary& dict) noexcept { return codec_ctx_set_dict(ptr_.get(), dict.get()); }
+
+    int compress(ByteView in, MutableByteView out, size_t& out_len) noexcept {
+        return codec_ctx_compress(ptr_.get(), in.data(), in.size(), out.data(), out.size(), &out_len);
+    }
+    int decompress(ByteView in, MutableByteView out, size_t& out_len) noexcept {
+        return codec_ctx_decompress(ptr_.get(), in.data(), in.size(), out.data(), out.size(), &out_len);
+    }
+    int compress_frame(int flags, ByteView in, MutableByteView out, size_t& out_len) noexcept {
+        return codec_ctx_compress_frame(ptr_.get(), flags, in.data(), in.size(), out.data(), out.size(), &out_len);
+    }
+    int decompress_frame(ByteView in, MutableByteView out, size_t& out_len) noexcept {
+        return codec_ctx_decompress_frame(ptr_.get(), in.data(), in.size(), out.data(), out.size(), &out_len);
+    }
+
+private:
+    std::unique_ptr<codec_ctx, detail::HandleDeleter<codec_ctx, codec_ctx_destroy>> ptr_;
+};
+
+// Context for a codec fixed at compile time. The static members call the codec's own
+// entry points (compress_string_lz4_into, compress_bound_zstd, ...) with no codec
+// switch; the one-shot ones run on the calling thread's cached context.
+template <Codec C>
+class Compressor {
+    static_assert(C == Codec::Zlib || C == Codec::Lz4 || C == Codec::Zstd,
+                  "Compressor needs a block codec; stored frames have no context");
+
+public:
+    static constexpr Codec codec = C;
+    static constexpr int id = static_cast<int>(C);
+
+    static int default_level() noexcept { return codec_default_level(id); }
+
+    // Worst-case output of compress / compress_once for in_len bytes (0 if too large)
+    static size_t compress_bound(size_t in_len) noexcept {
+        if constexpr (C == Codec::Zlib) {
+            return ::compress_bound(in_len);
+        } else if constexpr (C == Codec::Lz4) {
+            return compress_bound_lz4(in_len);
+        } else {
+            return compress_bound_zstd(in_len);
+        }
+    }
+
+    static size_t frame_bound(size_t in_len) noexcept { return frame_compress_bound(id, in_len); }
+
+    // One-shot compression at the default level
+    static int compress_once(ByteView in, MutableByteView out, size_t& out_len) noexcept {
+        if constexpr (C == Codec::Zlib) {
+            return compress_string_into(in.data(), in.size(), out.data(), out.size(), &out_len);
+        } else if constexpr (C == Codec::Lz4) {
+            return compress_string_lz4_into(in.data(), in.size(), out.data(), out.size(), &out_len);
+        } else {
+            return compress_string_zstd_into(in.data(), in.size(), out.data(), out.size(), &out_len);
+        }
+    }
+
+    static int decompress_once(ByteView in, MutableByteView out, size_t& out_len) noexcept {
+        if constexpr (C == Codec::Zlib) {
+            return decompress_data_into(in.data(), in.size(), out.data(), out.size(), &out_len);
+        } else if constexpr (C == Codec::Lz4) {
+            return decompress_data_lz4_into(in.data(), in.size(), out.data(), out.size(), &out_len);
+        } else {
+            return decompress_data_zstd_into(in.data(), in.size(), out.data(), out.size(), &out_len);
+        }
+    }
+
+    // Allocating one-shot forms; an empty buffer means failure
+    static CompressedBuffer compress_once(ByteView in) noexcept {
+        if constexpr (C == Codec::Zlib) {
+            return CompressedBuffer(compress_string(in.data(), in.size()));
+        } else if constexpr (C == Codec::Lz4) {
+            return CompressedBuffer(compress_string_lz4(in.data(), in.size()));
+        } else {
+            return CompressedBuffer(compress_string_zstd(in.data(), in.size()));
+        }
+    }
+
+    static DecompressedBuffer decompress_once(ByteView in) noexcept {
+        if constexpr (C == Codec::Zlib) {
+            return DecompressedBuffer(decompress_data(in.data(), in.size()));
+        } else if constexpr (C == Codec::Lz4) {
+            return DecompressedBuffer(decompress_data_lz4(in.data(), in.size()));
+        } else {
+            return DecompressedBuffer(decompress_data_zstd(in.data(), in.size()));
+        }
+    }
+
+    Compressor() noexcept : ctx_(id) {}
+
+    // False if the context could not be allocated
+    explicit operator bool() const noexcept { return static_cast<bool>(ctx_); }
+    Context& context() noexcept { return ctx_; }
+
+    int set_level(int level) noexcept { return ctx_.set_level(level); }
+    int set_dict(const Dictionary& dict) noexcept { return ctx_.set_dict(dict); }
+
+    int compress(ByteView in, MutableByteView out, size_t& out_len) noexcept { return ctx_.compress(in, out, out_len); }
+    int decompress(ByteView in, MutableByteView out, size_t& out_len) noexcept {
+        return ctx_.decompress(in, out, out_len);
+    }
+    int compress_frame(int flags, ByteView in, MutableByteView out, size_t& out_len) noexcept {
+        return ctx_.compress_frame(flags, in, out, out_len);
+    }
+    int decompress_frame(ByteView in, MutableByteView out, size_t& out_len) noexcept {
+        return ctx_.decompress_frame(in, out, out_len);
+    }
+
+    // Compress into out, growing it to codec_compress_bound (which leaves room for a
+    // dictionary ID) and shrinking it to the result
+    int compress(ByteView in, std::vector<char>& out) {
+        size_t out_len = 0;
+        out.resize(codec_compress_bound(id, in.size()));
+        int rc = out.empty() ? CODEC_ERR_TOO_LARGE : compress(in, MutableByteView(out), out_len);
+        out.resize(rc == CODEC_OK ? out_len : 0);
+        return rc;
+    }
+
+private:
+    Context ctx_;
+};
+
+template <Codec C>
+using CodecTag = std::integral_constant<Codec, C>;
+
+// Call f(CodecTag<C>{}) for the block codec with run-time identifier codec, so generic
+// code can be written once against Compressor<decltype(tag)::value> and instantiated per
+// codec. Returns CODEC_ERR_INVALID_ARG for other identifiers; f must return int.
+template <typename F>
+int visit_codec(int codec, F&& f) {
+    switch (codec) {
+        case CODEC_ZLIB: return std::forward<F>(f)(CodecTag<Codec::Zlib>{});
+        case CODEC_LZ4: return std::forward<F>(f)(CodecTag<Codec::Lz4>{});
+        case CODEC_ZSTD: return std::forward<F>(f)(CodecTag<Codec::Zstd>{});
+        default: return CODEC_ERR_INVALID_ARG;
+    }
+}
+
+// Zero-copy read of a CODEC_STORED frame: data is set to the original bytes inside frame.
+// Returns CODEC_ERR_WRONG_CODEC for a compressed frame (decompress it instead)
+inline int stored_frame_view(ByteView frame, ByteView& data) noexcept {
+    const char* ptr = nullptr;
+    size_t len = 0;
+    int rc = frame_stored_view(frame.data(), frame.size(), &ptr, &len);
+    data = ByteView(ptr, len);
+    return rc;
+}
+
+// CRC32C of data (the frame checksum), continuing from crc
+inline uint32_t crc32c(ByteView data, uint32_t crc = 0) noexcept {
+    return checksum_crc32c(crc, data.data(), data.size());
+}
+
+// Streaming compressor or decompressor (see stream_begin)
+class Stream {
+public:
+    Stream() noexcept = default;
+    Stream(int codec, int mode, int level) noexcept : ptr_(stream_begin(codec, mode, level)) {}
+
+    // False if stream_begin rejected the codec, mode or level
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+    int update(ByteView in, size_t& in_consumed, MutableByteView out, size_t& out_len) noexcept {
+        return stream_update(ptr_.get(), in.data(), in.size(), &in_consumed, out.data(), out.size(), &out_len);
+    }
+    int end(MutableByteView out, size_t& out_len) noexcept {
+        return stream_end(ptr_.get(), out.data(), out.size(), &out_len);
+    }
+
+private:
+    std::unique_ptr<codec_stream, detail::HandleDeleter<codec_stream, stream_destroy>> ptr_;
+};
+
+// Random access into a block-parallel container; in must outlive the reader
+class RangeReader {
+public:
+    RangeReader() noexcept = default;
+    explicit RangeReader(ByteView in) noexcept : ptr_(range_reader_open(in.data(), in.size())) {}
+
+    // False if the input is not a block-parallel container
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+    size_t size() const noexcept { return range_reader_size(ptr_.get()); }
+
+    int read(size_t offset, size_t len, MutableByteView out, size_t& out_len) noexcept {
+        return range_reader_read(ptr_.get(), offset, len, out.data(), out.size(), &out_len);
+    }
+
+private:
+    std::unique_ptr<range_reader, detail::HandleDeleter<range_reader, range_reader_close>> ptr_;
+};
+
+// Pull-based reader over varint-length-prefixed records; in must outlive the reader
+class RecordReader {
+public:
+    RecordReader() noexcept = default;
+    RecordReader(Codec codec, ByteView in, size_t window = 0) noexcept
+        : ptr_(record_reader_open(static_cast<int>(codec), in.data(), in.size(), window)) {}
+
+    // False if the codec or length header was rejected
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+    // CODEC_OK with record set (valid until the next call), RECORD_END, or CODEC_ERR_*
+    int next(ByteView& record) noexcept {
+        const char* data = nullptr;
+        size_t len = 0;
+        int rc = record_reader_next(ptr_.get(), &data, &len);
+        record = ByteView(data, len);
+        return rc;
+    }
+
+private:
+    std::unique_ptr<record_reader, detail::HandleDeleter<record_reader, record_reader_close>> ptr_;
+};
+
+} // namespace rffi
+
+#endif // RUST_FFI_EXAMPLE_HPP
@@ -1,9 +1,40 @@
+#ifdef __linux__
+#define _GNU_SOURCE // pthread_setaffinity_np, CPU_* macros
+#endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <math.h>
+#include <time.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
 #include <zlib.h>
 #include <lz4.h>
+#include <lz4hc.h>
+#include <lz4frame.h>
+#define ZSTD_STATIC_LINKING_ONLY // ZSTD_customMem constructors
 #include <zstd.h>
+#include <zstd_errors.h>
+#include <zdict.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define VARINT_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VARINT_NEON 1
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARMV8 1
+#endif
+#endif
 
 // Define a struct to return both buffer and length
 typedef struct {
@@ -17,6 +48,220 @@ typedef struct {
     unsigned long length;
 } DecompressedData;
 
+// Maximum number of bytes a varint-encoded 64-bit length can occupy
+#define MAX_VARINT_LEN 10
+
+// Upper bound on original_len accepted by the allocating decompressors
+// (prevents absurdly large allocations from corrupted headers)
+#define MAX_DECOMPRESSED_SIZE (100 * 1024 * 1024)
+
+// Status codes returned by the caller-provided buffer (*_into) entry points
+#define CODEC_OK 0
+#define CODEC_ERR_INVALID_ARG -1
+#define CODEC_ERR_BUFFER_TOO_SMALL -2
+#define CODEC_ERR_CORRUPT -3
+#define CODEC_ERR_TOO_LARGE -4
+#define CODEC_ERR_CODEC -5
+#define CODEC_ERR_ALLOC -6
+#define CODEC_ERR_DICT_MISMATCH -7
+#define CODEC_ERR_CHECKSUM -8
+#define CODEC_ERR_WRONG_CODEC -9
+
+// Codec identifiers used by the context API
+#define CODEC_ZLIB 0
+#define CODEC_LZ4 1
+#define CODEC_ZSTD 2
+#define CODEC_STORED 3 // Frames only: body holds the input uncompressed
+#define CODEC_AUTO (-1) // Frames only: codec picked per input by compress_frame_auto_into
+
+// Default zstd level used by compress_string_zstd
+#define ZSTD_DEFAULT_LEVEL 1
+
+// LZ4 level mapping: negative levels select the fast mode with acceleration -level,
+// 0 up to LZ4HC_CLEVEL_MIN - 1 select LZ4_compress_default, and LZ4HC_CLEVEL_MIN..LZ4HC_CLEVEL_MAX
+// select LZ4HC at that level
+#define LZ4_MIN_LEVEL (-65537) // LZ4's maximum acceleration
+
+// Runtime statistics
+//
+// Every block compression or decompression adds its outcome, byte counts and duration
+// to its codec's counters: the one-shot and _into functions, contexts, and the batch,
+// frame, parallel and range calls built on them (one call per item or block), as well
+// as each stream_update/stream_end call. Bytes are counted for successful calls only,
+// so bytes_out / bytes_in is the achieved ratio. The trial compressions of
+// codec_auto_select are not counted. get_codec_stats sums the counters into a snapshot.
+//
+// Counters are relaxed atomics in STATS_STRIPES cache-line aligned copies; each thread
+// always updates the same copy, so threads rarely share a line. A counted call costs
+// two clock reads and a few uncontended increments. Building with -DCODEC_NO_STATS
+// (cargo feature no-stats) compiles all of it out, and get_codec_stats then returns
+// zeros with enabled = 0.
+
+#define CODEC_STATS_CODECS 4       // CODEC_ZLIB..CODEC_STORED
+#define CODEC_STATS_COMPRESS 0
+#define CODEC_STATS_DECOMPRESS 1
+#define CODEC_STATS_BUCKETS 32     // Bucket i: calls taking [2^i, 2^(i+1)) ns; the last one is open-ended
+#define CODEC_STATS_ERROR_CODES 10 // errors_by_code is indexed by -CODEC_ERR_*
+
+typedef struct {
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t total_ns;
+    uint64_t latency[CODEC_STATS_BUCKETS];
+} codec_op_stats;
+
+typedef struct {
+    codec_op_stats ops[CODEC_STATS_CODECS][2];
+    uint64_t errors_by_code[CODEC_STATS_ERROR_CODES];
+    uint64_t bad_varint;
+    uint64_t over_size_cap;
+    int enabled;
+} codec_stats;
+
+#ifndef CODEC_NO_STATS
+
+#define STATS_STRIPES 16
+
+typedef struct {
+    _Atomic uint64_t calls;
+    _Atomic uint64_t errors;
+    _Atomic uint64_t bytes_in;
+    _Atomic uint64_t bytes_out;
+    _Atomic uint64_t total_ns;
+    _Atomic uint64_t latency[CODEC_STATS_BUCKETS];
+} stats_op_counters;
+
+typedef struct {
+    _Alignas(64) stats_op_counters ops[CODEC_STATS_CODECS][2];
+    _Atomic uint64_t errors_by_code[CODEC_STATS_ERROR_CODES];
+    _Atomic uint64_t bad_varint;
+    _Atomic uint64_t over_size_cap;
+} stats_stripe;
+
+static stats_stripe stats_stripes[STATS_STRIPES];
+static atomic_uint stats_next_stripe;
+static _Thread_local stats_stripe *stats_own_stripe;
+
+static stats_stripe *stats_stripe_get(void) {
+    if (stats_own_stripe == NULL) {
+        unsigned i = atomic_fetch_add_explicit(&stats_next_stripe, 1, memory_order_relaxed);
+        stats_own_stripe = &stats_stripes[i % STATS_STRIPES];
+    }
+    return stats_own_stripe;
+}
+
+#define STATS_ADD(counter, n) atomic_fetch_add_explicit(&(counter), (uint64_t)(n), memory_order_relaxed)
+#define STATS_COUNT(field) STATS_ADD(stats_stripe_get()->field, 1)
+
+static inline uint64_t stats_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Record one call that started at stats_clock() == start and returned rc
+// codec may be out of range (e.g. a NULL context); then only the error code is counted
+static void stats_record(int codec, int op, size_t bytes_in, size_t bytes_out, int rc, uint64_t start) {
+    uint64_t ns = stats_clock() - start;
+    stats_stripe *s = stats_stripe_get();
+    if (rc < 0 && -rc < CODEC_STATS_ERROR_CODES) {
+        STATS_ADD(s->errors_by_code[-rc], 1);
+    }
+    if (codec < 0 || codec >= CODEC_STATS_CODECS) {
+        return;
+    }
+    stats_op_counters *c = &s->ops[codec][op];
+    STATS_ADD(c->calls, 1);
+    STATS_ADD(c->total_ns, ns);
+    int bucket = 63 - __builtin_clzll(ns | 1);
+    STATS_ADD(c->latency[bucket < CODEC_STATS_BUCKETS ? bucket : CODEC_STATS_BUCKETS - 1], 1);
+    if (rc < 0) {
+        STATS_ADD(c->errors, 1);
+    } else {
+        STATS_ADD(c->bytes_in, bytes_in);
+        STATS_ADD(c->bytes_out, bytes_out);
+    }
+}
+
+#else
+
+#define STATS_COUNT(field) ((void)0)
+
+static inline uint64_t stats_clock(void) {
+    return 0;
+}
+
+static inline void stats_record(int codec, int op, size_t bytes_in, size_t bytes_out, int rc, uint64_t start) {
+    (void)codec, (void)op, (void)bytes_in, (void)bytes_out, (void)rc, (void)start;
+}
+
+#endif
+
+// Snapshot of all counters, summed over threads
+// Counters keep moving while they are read, so fields of one snapshot can be off by the
+// calls in flight. Returns CODEC_ERR_INVALID_ARG if stats is NULL
+int get_codec_stats(codec_stats *stats) {
+    if (stats == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    memset(stats, 0, sizeof(*stats));
+#ifndef CODEC_NO_STATS
+    stats->enabled = 1;
+    for (int i = 0; i < STATS_STRIPES; i++) {
+        stats_stripe *s = &stats_stripes[i];
+        for (int codec = 0; codec < CODEC_STATS_CODECS; codec++) {
+            for (int op = 0; op < 2; op++) {
+                stats_op_counters *c = &s->ops[codec][op];
+                codec_op_stats *out = &stats->ops[codec][op];
+                out->calls += atomic_load_explicit(&c->calls, memory_order_relaxed);
+                out->errors += atomic_load_explicit(&c->errors, memory_order_relaxed);
+                out->bytes_in += atomic_load_explicit(&c->bytes_in, memory_order_relaxed);
+                out->bytes_out += atomic_load_explicit(&c->bytes_out, memory_order_relaxed);
+                out->total_ns += atomic_load_explicit(&c->total_ns, memory_order_relaxed);
+                for (int b = 0; b < CODEC_STATS_BUCKETS; b++) {
+                    out->latency[b] += atomic_load_explicit(&c->latency[b], memory_order_relaxed);
+                }
+            }
+        }
+        for (int e = 0; e < CODEC_STATS_ERROR_CODES; e++) {
+            stats->errors_by_code[e] += atomic_load_explicit(&s->errors_by_code[e], memory_order_relaxed);
+        }
+        stats->bad_varint += atomic_load_explicit(&s->bad_varint, memory_order_relaxed);
+        stats->over_size_cap += atomic_load_explicit(&s->over_size_cap, memory_order_relaxed);
+    }
+#endif
+    return CODEC_OK;
+}
+
+// Zero all counters; calls running concurrently may or may not be included afterwards
+void reset_codec_stats(void) {
+#ifndef CODEC_NO_STATS
+    for (int i = 0; i < STATS_STRIPES; i++) {
+        stats_stripe *s = &stats_stripes[i];
+        for (int codec = 0; codec < CODEC_STATS_CODECS; codec++) {
+            for (int op = 0; op < 2; op++) {
+                stats_op_counters *c = &s->ops[codec][op];
+                atomic_store_explicit(&c->calls, 0, memory_order_relaxed);
+                atomic_store_explicit(&c->errors, 0, memory_order_relaxed);
+                atomic_store_explicit(&c->bytes_in, 0, memory_order_relaxed);
+                atomic_store_explicit(&c->bytes_out, 0, memory_order_relaxed);
+                atomic_store_explicit(&c->total_ns, 0, memory_order_relaxed);
+                for (int b = 0; b < CODEC_STATS_BUCKETS; b++) {
+                    atomic_store_explicit(&c->latency[b], 0, memory_order_relaxed);
+                }
+            }
+        }
+        for (int e = 0; e < CODEC_STATS_ERROR_CODES; e++) {
+            atomic_store_explicit(&s->errors_by_code[e], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&s->bad_varint, 0, memory_order_relaxed);
+        atomic_store_explicit(&s->over_size_cap, 0, memory_order_relaxed);
+    }
+#endif
+}
+
 // Variable-byte encoding functions
 
 // Encode a length as variable-byte encoding
@@ -52,6 +297,7 @@ int decode_varint(const char *buffer, int max_bytes, unsigned long *value) {
             #ifdef DEBUG_FUZZING
             fprintf(stderr, "Varint overflow: length too large\n");
             #endif
+            STATS_COUNT(bad_varint);
             return -1; // Overflow
         }
     }
@@ -60,405 +306,5148 @@ int decode_varint(const char *buffer, int max_bytes, unsigned long *value) {
     #ifdef DEBUG_FUZZING
     fprintf(stderr, "Incomplete varint: unexpected end of data\n");
     #endif
+    STATS_COUNT(bad_varint);
     return -1; // Incomplete varint
 }
 
-// Function to compress a string using zlib with variable-byte length header
-// The compressed data format: [varint original length][zlib compressed data]
-// The caller is responsible for freeing the returned buffer
-CompressedData compress_string(const char *input, unsigned long input_len) {
-    unsigned long compressed_bound = compressBound(input_len);
-    // Allocate buffer for: max 10-byte varint header + compressed data
-    unsigned long total_buffer_size = 10 + compressed_bound;
-    char *output_buffer = (char *)malloc(total_buffer_size);
-    CompressedData result = {NULL, 0};
+// Bulk variable-byte encoding
+//
+// encode_varint_array/decode_varint_array process whole arrays in the same LEB128
+// format as encode_varint/decode_varint. Posting lists are dominated by small deltas,
+// so the kernels:
+//   - handle runs of single-byte values 16/32 at a time with SSE2/AVX2/NEON: a
+//     movemask of the continuation bits gives the run length, the whole vector is
+//     widened to uint64 and only the leading single-byte values are kept,
+//   - decode other values of up to 8 bytes branchlessly from one 64-bit load: the
+//     terminator is found with ctz on the inverted continuation bits and the 7-bit
+//     groups are compacted with pext (BMI2) or three shift/mask steps,
+//   - fall back to the byte loop for 9-10 byte values and near the buffer end.
+// The kernel is picked once at runtime from the CPU features (see varint_array_kernel).
 
-    if (output_buffer == NULL) {
-        perror("Failed to allocate memory for compression");
-        return result; // Return empty result
-    }
+#define VARINT_CONT_BITS 0x8080808080808080ULL
+#define VARINT_DATA_BITS 0x7f7f7f7f7f7f7f7fULL
 
-    // Encode original length as varint at the beginning
-    int header_size = encode_varint(input_len, output_buffer);
+static inline uint64_t varint_load64(const unsigned char *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
 
-    // Compress data after the varint header
-    unsigned long compressed_len = compressed_bound;
-    int res = compress((Bytef *)(output_buffer + header_size), &compressed_len, (const Bytef *)input, input_len);
+static inline void varint_store64(unsigned char *p, uint64_t w) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    memcpy(p, &w, sizeof(w));
+}
 
-    if (res != Z_OK) {
-        fprintf(stderr, "Compression failed: %d\n", res);
-        free(output_buffer);
-        return result; // Return empty result
+// Gather the low 7 bits of each byte into a contiguous value (portable pext)
+static inline uint64_t varint_compact(uint64_t x) {
+    x &= VARINT_DATA_BITS;
+    x = ((x & 0x7f007f007f007f00ULL) >> 1) | (x & 0x007f007f007f007fULL);
+    x = ((x & 0x3fff00003fff0000ULL) >> 2) | (x & 0x00003fff00003fffULL);
+    x = ((x & 0x0fffffff00000000ULL) >> 4) | (x & 0x000000000fffffffULL);
+    return x;
+}
+
+// Spread a value below 2^56 into 7-bit groups, one per byte (portable pdep)
+static inline uint64_t varint_spread(uint64_t x) {
+    x = ((x & 0x00fffffff0000000ULL) << 4) | (x & 0x000000000fffffffULL);
+    x = ((x & 0x0fffc0000fffc000ULL) << 2) | (x & 0x00003fff00003fffULL);
+    x = ((x & 0x3f803f803f803f80ULL) << 1) | (x & 0x007f007f007f007fULL);
+    return x;
+}
+
+// Decode one varint with the byte loop; same acceptance rules as decode_varint
+// Returns the number of bytes read, or -1 if malformed or truncated
+static inline int varint_decode_one_scalar(const unsigned char *p, size_t avail, uint64_t *value) {
+    size_t max_bytes = avail < MAX_VARINT_LEN ? avail : MAX_VARINT_LEN;
+    uint64_t v = 0;
+    for (size_t k = 0; k < max_bytes; k++) {
+        v |= (uint64_t)(p[k] & 0x7F) << (7 * k);
+        if ((p[k] & 0x80) == 0) {
+            *value = v;
+            return (int)k + 1;
+        }
     }
+    return -1;
+}
 
-    result.buffer = output_buffer;
-    result.length = header_size + compressed_len; // Header + compressed data
-    return result;
+// Encode one value with the byte loop; returns the number of bytes written
+static inline int varint_encode_one_scalar(uint64_t v, unsigned char *out) {
+    int n = 0;
+    while (v >= 0x80) {
+        out[n++] = (unsigned char)((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (unsigned char)v;
+    return n;
 }
 
-// Function to decompress data using zlib, automatically reading original size from varint header
-// Expects input format: [varint original length][zlib compressed data]
-// The caller is responsible for freeing the returned buffer
-DecompressedData decompress_data(const char *input, unsigned long input_len) {
-    DecompressedData result = {NULL, 0};
-    
-    // Check minimum input size (at least 1 byte for varint + some compressed data)
-    if (input_len < 2) {
-        // Reduce noise during fuzzing - only print in debug mode
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid compressed data: too small (need at least 2 bytes)\n");
-        #endif
-        return result;
+// Length of the varint in the 8-byte word w, or 0 if it is longer than 8 bytes.
+// *keep is set to a mask of the bytes that belong to it.
+static inline unsigned varint_word_len(uint64_t w, uint64_t *keep) {
+    uint64_t stop = ~w & VARINT_CONT_BITS;
+    if (stop == 0) {
+        return 0;
     }
-    
-    // Decode original length from varint header
-    unsigned long original_len;
-    int header_size = decode_varint(input, input_len, &original_len);
-    if (header_size < 0) {
-        // Reduce noise during fuzzing - only print in debug mode
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid compressed data: failed to decode varint header\n");
-        #endif
-        return result;
+    *keep = stop ^ (stop - 1); // Every bit up to the terminator's high bit
+    return ((unsigned)__builtin_ctzll(stop) >> 3) + 1;
+}
+
+// Encode length of v (1-10 bytes)
+static inline unsigned varint_len(uint64_t v) {
+    unsigned bits = 64 - (unsigned)__builtin_clzll(v | 1);
+    return (bits + 6) / 7;
+}
+
+// Shared loops, instantiated per kernel with its run handler and (un)packing step.
+// RUN_STEP may consume a run of single-byte values and `continue`.
+#define VARINT_DECODE_BODY(RUN_STEP, COMPACT)                                        \
+    const unsigned char *p = (const unsigned char *)input;                           \
+    size_t pos = 0;                                                                  \
+    size_t i = 0;                                                                    \
+    while (i < n) {                                                                  \
+        RUN_STEP                                                                     \
+        if (input_len - pos >= 8) {                                                  \
+            uint64_t keep;                                                           \
+            uint64_t w = varint_load64(p + pos);                                     \
+            if ((w & 0x80) == 0) {                                                   \
+                values[i++] = w & 0x7F;                                              \
+                pos++;                                                               \
+                continue;                                                            \
+            }                                                                        \
+            unsigned len = varint_word_len(w, &keep);                                \
+            if (len != 0) {                                                          \
+                values[i++] = COMPACT(w & keep);                                     \
+                pos += len;                                                          \
+                continue;                                                            \
+            }                                                                        \
+        }                                                                            \
+        int r = varint_decode_one_scalar(p + pos, input_len - pos, &values[i]);      \
+        if (r < 0) {                                                                 \
+            return CODEC_ERR_CORRUPT;                                                \
+        }                                                                            \
+        pos += (size_t)r;                                                            \
+        i++;                                                                         \
+    }                                                                                \
+    *bytes_read = pos;                                                               \
+    return CODEC_OK;
+
+#define VARINT_ENCODE_BODY(SPREAD)                                                   \
+    unsigned char *o = (unsigned char *)output;                                      \
+    size_t pos = 0;                                                                  \
+    size_t i = 0;                                                                    \
+    while (i < n) {                                                                  \
+        /* Runs of small values: the OR test and byte copy vectorize */              \
+        if (n - i >= 8) {                                                            \
+            uint64_t any = 0;                                                        \
+            for (int k = 0; k < 8; k++) any |= values[i + k];                        \
+            if (any < 0x80) {                                                        \
+                for (int k = 0; k < 8; k++) o[pos + k] = (unsigned char)values[i + k]; \
+                pos += 8;                                                            \
+                i += 8;                                                              \
+                continue;                                                            \
+            }                                                                        \
+        }                                                                            \
+        uint64_t v = values[i++];                                                    \
+        if (v < (1ULL << 56)) {                                                      \
+            /* Up to 8 bytes: spread the groups and set every continuation bit but  \
+               the last in one store; bound guarantees 8 writable bytes here */      \
+            unsigned len = varint_len(v);                                            \
+            uint64_t cont = VARINT_CONT_BITS & ((1ULL << (8 * (len - 1))) - 1);      \
+            varint_store64(o + pos, SPREAD(v) | cont);                               \
+            pos += len;                                                              \
+        } else {                                                                     \
+            pos += (size_t)varint_encode_one_scalar(v, o + pos);                     \
+        }                                                                            \
+    }                                                                                \
+    return pos;
+
+// Worst-case output size of encode_varint_array for n values
+size_t varint_array_bound(size_t n) {
+    if (n > SIZE_MAX / MAX_VARINT_LEN) {
+        return 0;
     }
-    
-    // Check that we have enough data after the header
-    if ((unsigned long)header_size >= input_len) {
-        // Reduce noise during fuzzing - only print in debug mode
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid compressed data: no data after varint header\n");
-        #endif
-        return result;
+    return n * MAX_VARINT_LEN;
+}
+
+// Reference byte-at-a-time kernels (also used to validate and benchmark the fast ones)
+size_t encode_varint_array_scalar(const uint64_t *values, size_t n, char *output) {
+    size_t pos = 0;
+    for (size_t i = 0; i < n; i++) {
+        pos += (size_t)varint_encode_one_scalar(values[i], (unsigned char *)output + pos);
     }
-    
-    // Sanity check on original length (prevent absurdly large allocations)
-    if (original_len > 100 * 1024 * 1024) { // 100MB limit
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid compressed data: original length too large (%lu bytes)\n", original_len);
-        #endif
-        return result;
+    return pos;
+}
+
+int decode_varint_array_scalar(const char *input, size_t input_len, uint64_t *values, size_t n,
+                               size_t *bytes_read) {
+    if (bytes_read == NULL || (input == NULL && input_len > 0) || (values == NULL && n > 0)) {
+        return CODEC_ERR_INVALID_ARG;
     }
-    
-    // Allocate buffer for decompressed data
-    char *output_buffer = (char *)calloc(original_len + 1, 1); // calloc zero-initializes memory
-    if (output_buffer == NULL) {
-        perror("Failed to allocate memory for decompression");
-        return result;
+    size_t pos = 0;
+    for (size_t i = 0; i < n; i++) {
+        int r = varint_decode_one_scalar((const unsigned char *)input + pos, input_len - pos, &values[i]);
+        if (r < 0) {
+            return CODEC_ERR_CORRUPT;
+        }
+        pos += (size_t)r;
     }
+    *bytes_read = pos;
+    return CODEC_OK;
+}
 
-    // Decompress data (skip the varint header)
-    unsigned long actual_output_len = original_len;
-    int res = uncompress((Bytef *)output_buffer, &actual_output_len, 
-                        (const Bytef *)(input + header_size), input_len - header_size);
+// Portable word-at-a-time kernels
+static size_t varint_encode_word(const uint64_t *values, size_t n, char *output) {
+    VARINT_ENCODE_BODY(varint_spread)
+}
 
-    if (res != Z_OK) {
-        // Reduce noise during fuzzing - only print in debug mode
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Decompression failed: %d\n", res);
-        #endif
-        free(output_buffer);
-        return result;
+static int varint_decode_word(const char *input, size_t input_len, uint64_t *values, size_t n,
+                              size_t *bytes_read) {
+    VARINT_DECODE_BODY(, varint_compact)
+}
+
+#if defined(VARINT_X86)
+// SSE2 is part of the x86-64 baseline; widen 16 single-byte values to uint64
+static inline void varint_widen16_sse2(__m128i v, uint64_t *dst) {
+    const __m128i z = _mm_setzero_si128();
+    __m128i h[2] = {_mm_unpacklo_epi8(v, z), _mm_unpackhi_epi8(v, z)};
+    for (int a = 0; a < 2; a++) {
+        __m128i d[2] = {_mm_unpacklo_epi16(h[a], z), _mm_unpackhi_epi16(h[a], z)};
+        for (int b = 0; b < 2; b++) {
+            _mm_storeu_si128((__m128i *)(dst + 8 * a + 4 * b), _mm_unpacklo_epi32(d[b], z));
+            _mm_storeu_si128((__m128i *)(dst + 8 * a + 4 * b + 2), _mm_unpackhi_epi32(d[b], z));
+        }
     }
-    
-    // Verify that decompressed length matches expected length
-    if (actual_output_len != original_len) {
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Decompression length mismatch: expected %lu, got %lu\n", 
-                original_len, actual_output_len);
-        #endif
-        free(output_buffer);
-        return result;
+}
+
+#define VARINT_RUN_SSE2                                                              \
+    if (input_len - pos >= 16 && n - i >= 16) {                                      \
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + pos));                     \
+        unsigned m = (unsigned)_mm_movemask_epi8(v);                                 \
+        if (m == 0) {                                                                \
+            varint_widen16_sse2(v, values + i);                                      \
+            i += 16;                                                                 \
+            pos += 16;                                                               \
+            continue;                                                                \
+        }                                                                            \
+        /* Widen all 16 anyway and keep only the leading single-byte values */   \
+        varint_widen16_sse2(v, values + i);                                          \
+        unsigned singles = (unsigned)__builtin_ctz(m);                               \
+        i += singles;                                                                \
+        pos += singles;                                                              \
     }
 
-    result.buffer = output_buffer;
-    result.length = actual_output_len;
-    return result;
+static int varint_decode_sse2(const char *input, size_t input_len, uint64_t *values, size_t n,
+                              size_t *bytes_read) {
+    VARINT_DECODE_BODY(VARINT_RUN_SSE2, varint_compact)
 }
 
-// Function to compress a string using LZ4 with variable-byte length header
-// The compressed data format: [varint original length][LZ4 compressed data]
-// The caller is responsible for freeing the returned buffer
-CompressedData compress_string_lz4(const char *input, unsigned long input_len) {
-    // Calculate the maximum compressed size using LZ4_compressBound
-    int lz4_max_compressed_size = LZ4_compressBound((int)input_len);
-    if (lz4_max_compressed_size <= 0) {
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "LZ4_compressBound failed or input size is 0.\n");
-        #endif
-        return (CompressedData){NULL, 0};
-    }
+__attribute__((target("bmi2"))) static inline uint64_t varint_compact_pext(uint64_t x) {
+    return _pext_u64(x, VARINT_DATA_BITS);
+}
 
-    // Allocate buffer for: max 10-byte varint header + compressed data
-    unsigned long total_buffer_size = 10 + (unsigned long)lz4_max_compressed_size;
-    char *output_buffer = (char *)malloc(total_buffer_size);
-    CompressedData result = {NULL, 0};
+__attribute__((target("bmi2"))) static inline uint64_t varint_spread_pdep(uint64_t x) {
+    return _pdep_u64(x, VARINT_DATA_BITS);
+}
 
-    if (output_buffer == NULL) {
-        perror("Failed to allocate memory for LZ4 compression");
-        return result; // Return empty result
-    }
+#define VARINT_RUN_AVX2                                                              \
+    if (input_len - pos >= 32 && n - i >= 32) {                                      \
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + pos));                  \
+        unsigned m = (unsigned)_mm256_movemask_epi8(v);                              \
+        if (m == 0) {                                                                \
+            for (int k = 0; k < 32; k += 4) {                                        \
+                int32_t four;                                                        \
+                memcpy(&four, p + pos + k, sizeof(four));                            \
+                _mm256_storeu_si256((__m256i *)(values + i + k),                     \
+                                    _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(four)));  \
+            }                                                                        \
+            i += 32;                                                                 \
+            pos += 32;                                                               \
+            continue;                                                                \
+        }                                                                            \
+    }                                                                                \
+    VARINT_RUN_SSE2 /* Mixed window: handle it 16 bytes at a time */
 
-    // Encode original length as varint at the beginning
-    int header_size = encode_varint(input_len, output_buffer);
+__attribute__((target("avx2,bmi2")))
+static int varint_decode_avx2(const char *input, size_t input_len, uint64_t *values, size_t n,
+                              size_t *bytes_read) {
+    VARINT_DECODE_BODY(VARINT_RUN_AVX2, varint_compact_pext)
+}
 
-    // Compress data after the varint header
-    int compressed_data_size = LZ4_compress_default(input, output_buffer + header_size, (int)input_len, (int)(total_buffer_size - header_size));
+__attribute__((target("avx2,bmi2")))
+static size_t varint_encode_bmi2(const uint64_t *values, size_t n, char *output) {
+    VARINT_ENCODE_BODY(varint_spread_pdep)
+}
+#endif
 
-    if (compressed_data_size <= 0) {
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "LZ4_compress_default failed: %d\n", compressed_data_size);
-        #endif
-        free(output_buffer);
-        return result; // Return empty result
+#if defined(VARINT_NEON)
+#define VARINT_RUN_NEON                                                              \
+    if (input_len - pos >= 16 && n - i >= 16) {                                      \
+        uint8x16_t v = vld1q_u8(p + pos);                                            \
+        if (vmaxvq_u8(v) < 0x80) {                                                   \
+            uint16x8_t h[2] = {vmovl_u8(vget_low_u8(v)), vmovl_u8(vget_high_u8(v))}; \
+            for (int a = 0; a < 2; a++) {                                            \
+                uint32x4_t d[2] = {vmovl_u16(vget_low_u16(h[a])), vmovl_u16(vget_high_u16(h[a]))}; \
+                for (int b = 0; b < 2; b++) {                                        \
+                    vst1q_u64(values + i + 8 * a + 4 * b, vmovl_u32(vget_low_u32(d[b]))); \
+                    vst1q_u64(values + i + 8 * a + 4 * b + 2, vmovl_u32(vget_high_u32(d[b]))); \
+                }                                                                    \
+            }                                                                        \
+            i += 16;                                                                 \
+            pos += 16;                                                               \
+            continue;                                                                \
+        }                                                                            \
     }
 
-    result.buffer = output_buffer;
-    result.length = header_size + compressed_data_size; // Header + compressed data
-    return result;
+static int varint_decode_neon(const char *input, size_t input_len, uint64_t *values, size_t n,
+                              size_t *bytes_read) {
+    VARINT_DECODE_BODY(VARINT_RUN_NEON, varint_compact)
 }
+#endif
 
-// Function to decompress data using LZ4, automatically reading original size from varint header
-// Expects input format: [varint original length][LZ4 compressed data]
-// The caller is responsible for freeing the returned buffer
-DecompressedData decompress_data_lz4(const char *input, unsigned long input_len) {
-    DecompressedData result = {NULL, 0};
+typedef struct {
+    const char *name;
+    size_t (*encode)(const uint64_t *values, size_t n, char *output);
+    int (*decode)(const char *input, size_t input_len, uint64_t *values, size_t n, size_t *bytes_read);
+} varint_kernel;
 
-    // Check minimum input size (at least 1 byte for varint + some compressed data)
-    if (input_len < 2) {
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid LZ4 compressed data: too small (need at least 2 bytes)\n");
-        #endif
-        return result;
-    }
+static varint_kernel varint_active = {"word", varint_encode_word, varint_decode_word};
+static pthread_once_t varint_once = PTHREAD_ONCE_INIT;
 
-    // Decode original length from varint header
-    unsigned long original_len;
-    int header_size = decode_varint(input, input_len, &original_len);
-    if (header_size < 0) {
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid LZ4 compressed data: failed to decode varint header\n");
-        #endif
-        return result;
+static void varint_select_kernel(void) {
+#if defined(VARINT_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")) {
+        varint_kernel k = {"avx2+bmi2", varint_encode_bmi2, varint_decode_avx2};
+        varint_active = k;
+    } else {
+        varint_kernel k = {"sse2", varint_encode_word, varint_decode_sse2};
+        varint_active = k;
     }
+#elif defined(VARINT_NEON)
+    varint_kernel k = {"neon", varint_encode_word, varint_decode_neon};
+    varint_active = k;
+#endif
+}
 
-    // Check that we have enough data after the header
-    if ((unsigned long)header_size >= input_len) {
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid LZ4 compressed data: no data after varint header\n");
-        #endif
-        return result;
+// Name of the kernel selected for this CPU ("avx2+bmi2", "sse2", "neon" or "word")
+const char *varint_array_kernel(void) {
+    pthread_once(&varint_once, varint_select_kernel);
+    return varint_active.name;
+}
+
+// Encode n values back to back into output
+// output must have room for varint_array_bound(n) bytes: values are written with
+// 8-byte stores, so bytes past the returned length may be overwritten
+// Returns the number of bytes written
+size_t encode_varint_array(const uint64_t *values, size_t n, char *output) {
+    if (n == 0) {
+        return 0;
     }
+    pthread_once(&varint_once, varint_select_kernel);
+    return varint_active.encode(values, n, output);
+}
 
-    // Sanity check on original length (prevent absurdly large allocations)
-    // Using the same limit as zlib version for consistency
-    if (original_len > 100 * 1024 * 1024) { // 100MB limit
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid LZ4 compressed data: original length too large (%lu bytes)\n", original_len);
-        #endif
-        return result;
+// Decode exactly n values from input into values
+// *bytes_read is set to the number of input bytes consumed
+// Returns CODEC_OK, CODEC_ERR_CORRUPT if a value is malformed or the input ends
+// early, or CODEC_ERR_INVALID_ARG for NULL arguments
+int decode_varint_array(const char *input, size_t input_len, uint64_t *values, size_t n, size_t *bytes_read) {
+    if (bytes_read == NULL || (input == NULL && input_len > 0) || (values == NULL && n > 0)) {
+        return CODEC_ERR_INVALID_ARG;
     }
-    
-    if (original_len == 0) { // Handle zero-length original string case
-        char *output_buffer = (char *)calloc(1, 1); // calloc zero-initializes memory
-        if (output_buffer == NULL) {
-            perror("Failed to allocate memory for LZ4 decompression (empty string)");
-            return result;
-        }
-        output_buffer[0] = '\0';
-        result.buffer = output_buffer;
-        result.length = 0;
-        return result;
+    if (n == 0) {
+        *bytes_read = 0;
+        return CODEC_OK;
     }
+    pthread_once(&varint_once, varint_select_kernel);
+    return varint_active.decode(input, input_len, values, n, bytes_read);
+}
 
+// Stream-VByte integer format
+//
+// An alternative to LEB128 for arrays of 32-bit integers that decodes without a
+// per-byte dependency chain. Lengths are stored apart from the data:
+//   [ceil(n / 4) control bytes][data bytes]
+// Each control byte holds four 2-bit codes (value i at bits 2*(i%4)), code = byte
+// length - 1, and each value is stored little-endian in 1-4 bytes. A decoder can
+// therefore look up the byte layout of four values from one control byte and
+// gather them with a single shuffle (SSSE3 pshufb / NEON tbl).
+//
+// Optional transforms, applied before encoding and undone after decoding:
+//   STREAMVBYTE_DELTA  - store differences from the previous value (sorted lists)
+//   STREAMVBYTE_ZIGZAG - map signed values to unsigned ((v << 1) ^ (v >> 31)) so
+//                        small negative numbers stay short; with DELTA it applies
+//                        to the differences
 
-    // Allocate buffer for decompressed data
-    char *output_buffer = (char *)calloc(original_len + 1, 1); // calloc zero-initializes memory
-    if (output_buffer == NULL) {
-        perror("Failed to allocate memory for LZ4 decompression");
-        return result;
-    }
+#define STREAMVBYTE_DELTA 1
+#define STREAMVBYTE_ZIGZAG 2
 
-    // Decompress data (skip the varint header)
-    int decompressed_size = LZ4_decompress_safe(input + header_size, output_buffer, (int)(input_len - header_size), (int)original_len);
+// Per-control-byte data length and pshufb/tbl gather masks, built once
+static uint8_t svb_lengths[256];
+static uint8_t svb_shuffles[256][16];
+static pthread_once_t svb_once = PTHREAD_ONCE_INIT;
 
-    if (decompressed_size < 0) {
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "LZ4_decompress_safe failed: %d\n", decompressed_size);
-        #endif
-        free(output_buffer);
-        return result;
+static void svb_build_tables(void) {
+    for (int c = 0; c < 256; c++) {
+        int src = 0;
+        for (int v = 0; v < 4; v++) {
+            int len = ((c >> (2 * v)) & 3) + 1;
+            for (int b = 0; b < 4; b++) {
+                // 0x80 makes the shuffle write a zero byte
+                svb_shuffles[c][4 * v + b] = b < len ? (uint8_t)(src + b) : 0x80;
+            }
+            src += len;
+        }
+        svb_lengths[c] = (uint8_t)src;
     }
+}
 
-    // Verify that decompressed length matches expected length
-    if ((unsigned long)decompressed_size != original_len) {
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "LZ4 Decompression length mismatch: expected %lu, got %d\n",
-                original_len, decompressed_size);
-        #endif
-        free(output_buffer);
-        return result;
-    }
-    
-    output_buffer[original_len] = '\0'; // Ensure null termination
+static inline uint32_t svb_zigzag_encode(uint32_t v) {
+    return (v << 1) ^ (uint32_t)-(int32_t)(v >> 31);
+}
 
-    result.buffer = output_buffer;
-    result.length = (unsigned long)decompressed_size;
-    return result;
+static inline uint32_t svb_zigzag_decode(uint32_t v) {
+    return (v >> 1) ^ (uint32_t)-(int32_t)(v & 1);
 }
 
-// Function to compress a string using Zstandard (zstd) with variable-byte length header
-// The compressed data format: [varint original length][ZSTD compressed data]
-// The caller is responsible for freeing the returned buffer
-CompressedData compress_string_zstd(const char *input, unsigned long input_len) {
-    // Calculate the maximum compressed size using ZSTD_compressBound
-    size_t zstd_max_compressed_size = ZSTD_compressBound(input_len);
-    if (ZSTD_isError(zstd_max_compressed_size)) {
-        #ifdef DEBUG_FUZZING
-        fprintf(stderr, "ZSTD_compressBound failed: %s\n", ZSTD_getErrorName(zstd_max_compressed_size));
-        #endif
-        return (CompressedData){NULL, 0};
+// Worst-case output size of streamvbyte_encode for n values, or 0 on overflow
+size_t streamvbyte_bound(size_t n) {
+    if (n > (SIZE_MAX - 3) / 5) {
+        return 0;
     }
+    return (n + 3) / 4 + 4 * n;
+}
 
-    // Allocate buffer for: max 10-byte varint header + compressed data
-    unsigned long total_buffer_size = 10 + (unsigned long)zstd_max_compressed_size;
-    char *output_buffer = (char *)malloc(total_buffer_size);
-    CompressedData result = {NULL, 0};
+// Encode n values with the given STREAMVBYTE_* flags
+// output must hold streamvbyte_bound(n) bytes; returns the number of bytes written
+size_t streamvbyte_encode(const uint32_t *values, size_t n, char *output, int flags) {
+    unsigned char *control = (unsigned char *)output;
+    unsigned char *data = control + (n + 3) / 4;
+    unsigned char *d = data;
+    uint32_t prev = 0;
+    memset(control, 0, (n + 3) / 4);
 
-    if (output_buffer == NULL) {
-        perror("Failed to allocate memory for ZSTD compression");
-        return result; // Return empty result
+    for (size_t i = 0; i < n; i++) {
+        uint32_t v = values[i];
+        if (flags & STREAMVBYTE_DELTA) {
+            uint32_t delta = v - prev;
+            prev = v;
+            v = delta;
+        }
+        if (flags & STREAMVBYTE_ZIGZAG) {
+            v = svb_zigzag_encode(v);
+        }
+        unsigned code = (v > 0xFF) + (v > 0xFFFF) + (v > 0xFFFFFF);
+        control[i / 4] |= (unsigned char)(code << (2 * (i % 4)));
+        d[0] = (unsigned char)v;
+        d[1] = (unsigned char)(v >> 8);
+        d[2] = (unsigned char)(v >> 16);
+        d[3] = (unsigned char)(v >> 24);
+        d += code + 1; // Bytes beyond the value's length are overwritten by the next one
     }
+    return (size_t)(d - control);
+}
+
+// Scalar decode of values [start, n) whose data begins at *data; undoes transforms
+// with *prev carrying the running delta sum. Returns -1 if the data runs out.
+static int svb_decode_scalar_range(const unsigned char *control, const unsigned char **data,
+                                   const unsigned char *end, uint32_t *values, size_t start, size_t n,
+                                   int flags, uint32_t *prev) {
+    const unsigned char *d = *data;
+    for (size_t i = start; i < n; i++) {
+        unsigned len = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        if ((size_t)(end - d) < len) {
+            return -1;
+        }
+        uint32_t v = 0;
+        for (unsigned b = 0; b < len; b++) {
+            v |= (uint32_t)d[b] << (8 * b);
+        }
+        d += len;
+        if (flags & STREAMVBYTE_ZIGZAG) {
+            v = svb_zigzag_decode(v);
+        }
+        if (flags & STREAMVBYTE_DELTA) {
+            v += *prev;
+            *prev = v;
+        }
+        values[i] = v;
+    }
+    *data = d;
+    return 0;
+}
+
+#if defined(VARINT_X86)
+__attribute__((target("ssse3")))
+static size_t svb_decode_quads_ssse3(const unsigned char *control, const unsigned char **data,
+                                     const unsigned char *end, uint32_t *values, size_t quads,
+                                     int flags, uint32_t *prev) {
+    const unsigned char *d = *data;
+    __m128i carry = _mm_set1_epi32((int)*prev);
+    const __m128i one = _mm_set1_epi32(1);
+    size_t q = 0;
+    // Each iteration loads 16 bytes; stop while that is still in bounds
+    for (; q < quads && end - d >= 16; q++) {
+        unsigned c = control[q];
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)d),
+                                     _mm_loadu_si128((const __m128i *)svb_shuffles[c]));
+        d += svb_lengths[c];
+        if (flags & STREAMVBYTE_ZIGZAG) {
+            x = _mm_xor_si128(_mm_srli_epi32(x, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(x, one)));
+        }
+        if (flags & STREAMVBYTE_DELTA) {
+            // Inclusive prefix sum over the four lanes, plus the previous quad's last value
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi32(x, carry);
+            carry = _mm_shuffle_epi32(x, 0xFF);
+        }
+        _mm_storeu_si128((__m128i *)(values + 4 * q), x);
+    }
+    *prev = (uint32_t)_mm_cvtsi128_si32(carry);
+    *data = d;
+    return q;
+}
+#endif
+
+#if defined(VARINT_NEON)
+static size_t svb_decode_quads_neon(const unsigned char *control, const unsigned char **data,
+                                    const unsigned char *end, uint32_t *values, size_t quads,
+                                    int flags, uint32_t *prev) {
+    const unsigned char *d = *data;
+    uint32x4_t carry = vdupq_n_u32(*prev);
+    const uint32x4_t zero = vdupq_n_u32(0);
+    size_t q = 0;
+    for (; q < quads && end - d >= 16; q++) {
+        unsigned c = control[q];
+        uint32x4_t x = vreinterpretq_u32_u8(vqtbl1q_u8(vld1q_u8(d), vld1q_u8(svb_shuffles[c])));
+        d += svb_lengths[c];
+        if (flags & STREAMVBYTE_ZIGZAG) {
+            x = veorq_u32(vshrq_n_u32(x, 1), vsubq_u32(zero, vandq_u32(x, vdupq_n_u32(1))));
+        }
+        if (flags & STREAMVBYTE_DELTA) {
+            x = vaddq_u32(x, vextq_u32(zero, x, 3));
+            x = vaddq_u32(x, vextq_u32(zero, x, 2));
+            x = vaddq_u32(x, carry);
+            carry = vdupq_laneq_u32(x, 3);
+        }
+        vst1q_u32(values + 4 * q, x);
+    }
+    *prev = vgetq_lane_u32(carry, 0);
+    *data = d;
+    return q;
+}
+#endif
+
+typedef size_t (*svb_quad_fn)(const unsigned char *control, const unsigned char **data, const unsigned char *end,
+                              uint32_t *values, size_t quads, int flags, uint32_t *prev);
+
+static svb_quad_fn svb_quad_kernel = NULL;
+
+static void svb_init(void) {
+    svb_build_tables();
+#if defined(VARINT_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        svb_quad_kernel = svb_decode_quads_ssse3;
+    }
+#elif defined(VARINT_NEON)
+    svb_quad_kernel = svb_decode_quads_neon;
+#endif
+}
+
+static int svb_decode(const char *input, size_t input_len, uint32_t *values, size_t n, int flags,
+                      size_t *bytes_read, int use_simd) {
+    if (bytes_read == NULL || (input == NULL && input_len > 0) || (values == NULL && n > 0)) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    size_t control_len = (n + 3) / 4;
+    if (control_len > input_len) {
+        return CODEC_ERR_CORRUPT;
+    }
+    pthread_once(&svb_once, svb_init);
+
+    const unsigned char *control = (const unsigned char *)input;
+    const unsigned char *data = control + control_len;
+    const unsigned char *end = control + input_len;
+    uint32_t prev = 0;
+    size_t done = 0;
+    if (use_simd && svb_quad_kernel != NULL) {
+        done = 4 * svb_quad_kernel(control, &data, end, values, n / 4, flags, &prev);
+    }
+    if (svb_decode_scalar_range(control, &data, end, values, done, n, flags, &prev) < 0) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Stream-VByte data ends before %zu values\n", n);
+        #endif
+        return CODEC_ERR_CORRUPT;
+    }
+    *bytes_read = (size_t)(data - control);
+    return CODEC_OK;
+}
+
+// Decode exactly n values encoded with the same flags
+// *bytes_read is set to the size of the encoded stream
+// Returns CODEC_OK, CODEC_ERR_CORRUPT if input is too short, or CODEC_ERR_INVALID_ARG
+int streamvbyte_decode(const char *input, size_t input_len, uint32_t *values, size_t n, int flags,
+                       size_t *bytes_read) {
+    return svb_decode(input, input_len, values, n, flags, bytes_read, 1);
+}
+
+// Scalar reference decoder (same contract as streamvbyte_decode)
+int streamvbyte_decode_scalar(const char *input, size_t input_len, uint32_t *values, size_t n, int flags,
+                              size_t *bytes_read) {
+    return svb_decode(input, input_len, values, n, flags, bytes_read, 0);
+}
+
+// Name of the Stream-VByte decode kernel selected for this CPU
+const char *streamvbyte_kernel(void) {
+    pthread_once(&svb_once, svb_init);
+#if defined(VARINT_X86)
+    return svb_quad_kernel != NULL ? "ssse3" : "scalar";
+#elif defined(VARINT_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+// Bit-packed integer blocks (frame of reference + patched exceptions)
+//
+// For 64-bit columns that are mostly narrow once delta-coded (timestamps, IDs,
+// offsets). Values go in blocks of PFOR_BLOCK; after the optional transforms every
+// full block is stored as
+//   [varint base][u8 bit width b][u8 exception count e]
+//   [16 * b bytes packed][e u8 positions][e varint high parts]
+// base is the block minimum (frame of reference) and each value - base keeps its
+// low b bits in the packed area. b is picked to minimize the block size, so a few
+// outliers (e.g. a gap in the timestamps) do not widen the whole block: they become
+// exceptions whose bits above b are patched in after unpacking, as in PFor.
+//
+// The packed area uses four interleaved 32-bit lanes (value i in lane i % 4, as
+// in SIMD-BP128): word k of lane l is stored little-endian at byte 16 * k + 4 * l,
+// so one 128-bit shift/mask step unpacks four consecutive values. A partial last
+// block of fewer than PFOR_BLOCK values is stored as LEB128 varints.
+//
+// Transforms, applied in this order before packing and undone after decoding:
+//   PFOR_DELTA  - store differences from the previous value (sorted columns)
+//   PFOR_ZIGZAG - map signed values to unsigned ((v << 1) ^ (v >> 63))
+
+#define PFOR_DELTA 1
+#define PFOR_ZIGZAG 2
+#define PFOR_BLOCK 128
+#define PFOR_MAX_BITS 32
+// base + b + e header, a full-width packed area, and every value an exception
+// whose high part (at most 32 bits over b = 32) takes 5 varint bytes
+#define PFOR_BLOCK_BOUND (MAX_VARINT_LEN + 2 + 16 * PFOR_MAX_BITS + PFOR_BLOCK * (1 + 5))
+
+typedef void (*pfor_unpack_fn)(const unsigned char *in, unsigned b, uint32_t *out);
+
+static pfor_unpack_fn pfor_unpack_kernel = NULL;
+static pthread_once_t pfor_once = PTHREAD_ONCE_INIT;
+
+static inline uint32_t pfor_load32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline unsigned pfor_bits(uint64_t v) {
+    return v == 0 ? 0 : 64 - (unsigned)__builtin_clzll(v);
+}
+
+// Pack the low b bits of 128 values into 16 * b bytes using the lane layout
+static void pfor_pack(const uint64_t *vals, unsigned b, unsigned char *out) {
+    uint32_t words[4 * PFOR_MAX_BITS];
+    uint32_t mask = b == 32 ? 0xFFFFFFFFu : (1u << b) - 1;
+    memset(words, 0, 16 * b);
+    for (unsigned i = 0; i < PFOR_BLOCK; i++) {
+        unsigned lane = i & 3, bit = (i >> 2) * b, word = bit >> 5, off = bit & 31;
+        uint32_t v = (uint32_t)vals[i] & mask;
+        words[4 * word + lane] |= v << off;
+        if (off + b > 32) {
+            words[4 * (word + 1) + lane] |= v >> (32 - off);
+        }
+    }
+    for (unsigned k = 0; k < 4 * b; k++) {
+        out[4 * k] = (unsigned char)words[k];
+        out[4 * k + 1] = (unsigned char)(words[k] >> 8);
+        out[4 * k + 2] = (unsigned char)(words[k] >> 16);
+        out[4 * k + 3] = (unsigned char)(words[k] >> 24);
+    }
+}
+
+// Reference unpack of 128 b-bit values (1 <= b <= 32)
+static void pfor_unpack_scalar(const unsigned char *in, unsigned b, uint32_t *out) {
+    uint32_t mask = b == 32 ? 0xFFFFFFFFu : (1u << b) - 1;
+    for (unsigned i = 0; i < PFOR_BLOCK; i++) {
+        unsigned lane = i & 3, bit = (i >> 2) * b, word = bit >> 5, off = bit & 31;
+        uint64_t two = pfor_load32(in + 16 * word + 4 * lane);
+        if (off + b > 32) {
+            two |= (uint64_t)pfor_load32(in + 16 * (word + 1) + 4 * lane) << 32;
+        }
+        out[i] = (uint32_t)(two >> off) & mask;
+    }
+}
+
+#if defined(VARINT_X86)
+// SSE2 is part of the x86-64 baseline; shift counts come from a register so one
+// loop serves every width
+static void pfor_unpack_sse2(const unsigned char *in, unsigned b, uint32_t *out) {
+    const __m128i *w = (const __m128i *)in;
+    const __m128i mask = _mm_set1_epi32(b == 32 ? -1 : (int)((1u << b) - 1));
+    for (unsigned j = 0; j < PFOR_BLOCK / 4; j++) {
+        unsigned bit = j * b, word = bit >> 5, off = bit & 31;
+        __m128i x = _mm_srl_epi32(_mm_loadu_si128(w + word), _mm_cvtsi32_si128((int)off));
+        if (off + b > 32) {
+            x = _mm_or_si128(x, _mm_sll_epi32(_mm_loadu_si128(w + word + 1), _mm_cvtsi32_si128((int)(32 - off))));
+        }
+        _mm_storeu_si128((__m128i *)(out + 4 * j), _mm_and_si128(x, mask));
+    }
+}
+#endif
+
+#if defined(VARINT_NEON)
+static void pfor_unpack_neon(const unsigned char *in, unsigned b, uint32_t *out) {
+    const uint32x4_t mask = vdupq_n_u32(b == 32 ? 0xFFFFFFFFu : (1u << b) - 1);
+    for (unsigned j = 0; j < PFOR_BLOCK / 4; j++) {
+        unsigned bit = j * b, word = bit >> 5, off = bit & 31;
+        // A negative vshl count shifts right
+        uint32x4_t x = vshlq_u32(vreinterpretq_u32_u8(vld1q_u8(in + 16 * word)), vdupq_n_s32(-(int)off));
+        if (off + b > 32) {
+            x = vorrq_u32(x, vshlq_u32(vreinterpretq_u32_u8(vld1q_u8(in + 16 * (word + 1))),
+                                       vdupq_n_s32((int)(32 - off))));
+        }
+        vst1q_u32(out + 4 * j, vandq_u32(x, mask));
+    }
+}
+#endif
+
+static void pfor_init(void) {
+#if defined(VARINT_X86)
+    pfor_unpack_kernel = pfor_unpack_sse2;
+#elif defined(VARINT_NEON)
+    pfor_unpack_kernel = pfor_unpack_neon;
+#endif
+}
+
+static inline uint64_t pfor_zigzag_encode(uint64_t v) {
+    return (v << 1) ^ (uint64_t)-(int64_t)(v >> 63);
+}
+
+static inline uint64_t pfor_zigzag_decode(uint64_t v) {
+    return (v >> 1) ^ (uint64_t)-(int64_t)(v & 1);
+}
+
+// Apply the transforms to count values starting at values[0]; *prev carries the
+// last original value across blocks
+static void pfor_transform(const uint64_t *values, size_t count, int flags, uint64_t *prev, uint64_t *t) {
+    for (size_t i = 0; i < count; i++) {
+        uint64_t v = values[i];
+        if (flags & PFOR_DELTA) {
+            uint64_t delta = v - *prev;
+            *prev = v;
+            v = delta;
+        }
+        t[i] = (flags & PFOR_ZIGZAG) ? pfor_zigzag_encode(v) : v;
+    }
+}
+
+static void pfor_untransform(uint64_t *values, size_t count, int flags, uint64_t *prev) {
+    if ((flags & (PFOR_DELTA | PFOR_ZIGZAG)) == 0) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint64_t v = values[i];
+        if (flags & PFOR_ZIGZAG) {
+            v = pfor_zigzag_decode(v);
+        }
+        if (flags & PFOR_DELTA) {
+            v += *prev;
+            *prev = v;
+        }
+        values[i] = v;
+    }
+}
+
+// Encode one full block of transformed values; returns the bytes written
+static size_t pfor_encode_block(uint64_t *t, unsigned char *out) {
+    uint64_t base = t[0];
+    for (unsigned i = 1; i < PFOR_BLOCK; i++) {
+        base = t[i] < base ? t[i] : base;
+    }
+    // Histogram of value widths; ceil((w - b) / 7) is the varint length of a high part
+    unsigned widths[65] = {0};
+    unsigned max_width = 0;
+    for (unsigned i = 0; i < PFOR_BLOCK; i++) {
+        t[i] -= base;
+        unsigned w = pfor_bits(t[i]);
+        widths[w]++;
+        max_width = w > max_width ? w : max_width;
+    }
+    unsigned best_b = PFOR_MAX_BITS;
+    size_t best_cost = SIZE_MAX;
+    for (unsigned b = 0; b <= PFOR_MAX_BITS && b <= max_width; b++) {
+        size_t cost = 16 * (size_t)b;
+        for (unsigned w = b + 1; w <= max_width; w++) {
+            cost += (size_t)widths[w] * (1 + (w - b + 6) / 7);
+        }
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_b = b;
+        }
+    }
+
+    size_t pos = (size_t)varint_encode_one_scalar(base, out);
+    unsigned char *header = out + pos;
+    pos += 2;
+    if (best_b > 0) {
+        pfor_pack(t, best_b, out + pos);
+        pos += 16 * (size_t)best_b;
+    }
+    unsigned exceptions = 0;
+    for (unsigned i = 0; i < PFOR_BLOCK; i++) {
+        if (pfor_bits(t[i]) > best_b) {
+            out[pos++] = (unsigned char)i;
+            exceptions++;
+        }
+    }
+    for (unsigned i = 0; i < PFOR_BLOCK; i++) {
+        if (pfor_bits(t[i]) > best_b) {
+            pos += (size_t)varint_encode_one_scalar(t[i] >> best_b, out + pos);
+        }
+    }
+    header[0] = (unsigned char)best_b;
+    header[1] = (unsigned char)exceptions;
+    return pos;
+}
+
+// Worst-case output size of pfor_encode for n values, or 0 on overflow
+size_t pfor_bound(size_t n) {
+    if (n / PFOR_BLOCK > SIZE_MAX / PFOR_BLOCK_BOUND) {
+        return 0;
+    }
+    return (n / PFOR_BLOCK) * PFOR_BLOCK_BOUND + (n % PFOR_BLOCK) * MAX_VARINT_LEN;
+}
+
+// Encode n values with the given PFOR_* flags
+// output must hold pfor_bound(n) bytes; returns the number of bytes written
+size_t pfor_encode(const uint64_t *values, size_t n, char *output, int flags) {
+    unsigned char *out = (unsigned char *)output;
+    uint64_t t[PFOR_BLOCK];
+    uint64_t prev = 0;
+    size_t pos = 0, i = 0;
+    for (; n - i >= PFOR_BLOCK; i += PFOR_BLOCK) {
+        pfor_transform(values + i, PFOR_BLOCK, flags, &prev, t);
+        pos += pfor_encode_block(t, out + pos);
+    }
+    if (i < n) {
+        pfor_transform(values + i, n - i, flags, &prev, t);
+        pos += encode_varint_array(t, n - i, output + pos);
+    }
+    return pos;
+}
+
+static int pfor_decode_impl(const char *input, size_t input_len, uint64_t *values, size_t n, int flags,
+                            size_t *bytes_read, int use_simd) {
+    if (bytes_read == NULL || (input == NULL && input_len > 0) || (values == NULL && n > 0)) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    pthread_once(&pfor_once, pfor_init);
+    pfor_unpack_fn unpack = use_simd && pfor_unpack_kernel != NULL ? pfor_unpack_kernel : pfor_unpack_scalar;
+
+    const unsigned char *in = (const unsigned char *)input;
+    uint32_t low[PFOR_BLOCK];
+    uint64_t prev = 0;
+    size_t pos = 0, i = 0;
+    for (; n - i >= PFOR_BLOCK; i += PFOR_BLOCK) {
+        uint64_t base;
+        int r = varint_decode_one_scalar(in + pos, input_len - pos, &base);
+        if (r < 0 || input_len - pos - (size_t)r < 2) {
+            return CODEC_ERR_CORRUPT;
+        }
+        pos += (size_t)r;
+        unsigned b = in[pos], exceptions = in[pos + 1];
+        pos += 2;
+        if (b > PFOR_MAX_BITS || exceptions > PFOR_BLOCK || input_len - pos < 16 * (size_t)b + exceptions) {
+            return CODEC_ERR_CORRUPT;
+        }
+        uint64_t *v = values + i;
+        if (b == 0) {
+            for (unsigned k = 0; k < PFOR_BLOCK; k++) {
+                v[k] = base;
+            }
+        } else {
+            unpack(in + pos, b, low);
+            for (unsigned k = 0; k < PFOR_BLOCK; k++) {
+                v[k] = base + low[k];
+            }
+            pos += 16 * (size_t)b;
+        }
+        const unsigned char *positions = in + pos;
+        pos += exceptions;
+        for (unsigned e = 0; e < exceptions; e++) {
+            uint64_t high;
+            r = varint_decode_one_scalar(in + pos, input_len - pos, &high);
+            if (r < 0 || positions[e] >= PFOR_BLOCK) {
+                return CODEC_ERR_CORRUPT;
+            }
+            pos += (size_t)r;
+            v[positions[e]] += high << b;
+        }
+        pfor_untransform(v, PFOR_BLOCK, flags, &prev);
+    }
+    if (i < n) {
+        size_t used = 0;
+        int rc = use_simd ? decode_varint_array(input + pos, input_len - pos, values + i, n - i, &used)
+                          : decode_varint_array_scalar(input + pos, input_len - pos, values + i, n - i, &used);
+        if (rc != CODEC_OK) {
+            return CODEC_ERR_CORRUPT;
+        }
+        pos += used;
+        pfor_untransform(values + i, n - i, flags, &prev);
+    }
+    *bytes_read = pos;
+    return CODEC_OK;
+}
+
+// Decode exactly n values encoded with the same flags
+// *bytes_read is set to the size of the encoded stream
+// Returns CODEC_OK, CODEC_ERR_CORRUPT if a block is malformed or the input ends
+// early, or CODEC_ERR_INVALID_ARG for NULL arguments
+int pfor_decode(const char *input, size_t input_len, uint64_t *values, size_t n, int flags, size_t *bytes_read) {
+    return pfor_decode_impl(input, input_len, values, n, flags, bytes_read, 1);
+}
+
+// Scalar reference decoder (same contract as pfor_decode)
+int pfor_decode_scalar(const char *input, size_t input_len, uint64_t *values, size_t n, int flags,
+                       size_t *bytes_read) {
+    return pfor_decode_impl(input, input_len, values, n, flags, bytes_read, 0);
+}
+
+// Name of the bit-unpacking kernel selected for this CPU
+const char *pfor_kernel(void) {
+    pthread_once(&pfor_once, pfor_init);
+#if defined(VARINT_X86)
+    return "sse2";
+#elif defined(VARINT_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+// Read the [varint original length] header shared by all codecs.
+// codec_name is only used to prefix debug messages (e.g. "LZ4 ").
+// Returns the header size on success, or -1 if the header is invalid.
+static int parse_length_header(const char *input, size_t input_len, unsigned long *original_len,
+                               const char *codec_name) {
+    (void)codec_name;
+
+    // Check minimum input size (at least 1 byte for varint + some compressed data)
+    if (input == NULL || input_len < 2) {
+        // Reduce noise during fuzzing - only print in debug mode
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Invalid %scompressed data: too small (need at least 2 bytes)\n", codec_name);
+        #endif
+        return -1;
+    }
+
+    // Never read more than a full varint, and keep the count within int range
+    int max_bytes = input_len > MAX_VARINT_LEN ? MAX_VARINT_LEN : (int)input_len;
+    int header_size = decode_varint(input, max_bytes, original_len);
+    if (header_size < 0) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Invalid %scompressed data: failed to decode varint header\n", codec_name);
+        #endif
+        return -1;
+    }
+
+    // Check that we have enough data after the header
+    if ((size_t)header_size >= input_len) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Invalid %scompressed data: no data after varint header\n", codec_name);
+        #endif
+        return -1;
+    }
+
+    return header_size;
+}
+
+// Worst-case output size of compress_string_into for input_len bytes
+size_t compress_bound(size_t input_len) {
+    return MAX_VARINT_LEN + (size_t)compressBound((uLong)input_len);
+}
+
+// Worst-case output size of compress_string_lz4_into for input_len bytes
+// Returns 0 if input_len exceeds what LZ4 can compress in one call
+size_t compress_bound_lz4(size_t input_len) {
+    if (input_len > LZ4_MAX_INPUT_SIZE) {
+        return 0;
+    }
+    return MAX_VARINT_LEN + (size_t)LZ4_compressBound((int)input_len);
+}
+
+// Worst-case output size of compress_string_zstd_into for input_len bytes
+// Returns 0 if input_len is too large for zstd
+size_t compress_bound_zstd(size_t input_len) {
+    size_t bound = ZSTD_compressBound(input_len);
+    if (ZSTD_isError(bound) || bound == 0) {
+        return 0;
+    }
+    return MAX_VARINT_LEN + bound;
+}
+
+// Read the original (decompressed) length from the varint header of any codec's output
+// so callers can size the buffer passed to decompress_data*_into
+int decompressed_length(const char *input, size_t input_len, size_t *original_len) {
+    if (original_len == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    unsigned long len;
+    if (parse_length_header(input, input_len, &len, "") < 0) {
+        return CODEC_ERR_CORRUPT;
+    }
+    *original_len = (size_t)len;
+    return CODEC_OK;
+}
+
+// Validate the common arguments of the *_into entry points
+static int check_into_args(const char *input, size_t input_len, const char *output, size_t output_cap,
+                           const size_t *output_len) {
+    if (output_len == NULL || (input == NULL && input_len > 0) || (output == NULL && output_cap > 0)) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    return CODEC_OK;
+}
+
+// Write the varint length header into output, checking it fits
+// Returns the header size, or -1 if output_cap is too small
+static int write_length_header(size_t input_len, char *output, size_t output_cap) {
+    char header[MAX_VARINT_LEN];
+    int header_size = encode_varint((unsigned long)input_len, header);
+    if ((size_t)header_size > output_cap) {
+        return -1;
+    }
+    memcpy(output, header, header_size);
+    return header_size;
+}
+
+// Memory allocation
+//
+// Everything the library allocates - the buffers returned by the allocating functions,
+// contexts, dictionaries, streams, scratch space, and the internal state of zstd (through
+// ZSTD_customMem) and zlib (zalloc/zfree) - comes from the active allocator: the calling
+// thread's set_thread_allocator one if installed, else the process-wide set_allocator one
+// (malloc/free by default). LZ4 block state is allocated here and initialized in place;
+// the LZ4F contexts behind stream_begin(CODEC_LZ4, ...) still use malloc, as shared liblz4
+// builds do not export their custom-memory constructors.
+// Objects remember the allocator that created them and release memory through it, so the
+// active allocator may change while they are alive. Returned CompressedData and
+// DecompressedData buffers carry a header recording theirs for free_*_data.
+
+typedef void *(*codec_alloc_fn)(void *opaque, size_t size);
+typedef void (*codec_free_fn)(void *opaque, void *ptr);
+
+typedef struct {
+    codec_alloc_fn alloc_fn;
+    codec_free_fn free_fn;
+    void *opaque;
+} codec_allocator;
+
+static void *system_alloc(void *opaque, size_t size) {
+    (void)opaque;
+    return malloc(size);
+}
+
+static void system_free(void *opaque, void *ptr) {
+    (void)opaque;
+    free(ptr);
+}
+
+static codec_allocator global_allocator = {system_alloc, system_free, NULL};
+static _Thread_local codec_allocator thread_allocator; // alloc_fn == NULL: use global_allocator
+
+static int make_allocator(codec_alloc_fn alloc_fn, codec_free_fn free_fn, void *opaque, codec_allocator *out) {
+    if ((alloc_fn == NULL) != (free_fn == NULL)) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    out->alloc_fn = alloc_fn;
+    out->free_fn = free_fn;
+    out->opaque = alloc_fn != NULL ? opaque : NULL;
+    return CODEC_OK;
+}
+
+// Install the process-wide allocator, or restore malloc/free with two NULL functions
+// Not synchronized: call it before other threads use the library
+int set_allocator(codec_alloc_fn alloc_fn, codec_free_fn free_fn, void *opaque) {
+    codec_allocator a;
+    int rc = make_allocator(alloc_fn, free_fn, opaque, &a);
+    if (rc == CODEC_OK) {
+        global_allocator = alloc_fn != NULL ? a : (codec_allocator){system_alloc, system_free, NULL};
+    }
+    return rc;
+}
+
+// Override the allocator for the calling thread only, or remove the override with NULLs
+int set_thread_allocator(codec_alloc_fn alloc_fn, codec_free_fn free_fn, void *opaque) {
+    return make_allocator(alloc_fn, free_fn, opaque, &thread_allocator);
+}
+
+static codec_allocator current_allocator(void) {
+    return thread_allocator.alloc_fn != NULL ? thread_allocator : global_allocator;
+}
+
+static void *alloc_with(const codec_allocator *a, size_t size) {
+    return a->alloc_fn(a->opaque, size);
+}
+
+static void free_with(const codec_allocator *a, void *ptr) {
+    if (ptr != NULL) {
+        a->free_fn(a->opaque, ptr);
+    }
+}
+
+// Allocation freed again within the same call (same thread, same active allocator)
+static void *scratch_alloc(size_t size) {
+    codec_allocator a = current_allocator();
+    return alloc_with(&a, size);
+}
+
+static void scratch_free(void *ptr) {
+    codec_allocator a = current_allocator();
+    free_with(&a, ptr);
+}
+
+static ZSTD_customMem zstd_mem(const codec_allocator *a) {
+    ZSTD_customMem mem = {a->alloc_fn, a->free_fn, a->opaque};
+    return mem;
+}
+
+static voidpf zlib_alloc(voidpf opaque, uInt items, uInt size) {
+    if (size != 0 && items > SIZE_MAX / size) {
+        return Z_NULL;
+    }
+    return alloc_with((const codec_allocator *)opaque, (size_t)items * size);
+}
+
+static void zlib_free(voidpf opaque, voidpf ptr) {
+    free_with((const codec_allocator *)opaque, ptr);
+}
+
+// Route a not yet initialized z_stream's allocations through a (which must outlive it)
+static void zlib_use_allocator(z_stream *strm, const codec_allocator *a) {
+    strm->zalloc = zlib_alloc;
+    strm->zfree = zlib_free;
+    strm->opaque = (voidpf)a;
+}
+
+static LZ4_stream_t *lz4_stream_create(const codec_allocator *a) {
+    void *mem = alloc_with(a, sizeof(LZ4_stream_t));
+    if (mem == NULL) {
+        return NULL;
+    }
+    LZ4_stream_t *stream = LZ4_initStream(mem, sizeof(LZ4_stream_t));
+    if (stream == NULL) {
+        free_with(a, mem); // Misaligned allocator result
+    }
+    return stream;
+}
+
+// Header in front of returned CompressedData/DecompressedData buffers, padded so the
+// data keeps max_align_t alignment
+typedef union {
+    struct {
+        codec_allocator allocator;
+        size_t mapped_len; // Non-zero: buffer was mmap'ed directly
+    };
+    max_align_t align;
+} buffer_header;
+
+// Returned buffers at least this large bypass malloc when the default allocator is active
+#define HUGE_BUFFER_MIN (2 * 1024 * 1024)
+
+// Map a large buffer directly and ask for transparent huge pages, so the first pass of the
+// codec over it takes one fault per 2 MiB instead of per 4 KiB page. Returns NULL when the
+// mapping fails; the caller then falls back to the allocator.
+static buffer_header *huge_buffer_map(size_t len) {
+    void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(p, len, MADV_HUGEPAGE); // Advisory; THP may be disabled
+#endif
+    buffer_header *h = (buffer_header *)p;
+    h->mapped_len = len;
+    return h;
+}
+
+// Buffers are not zero-filled: every caller writes all bytes it reports, and the
+// decompressors fail unless the codec produced exactly the length in the header
+static char *buffer_alloc(size_t size) {
+    codec_allocator a = current_allocator();
+    if (size > SIZE_MAX - sizeof(buffer_header)) {
+        return NULL;
+    }
+    size_t total = sizeof(buffer_header) + size;
+    buffer_header *h = NULL;
+    if (total >= HUGE_BUFFER_MIN && a.alloc_fn == system_alloc) {
+        h = huge_buffer_map(total);
+    }
+    if (h == NULL) {
+        h = (buffer_header *)alloc_with(&a, total);
+        if (h == NULL) {
+            return NULL;
+        }
+        h->mapped_len = 0;
+    }
+    h->allocator = a;
+    return (char *)(h + 1);
+}
+
+static void buffer_free(char *buffer) {
+    if (buffer != NULL) {
+        buffer_header *h = (buffer_header *)buffer - 1;
+        if (h->mapped_len != 0) {
+            munmap(h, h->mapped_len);
+            return;
+        }
+        codec_allocator a = h->allocator;
+        free_with(&a, h);
+    }
+}
+
+// Built-in arena: a lock-free bump allocator over one block, for many short-lived
+// requests. Each allocation is preceded by a header holding its size, so freeing the
+// most recent one hands its space back; codecs tear their state down in reverse order,
+// so a one-shot call leaves only the buffer it returns. Other frees are deferred until
+// codec_arena_reset. Requests that do not fit fall back to malloc/free.
+#define ARENA_ALIGN 16 // also the header size
+
+typedef struct codec_arena {
+    char *base;
+    size_t capacity;
+    atomic_size_t used;
+} codec_arena;
+
+// Create an arena of capacity bytes, or NULL on allocation failure
+codec_arena *codec_arena_create(size_t capacity) {
+    codec_arena *a = (codec_arena *)malloc(sizeof(codec_arena));
+    if (a == NULL) {
+        perror("Failed to allocate arena");
+        return NULL;
+    }
+    a->base = capacity > 0 ? (char *)aligned_alloc(ARENA_ALIGN, (capacity + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1)) : NULL;
+    if (capacity > 0 && a->base == NULL) {
+        perror("Failed to allocate arena");
+        free(a);
+        return NULL;
+    }
+    a->capacity = capacity;
+    atomic_init(&a->used, 0);
+    return a;
+}
+
+// codec_alloc_fn for an arena passed as opaque; safe to call from several threads
+void *codec_arena_alloc(void *opaque, size_t size) {
+    codec_arena *a = (codec_arena *)opaque;
+    if (size > SIZE_MAX - ARENA_ALIGN) {
+        return NULL;
+    }
+    size_t need = ARENA_ALIGN + ((size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+    size_t used = atomic_load_explicit(&a->used, memory_order_relaxed);
+    do {
+        if (need > a->capacity - used) {
+            return malloc(size);
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&a->used, &used, used + need, memory_order_relaxed,
+                                                    memory_order_relaxed));
+    memcpy(a->base + used, &need, sizeof(need));
+    return a->base + used + ARENA_ALIGN;
+}
+
+// codec_free_fn matching codec_arena_alloc
+void codec_arena_free(void *opaque, void *ptr) {
+    codec_arena *a = (codec_arena *)opaque;
+    uintptr_t p = (uintptr_t)ptr, base = (uintptr_t)a->base;
+    if (p < base || p >= base + a->capacity) {
+        free(ptr);
+        return;
+    }
+    size_t start = (size_t)(p - base) - ARENA_ALIGN;
+    size_t need;
+    memcpy(&need, a->base + start, sizeof(need));
+    // Only succeeds while nothing was allocated after it; otherwise wait for the reset
+    size_t end = start + need;
+    atomic_compare_exchange_strong_explicit(&a->used, &end, start, memory_order_relaxed, memory_order_relaxed);
+}
+
+// Bytes of the arena handed out since the last reset
+size_t codec_arena_used(const codec_arena *a) {
+    return a != NULL ? atomic_load(&a->used) : 0;
+}
+
+// Reclaim the whole arena; nothing allocated from it may still be in use
+void codec_arena_reset(codec_arena *a) {
+    if (a != NULL) {
+        atomic_store(&a->used, 0);
+    }
+}
+
+// Free the arena (NULL is ignored); nothing allocated from it may still be in use
+void codec_arena_destroy(codec_arena *a) {
+    if (a != NULL) {
+        free(a->base);
+        free(a);
+    }
+}
+
+// zlib's compress()/uncompress() allocate their state with malloc, so the one-shot
+// functions drive a z_stream through the active allocator instead. The output is the
+// same as compress()'s. Returns a zlib status (Z_BUF_ERROR if output is too small)
+static int zlib_oneshot(int compressing, const char *input, size_t input_len, char *output, size_t output_cap,
+                        size_t *output_len) {
+    codec_allocator a = current_allocator();
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    zlib_use_allocator(&strm, &a);
+    int res = compressing ? deflateInit(&strm, Z_DEFAULT_COMPRESSION) : inflateInit(&strm);
+    if (res != Z_OK) {
+        return res;
+    }
+
+    const size_t max_slice = 1u << 30; // avail_in/avail_out are 32-bit
+    size_t in_left = input_len;
+    size_t out_left = output_cap;
+    unsigned char dummy = 0;
+    strm.next_in = (Bytef *)(input != NULL ? input : (const char *)&dummy);
+    strm.next_out = (Bytef *)(output != NULL ? output : (char *)&dummy);
+    do {
+        if (strm.avail_out == 0) {
+            strm.avail_out = (uInt)(out_left > max_slice ? max_slice : out_left);
+            out_left -= strm.avail_out;
+        }
+        if (strm.avail_in == 0) {
+            strm.avail_in = (uInt)(in_left > max_slice ? max_slice : in_left);
+            in_left -= strm.avail_in;
+        }
+        res = compressing ? deflate(&strm, in_left > 0 ? Z_NO_FLUSH : Z_FINISH) : inflate(&strm, Z_NO_FLUSH);
+    } while (res == Z_OK);
+    *output_len = (size_t)((char *)strm.next_out - (output != NULL ? output : (char *)&dummy));
+    if (compressing) {
+        deflateEnd(&strm);
+    } else {
+        inflateEnd(&strm);
+    }
+    if (res == Z_STREAM_END) {
+        return Z_OK;
+    }
+    if (!compressing && (res == Z_NEED_DICT || (res == Z_BUF_ERROR && out_left + strm.avail_out > 0))) {
+        return Z_DATA_ERROR; // Truncated or dictionary input, not a short output buffer
+    }
+    return res;
+}
+
+// The one-shot functions below run on the calling thread's cached context when one is
+// available (see "Thread-local context cache"), and set up codec state per call otherwise
+typedef struct codec_ctx codec_ctx;
+static codec_ctx *thread_ctx(int codec);
+int codec_ctx_compress(codec_ctx *ctx, const char *input, size_t input_len, char *output, size_t output_cap,
+                       size_t *output_len);
+int codec_ctx_decompress(codec_ctx *ctx, const char *input, size_t input_len, char *output, size_t output_cap,
+                         size_t *output_len);
+
+// Uncounted body of compress_string_into
+static int zlib_compress_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                              size_t *output_len) {
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+
+    // Encode original length as varint at the beginning
+    int header_size = write_length_header(input_len, output, output_cap);
+    if (header_size < 0) {
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+
+    // Compress data after the varint header
+    size_t compressed_len;
+    int res = zlib_oneshot(1, input, input_len, output + header_size, output_cap - header_size, &compressed_len);
+    if (res == Z_BUF_ERROR) {
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+    if (res != Z_OK) {
+        fprintf(stderr, "Compression failed: %d\n", res);
+        return CODEC_ERR_CODEC;
+    }
+
+    *output_len = header_size + compressed_len; // Header + compressed data
+    return CODEC_OK;
+}
+
+// Compress with zlib into a caller-provided buffer
+// Output format: [varint original length][zlib compressed data]
+// Returns CODEC_OK and sets *output_len, or a negative CODEC_ERR_* code
+int compress_string_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                         size_t *output_len) {
+    codec_ctx *cached = thread_ctx(CODEC_ZLIB);
+    if (cached != NULL) {
+        return codec_ctx_compress(cached, input, input_len, output, output_cap, output_len);
+    }
+    uint64_t start = stats_clock();
+    int rc = zlib_compress_into(input, input_len, output, output_cap, output_len);
+    stats_record(CODEC_ZLIB, CODEC_STATS_COMPRESS, input_len, rc == CODEC_OK ? *output_len : 0, rc, start);
+    return rc;
+}
+
+// Uncounted body of decompress_data_into
+static int zlib_decompress_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                                size_t *output_len) {
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+
+    unsigned long original_len;
+    int header_size = parse_length_header(input, input_len, &original_len, "");
+    if (header_size < 0) {
+        return CODEC_ERR_CORRUPT;
+    }
+    if (original_len > output_cap) {
+        *output_len = original_len;
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+
+    // Decompress data (skip the varint header)
+    size_t actual_output_len;
+    int res = zlib_oneshot(0, input + header_size, input_len - header_size, output, original_len,
+                           &actual_output_len);
+
+    if (res != Z_OK) {
+        // Reduce noise during fuzzing - only print in debug mode
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Decompression failed: %d\n", res);
+        #endif
+        return CODEC_ERR_CORRUPT;
+    }
+
+    // Verify that decompressed length matches expected length
+    if (actual_output_len != original_len) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Decompression length mismatch: expected %lu, got %lu\n",
+                original_len, (unsigned long)actual_output_len);
+        #endif
+        return CODEC_ERR_CORRUPT;
+    }
+
+    *output_len = actual_output_len;
+    return CODEC_OK;
+}
+
+// Decompress zlib data into a caller-provided buffer
+// Expects input format: [varint original length][zlib compressed data]
+// If output_cap is smaller than the original length, returns CODEC_ERR_BUFFER_TOO_SMALL
+// and sets *output_len to the required size
+int decompress_data_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                         size_t *output_len) {
+    codec_ctx *cached = thread_ctx(CODEC_ZLIB);
+    if (cached != NULL) {
+        return codec_ctx_decompress(cached, input, input_len, output, output_cap, output_len);
+    }
+    uint64_t start = stats_clock();
+    int rc = zlib_decompress_into(input, input_len, output, output_cap, output_len);
+    stats_record(CODEC_ZLIB, CODEC_STATS_DECOMPRESS, input_len, rc == CODEC_OK ? *output_len : 0, rc, start);
+    return rc;
+}
+
+// Uncounted body of compress_string_lz4_into
+static int lz4_compress_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                             size_t *output_len) {
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+
+    if (input_len > LZ4_MAX_INPUT_SIZE) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "LZ4 input too large: %zu bytes\n", input_len);
+        #endif
+        return CODEC_ERR_TOO_LARGE;
+    }
+
+    int header_size = write_length_header(input_len, output, output_cap);
+    if (header_size < 0) {
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+
+    size_t dst_cap = output_cap - header_size;
+    if (dst_cap > (size_t)LZ4_compressBound((int)input_len)) {
+        dst_cap = (size_t)LZ4_compressBound((int)input_len); // LZ4 takes an int capacity
+    }
+    int compressed_data_size = LZ4_compress_default(input, output + header_size, (int)input_len, (int)dst_cap);
+
+    if (compressed_data_size <= 0) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "LZ4_compress_default failed: %d\n", compressed_data_size);
+        #endif
+        // LZ4 only fails when the output does not fit
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+
+    *output_len = header_size + (size_t)compressed_data_size;
+    return CODEC_OK;
+}
+
+// Compress with LZ4 into a caller-provided buffer
+// Output format: [varint original length][LZ4 compressed data]
+int compress_string_lz4_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                             size_t *output_len) {
+    codec_ctx *cached = thread_ctx(CODEC_LZ4);
+    if (cached != NULL) {
+        return codec_ctx_compress(cached, input, input_len, output, output_cap, output_len);
+    }
+    uint64_t start = stats_clock();
+    int rc = lz4_compress_into(input, input_len, output, output_cap, output_len);
+    stats_record(CODEC_LZ4, CODEC_STATS_COMPRESS, input_len, rc == CODEC_OK ? *output_len : 0, rc, start);
+    return rc;
+}
+
+// Uncounted body of decompress_data_lz4_into
+static int lz4_decompress_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                               size_t *output_len) {
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+
+    unsigned long original_len;
+    int header_size = parse_length_header(input, input_len, &original_len, "LZ4 ");
+    if (header_size < 0) {
+        return CODEC_ERR_CORRUPT;
+    }
+    if (original_len > output_cap) {
+        *output_len = original_len;
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+    if (original_len == 0) { // Handle zero-length original string case
+        return CODEC_OK;
+    }
+    if (original_len > LZ4_MAX_INPUT_SIZE || input_len - header_size > (size_t)INT32_MAX) {
+        return CODEC_ERR_TOO_LARGE;
+    }
+
+    // Decompress data (skip the varint header)
+    int decompressed_size = LZ4_decompress_safe(input + header_size, output, (int)(input_len - header_size), (int)original_len);
+
+    if (decompressed_size < 0) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "LZ4_decompress_safe failed: %d\n", decompressed_size);
+        #endif
+        return CODEC_ERR_CORRUPT;
+    }
+
+    // Verify that decompressed length matches expected length
+    if ((unsigned long)decompressed_size != original_len) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "LZ4 Decompression length mismatch: expected %lu, got %d\n",
+                original_len, decompressed_size);
+        #endif
+        return CODEC_ERR_CORRUPT;
+    }
+
+    *output_len = (size_t)decompressed_size;
+    return CODEC_OK;
+}
+
+// Decompress LZ4 data into a caller-provided buffer
+// Expects input format: [varint original length][LZ4 compressed data]
+// LZ4 block decompression keeps no state, so this never needs a context
+int decompress_data_lz4_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                             size_t *output_len) {
+    uint64_t start = stats_clock();
+    int rc = lz4_decompress_into(input, input_len, output, output_cap, output_len);
+    stats_record(CODEC_LZ4, CODEC_STATS_DECOMPRESS, input_len, rc == CODEC_OK ? *output_len : 0, rc, start);
+    return rc;
+}
+
+// Uncounted body of compress_string_zstd_into
+static int zstd_compress_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                              size_t *output_len) {
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+
+    int header_size = write_length_header(input_len, output, output_cap);
+    if (header_size < 0) {
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+
+    // ZSTD_compress would allocate its workspace with malloc
+    codec_allocator a = current_allocator();
+    ZSTD_CCtx *cctx = ZSTD_createCCtx_advanced(zstd_mem(&a));
+    if (cctx == NULL) {
+        return CODEC_ERR_ALLOC;
+    }
+    size_t compressed_data_size = ZSTD_compressCCtx(
+        cctx,
+        output + header_size,
+        output_cap - header_size,
+        input,
+        input_len,
+        ZSTD_DEFAULT_LEVEL
+    );
+    ZSTD_freeCCtx(cctx);
 
-    // Encode original length as varint at the beginning
-    int header_size = encode_varint(input_len, output_buffer);
-
-    // Compress data after the varint header
-    size_t compressed_data_size = ZSTD_compress(
-        output_buffer + header_size, 
-        total_buffer_size - header_size,
-        input, 
-        input_len,
-        1 // Default compression level
-    );
-
     if (ZSTD_isError(compressed_data_size)) {
         #ifdef DEBUG_FUZZING
-        fprintf(stderr, "ZSTD_compress failed: %s\n", ZSTD_getErrorName(compressed_data_size));
+        fprintf(stderr, "ZSTD_compress failed: %s\n", ZSTD_getErrorName(compressed_data_size));
+        #endif
+        if (ZSTD_getErrorCode(compressed_data_size) == ZSTD_error_dstSize_tooSmall) {
+            return CODEC_ERR_BUFFER_TOO_SMALL;
+        }
+        return CODEC_ERR_CODEC;
+    }
+
+    *output_len = header_size + compressed_data_size;
+    return CODEC_OK;
+}
+
+// Compress with Zstandard into a caller-provided buffer
+// Output format: [varint original length][ZSTD compressed data]
+int compress_string_zstd_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                              size_t *output_len) {
+    codec_ctx *cached = thread_ctx(CODEC_ZSTD);
+    if (cached != NULL) {
+        return codec_ctx_compress(cached, input, input_len, output, output_cap, output_len);
+    }
+    uint64_t start = stats_clock();
+    int rc = zstd_compress_into(input, input_len, output, output_cap, output_len);
+    stats_record(CODEC_ZSTD, CODEC_STATS_COMPRESS, input_len, rc == CODEC_OK ? *output_len : 0, rc, start);
+    return rc;
+}
+
+// Uncounted body of decompress_data_zstd_into
+static int zstd_decompress_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                                size_t *output_len) {
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+
+    unsigned long original_len;
+    int header_size = parse_length_header(input, input_len, &original_len, "ZSTD ");
+    if (header_size < 0) {
+        return CODEC_ERR_CORRUPT;
+    }
+    if (original_len > output_cap) {
+        *output_len = original_len;
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+    if (original_len == 0) { // Handle zero-length original string case
+        return CODEC_OK;
+    }
+
+    // Decompress data (skip the varint header)
+    codec_allocator a = current_allocator();
+    ZSTD_DCtx *dctx = ZSTD_createDCtx_advanced(zstd_mem(&a));
+    if (dctx == NULL) {
+        return CODEC_ERR_ALLOC;
+    }
+    size_t decompressed_size = ZSTD_decompressDCtx(
+        dctx,
+        output,
+        original_len,
+        input + header_size,
+        input_len - header_size
+    );
+    ZSTD_freeDCtx(dctx);
+
+    if (ZSTD_isError(decompressed_size)) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "ZSTD_decompress failed: %s\n", ZSTD_getErrorName(decompressed_size));
+        #endif
+        return CODEC_ERR_CORRUPT;
+    }
+
+    // Verify that decompressed length matches expected length
+    if (decompressed_size != original_len) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "ZSTD Decompression length mismatch: expected %lu, got %zu\n",
+                original_len, decompressed_size);
+        #endif
+        return CODEC_ERR_CORRUPT;
+    }
+
+    *output_len = decompressed_size;
+    return CODEC_OK;
+}
+
+// Decompress Zstandard data into a caller-provided buffer
+// Expects input format: [varint original length][ZSTD compressed data]
+int decompress_data_zstd_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                              size_t *output_len) {
+    codec_ctx *cached = thread_ctx(CODEC_ZSTD);
+    if (cached != NULL) {
+        return codec_ctx_decompress(cached, input, input_len, output, output_cap, output_len);
+    }
+    uint64_t start = stats_clock();
+    int rc = zstd_decompress_into(input, input_len, output, output_cap, output_len);
+    stats_record(CODEC_ZSTD, CODEC_STATS_DECOMPRESS, input_len, rc == CODEC_OK ? *output_len : 0, rc, start);
+    return rc;
+}
+
+// Signature shared by the *_into codec entry points
+typedef int (*codec_into_fn)(const char *input, size_t input_len, char *output, size_t output_cap,
+                             size_t *output_len);
+
+// Allocate a worst-case sized buffer and run a compress_*_into function into it
+static CompressedData compress_alloc(codec_into_fn compress_fn, size_t bound, const char *input,
+                                     unsigned long input_len, const char *alloc_error) {
+    CompressedData result = {NULL, 0};
+    if (bound == 0) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Compress bound failed for input of %lu bytes\n", input_len);
+        #endif
+        return result;
+    }
+
+    char *output_buffer = buffer_alloc(bound);
+    if (output_buffer == NULL) {
+        perror(alloc_error);
+        return result; // Return empty result
+    }
+
+    size_t output_len;
+    if (compress_fn(input, input_len, output_buffer, bound, &output_len) != CODEC_OK) {
+        buffer_free(output_buffer);
+        return result; // Return empty result
+    }
+
+    result.buffer = output_buffer;
+    result.length = output_len; // Header + compressed data
+    return result;
+}
+
+// Allocate a buffer sized from the varint header and run a decompress_*_into function into it
+// The returned buffer is always null-terminated (one byte past length)
+static DecompressedData decompress_alloc(codec_into_fn decompress_fn, const char *input,
+                                         unsigned long input_len, const char *codec_name,
+                                         const char *alloc_error) {
+    DecompressedData result = {NULL, 0};
+
+    unsigned long original_len;
+    if (parse_length_header(input, input_len, &original_len, codec_name) < 0) {
+        return result;
+    }
+
+    // Sanity check on original length (prevent absurdly large allocations)
+    if (original_len > MAX_DECOMPRESSED_SIZE) { // 100MB limit
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Invalid %scompressed data: original length too large (%lu bytes)\n", codec_name, original_len);
+        #endif
+        STATS_COUNT(over_size_cap);
+        return result;
+    }
+
+    // Allocate buffer for decompressed data
+    char *output_buffer = buffer_alloc(original_len + 1);
+    if (output_buffer == NULL) {
+        perror(alloc_error);
+        return result;
+    }
+
+    size_t output_len;
+    if (decompress_fn(input, input_len, output_buffer, original_len, &output_len) != CODEC_OK) {
+        buffer_free(output_buffer);
+        return result;
+    }
+
+    output_buffer[output_len] = '\0'; // Ensure null termination
+
+    result.buffer = output_buffer;
+    result.length = output_len;
+    return result;
+}
+
+// Function to compress a string using zlib with variable-byte length header
+// The compressed data format: [varint original length][zlib compressed data]
+// The caller is responsible for freeing the returned buffer
+CompressedData compress_string(const char *input, unsigned long input_len) {
+    return compress_alloc(compress_string_into, compress_bound(input_len), input, input_len,
+                          "Failed to allocate memory for compression");
+}
+
+// Function to decompress data using zlib, automatically reading original size from varint header
+// Expects input format: [varint original length][zlib compressed data]
+// The caller is responsible for freeing the returned buffer
+DecompressedData decompress_data(const char *input, unsigned long input_len) {
+    return decompress_alloc(decompress_data_into, input, input_len, "",
+                            "Failed to allocate memory for decompression");
+}
+
+// Function to compress a string using LZ4 with variable-byte length header
+// The compressed data format: [varint original length][LZ4 compressed data]
+// The caller is responsible for freeing the returned buffer
+CompressedData compress_string_lz4(const char *input, unsigned long input_len) {
+    return compress_alloc(compress_string_lz4_into, compress_bound_lz4(input_len), input, input_len,
+                          "Failed to allocate memory for LZ4 compression");
+}
+
+// Function to decompress data using LZ4, automatically reading original size from varint header
+// Expects input format: [varint original length][LZ4 compressed data]
+// The caller is responsible for freeing the returned buffer
+DecompressedData decompress_data_lz4(const char *input, unsigned long input_len) {
+    return decompress_alloc(decompress_data_lz4_into, input, input_len, "LZ4 ",
+                            "Failed to allocate memory for LZ4 decompression");
+}
+
+// Function to compress a string using Zstandard (zstd) with variable-byte length header
+// The compressed data format: [varint original length][ZSTD compressed data]
+// The caller is responsible for freeing the returned buffer
+CompressedData compress_string_zstd(const char *input, unsigned long input_len) {
+    return compress_alloc(compress_string_zstd_into, compress_bound_zstd(input_len), input, input_len,
+                          "Failed to allocate memory for ZSTD compression");
+}
+
+// Function to decompress data using Zstandard (zstd), automatically reading original size from varint header
+// Expects input format: [varint original length][ZSTD compressed data]
+// The caller is responsible for freeing the returned buffer
+DecompressedData decompress_data_zstd(const char *input, unsigned long input_len) {
+    return decompress_alloc(decompress_data_zstd_into, input, input_len, "ZSTD ",
+                            "Failed to allocate memory for ZSTD decompression");
+}
+
+// CRC32C (Castagnoli)
+//
+// Hardware kernels use the SSE4.2 crc32 instruction (selected at runtime) or the ARMv8
+// CRC extension (when the compiler targets it); both run three independent streams over
+// CRC32C_STRIPE-byte stripes so the 3-cycle instruction latency overlaps, then merge the
+// stripes with crc32c_shift. Elsewhere slicing-by-8 folds 8 input bytes per table step.
+// All kernels update the inverted register; checksum_crc32c does the pre/post inversion.
+
+#define CRC32C_POLY 0x82F63B78u // reflected
+#define CRC32C_STRIPE 4096      // Three stripes (12 KiB) stay in L1 for crc32c_copy
+#define CRC32C_FUSED_SLICE (64 * 1024) // Codec loop slice checksummed while still in cache
+
+static uint32_t crc32c_table[8][256];
+// Multiplication by x^(8 * CRC32C_STRIPE) and x^(16 * CRC32C_STRIPE), a byte at a time
+static uint32_t crc32c_shift_table[2][4][256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+typedef uint32_t (*crc32c_fn)(uint32_t crc, const unsigned char *p, size_t len);
+static crc32c_fn crc32c_kernel_fn = NULL;
+static const char *crc32c_kernel_name = "slice8";
+
+// a * b modulo the CRC polynomial, in reflected bit order (bit 31 is x^0)
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b) {
+    uint32_t p = 0;
+    for (uint32_t m = 1u << 31; m != 0; m >>= 1) {
+        if (a & m) {
+            p ^= b;
+        }
+        b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+// x^(8 * n) modulo the polynomial
+static uint32_t crc32c_x8n(size_t n) {
+    uint32_t p = 1u << 31, x8 = 1u << 23; // x^0 and x^8
+    for (size_t i = 0; i < n; i++) {
+        p = crc32c_multmodp(p, x8);
+    }
+    return p;
+}
+
+// Register after feeding len zero bytes to crc, with len given by table
+static inline uint32_t crc32c_shift(const uint32_t table[4][256], uint32_t crc) {
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^ table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+static inline uint64_t crc32c_load64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t crc32c_slice8(uint32_t crc, const unsigned char *p, size_t len) {
+    for (; len >= 8; len -= 8, p += 8) {
+        uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        crc = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+              crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+              crc32c_table[3][p[4]] ^ crc32c_table[2][p[5]] ^ crc32c_table[1][p[6]] ^ crc32c_table[0][p[7]];
+    }
+    while (len-- > 0) {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+// Three-stripe kernel body over a hardware step for 8 bytes (U64) and 1 byte (U8)
+#define CRC32C_HW_BODY(U64, U8)                                                              \
+    for (; len >= 3 * CRC32C_STRIPE; len -= 3 * CRC32C_STRIPE, p += 3 * CRC32C_STRIPE) {     \
+        uint32_t a = crc, b = 0, c = 0;                                                      \
+        for (size_t i = 0; i < CRC32C_STRIPE; i += 8) {                                      \
+            a = (uint32_t)U64(a, crc32c_load64(p + i));                                      \
+            b = (uint32_t)U64(b, crc32c_load64(p + CRC32C_STRIPE + i));                      \
+            c = (uint32_t)U64(c, crc32c_load64(p + 2 * CRC32C_STRIPE + i));                  \
+        }                                                                                    \
+        crc = crc32c_shift(crc32c_shift_table[1], a) ^ crc32c_shift(crc32c_shift_table[0], b) ^ c; \
+    }                                                                                        \
+    for (; len >= 8; len -= 8, p += 8) {                                                     \
+        crc = (uint32_t)U64(crc, crc32c_load64(p));                                          \
+    }                                                                                        \
+    while (len-- > 0) {                                                                      \
+        crc = U8(crc, *p++);                                                                 \
+    }                                                                                        \
+    return crc;
+
+#if defined(VARINT_X86)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *p, size_t len) {
+    CRC32C_HW_BODY(_mm_crc32_u64, _mm_crc32_u8)
+}
+#elif defined(CRC32C_ARMV8)
+static uint32_t crc32c_armv8(uint32_t crc, const unsigned char *p, size_t len) {
+    CRC32C_HW_BODY(__crc32cd, __crc32cb)
+}
+#endif
+
+static void crc32c_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        }
+        crc32c_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t prev = crc32c_table[t - 1][i];
+            crc32c_table[t][i] = (prev >> 8) ^ crc32c_table[0][prev & 0xff];
+        }
+    }
+    // Shifting is linear in the register, so tabulate it per byte position
+    uint32_t x = crc32c_x8n(CRC32C_STRIPE);
+    uint32_t shifts[2] = {x, crc32c_multmodp(x, x)};
+    for (int s = 0; s < 2; s++) {
+        for (int b = 0; b < 4; b++) {
+            for (uint32_t i = 0; i < 256; i++) {
+                crc32c_shift_table[s][b][i] = crc32c_multmodp(shifts[s], i << (8 * b));
+            }
+        }
+    }
+
+    crc32c_kernel_fn = crc32c_slice8;
+#if defined(VARINT_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc32c_kernel_fn = crc32c_sse42;
+        crc32c_kernel_name = "sse4.2";
+    }
+#elif defined(CRC32C_ARMV8)
+    crc32c_kernel_fn = crc32c_armv8;
+    crc32c_kernel_name = "armv8-crc";
+#endif
+}
+
+// Update a CRC32C with len more bytes; start from crc = 0 (same chaining as zlib's crc32)
+uint32_t checksum_crc32c(uint32_t crc, const char *data, size_t len) {
+    if (data == NULL) {
+        return crc;
+    }
+    pthread_once(&crc32c_once, crc32c_init);
+    return ~crc32c_kernel_fn(~crc, (const unsigned char *)data, len);
+}
+
+// Name of the CRC32C kernel selected for this CPU
+const char *checksum_crc32c_kernel(void) {
+    pthread_once(&crc32c_once, crc32c_init);
+    return crc32c_kernel_name;
+}
+
+static uint32_t crc32c(const char *data, size_t len) {
+    return checksum_crc32c(0, data, len);
+}
+
+// memcpy that checksums what it copies: each L1-sized chunk is read from memory once,
+// by the checksum, and copied while still in cache
+static uint32_t crc32c_copy(uint32_t crc, char *dst, const char *src, size_t len) {
+    const size_t chunk = 3 * CRC32C_STRIPE;
+    for (size_t pos = 0; pos < len; pos += chunk) {
+        size_t n = len - pos < chunk ? len - pos : chunk;
+        crc = checksum_crc32c(crc, src + pos, n);
+        memcpy(dst + pos, src + pos, n);
+    }
+    return crc;
+}
+
+// Checksum computed by a codec loop as it reads or writes the data (see codec_ctx.fused)
+typedef struct fused_checksum {
+    uint32_t crc;
+    int done; // set once the whole input or output has been folded into crc
+} fused_checksum;
+
+// Reusable compression context
+//
+// Holds the per-codec state that the one-shot functions set up and tear down on
+// every call (ZSTD_CCtx/ZSTD_DCtx, an LZ4_stream_t, and deflate/inflate z_streams),
+// so repeated calls on small messages only pay for the actual (de)compression.
+// State is created lazily on first use in each direction.
+// A context must not be used from more than one thread at a time.
+typedef struct codec_ctx {
+    int codec;
+    int level;
+    ZSTD_CCtx *zstd_cctx;
+    ZSTD_DCtx *zstd_dctx;
+    LZ4_stream_t *lz4_stream;
+    void *lz4hc_state;
+    z_stream deflate_stream;
+    int deflate_ready;
+    int deflate_level;
+    z_stream inflate_stream;
+    int inflate_ready;
+    const struct codec_dict *dict; // attached with codec_ctx_set_dict, not owned
+    codec_allocator allocator;     // active allocator at creation, used for all state
+    int skip_verify;               // frames decode without checking their checksum
+    fused_checksum *fused;         // set by the frame code for one call: zlib and zstd
+                                   // decoding checksum the data inside their loops
+} codec_ctx;
+
+// Largest varint-encoded 32-bit dictionary ID
+#define MAX_DICT_ID_LEN 5
+
+// Worst-case compressed size (including the varint header and, when a dictionary is
+// attached, the dictionary ID) for the given codec
+// Returns 0 for an unknown codec or an input too large for the codec
+size_t codec_compress_bound(int codec, size_t input_len) {
+    size_t bound;
+    switch (codec) {
+        case CODEC_ZLIB: bound = compress_bound(input_len); break;
+        case CODEC_LZ4: bound = compress_bound_lz4(input_len); break;
+        case CODEC_ZSTD: bound = compress_bound_zstd(input_len); break;
+        default: return 0;
+    }
+    return bound == 0 ? 0 : bound + MAX_DICT_ID_LEN;
+}
+
+// Default level used by the codec's plain compress_string* function
+// Returns 0 for an unknown codec
+int codec_default_level(int codec) {
+    switch (codec) {
+        case CODEC_ZLIB: return Z_DEFAULT_COMPRESSION;
+        case CODEC_LZ4: return 0;
+        case CODEC_ZSTD: return ZSTD_DEFAULT_LEVEL;
+        default: return 0;
+    }
+}
+
+// Report the accepted level range for a codec
+// zlib: -1 (default) to 9; LZ4: negative = acceleration, 0-2 = default, 3-12 = LZ4HC;
+// zstd: ZSTD_minCLevel() (negative, fastest) to ZSTD_maxCLevel()
+int codec_level_range(int codec, int *min_level, int *max_level) {
+    if (min_level == NULL || max_level == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    switch (codec) {
+        case CODEC_ZLIB:
+            *min_level = Z_DEFAULT_COMPRESSION;
+            *max_level = Z_BEST_COMPRESSION;
+            return CODEC_OK;
+        case CODEC_LZ4:
+            *min_level = LZ4_MIN_LEVEL;
+            *max_level = LZ4HC_CLEVEL_MAX;
+            return CODEC_OK;
+        case CODEC_ZSTD:
+            *min_level = ZSTD_minCLevel();
+            *max_level = ZSTD_maxCLevel();
+            return CODEC_OK;
+        default:
+            return CODEC_ERR_INVALID_ARG;
+    }
+}
+
+// Create a context for one codec (CODEC_ZLIB, CODEC_LZ4 or CODEC_ZSTD)
+// Returns NULL for an unknown codec or on allocation failure
+codec_ctx *codec_ctx_create(int codec) {
+    if (codec != CODEC_ZLIB && codec != CODEC_LZ4 && codec != CODEC_ZSTD) {
+        return NULL;
+    }
+    codec_allocator a = current_allocator();
+    codec_ctx *ctx = (codec_ctx *)alloc_with(&a, sizeof(codec_ctx));
+    if (ctx == NULL) {
+        perror("Failed to allocate codec context");
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->allocator = a;
+    ctx->codec = codec;
+    ctx->level = codec_default_level(codec);
+    return ctx;
+}
+
+// Change the compression level used by later codec_ctx_compress calls
+// Returns CODEC_ERR_INVALID_ARG if level is outside codec_level_range
+int codec_ctx_set_level(codec_ctx *ctx, int level) {
+    int min_level, max_level;
+    if (ctx == NULL || codec_level_range(ctx->codec, &min_level, &max_level) != CODEC_OK) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    if (level < min_level || level > max_level) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    ctx->level = level;
+    return CODEC_OK;
+}
+
+// Verify frame checksums when decoding through ctx (the default), or skip it with
+// verify = 0 on paths whose data is already trusted
+int codec_ctx_set_verify(codec_ctx *ctx, int verify) {
+    if (ctx == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    ctx->skip_verify = !verify;
+    return CODEC_OK;
+}
+
+// Free a context and all codec state it holds (NULL is ignored)
+void codec_ctx_destroy(codec_ctx *ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    ZSTD_freeCCtx(ctx->zstd_cctx);
+    ZSTD_freeDCtx(ctx->zstd_dctx);
+    free_with(&ctx->allocator, ctx->lz4_stream);
+    free_with(&ctx->allocator, ctx->lz4hc_state);
+    if (ctx->deflate_ready) {
+        deflateEnd(&ctx->deflate_stream);
+    }
+    if (ctx->inflate_ready) {
+        inflateEnd(&ctx->inflate_stream);
+    }
+    codec_allocator a = ctx->allocator;
+    free_with(&a, ctx);
+}
+
+// Dictionary compression
+//
+// Small messages share most of their structure (field names, enum values) but each
+// one is too short for the codec to learn it, so ratios collapse below a few KB.
+// A dictionary trained on sample messages (dict_train) primes the codec with that
+// shared content. codec_dict_create digests it once - a ZSTD_CDict/ZSTD_DDict pair,
+// or an LZ4 stream with the dictionary already hashed - so contexts attached to it
+// with codec_ctx_set_dict skip the per-call dictionary setup. zlib has no digested
+// form and calls deflateSetDictionary/inflateSetDictionary per message.
+//
+// A context with a dictionary writes [varint original length][varint dict ID][payload]
+// so the decompressor can check it holds the matching dictionary.
+
+// zlib only looks back 32 KiB, so both sides feed it the tail of the dictionary
+#define ZLIB_DICT_WINDOW (32 * 1024)
+
+typedef struct codec_dict {
+    int codec;
+    int level;
+    uint32_t id;
+    char *content;
+    size_t content_len;
+    ZSTD_CDict *zstd_cdict;
+    ZSTD_DDict *zstd_ddict;
+    LZ4_stream_t *lz4_stream; // LZ4_loadDict'ed once, copied into the context per call
+    codec_allocator allocator;
+} codec_dict;
+
+void codec_dict_destroy(codec_dict *dict);
+
+// Train a dictionary of at most dict_cap bytes from count samples stored back to back
+// in samples (sample i is sample_lens[i] bytes long), using ZDICT_trainFromBuffer.
+// The result works with every codec: zstd uses its entropy tables, zlib and LZ4 use
+// the content. Returns CODEC_OK and sets *dict_len, or a negative CODEC_ERR_* code
+// (CODEC_ERR_CODEC if the samples are too few or too small to train on).
+int dict_train(const char *samples, const size_t *sample_lens, size_t count, char *dict, size_t dict_cap,
+               size_t *dict_len) {
+    if (samples == NULL || sample_lens == NULL || dict == NULL || dict_len == NULL || count == 0 ||
+        count > UINT32_MAX) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    *dict_len = 0;
+    size_t n = ZDICT_trainFromBuffer(dict, dict_cap, samples, sample_lens, (unsigned)count);
+    if (ZDICT_isError(n)) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "ZDICT_trainFromBuffer failed: %s\n", ZDICT_getErrorName(n));
+        #endif
+        return CODEC_ERR_CODEC;
+    }
+    *dict_len = n;
+    return CODEC_OK;
+}
+
+// Digest a dictionary for one codec. level is only used by zstd, whose CDict fixes the
+// compression level; contexts using the dictionary compress at it regardless of
+// codec_ctx_set_level. The dictionary bytes are copied.
+// Returns NULL for an unknown codec, an out-of-range level, an empty dictionary or
+// on allocation failure
+codec_dict *codec_dict_create(int codec, int level, const char *dict, size_t dict_len) {
+    int min_level, max_level;
+    if (codec_level_range(codec, &min_level, &max_level) != CODEC_OK || level < min_level ||
+        level > max_level || dict == NULL || dict_len == 0) {
+        return NULL;
+    }
+    codec_allocator a = current_allocator();
+    codec_dict *d = (codec_dict *)alloc_with(&a, sizeof(codec_dict));
+    if (d == NULL) {
+        perror("Failed to allocate dictionary");
+        return NULL;
+    }
+    memset(d, 0, sizeof(*d));
+    d->allocator = a;
+    d->codec = codec;
+    d->level = level;
+    d->content_len = dict_len;
+    d->content = (char *)alloc_with(&a, dict_len);
+    if (d->content == NULL) {
+        codec_dict_destroy(d);
+        return NULL;
+    }
+    memcpy(d->content, dict, dict_len);
+
+    // Trained dictionaries carry their own ID; raw content ones are identified by the
+    // same adler32 zlib stores for its preset dictionary. 0 means "no dictionary".
+    d->id = ZDICT_getDictID(dict, dict_len);
+    if (d->id == 0) {
+        size_t window = dict_len > ZLIB_DICT_WINDOW ? ZLIB_DICT_WINDOW : dict_len;
+        d->id = (uint32_t)adler32(adler32(0L, Z_NULL, 0), (const Bytef *)(dict + dict_len - window), (uInt)window);
+        if (d->id == 0) {
+            d->id = 1;
+        }
+    }
+
+    switch (codec) {
+        case CODEC_ZSTD: {
+            // The level's parameters for a dictionary of this size, with every allocation from
+            // our allocator (ZSTD_createCCtxParams would malloc behind its back)
+            ZSTD_compressionParameters cparams = ZSTD_getCParams(level, ZSTD_CONTENTSIZE_UNKNOWN, dict_len);
+            d->zstd_cdict =
+                ZSTD_createCDict_advanced(d->content, dict_len, ZSTD_dlm_byCopy, ZSTD_dct_auto, cparams, zstd_mem(&a));
+            d->zstd_ddict = ZSTD_createDDict_advanced(d->content, dict_len, ZSTD_dlm_byCopy, ZSTD_dct_auto,
+                                                      zstd_mem(&a));
+            if (d->zstd_cdict == NULL || d->zstd_ddict == NULL) {
+                codec_dict_destroy(d);
+                return NULL;
+            }
+            break;
+        }
+        case CODEC_LZ4:
+            d->lz4_stream = lz4_stream_create(&a);
+            if (d->lz4_stream == NULL) {
+                codec_dict_destroy(d);
+                return NULL;
+            }
+            // LZ4 keeps at most the last 64 KiB, and needs an int length
+            LZ4_loadDict(d->lz4_stream, d->content, dict_len > INT32_MAX ? INT32_MAX : (int)dict_len);
+            break;
+        default:
+            break;
+    }
+    return d;
+}
+
+// ID written into frames compressed with this dictionary (never 0)
+uint32_t codec_dict_id(const codec_dict *dict) {
+    return dict != NULL ? dict->id : 0;
+}
+
+// Free a dictionary (NULL is ignored); no context may still be using it
+void codec_dict_destroy(codec_dict *dict) {
+    if (dict == NULL) {
+        return;
+    }
+    ZSTD_freeCDict(dict->zstd_cdict);
+    ZSTD_freeDDict(dict->zstd_ddict);
+    codec_allocator a = dict->allocator;
+    free_with(&a, dict->lz4_stream);
+    free_with(&a, dict->content);
+    free_with(&a, dict);
+}
+
+// Attach a dictionary to later codec_ctx_compress/codec_ctx_decompress calls, or detach
+// it with NULL. The dictionary is not copied and must outlive its use by the context.
+// Returns CODEC_ERR_INVALID_ARG if the dictionary was created for another codec
+int codec_ctx_set_dict(codec_ctx *ctx, const codec_dict *dict) {
+    if (ctx == NULL || (dict != NULL && dict->codec != ctx->codec)) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    ctx->dict = dict;
+    return CODEC_OK;
+}
+
+// Read the dictionary ID that follows the length header at input[pos]
+// Returns the ID's size, or -1 if it is malformed or nothing follows it
+static int parse_dict_id(const char *input, size_t input_len, size_t pos, uint32_t *dict_id) {
+    size_t remaining = input_len - pos;
+    unsigned long id;
+    int n = decode_varint(input + pos, remaining < MAX_DICT_ID_LEN ? (int)remaining : MAX_DICT_ID_LEN, &id);
+    if (n <= 0 || id == 0 || id > UINT32_MAX || (size_t)n >= remaining) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Invalid compressed data: malformed dictionary ID\n");
+        #endif
+        return -1;
+    }
+    *dict_id = (uint32_t)id;
+    return n;
+}
+
+// Read the dictionary ID from the header of data compressed by a context with a
+// dictionary, so the caller can pick the dictionary to decompress it with
+// Returns CODEC_OK, or CODEC_ERR_CORRUPT if the header is invalid
+int compressed_dict_id(const char *input, size_t input_len, uint32_t *dict_id) {
+    if (dict_id == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    unsigned long original_len;
+    int header_size = parse_length_header(input, input_len, &original_len, "");
+    if (header_size < 0 || parse_dict_id(input, input_len, (size_t)header_size, dict_id) < 0) {
+        return CODEC_ERR_CORRUPT;
+    }
+    return CODEC_OK;
+}
+
+// zlib compression on a persistent deflate stream (same output as compress())
+static int ctx_deflate(codec_ctx *ctx, const char *input, size_t input_len, char *output, size_t output_cap,
+                       size_t *compressed_len) {
+    z_stream *strm = &ctx->deflate_stream;
+    if (ctx->deflate_ready && ctx->deflate_level != ctx->level) {
+        // The level is fixed at deflateInit time, so re-create the stream
+        deflateEnd(strm);
+        ctx->deflate_ready = 0;
+    }
+    if (!ctx->deflate_ready) {
+        memset(strm, 0, sizeof(*strm));
+        zlib_use_allocator(strm, &ctx->allocator);
+        if (deflateInit(strm, ctx->level) != Z_OK) {
+            return CODEC_ERR_ALLOC;
+        }
+        ctx->deflate_ready = 1;
+        ctx->deflate_level = ctx->level;
+    } else if (deflateReset(strm) != Z_OK) {
+        return CODEC_ERR_CODEC;
+    }
+    if (ctx->dict != NULL) {
+        size_t window = ctx->dict->content_len > ZLIB_DICT_WINDOW ? ZLIB_DICT_WINDOW : ctx->dict->content_len;
+        if (deflateSetDictionary(strm, (const Bytef *)(ctx->dict->content + ctx->dict->content_len - window),
+                                 (uInt)window) != Z_OK) {
+            return CODEC_ERR_CODEC;
+        }
+    }
+
+    // avail_in/avail_out are 32-bit, so feed large buffers in slices; with a fused
+    // checksum the slices are cache-sized and each is checksummed just before deflate reads it
+    const size_t max_slice = 1u << 30;
+    const size_t in_slice = ctx->fused != NULL ? CRC32C_FUSED_SLICE : max_slice;
+    size_t in_left = input_len;
+    size_t out_left = output_cap;
+    unsigned char dummy = 0;
+    strm->next_in = (Bytef *)(input != NULL ? input : (const char *)&dummy);
+    strm->next_out = (Bytef *)(output != NULL ? output : (char *)&dummy);
+    strm->avail_in = 0;
+    strm->avail_out = 0;
+
+    int res;
+    do {
+        if (strm->avail_in == 0 && in_left > 0) {
+            strm->avail_in = (uInt)(in_left > in_slice ? in_slice : in_left);
+            in_left -= strm->avail_in;
+            if (ctx->fused != NULL) {
+                ctx->fused->crc = checksum_crc32c(ctx->fused->crc, (const char *)strm->next_in, strm->avail_in);
+            }
+        }
+        if (strm->avail_out == 0 && out_left > 0) {
+            strm->avail_out = (uInt)(out_left > max_slice ? max_slice : out_left);
+            out_left -= strm->avail_out;
+        }
+        res = deflate(strm, in_left == 0 ? Z_FINISH : Z_NO_FLUSH);
+        if (res == Z_BUF_ERROR || (res == Z_OK && strm->avail_out == 0 && out_left == 0)) {
+            return CODEC_ERR_BUFFER_TOO_SMALL;
+        }
+        if (res != Z_OK && res != Z_STREAM_END) {
+            return CODEC_ERR_CODEC;
+        }
+    } while (res != Z_STREAM_END);
+
+    if (ctx->fused != NULL) {
+        ctx->fused->done = 1;
+    }
+    *compressed_len = (size_t)strm->total_out;
+    return CODEC_OK;
+}
+
+// zlib decompression on a persistent inflate stream; output must be exactly original_len
+static int ctx_inflate(codec_ctx *ctx, const char *input, size_t input_len, char *output, size_t original_len) {
+    z_stream *strm = &ctx->inflate_stream;
+    if (!ctx->inflate_ready) {
+        memset(strm, 0, sizeof(*strm));
+        zlib_use_allocator(strm, &ctx->allocator);
+        if (inflateInit(strm) != Z_OK) {
+            return CODEC_ERR_ALLOC;
+        }
+        ctx->inflate_ready = 1;
+    } else if (inflateReset(strm) != Z_OK) {
+        return CODEC_ERR_CODEC;
+    }
+
+    // With a fused checksum the output slices are cache-sized, and what each inflate
+    // call wrote is checksummed right after it
+    const size_t max_slice = 1u << 30;
+    const size_t out_slice = ctx->fused != NULL ? CRC32C_FUSED_SLICE : max_slice;
+    size_t in_left = input_len;
+    size_t out_left = original_len;
+    size_t checked = 0;
+    unsigned char dummy = 0;
+    strm->next_in = (Bytef *)input;
+    strm->next_out = (Bytef *)(output != NULL ? output : (char *)&dummy);
+    strm->avail_in = 0;
+    strm->avail_out = 0;
+
+    int res;
+    do {
+        if (strm->avail_in == 0 && in_left > 0) {
+            strm->avail_in = (uInt)(in_left > max_slice ? max_slice : in_left);
+            in_left -= strm->avail_in;
+        }
+        if (strm->avail_out == 0 && out_left > 0) {
+            strm->avail_out = (uInt)(out_left > out_slice ? out_slice : out_left);
+            out_left -= strm->avail_out;
+        }
+        res = inflate(strm, Z_NO_FLUSH);
+        if (ctx->fused != NULL && strm->total_out > checked) {
+            ctx->fused->crc = checksum_crc32c(ctx->fused->crc, output + checked, strm->total_out - checked);
+            checked = strm->total_out;
+        }
+        if (res == Z_NEED_DICT && ctx->dict != NULL) {
+            // Z_DATA_ERROR here means the stream was compressed with another dictionary
+            size_t window = ctx->dict->content_len > ZLIB_DICT_WINDOW ? ZLIB_DICT_WINDOW : ctx->dict->content_len;
+            res = inflateSetDictionary(strm, (const Bytef *)(ctx->dict->content + ctx->dict->content_len - window),
+                                       (uInt)window);
+            continue;
+        }
+        if (res == Z_OK && strm->avail_in == 0 && in_left == 0 && strm->avail_out != 0) {
+            break; // Input exhausted before the end of the stream
+        }
+    } while (res == Z_OK); // Z_BUF_ERROR: stream longer than the header claims
+
+    if (res != Z_STREAM_END || strm->total_out != original_len) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Decompression failed: %d\n", res);
+        #endif
+        return CODEC_ERR_CORRUPT;
+    }
+    if (ctx->fused != NULL) {
+        ctx->fused->done = 1;
+    }
+    return CODEC_OK;
+}
+
+// zstd decoding with a fused checksum: stream straight into output (stable output
+// buffer, so no intermediate copy) while feeding the input in slices, and checksum
+// each stretch of output right after zstd writes it
+#define ZSTD_FUSED_INPUT_SLICE (8 * 1024)
+
+static int ctx_zstd_decompress_fused(codec_ctx *ctx, const char *payload, size_t payload_len, char *output,
+                                     size_t original_len) {
+    ZSTD_DCtx *dctx = ctx->zstd_dctx;
+    ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters);
+    int rc = CODEC_OK;
+    if (ZSTD_isError(ZSTD_DCtx_setParameter(dctx, ZSTD_d_stableOutBuffer, 1)) ||
+        (ctx->dict != NULL && ZSTD_isError(ZSTD_DCtx_refDDict(dctx, ctx->dict->zstd_ddict)))) {
+        rc = CODEC_ERR_CODEC;
+    }
+    ZSTD_outBuffer out = {output, original_len, 0};
+    ZSTD_inBuffer in = {payload, 0, 0};
+    uint32_t crc = ctx->fused->crc;
+    size_t hint = 1;
+    while (rc == CODEC_OK && (hint != 0 || in.pos < payload_len)) {
+        size_t in_before = in.pos, out_before = out.pos;
+        in.size = payload_len - in.size > ZSTD_FUSED_INPUT_SLICE ? in.size + ZSTD_FUSED_INPUT_SLICE : payload_len;
+        hint = ZSTD_decompressStream(dctx, &out, &in);
+        if (ZSTD_isError(hint)) {
+            #ifdef DEBUG_FUZZING
+            fprintf(stderr, "ZSTD_decompressStream failed: %s\n", ZSTD_getErrorName(hint));
+            #endif
+            rc = CODEC_ERR_CORRUPT;
+            break;
+        }
+        crc = checksum_crc32c(crc, output + out_before, out.pos - out_before);
+        if (in.pos == in_before && out.pos == out_before && in.size == payload_len) {
+            rc = CODEC_ERR_CORRUPT; // Truncated frame, or more data than original_len
+        }
+    }
+    // Parameters are sticky; the one-shot paths expect a clean context
+    ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters);
+    if (rc == CODEC_OK && out.pos != original_len) {
+        rc = CODEC_ERR_CORRUPT;
+    }
+    if (rc == CODEC_OK) {
+        ctx->fused->crc = crc;
+        ctx->fused->done = 1;
+    }
+    return rc;
+}
+
+// Uncounted body of codec_ctx_compress
+static int ctx_compress(codec_ctx *ctx, const char *input, size_t input_len, char *output, size_t output_cap,
+                        size_t *output_len) {
+    if (ctx == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+
+    int header_size = write_length_header(input_len, output, output_cap);
+    if (header_size < 0) {
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+    if (ctx->dict != NULL) {
+        char id[MAX_VARINT_LEN];
+        int id_size = encode_varint(ctx->dict->id, id);
+        if ((size_t)(header_size + id_size) > output_cap) {
+            return CODEC_ERR_BUFFER_TOO_SMALL;
+        }
+        memcpy(output + header_size, id, id_size);
+        header_size += id_size;
+    }
+    char *payload = output + header_size;
+    size_t payload_cap = output_cap - header_size;
+    size_t payload_len = 0;
+
+    switch (ctx->codec) {
+        case CODEC_ZLIB:
+            rc = ctx_deflate(ctx, input, input_len, payload, payload_cap, &payload_len);
+            if (rc != CODEC_OK) {
+                return rc;
+            }
+            break;
+
+        case CODEC_LZ4: {
+            if (input_len > LZ4_MAX_INPUT_SIZE) {
+                return CODEC_ERR_TOO_LARGE;
+            }
+            if (payload_cap > (size_t)LZ4_compressBound((int)input_len)) {
+                payload_cap = (size_t)LZ4_compressBound((int)input_len); // LZ4 takes an int capacity
+            }
+            int n;
+            const codec_dict *dict = ctx->dict;
+            if (ctx->level >= LZ4HC_CLEVEL_MIN) {
+                if (ctx->lz4hc_state == NULL) {
+                    ctx->lz4hc_state = alloc_with(&ctx->allocator, (size_t)LZ4_sizeofStateHC());
+                    if (ctx->lz4hc_state == NULL) {
+                        return CODEC_ERR_ALLOC;
+                    }
+                    LZ4_initStreamHC(ctx->lz4hc_state, (size_t)LZ4_sizeofStateHC());
+                }
+                if (dict != NULL) {
+                    // HC match finding dominates, so loading the dictionary per call is cheap
+                    LZ4_streamHC_t *hc = (LZ4_streamHC_t *)ctx->lz4hc_state;
+                    LZ4_resetStreamHC_fast(hc, ctx->level);
+                    LZ4_loadDictHC(hc, dict->content, dict->content_len > INT32_MAX ? INT32_MAX : (int)dict->content_len);
+                    n = LZ4_compress_HC_continue(hc, input, payload, (int)input_len, (int)payload_cap);
+                } else {
+                    n = LZ4_compress_HC_extStateHC(ctx->lz4hc_state, input, payload, (int)input_len, (int)payload_cap, ctx->level);
+                }
+            } else {
+                if (ctx->lz4_stream == NULL) {
+                    ctx->lz4_stream = lz4_stream_create(&ctx->allocator);
+                    if (ctx->lz4_stream == NULL) {
+                        return CODEC_ERR_ALLOC;
+                    }
+                }
+                int acceleration = ctx->level < 0 ? -ctx->level : 1;
+                if (dict != NULL) {
+                    // Copying the preloaded stream replaces LZ4_loadDict's hashing on every call
+                    memcpy(ctx->lz4_stream, dict->lz4_stream, sizeof(LZ4_stream_t));
+                    n = LZ4_compress_fast_continue(ctx->lz4_stream, input, payload, (int)input_len, (int)payload_cap, acceleration);
+                } else {
+                    // The extState variant reuses the stream's hash table instead of allocating one
+                    n = LZ4_compress_fast_extState(ctx->lz4_stream, input, payload, (int)input_len, (int)payload_cap, acceleration);
+                }
+            }
+            if (n <= 0) {
+                return CODEC_ERR_BUFFER_TOO_SMALL;
+            }
+            payload_len = (size_t)n;
+            break;
+        }
+
+        case CODEC_ZSTD: {
+            if (ctx->zstd_cctx == NULL) {
+                ctx->zstd_cctx = ZSTD_createCCtx_advanced(zstd_mem(&ctx->allocator));
+                if (ctx->zstd_cctx == NULL) {
+                    return CODEC_ERR_ALLOC;
+                }
+            }
+            size_t n = ctx->dict != NULL
+                ? ZSTD_compress_usingCDict(ctx->zstd_cctx, payload, payload_cap, input, input_len, ctx->dict->zstd_cdict)
+                : ZSTD_compressCCtx(ctx->zstd_cctx, payload, payload_cap, input, input_len, ctx->level);
+            if (ZSTD_isError(n)) {
+                #ifdef DEBUG_FUZZING
+                fprintf(stderr, "ZSTD_compressCCtx failed: %s\n", ZSTD_getErrorName(n));
+                #endif
+                return ZSTD_getErrorCode(n) == ZSTD_error_dstSize_tooSmall ? CODEC_ERR_BUFFER_TOO_SMALL : CODEC_ERR_CODEC;
+            }
+            payload_len = n;
+            break;
+        }
+
+        default:
+            return CODEC_ERR_INVALID_ARG;
+    }
+
+    *output_len = header_size + payload_len;
+    return CODEC_OK;
+}
+
+// Compress into a caller-provided buffer using the context's codec
+// Output format matches the codec's one-shot function: [varint original length][payload],
+// or [varint original length][varint dict ID][payload] with a dictionary attached
+int codec_ctx_compress(codec_ctx *ctx, const char *input, size_t input_len, char *output, size_t output_cap,
+                       size_t *output_len) {
+    uint64_t start = stats_clock();
+    int rc = ctx_compress(ctx, input, input_len, output, output_cap, output_len);
+    stats_record(ctx != NULL ? ctx->codec : -1, CODEC_STATS_COMPRESS, input_len, rc == CODEC_OK ? *output_len : 0, rc,
+                 start);
+    return rc;
+}
+
+// Uncounted body of codec_ctx_decompress
+static int ctx_decompress(codec_ctx *ctx, const char *input, size_t input_len, char *output, size_t output_cap,
+                          size_t *output_len) {
+    if (ctx == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+
+    unsigned long original_len;
+    int header_size = parse_length_header(input, input_len, &original_len, "");
+    if (header_size < 0) {
+        return CODEC_ERR_CORRUPT;
+    }
+    if (ctx->dict != NULL) {
+        uint32_t dict_id;
+        int id_size = parse_dict_id(input, input_len, (size_t)header_size, &dict_id);
+        if (id_size < 0) {
+            return CODEC_ERR_CORRUPT;
+        }
+        if (dict_id != ctx->dict->id) {
+            return CODEC_ERR_DICT_MISMATCH;
+        }
+        header_size += id_size;
+    }
+    if (original_len > output_cap) {
+        *output_len = original_len;
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+    const char *payload = input + header_size;
+    size_t payload_len = input_len - header_size;
+
+    switch (ctx->codec) {
+        case CODEC_ZLIB:
+            rc = ctx_inflate(ctx, payload, payload_len, output, original_len);
+            if (rc != CODEC_OK) {
+                return rc;
+            }
+            break;
+
+        case CODEC_LZ4: {
+            if (ctx->dict == NULL) {
+                // LZ4 block decompression is stateless; delegate to the one-shot path
+                return lz4_decompress_into(input, input_len, output, output_cap, output_len);
+            }
+            if (original_len == 0) {
+                break;
+            }
+            if (original_len > LZ4_MAX_INPUT_SIZE || payload_len > (size_t)INT32_MAX) {
+                return CODEC_ERR_TOO_LARGE;
+            }
+            const codec_dict *dict = ctx->dict;
+            int n = LZ4_decompress_safe_usingDict(payload, output, (int)payload_len, (int)original_len, dict->content,
+                                                  dict->content_len > INT32_MAX ? INT32_MAX : (int)dict->content_len);
+            if (n < 0 || (unsigned long)n != original_len) {
+                #ifdef DEBUG_FUZZING
+                fprintf(stderr, "LZ4_decompress_safe_usingDict failed or length mismatch: %d\n", n);
+                #endif
+                return CODEC_ERR_CORRUPT;
+            }
+            break;
+        }
+
+        case CODEC_ZSTD: {
+            if (original_len == 0) {
+                break;
+            }
+            if (ctx->zstd_dctx == NULL) {
+                ctx->zstd_dctx = ZSTD_createDCtx_advanced(zstd_mem(&ctx->allocator));
+                if (ctx->zstd_dctx == NULL) {
+                    return CODEC_ERR_ALLOC;
+                }
+            }
+            if (ctx->fused != NULL) {
+                rc = ctx_zstd_decompress_fused(ctx, payload, payload_len, output, original_len);
+                if (rc != CODEC_OK) {
+                    return rc;
+                }
+                break;
+            }
+            size_t n = ctx->dict != NULL
+                ? ZSTD_decompress_usingDDict(ctx->zstd_dctx, output, original_len, payload, payload_len, ctx->dict->zstd_ddict)
+                : ZSTD_decompressDCtx(ctx->zstd_dctx, output, original_len, payload, payload_len);
+            if (ZSTD_isError(n) || n != original_len) {
+                #ifdef DEBUG_FUZZING
+                fprintf(stderr, "ZSTD_decompressDCtx failed or length mismatch\n");
+                #endif
+                return CODEC_ERR_CORRUPT;
+            }
+            break;
+        }
+
+        default:
+            return CODEC_ERR_INVALID_ARG;
+    }
+
+    *output_len = original_len;
+    return CODEC_OK;
+}
+
+// Decompress into a caller-provided buffer using the context's codec
+// Same buffer contract as decompress_data_into; with a dictionary attached, returns
+// CODEC_ERR_DICT_MISMATCH if the input names a different dictionary ID
+int codec_ctx_decompress(codec_ctx *ctx, const char *input, size_t input_len, char *output, size_t output_cap,
+                         size_t *output_len) {
+    uint64_t start = stats_clock();
+    int rc = ctx_decompress(ctx, input, input_len, output, output_cap, output_len);
+    stats_record(ctx != NULL ? ctx->codec : -1, CODEC_STATS_DECOMPRESS, input_len, rc == CODEC_OK ? *output_len : 0, rc,
+                 start);
+    return rc;
+}
+
+// Thread-local context cache
+//
+// Each thread keeps one context per codec for the plain compress_string*/decompress_data*
+// calls, so their codec state (deflate/inflate streams, LZ4 stream, zstd CCtx/DCtx) is
+// created once per thread instead of once per call. Nothing is shared between threads
+// and no locks are taken. The contexts are freed when the thread exits, or earlier by
+// codec_thread_cache_release.
+//
+// The cache is bypassed while a thread allocator override is installed: overrides are
+// typically scoped (an arena that is reset, a tracking allocator on the stack), and a
+// context kept across the scope would outlive its memory. Contexts created under the
+// process-wide allocator remember it and are freed through it.
+#define THREAD_CTX_CODECS 3
+
+static _Thread_local codec_ctx *thread_ctx_cache[THREAD_CTX_CODECS];
+static pthread_key_t thread_ctx_key;
+static pthread_once_t thread_ctx_once = PTHREAD_ONCE_INIT;
+static int thread_ctx_key_ok;
+
+static void thread_ctx_destroy_all(void *cache) {
+    codec_ctx **slots = (codec_ctx **)cache;
+    for (int i = 0; i < THREAD_CTX_CODECS; i++) {
+        codec_ctx_destroy(slots[i]);
+        slots[i] = NULL;
+    }
+}
+
+static void thread_ctx_key_create(void) {
+    thread_ctx_key_ok = pthread_key_create(&thread_ctx_key, thread_ctx_destroy_all) == 0;
+}
+
+// The calling thread's context for codec, created on first use, or NULL when the cache
+// is bypassed or unavailable (the caller then sets up codec state itself)
+static codec_ctx *thread_ctx(int codec) {
+    if (thread_allocator.alloc_fn != NULL || codec < 0 || codec >= THREAD_CTX_CODECS) {
+        return NULL;
+    }
+    codec_ctx *ctx = thread_ctx_cache[codec];
+    if (ctx != NULL) {
+        return ctx;
+    }
+    pthread_once(&thread_ctx_once, thread_ctx_key_create);
+    // The key's destructor is what frees the contexts at thread exit; without it, do not cache
+    if (!thread_ctx_key_ok || pthread_setspecific(thread_ctx_key, thread_ctx_cache) != 0) {
+        return NULL;
+    }
+    ctx = codec_ctx_create(codec);
+    thread_ctx_cache[codec] = ctx;
+    return ctx;
+}
+
+// Free the calling thread's cached contexts; later calls recreate them on demand
+// Returns the number of contexts released
+int codec_thread_cache_release(void) {
+    int released = 0;
+    for (int i = 0; i < THREAD_CTX_CODECS; i++) {
+        released += thread_ctx_cache[i] != NULL;
+    }
+    thread_ctx_destroy_all(thread_ctx_cache);
+    return released;
+}
+
+// One-shot compression at an explicit level into a caller-provided buffer
+// level follows codec_level_range; output format matches the codec's compress_string* function
+int compress_string_level_into(int codec, int level, const char *input, size_t input_len, char *output,
+                               size_t output_cap, size_t *output_len) {
+    codec_ctx *ctx = codec_ctx_create(codec);
+    if (ctx == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    int rc = codec_ctx_set_level(ctx, level);
+    if (rc == CODEC_OK) {
+        rc = codec_ctx_compress(ctx, input, input_len, output, output_cap, output_len);
+    }
+    codec_ctx_destroy(ctx);
+    return rc;
+}
+
+// Allocating variant of compress_string_level_into
+// The caller is responsible for freeing the returned buffer with free_compressed_data
+CompressedData compress_string_level(int codec, int level, const char *input, unsigned long input_len) {
+    CompressedData result = {NULL, 0};
+    size_t bound = codec_compress_bound(codec, input_len);
+    if (bound == 0) {
+        return result;
+    }
+    char *output_buffer = buffer_alloc(bound);
+    if (output_buffer == NULL) {
+        perror("Failed to allocate memory for compression");
+        return result;
+    }
+    size_t output_len;
+    if (compress_string_level_into(codec, level, input, input_len, output_buffer, bound, &output_len) != CODEC_OK) {
+        buffer_free(output_buffer);
+        return result;
+    }
+    result.buffer = output_buffer;
+    result.length = output_len;
+    return result;
+}
+
+// Batch compression
+//
+// Compresses or decompresses many small items in one call through a single context,
+// writing all results back to back into one caller-provided arena. Item i occupies
+// arena[offsets[i] .. offsets[i + 1]], so offsets must have count + 1 entries.
+// Each item has the same format as a single codec_ctx_compress call.
+
+// Worst-case arena size for codec_batch_compress, or 0 if any item is too large
+size_t codec_batch_compress_bound(int codec, const size_t *input_lens, size_t count) {
+    if (input_lens == NULL && count > 0) {
+        return 0;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t bound = codec_compress_bound(codec, input_lens[i]);
+        if (bound == 0 || bound > SIZE_MAX - total) {
+            return 0;
+        }
+        total += bound;
+    }
+    return total;
+}
+
+// Total decompressed size of a batch, read from each item's varint header
+// Returns CODEC_OK, or CODEC_ERR_CORRUPT if any header is malformed
+int codec_batch_decompressed_size(const char *const *inputs, const size_t *input_lens, size_t count,
+                                  size_t *total_len) {
+    if (total_len == NULL || ((inputs == NULL || input_lens == NULL) && count > 0)) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t original_len;
+        int rc = decompressed_length(inputs[i], input_lens[i], &original_len);
+        if (rc != CODEC_OK) {
+            return rc;
+        }
+        if (original_len > SIZE_MAX - total) {
+            return CODEC_ERR_TOO_LARGE;
+        }
+        total += original_len;
+    }
+    *total_len = total;
+    return CODEC_OK;
+}
+
+// Shared loop for the batch entry points; stops at the first failing item
+static int ctx_batch(codec_ctx *ctx, int compress, const char *const *inputs, const size_t *input_lens,
+                     size_t count, char *arena, size_t arena_cap, size_t *offsets) {
+    if (ctx == NULL || offsets == NULL || ((inputs == NULL || input_lens == NULL) && count > 0) ||
+        (arena == NULL && arena_cap > 0)) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    size_t pos = 0;
+    offsets[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t item_len;
+        int rc;
+        if (compress) {
+            rc = codec_ctx_compress(ctx, inputs[i], input_lens[i], arena + pos, arena_cap - pos, &item_len);
+        } else {
+            rc = codec_ctx_decompress(ctx, inputs[i], input_lens[i], arena + pos, arena_cap - pos, &item_len);
+        }
+        if (rc != CODEC_OK) {
+            #ifdef DEBUG_FUZZING
+            fprintf(stderr, "Batch item %zu failed: %d\n", i, rc);
+            #endif
+            return rc;
+        }
+        pos += item_len;
+        offsets[i + 1] = pos;
+    }
+    return CODEC_OK;
+}
+
+// Compress count items into arena using ctx's codec and level
+// arena_cap of codec_batch_compress_bound() always suffices
+// Returns CODEC_OK or the first item's negative CODEC_ERR_* code
+int codec_batch_compress(codec_ctx *ctx, const char *const *inputs, const size_t *input_lens, size_t count,
+                         char *arena, size_t arena_cap, size_t *offsets) {
+    return ctx_batch(ctx, 1, inputs, input_lens, count, arena, arena_cap, offsets);
+}
+
+// Decompress count items into arena; arena_cap of codec_batch_decompressed_size() suffices
+// Returns CODEC_OK or the first item's negative CODEC_ERR_* code
+int codec_batch_decompress(codec_ctx *ctx, const char *const *inputs, const size_t *input_lens, size_t count,
+                           char *arena, size_t arena_cap, size_t *offsets) {
+    return ctx_batch(ctx, 0, inputs, input_lens, count, arena, arena_cap, offsets);
+}
+
+// Streaming compression
+//
+// A codec_stream compresses or decompresses input of any size with constant memory.
+// Unlike the one-shot functions, the output is the codec's native self-terminating
+// frame (a zstd frame, an LZ4 frame via LZ4F_*, or a zlib stream) with no varint
+// length header, so the original size does not need to be known up front and the
+// MAX_DECOMPRESSED_SIZE cap does not apply.
+//
+// Usage: call stream_update for each input chunk until it returns CODEC_OK (all input
+// consumed), draining out whenever it returns STREAM_OUTPUT_FULL. Then call stream_end
+// until it stops returning STREAM_OUTPUT_FULL.
+
+#define STREAM_COMPRESS 0
+#define STREAM_DECOMPRESS 1
+
+// stream_update/stream_end return values besides CODEC_OK and CODEC_ERR_*
+#define STREAM_OUTPUT_FULL 1 // out was filled; call again with more output space
+#define STREAM_FRAME_END 2   // decompression reached the end of the frame
+
+// LZ4F input block fed per LZ4F_compressUpdate call; bounds the staging buffer
+#define STREAM_LZ4_BLOCK (64 * 1024)
+
+typedef struct codec_stream {
+    int codec;
+    int mode;
+    int level;
+    int finished; // compress: epilogue written; decompress: frame end seen
+    ZSTD_CCtx *zstd_cctx;
+    ZSTD_DCtx *zstd_dctx;
+    LZ4F_cctx *lz4_cctx;
+    LZ4F_dctx *lz4_dctx;
+    LZ4F_preferences_t lz4_prefs;
+    z_stream zlib_stream;
+    int zlib_ready;
+    // LZ4F_compressUpdate needs a worst-case sized destination, so compressed
+    // LZ4 output is staged here and copied out as space allows
+    char *staging;
+    size_t staging_cap;
+    size_t staging_len;
+    size_t staging_pos;
+    int lz4_header_written;
+    codec_allocator allocator;
+} codec_stream;
+
+void stream_destroy(codec_stream *s);
+
+// Start a compression (STREAM_COMPRESS) or decompression (STREAM_DECOMPRESS) stream
+// level follows codec_level_range and is ignored for decompression
+// Returns NULL for invalid arguments or on allocation failure
+codec_stream *stream_begin(int codec, int mode, int level) {
+    int min_level, max_level;
+    if (codec_level_range(codec, &min_level, &max_level) != CODEC_OK) {
+        return NULL;
+    }
+    if (mode != STREAM_COMPRESS && mode != STREAM_DECOMPRESS) {
+        return NULL;
+    }
+    if (mode == STREAM_COMPRESS && (level < min_level || level > max_level)) {
+        return NULL;
+    }
+
+    codec_allocator a = current_allocator();
+    codec_stream *s = (codec_stream *)alloc_with(&a, sizeof(codec_stream));
+    if (s == NULL) {
+        perror("Failed to allocate codec stream");
+        return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    s->allocator = a;
+    zlib_use_allocator(&s->zlib_stream, &s->allocator);
+    s->codec = codec;
+    s->mode = mode;
+    s->level = level;
+
+    int ok = 1;
+    switch (codec) {
+        case CODEC_ZSTD:
+            if (mode == STREAM_COMPRESS) {
+                s->zstd_cctx = ZSTD_createCCtx_advanced(zstd_mem(&a));
+                ok = s->zstd_cctx != NULL &&
+                     !ZSTD_isError(ZSTD_CCtx_setParameter(s->zstd_cctx, ZSTD_c_compressionLevel, level)) &&
+                     !ZSTD_isError(ZSTD_CCtx_setParameter(s->zstd_cctx, ZSTD_c_checksumFlag, 1));
+            } else {
+                s->zstd_dctx = ZSTD_createDCtx_advanced(zstd_mem(&a));
+                ok = s->zstd_dctx != NULL;
+            }
+            break;
+
+        case CODEC_LZ4:
+            if (mode == STREAM_COMPRESS) {
+                memset(&s->lz4_prefs, 0, sizeof(s->lz4_prefs));
+                s->lz4_prefs.compressionLevel = level;
+                s->lz4_prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+                s->staging_cap = LZ4F_compressBound(STREAM_LZ4_BLOCK, &s->lz4_prefs);
+                if (s->staging_cap < LZ4F_HEADER_SIZE_MAX) {
+                    s->staging_cap = LZ4F_HEADER_SIZE_MAX;
+                }
+                s->staging = (char *)alloc_with(&a, s->staging_cap);
+                ok = s->staging != NULL && !LZ4F_isError(LZ4F_createCompressionContext(&s->lz4_cctx, LZ4F_VERSION));
+            } else {
+                ok = !LZ4F_isError(LZ4F_createDecompressionContext(&s->lz4_dctx, LZ4F_VERSION));
+            }
+            break;
+
+        case CODEC_ZLIB:
+            if (mode == STREAM_COMPRESS) {
+                ok = deflateInit(&s->zlib_stream, level) == Z_OK;
+            } else {
+                ok = inflateInit(&s->zlib_stream) == Z_OK;
+            }
+            s->zlib_ready = ok;
+            break;
+    }
+
+    if (!ok) {
+        stream_destroy(s);
+        return NULL;
+    }
+    return s;
+}
+
+// Free a stream and its codec state (NULL is ignored)
+void stream_destroy(codec_stream *s) {
+    if (s == NULL) {
+        return;
+    }
+    ZSTD_freeCCtx(s->zstd_cctx);
+    ZSTD_freeDCtx(s->zstd_dctx);
+    if (s->lz4_cctx != NULL) {
+        LZ4F_freeCompressionContext(s->lz4_cctx);
+    }
+    if (s->lz4_dctx != NULL) {
+        LZ4F_freeDecompressionContext(s->lz4_dctx);
+    }
+    if (s->zlib_ready) {
+        if (s->mode == STREAM_COMPRESS) {
+            deflateEnd(&s->zlib_stream);
+        } else {
+            inflateEnd(&s->zlib_stream);
+        }
+    }
+    codec_allocator a = s->allocator;
+    free_with(&a, s->staging);
+    free_with(&a, s);
+}
+
+// Copy pending staged LZ4 output into out; returns 1 if everything was drained
+static int stream_drain_staging(codec_stream *s, char *output, size_t output_cap, size_t *produced) {
+    size_t pending = s->staging_len - s->staging_pos;
+    size_t space = output_cap - *produced;
+    size_t n = pending < space ? pending : space;
+    if (n > 0) {
+        memcpy(output + *produced, s->staging + s->staging_pos, n);
+        s->staging_pos += n;
+        *produced += n;
+    }
+    if (s->staging_pos == s->staging_len) {
+        s->staging_pos = 0;
+        s->staging_len = 0;
+        return 1;
+    }
+    return 0;
+}
+
+// Run zlib deflate/inflate over the given buffers, slicing to fit 32-bit counters
+static int stream_zlib_step(codec_stream *s, const char *input, size_t input_len, size_t *consumed,
+                            char *output, size_t output_cap, size_t *produced, int flush) {
+    const size_t max_slice = 1u << 30;
+    z_stream *strm = &s->zlib_stream;
+    for (;;) {
+        size_t in_slice = input_len - *consumed;
+        size_t out_slice = output_cap - *produced;
+        if (in_slice > max_slice) in_slice = max_slice;
+        if (out_slice > max_slice) out_slice = max_slice;
+        unsigned char dummy = 0;
+        strm->next_in = (Bytef *)(in_slice > 0 ? input + *consumed : (const char *)&dummy);
+        strm->avail_in = (uInt)in_slice;
+        strm->next_out = (Bytef *)(out_slice > 0 ? output + *produced : (char *)&dummy);
+        strm->avail_out = (uInt)out_slice;
+
+        int last_slice = *consumed + in_slice == input_len;
+        int res;
+        if (s->mode == STREAM_COMPRESS) {
+            res = deflate(strm, (flush && last_slice) ? Z_FINISH : Z_NO_FLUSH);
+        } else {
+            res = inflate(strm, Z_NO_FLUSH);
+        }
+        *consumed += in_slice - strm->avail_in;
+        *produced += out_slice - strm->avail_out;
+
+        if (res == Z_STREAM_END) {
+            s->finished = 1;
+            return s->mode == STREAM_DECOMPRESS ? STREAM_FRAME_END : CODEC_OK;
+        }
+        if (res != Z_OK && res != Z_BUF_ERROR) {
+            #ifdef DEBUG_FUZZING
+            fprintf(stderr, "zlib stream failed: %d\n", res);
+            #endif
+            return s->mode == STREAM_DECOMPRESS ? CODEC_ERR_CORRUPT : CODEC_ERR_CODEC;
+        }
+        if (*produced == output_cap) {
+            return STREAM_OUTPUT_FULL;
+        }
+        if (*consumed == input_len && !flush) {
+            return CODEC_OK;
+        }
+        if (res == Z_BUF_ERROR) {
+            // No progress possible: needs more input (or more output, handled above)
+            return CODEC_OK;
+        }
+    }
+}
+
+// Uncounted body of stream_update
+static int stream_run(codec_stream *s, const char *input, size_t input_len, size_t *input_consumed,
+                      char *output, size_t output_cap, size_t *output_len) {
+    if (s == NULL || input_consumed == NULL ||
+        check_into_args(input, input_len, output, output_cap, output_len) != CODEC_OK) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    *input_consumed = 0;
+    *output_len = 0;
+    if (s->finished) {
+        return s->mode == STREAM_DECOMPRESS ? STREAM_FRAME_END : CODEC_ERR_INVALID_ARG;
+    }
+
+    size_t consumed = 0;
+    size_t produced = 0;
+    int rc = CODEC_OK;
+
+    switch (s->codec) {
+        case CODEC_ZSTD: {
+            ZSTD_inBuffer in = {input, input_len, 0};
+            ZSTD_outBuffer out = {output, output_cap, 0};
+            while (in.pos < in.size || s->mode == STREAM_DECOMPRESS) {
+                size_t ret;
+                if (s->mode == STREAM_COMPRESS) {
+                    ret = ZSTD_compressStream2(s->zstd_cctx, &out, &in, ZSTD_e_continue);
+                } else {
+                    ret = ZSTD_decompressStream(s->zstd_dctx, &out, &in);
+                }
+                if (ZSTD_isError(ret)) {
+                    #ifdef DEBUG_FUZZING
+                    fprintf(stderr, "ZSTD stream failed: %s\n", ZSTD_getErrorName(ret));
+                    #endif
+                    rc = s->mode == STREAM_DECOMPRESS ? CODEC_ERR_CORRUPT : CODEC_ERR_CODEC;
+                    break;
+                }
+                if (s->mode == STREAM_DECOMPRESS && ret == 0) {
+                    s->finished = 1;
+                    rc = STREAM_FRAME_END;
+                    break;
+                }
+                if (out.pos == out.size) {
+                    rc = STREAM_OUTPUT_FULL;
+                    break;
+                }
+                if (in.pos == in.size) {
+                    break; // Output not full: everything available has been flushed
+                }
+            }
+            consumed = in.pos;
+            produced = out.pos;
+            break;
+        }
+
+        case CODEC_LZ4:
+            if (s->mode == STREAM_COMPRESS) {
+                for (;;) {
+                    if (!stream_drain_staging(s, output, output_cap, &produced)) {
+                        rc = STREAM_OUTPUT_FULL;
+                        break;
+                    }
+                    if (!s->lz4_header_written) {
+                        size_t n = LZ4F_compressBegin(s->lz4_cctx, s->staging, s->staging_cap, &s->lz4_prefs);
+                        if (LZ4F_isError(n)) {
+                            rc = CODEC_ERR_CODEC;
+                            break;
+                        }
+                        s->staging_len = n;
+                        s->lz4_header_written = 1;
+                        continue;
+                    }
+                    if (consumed == input_len) {
+                        break;
+                    }
+                    size_t chunk = input_len - consumed;
+                    if (chunk > STREAM_LZ4_BLOCK) {
+                        chunk = STREAM_LZ4_BLOCK;
+                    }
+                    size_t n = LZ4F_compressUpdate(s->lz4_cctx, s->staging, s->staging_cap, input + consumed, chunk, NULL);
+                    if (LZ4F_isError(n)) {
+                        rc = CODEC_ERR_CODEC;
+                        break;
+                    }
+                    s->staging_len = n;
+                    consumed += chunk;
+                }
+            } else {
+                while (produced < output_cap) {
+                    size_t out_size = output_cap - produced;
+                    size_t in_size = input_len - consumed;
+                    size_t hint = LZ4F_decompress(s->lz4_dctx, output + produced, &out_size,
+                                                  input + consumed, &in_size, NULL);
+                    if (LZ4F_isError(hint)) {
+                        #ifdef DEBUG_FUZZING
+                        fprintf(stderr, "LZ4F_decompress failed: %s\n", LZ4F_getErrorName(hint));
+                        #endif
+                        rc = CODEC_ERR_CORRUPT;
+                        break;
+                    }
+                    consumed += in_size;
+                    produced += out_size;
+                    if (hint == 0) {
+                        s->finished = 1;
+                        rc = STREAM_FRAME_END;
+                        break;
+                    }
+                    if (in_size == 0 && out_size == 0) {
+                        break; // Needs more input
+                    }
+                }
+                if (rc == CODEC_OK && produced == output_cap) {
+                    rc = STREAM_OUTPUT_FULL;
+                }
+            }
+            break;
+
+        case CODEC_ZLIB:
+            rc = stream_zlib_step(s, input, input_len, &consumed, output, output_cap, &produced, 0);
+            break;
+
+        default:
+            rc = CODEC_ERR_INVALID_ARG;
+    }
+
+    *input_consumed = consumed;
+    *output_len = produced;
+    return rc;
+}
+
+// Feed input to the stream, writing as much output as fits in out
+// Returns CODEC_OK once all input is consumed, STREAM_OUTPUT_FULL if out filled up first
+// (call again with the remaining input), STREAM_FRAME_END when decompression completes
+// the frame (any trailing input is left unconsumed), or a negative CODEC_ERR_* code
+int stream_update(codec_stream *s, const char *input, size_t input_len, size_t *input_consumed,
+                  char *output, size_t output_cap, size_t *output_len) {
+    uint64_t start = stats_clock();
+    int rc = stream_run(s, input, input_len, input_consumed, output, output_cap, output_len);
+    int op = s != NULL && s->mode == STREAM_DECOMPRESS ? CODEC_STATS_DECOMPRESS : CODEC_STATS_COMPRESS;
+    stats_record(s != NULL ? s->codec : -1, op, rc >= 0 ? *input_consumed : 0, rc >= 0 ? *output_len : 0, rc, start);
+    return rc;
+}
+
+// Uncounted body of stream_end
+static int stream_finish(codec_stream *s, char *output, size_t output_cap, size_t *output_len) {
+    if (s == NULL || check_into_args(NULL, 0, output, output_cap, output_len) != CODEC_OK) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    *output_len = 0;
+
+    if (s->mode == STREAM_DECOMPRESS) {
+        if (!s->finished) {
+            #ifdef DEBUG_FUZZING
+            fprintf(stderr, "Stream ended before the end of the compressed frame\n");
+            #endif
+            return CODEC_ERR_CORRUPT;
+        }
+        return CODEC_OK;
+    }
+
+    size_t produced = 0;
+    switch (s->codec) {
+        case CODEC_ZSTD: {
+            if (s->finished) {
+                return CODEC_OK;
+            }
+            ZSTD_inBuffer in = {NULL, 0, 0};
+            ZSTD_outBuffer out = {output, output_cap, 0};
+            size_t remaining = ZSTD_compressStream2(s->zstd_cctx, &out, &in, ZSTD_e_end);
+            *output_len = out.pos;
+            if (ZSTD_isError(remaining)) {
+                return CODEC_ERR_CODEC;
+            }
+            if (remaining > 0) {
+                return STREAM_OUTPUT_FULL;
+            }
+            s->finished = 1;
+            return CODEC_OK;
+        }
+
+        case CODEC_LZ4: {
+            for (;;) {
+                if (!stream_drain_staging(s, output, output_cap, &produced)) {
+                    *output_len = produced;
+                    return STREAM_OUTPUT_FULL;
+                }
+                if (!s->lz4_header_written) {
+                    size_t n = LZ4F_compressBegin(s->lz4_cctx, s->staging, s->staging_cap, &s->lz4_prefs);
+                    if (LZ4F_isError(n)) {
+                        return CODEC_ERR_CODEC;
+                    }
+                    s->staging_len = n;
+                    s->lz4_header_written = 1;
+                    continue;
+                }
+                if (s->finished) {
+                    break;
+                }
+                size_t n = LZ4F_compressEnd(s->lz4_cctx, s->staging, s->staging_cap, NULL);
+                if (LZ4F_isError(n)) {
+                    return CODEC_ERR_CODEC;
+                }
+                s->staging_len = n;
+                s->finished = 1;
+            }
+            *output_len = produced;
+            return CODEC_OK;
+        }
+
+        case CODEC_ZLIB: {
+            if (s->finished) {
+                return CODEC_OK;
+            }
+            size_t consumed = 0;
+            int rc = stream_zlib_step(s, NULL, 0, &consumed, output, output_cap, &produced, 1);
+            *output_len = produced;
+            return rc;
+        }
+
+        default:
+            return CODEC_ERR_INVALID_ARG;
+    }
+}
+
+// Finish the stream
+// Compression: writes the frame epilogue; returns STREAM_OUTPUT_FULL until everything
+// has been written, then CODEC_OK
+// Decompression: returns CODEC_OK if the frame was complete, or CODEC_ERR_CORRUPT if the
+// input ended early
+int stream_end(codec_stream *s, char *output, size_t output_cap, size_t *output_len) {
+    uint64_t start = stats_clock();
+    int rc = stream_finish(s, output, output_cap, output_len);
+    int op = s != NULL && s->mode == STREAM_DECOMPRESS ? CODEC_STATS_DECOMPRESS : CODEC_STATS_COMPRESS;
+    stats_record(s != NULL ? s->codec : -1, op, 0, rc >= 0 ? *output_len : 0, rc, start);
+    return rc;
+}
+
+// Block-parallel compression
+//
+// The input is split into fixed-size blocks that are compressed independently on a
+// pool of worker threads, so both compression and decompression scale with cores.
+// Container format:
+//   ["RFPB"][version=1][codec][varint original_len][varint block_size][varint block_count]
+//   [block_count x varint compressed block length][blocks...]
+// Each block is a regular codec_ctx_compress output ([varint length][payload]) of
+// block_size input bytes (the last block holds the remainder).
+
+#define PARALLEL_MAGIC "RFPB"
+#define PARALLEL_MAGIC_LEN 4
+#define PARALLEL_VERSION 1
+#define PARALLEL_DEFAULT_BLOCK_SIZE (1024 * 1024)
+#define PARALLEL_FIXED_HEADER (PARALLEL_MAGIC_LEN + 2 + 3 * MAX_VARINT_LEN)
+#define PARALLEL_PIN_WORKERS 1   // Pin spawned workers to one CPU each, interleaved over NUMA nodes
+#define PARALLEL_LOCAL_BLOCKS 2  // Give each worker a fixed contiguous run of blocks
+#define PARALLEL_CACHE_BLOCKS 4  // block_size 0 picks parallel_cache_block_size()
+#define PARALLEL_FLAGS_ALL (PARALLEL_PIN_WORKERS | PARALLEL_LOCAL_BLOCKS | PARALLEL_CACHE_BLOCKS)
+#define PARALLEL_CACHE_BLOCK_MIN (256 * 1024)
+#define PARALLEL_CACHE_BLOCK_MAX (4 * 1024 * 1024)
+#define PARALLEL_MAX_PIN_CPUS 1024
+
+// Placement options (set_parallel_options), read once per call
+//
+// On a multi-socket host the per-block buffers a worker touches should live on its own
+// node. Linux places a page on the node of the thread that first writes it, so pinning
+// workers keeps their codec contexts and scratch (allocated after pinning) local, and
+// PARALLEL_LOCAL_BLOCKS replaces the shared block counter with a fixed contiguous run
+// of blocks per worker: the output slots a worker first-touches on a fresh buffer
+// (including the allocating variants' results) are the ones it writes again when the
+// buffer is reused, instead of whichever blocks it happens to claim. Inputs stay where
+// the caller put them. The calling thread takes part in every job unpinned.
+static atomic_int parallel_flags;
+static atomic_size_t parallel_block_size; // 0: PARALLEL_DEFAULT_BLOCK_SIZE
+
+// Largest power of two that, with its worst-case output slot, fits in half of the
+// per-core cache budget: the larger of L2 and an even share of the LLC, clamped to
+// [256 KiB, 4 MiB]. PARALLEL_DEFAULT_BLOCK_SIZE where the cache sizes are unknown
+size_t parallel_cache_block_size(void) {
+    size_t l2 = 0, llc = 0;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#if defined(_SC_LEVEL2_CACHE_SIZE) && defined(_SC_LEVEL3_CACHE_SIZE)
+    long v = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    l2 = v > 0 ? (size_t)v : 0;
+    v = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    llc = v > 0 ? (size_t)v : 0;
+#endif
+    size_t budget = llc / (size_t)(cpus > 0 ? cpus : 1);
+    if (l2 > budget) {
+        budget = l2;
+    }
+    if (budget == 0) {
+        return PARALLEL_DEFAULT_BLOCK_SIZE;
+    }
+    size_t block = PARALLEL_CACHE_BLOCK_MIN;
+    while (block < PARALLEL_CACHE_BLOCK_MAX && 4 * block <= budget) {
+        block *= 2;
+    }
+    return block;
+}
+
+// Set the process-wide placement flags (PARALLEL_*) and the block size that a
+// block_size of 0 selects (0 = PARALLEL_DEFAULT_BLOCK_SIZE). With PARALLEL_CACHE_BLOCKS
+// block_size must be 0. Calls already running keep the options they started with
+// Returns CODEC_OK or CODEC_ERR_INVALID_ARG
+int set_parallel_options(int flags, size_t block_size) {
+    if ((flags & ~PARALLEL_FLAGS_ALL) != 0 || ((flags & PARALLEL_CACHE_BLOCKS) && block_size != 0)) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    if (flags & PARALLEL_CACHE_BLOCKS) {
+        block_size = parallel_cache_block_size();
+    }
+    atomic_store(&parallel_block_size, block_size);
+    atomic_store(&parallel_flags, flags);
+    return CODEC_OK;
+}
+
+// The block size a block_size argument of 0 currently selects
+size_t parallel_default_block_size(void) {
+    size_t block_size = atomic_load(&parallel_block_size);
+    return block_size != 0 ? block_size : PARALLEL_DEFAULT_BLOCK_SIZE;
+}
+
+// CPUs to pin workers to, in order: the node-local CPUs of the process's affinity mask,
+// interleaved over NUMA nodes (node0 cpu, node1 cpu, ..., node0 next cpu, ...) so that
+// any worker count spreads evenly over sockets. Built once; without sysfs node
+// information all allowed CPUs count as one node
+static int pin_cpus[PARALLEL_MAX_PIN_CPUS];
+static int pin_cpu_count;
+static int pin_node_count;
+static pthread_once_t pin_once = PTHREAD_ONCE_INIT;
+
+#ifdef __linux__
+// Parse a sysfs CPU list ("0-3,8-11") into set, keeping only CPUs in allowed
+static int parse_cpu_list(const char *path, const cpu_set_t *allowed, cpu_set_t *set) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    CPU_ZERO(set);
+    int count = 0, lo, hi;
+    while (fscanf(f, "%d", &lo) == 1) {
+        hi = lo;
+        int c = fgetc(f);
+        if (c == '-') {
+            if (fscanf(f, "%d", &hi) != 1) {
+                break;
+            }
+            c = fgetc(f);
+        }
+        for (int cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++) {
+            if (cpu >= 0 && CPU_ISSET(cpu, allowed)) {
+                CPU_SET(cpu, set);
+                count++;
+            }
+        }
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(f);
+    return count;
+}
+#endif
+
+static void pin_topology_init(void) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+    enum { MAX_NODES = 64 };
+    static cpu_set_t nodes[MAX_NODES];
+    int node_count = 0;
+    for (int node = 0; node < MAX_NODES; node++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        if (parse_cpu_list(path, &allowed, &nodes[node_count]) > 0) {
+            node_count++;
+        }
+    }
+    if (node_count == 0) {
+        nodes[0] = allowed;
+        node_count = 1;
+    }
+    // Round-robin over the nodes, taking each node's CPUs in ascending order
+    int next[MAX_NODES] = {0};
+    for (int progress = 1; progress && pin_cpu_count < PARALLEL_MAX_PIN_CPUS;) {
+        progress = 0;
+        for (int n = 0; n < node_count && pin_cpu_count < PARALLEL_MAX_PIN_CPUS; n++) {
+            while (next[n] < CPU_SETSIZE && !CPU_ISSET(next[n], &nodes[n])) {
+                next[n]++;
+            }
+            if (next[n] < CPU_SETSIZE) {
+                pin_cpus[pin_cpu_count++] = next[n]++;
+                progress = 1;
+            }
+        }
+    }
+    pin_node_count = node_count;
+#endif
+}
+
+// Number of NUMA nodes workers are pinned across (1 on non-NUMA hosts, 0 where
+// PARALLEL_PIN_WORKERS is not supported)
+int parallel_numa_nodes(void) {
+    pthread_once(&pin_once, pin_topology_init);
+    return pin_cpu_count > 0 ? pin_node_count : 0;
+}
+
+static void pin_current_thread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set); // Best effort
+#else
+    (void)cpu;
+#endif
+}
+
+// Work shared by the pool: blocks are claimed by atomically bumping next_block
+typedef struct {
+    int codec;
+    int level;
+    int compress;
+    size_t block_count;
+    const char *const *in_ptrs; // per-block input
+    const size_t *in_lens;
+    char *const *out_ptrs;      // per-block output slot
+    const size_t *out_caps;
+    size_t *out_lens;
+    atomic_size_t next_block;
+    atomic_int error;           // first failure, CODEC_OK if none
+    codec_allocator allocator;  // the caller's, installed on the worker threads too
+    int flags;                  // PARALLEL_* options at the start of the call
+    int workers;                // threads the job was split for (PARALLEL_LOCAL_BLOCKS runs)
+    int started;                // of which spawned, set before the calling thread joins in
+} parallel_job;
+
+// One thread's share of a job; index 0 is the calling thread
+typedef struct {
+    parallel_job *job;
+    int index;
+    int cpu; // -1: leave the thread's affinity alone
+} parallel_worker_arg;
+
+static int parallel_resolve_threads(int threads, size_t block_count) {
+    if (threads <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (int)n : 1;
+    }
+    if ((size_t)threads > block_count) {
+        threads = block_count > 0 ? (int)block_count : 1;
+    }
+    return threads;
+}
+
+// Process one block of the job
+static int parallel_block(parallel_job *job, codec_ctx *ctx, size_t i) {
+    int rc;
+    if (job->compress) {
+        rc = codec_ctx_compress(ctx, job->in_ptrs[i], job->in_lens[i], job->out_ptrs[i], job->out_caps[i],
+                                &job->out_lens[i]);
+    } else {
+        rc = codec_ctx_decompress(ctx, job->in_ptrs[i], job->in_lens[i], job->out_ptrs[i], job->out_caps[i],
+                                  &job->out_lens[i]);
+        if (rc == CODEC_ERR_BUFFER_TOO_SMALL || (rc == CODEC_OK && job->out_lens[i] != job->out_caps[i])) {
+            rc = CODEC_ERR_CORRUPT; // Block does not hold exactly the expected byte count
+        }
+    }
+    return rc;
+}
+
+// PARALLEL_LOCAL_BLOCKS: worker `index` processes the contiguous run of blocks
+// [count * index / workers, count * (index + 1) / workers)
+static int parallel_local_run(parallel_job *job, codec_ctx *ctx, int index) {
+    size_t first = job->block_count * (size_t)index / (size_t)job->workers;
+    size_t last = job->block_count * (size_t)(index + 1) / (size_t)job->workers;
+    int rc = CODEC_OK;
+    for (size_t i = first; rc == CODEC_OK && i < last && atomic_load(&job->error) == CODEC_OK; i++) {
+        rc = parallel_block(job, ctx, i);
+    }
+    return rc;
+}
+
+static void *parallel_worker(void *arg) {
+    const parallel_worker_arg *w = (const parallel_worker_arg *)arg;
+    parallel_job *job = w->job;
+    if (w->cpu >= 0) {
+        pin_current_thread(w->cpu); // Before the context is allocated, so it lands on this node
+    }
+    codec_allocator saved = thread_allocator;
+    thread_allocator = job->allocator;
+    codec_ctx *ctx = codec_ctx_create(job->codec);
+    int rc = ctx == NULL ? CODEC_ERR_ALLOC : CODEC_OK;
+    if (rc == CODEC_OK && job->compress) {
+        rc = codec_ctx_set_level(ctx, job->level);
+    }
+
+    if (job->flags & PARALLEL_LOCAL_BLOCKS) {
+        if (rc == CODEC_OK) {
+            rc = parallel_local_run(job, ctx, w->index);
+        }
+        // The calling thread also takes the runs of workers that failed to start
+        for (int i = job->started + 1; w->index == 0 && rc == CODEC_OK && i < job->workers; i++) {
+            rc = parallel_local_run(job, ctx, i);
+        }
+    } else {
+        while (rc == CODEC_OK && atomic_load(&job->error) == CODEC_OK) {
+            size_t i = atomic_fetch_add(&job->next_block, 1);
+            if (i >= job->block_count) {
+                break;
+            }
+            rc = parallel_block(job, ctx, i);
+        }
+    }
+
+    if (rc != CODEC_OK) {
+        int expected = CODEC_OK;
+        atomic_compare_exchange_strong(&job->error, &expected, rc);
+    }
+    codec_ctx_destroy(ctx);
+    thread_allocator = saved;
+    return NULL;
+}
+
+// Run the job on `threads` threads (the calling thread is one of them)
+static int parallel_run(parallel_job *job, int threads) {
+    parallel_worker_arg caller = {job, 0, -1};
+    pthread_t *workers = NULL;
+    parallel_worker_arg *args = NULL;
+    int started = 0;
+    job->workers = threads;
+    job->started = 0;
+    if (threads > 1) {
+        size_t n = (size_t)(threads - 1);
+        workers = (pthread_t *)scratch_alloc(n * (sizeof(pthread_t) + sizeof(parallel_worker_arg)));
+        if (workers == NULL) {
+            return CODEC_ERR_ALLOC;
+        }
+        args = (parallel_worker_arg *)(workers + n);
+        int pin = (job->flags & PARALLEL_PIN_WORKERS) && parallel_numa_nodes() > 0;
+        for (; started < threads - 1; started++) {
+            // Spawned worker k takes the (k + 1)-th CPU of the interleaved order; the
+            // calling thread nominally has the first
+            args[started] = (parallel_worker_arg){job, started + 1, pin ? pin_cpus[(started + 1) % pin_cpu_count] : -1};
+            if (pthread_create(&workers[started], NULL, parallel_worker, &args[started]) != 0) {
+                break; // Carry on with the threads we have
+            }
+        }
+    }
+    job->started = started;
+    parallel_worker(&caller);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    scratch_free(workers);
+    return atomic_load(&job->error);
+}
+
+// Per-block pointer/length tables for a job, allocated in one piece
+typedef struct {
+    const char **in_ptrs;
+    size_t *in_lens;
+    char **out_ptrs;
+    size_t *out_caps;
+    size_t *out_lens;
+} parallel_tables;
+
+static int parallel_tables_alloc(parallel_tables *t, size_t block_count) {
+    size_t n = block_count > 0 ? block_count : 1;
+    char *mem = (char *)scratch_alloc(n * (2 * sizeof(char *) + 3 * sizeof(size_t)));
+    if (mem == NULL) {
+        return CODEC_ERR_ALLOC;
+    }
+    t->in_ptrs = (const char **)mem;
+    t->out_ptrs = (char **)(mem + n * sizeof(char *));
+    t->in_lens = (size_t *)(mem + 2 * n * sizeof(char *));
+    t->out_caps = t->in_lens + n;
+    t->out_lens = t->out_caps + n;
+    return CODEC_OK;
+}
+
+static void parallel_job_init(parallel_job *job, const parallel_tables *t, int codec, int level, int compress,
+                              size_t block_count) {
+    job->codec = codec;
+    job->level = level;
+    job->compress = compress;
+    job->block_count = block_count;
+    job->in_ptrs = t->in_ptrs;
+    job->in_lens = t->in_lens;
+    job->out_ptrs = t->out_ptrs;
+    job->out_caps = t->out_caps;
+    job->out_lens = t->out_lens;
+    atomic_init(&job->next_block, 0);
+    atomic_init(&job->error, CODEC_OK);
+    job->allocator = current_allocator();
+    job->flags = atomic_load(&parallel_flags);
+}
+
+// Worst-case container size for compress_parallel_into, or 0 if the input is too large
+// block_size of 0 selects parallel_default_block_size()
+size_t compress_parallel_bound(int codec, size_t input_len, size_t block_size) {
+    if (block_size == 0) {
+        block_size = parallel_default_block_size();
+    }
+    size_t block_count = input_len / block_size + (input_len % block_size != 0);
+    size_t full_bound = codec_compress_bound(codec, block_size);
+    size_t last_len = input_len - (block_count > 0 ? (block_count - 1) * block_size : 0);
+    size_t last_bound = codec_compress_bound(codec, last_len);
+    if (full_bound == 0 || last_bound == 0) {
+        return 0;
+    }
+    size_t per_block = full_bound + MAX_VARINT_LEN;
+    if (block_count > 1 && (block_count - 1) > (SIZE_MAX - PARALLEL_FIXED_HEADER - last_bound) / per_block) {
+        return 0;
+    }
+    return PARALLEL_FIXED_HEADER + (block_count > 0 ? (block_count - 1) * per_block + last_bound + MAX_VARINT_LEN : 0);
+}
+
+// Compress input into a block-parallel container using `threads` workers
+// threads <= 0 uses one per online CPU; block_size of 0 selects parallel_default_block_size()
+// out_cap must be at least compress_parallel_bound(codec, in_len, block_size), since
+// blocks are compressed in place into worst-case slots and then compacted
+// Returns CODEC_OK or a negative CODEC_ERR_* code
+int compress_parallel_into(int codec, int level, int threads, size_t block_size, const char *input,
+                           size_t input_len, char *output, size_t output_cap, size_t *output_len) {
+    if (check_into_args(input, input_len, output, output_cap, output_len) != CODEC_OK) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    int min_level, max_level;
+    if (codec_level_range(codec, &min_level, &max_level) != CODEC_OK || level < min_level || level > max_level) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    if (block_size == 0) {
+        block_size = parallel_default_block_size();
+    }
+    size_t bound = compress_parallel_bound(codec, input_len, block_size);
+    if (bound == 0) {
+        return CODEC_ERR_TOO_LARGE;
+    }
+    if (output_cap < bound) {
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+
+    size_t block_count = input_len / block_size + (input_len % block_size != 0);
+    parallel_tables t;
+    if (parallel_tables_alloc(&t, block_count) != CODEC_OK) {
+        return CODEC_ERR_ALLOC;
+    }
+
+    // Lay out worst-case slots after room for the largest possible header and index
+    size_t full_bound = codec_compress_bound(codec, block_size);
+    char *slot = output + PARALLEL_FIXED_HEADER + block_count * MAX_VARINT_LEN;
+    for (size_t i = 0; i < block_count; i++) {
+        t.in_ptrs[i] = input + i * block_size;
+        t.in_lens[i] = i + 1 < block_count ? block_size : input_len - i * block_size;
+        t.out_ptrs[i] = slot;
+        t.out_caps[i] = i + 1 < block_count ? full_bound : codec_compress_bound(codec, t.in_lens[i]);
+        slot += t.out_caps[i];
+    }
+
+    parallel_job job;
+    parallel_job_init(&job, &t, codec, level, 1, block_count);
+    int rc = parallel_run(&job, parallel_resolve_threads(threads, block_count));
+    if (rc != CODEC_OK) {
+        scratch_free(t.in_ptrs);
+        return rc;
+    }
+
+    // Write the header and index, then slide each block down behind it. Every block's
+    // final offset is at or below its slot, so moving them in order never overlaps
+    // data that has not been moved yet.
+    size_t pos = 0;
+    memcpy(output, PARALLEL_MAGIC, PARALLEL_MAGIC_LEN);
+    pos += PARALLEL_MAGIC_LEN;
+    output[pos++] = PARALLEL_VERSION;
+    output[pos++] = (char)codec;
+    pos += encode_varint((unsigned long)input_len, output + pos);
+    pos += encode_varint((unsigned long)block_size, output + pos);
+    pos += encode_varint((unsigned long)block_count, output + pos);
+    for (size_t i = 0; i < block_count; i++) {
+        pos += encode_varint((unsigned long)t.out_lens[i], output + pos);
+    }
+    for (size_t i = 0; i < block_count; i++) {
+        memmove(output + pos, t.out_ptrs[i], t.out_lens[i]);
+        pos += t.out_lens[i];
+    }
+
+    scratch_free(t.in_ptrs);
+    *output_len = pos;
+    return CODEC_OK;
+}
+
+// Parse the container header; on success fills the fields and returns the offset of the
+// block index, or -1 if the header is malformed
+static int parse_parallel_header(const char *input, size_t input_len, int *codec, size_t *original_len,
+                                 size_t *block_size, size_t *block_count) {
+    if (input == NULL || input_len < PARALLEL_MAGIC_LEN + 2 ||
+        memcmp(input, PARALLEL_MAGIC, PARALLEL_MAGIC_LEN) != 0 ||
+        input[PARALLEL_MAGIC_LEN] != PARALLEL_VERSION) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Invalid parallel container: bad magic or version\n");
+        #endif
+        return -1;
+    }
+    *codec = (unsigned char)input[PARALLEL_MAGIC_LEN + 1];
+    if (*codec != CODEC_ZLIB && *codec != CODEC_LZ4 && *codec != CODEC_ZSTD) {
+        return -1;
+    }
+
+    size_t pos = PARALLEL_MAGIC_LEN + 2;
+    unsigned long fields[3];
+    for (int f = 0; f < 3; f++) {
+        size_t remaining = input_len - pos;
+        int n = decode_varint(input + pos, remaining < MAX_VARINT_LEN ? (int)remaining : MAX_VARINT_LEN, &fields[f]);
+        if (n <= 0) {
+            #ifdef DEBUG_FUZZING
+            fprintf(stderr, "Invalid parallel container: malformed header varint\n");
+            #endif
+            return -1;
+        }
+        pos += n;
+    }
+    *original_len = fields[0];
+    *block_size = fields[1];
+    *block_count = fields[2];
+
+    // The block count is implied by the lengths; reject anything inconsistent before
+    // it is used to size allocations
+    if (*block_size == 0 ||
+        *block_count != *original_len / *block_size + (*original_len % *block_size != 0) ||
+        *block_count > input_len - pos) { // Every block needs at least one index byte
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Invalid parallel container: inconsistent block layout\n");
+        #endif
+        return -1;
+    }
+    return (int)pos;
+}
+
+// Read the original length from a block-parallel container header
+// Returns CODEC_OK, or CODEC_ERR_CORRUPT if the input is not a valid container header
+int parallel_decompressed_length(const char *input, size_t input_len, size_t *original_len) {
+    int codec;
+    size_t block_size, block_count;
+    if (original_len == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    if (parse_parallel_header(input, input_len, &codec, original_len, &block_size, &block_count) < 0) {
+        return CODEC_ERR_CORRUPT;
+    }
+    return CODEC_OK;
+}
+
+// Decompress a block-parallel container using `threads` workers (<= 0: one per CPU)
+// On CODEC_ERR_BUFFER_TOO_SMALL, *out_len is set to the required size
+// Returns CODEC_OK or a negative CODEC_ERR_* code
+int decompress_parallel_into(int threads, const char *input, size_t input_len, char *output, size_t output_cap,
+                             size_t *output_len) {
+    if (check_into_args(input, input_len, output, output_cap, output_len) != CODEC_OK) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    int codec;
+    size_t original_len, block_size, block_count;
+    int index_pos = parse_parallel_header(input, input_len, &codec, &original_len, &block_size, &block_count);
+    if (index_pos < 0) {
+        return CODEC_ERR_CORRUPT;
+    }
+    if (original_len > output_cap) {
+        *output_len = original_len;
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+
+    parallel_tables t;
+    if (parallel_tables_alloc(&t, block_count) != CODEC_OK) {
+        return CODEC_ERR_ALLOC;
+    }
+
+    // First pass: read the index and check the blocks exactly cover the rest of the input
+    size_t pos = (size_t)index_pos;
+    for (size_t i = 0; i < block_count; i++) {
+        unsigned long block_len;
+        size_t remaining = input_len - pos;
+        int n = decode_varint(input + pos, remaining < MAX_VARINT_LEN ? (int)remaining : MAX_VARINT_LEN, &block_len);
+        if (n <= 0) {
+            scratch_free(t.in_ptrs);
+            return CODEC_ERR_CORRUPT;
+        }
+        pos += n;
+        t.in_lens[i] = block_len;
+    }
+    for (size_t i = 0; i < block_count; i++) {
+        if (t.in_lens[i] > input_len - pos) {
+            #ifdef DEBUG_FUZZING
+            fprintf(stderr, "Invalid parallel container: block %zu extends past the input\n", i);
+            #endif
+            scratch_free(t.in_ptrs);
+            return CODEC_ERR_CORRUPT;
+        }
+        t.in_ptrs[i] = input + pos;
+        pos += t.in_lens[i];
+        t.out_ptrs[i] = output + i * block_size;
+        t.out_caps[i] = i + 1 < block_count ? block_size : original_len - i * block_size;
+    }
+    if (pos != input_len) {
+        scratch_free(t.in_ptrs);
+        return CODEC_ERR_CORRUPT;
+    }
+
+    parallel_job job;
+    parallel_job_init(&job, &t, codec, 0, 0, block_count);
+    int rc = parallel_run(&job, parallel_resolve_threads(threads, block_count));
+    scratch_free(t.in_ptrs);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = original_len;
+    return CODEC_OK;
+}
+
+// Allocating variant of compress_parallel_into
+// The caller is responsible for freeing the returned buffer with free_compressed_data
+CompressedData compress_parallel(int codec, int level, int threads, const char *input, unsigned long input_len) {
+    CompressedData result = {NULL, 0};
+    size_t bound = compress_parallel_bound(codec, input_len, 0);
+    if (bound == 0) {
+        return result;
+    }
+    char *output_buffer = buffer_alloc(bound);
+    if (output_buffer == NULL) {
+        perror("Failed to allocate memory for parallel compression");
+        return result;
+    }
+    size_t output_len;
+    if (compress_parallel_into(codec, level, threads, 0, input, input_len, output_buffer, bound, &output_len) != CODEC_OK) {
+        buffer_free(output_buffer);
+        return result;
+    }
+    result.buffer = output_buffer;
+    result.length = output_len;
+    return result;
+}
+
+// Allocating variant of decompress_parallel_into, subject to MAX_DECOMPRESSED_SIZE
+// The returned buffer is null-terminated; free it with free_decompressed_data
+DecompressedData decompress_parallel(int threads, const char *input, unsigned long input_len) {
+    DecompressedData result = {NULL, 0};
+    size_t original_len;
+    if (parallel_decompressed_length(input, input_len, &original_len) != CODEC_OK) {
+        return result;
+    }
+    if (original_len > MAX_DECOMPRESSED_SIZE) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Invalid parallel container: original length too large (%zu bytes)\n", original_len);
+        #endif
+        STATS_COUNT(over_size_cap);
+        return result;
+    }
+    char *output_buffer = buffer_alloc(original_len + 1);
+    if (output_buffer == NULL) {
+        perror("Failed to allocate memory for parallel decompression");
+        return result;
+    }
+    size_t output_len;
+    if (decompress_parallel_into(threads, input, input_len, output_buffer, original_len, &output_len) != CODEC_OK) {
+        buffer_free(output_buffer);
+        return result;
+    }
+    output_buffer[output_len] = '\0';
+    result.buffer = output_buffer;
+    result.length = output_len;
+    return result;
+}
+
+// Random access into block-parallel containers
+//
+// Blocks are compressed independently, so any byte range of the original data can be
+// served by decoding only the blocks that overlap it. A range_reader resolves the block
+// index to absolute offsets once; each read is then O(blocks touched) regardless of the
+// container size.
+
+typedef struct range_reader {
+    int codec;
+    size_t original_len;
+    size_t block_size;
+    size_t block_count;
+    const char *input;
+    size_t *block_offsets; // block_count + 1 offsets into input; block i spans [i], [i + 1]
+    codec_ctx *ctx;
+    char *scratch;         // one decoded block, for blocks only partly inside a range
+    codec_allocator allocator;
+} range_reader;
+
+void range_reader_close(range_reader *r);
+
+// Open a reader over a block-parallel container; input must stay valid until
+// range_reader_close. Returns NULL if the container is malformed or allocation fails
+range_reader *range_reader_open(const char *input, size_t input_len) {
+    int codec;
+    size_t original_len, block_size, block_count;
+    int index_pos = parse_parallel_header(input, input_len, &codec, &original_len, &block_size, &block_count);
+    if (index_pos < 0) {
+        return NULL;
+    }
+    codec_allocator a = current_allocator();
+    range_reader *r = (range_reader *)alloc_with(&a, sizeof(range_reader));
+    if (r == NULL) {
+        perror("Failed to allocate range reader");
+        return NULL;
+    }
+    memset(r, 0, sizeof(*r));
+    r->allocator = a;
+    r->codec = codec;
+    r->original_len = original_len;
+    r->block_size = block_size;
+    r->block_count = block_count;
+    r->input = input;
+    r->block_offsets = (size_t *)alloc_with(&a, (block_count + 1) * sizeof(size_t));
+    r->ctx = codec_ctx_create(codec);
+    if (r->block_offsets == NULL || r->ctx == NULL) {
+        perror("Failed to allocate range reader");
+        range_reader_close(r);
+        return NULL;
+    }
+
+    // Same checks as decompress_parallel_into: the blocks must exactly cover the input
+    size_t pos = (size_t)index_pos;
+    for (size_t i = 0; i < block_count; i++) {
+        unsigned long block_len;
+        size_t remaining = input_len - pos;
+        int n = decode_varint(input + pos, remaining < MAX_VARINT_LEN ? (int)remaining : MAX_VARINT_LEN, &block_len);
+        if (n <= 0) {
+            range_reader_close(r);
+            return NULL;
+        }
+        pos += n;
+        r->block_offsets[i + 1] = block_len; // lengths for now, turned into offsets below
+    }
+    r->block_offsets[0] = pos;
+    for (size_t i = 0; i < block_count; i++) {
+        if (r->block_offsets[i + 1] > input_len - r->block_offsets[i]) {
+            #ifdef DEBUG_FUZZING
+            fprintf(stderr, "Invalid parallel container: block %zu extends past the input\n", i);
+            #endif
+            range_reader_close(r);
+            return NULL;
+        }
+        r->block_offsets[i + 1] += r->block_offsets[i];
+    }
+    if (r->block_offsets[block_count] != input_len) {
+        range_reader_close(r);
+        return NULL;
+    }
+    return r;
+}
+
+// Original (decompressed) size of the container, or 0 for NULL
+size_t range_reader_size(const range_reader *r) {
+    return r == NULL ? 0 : r->original_len;
+}
+
+// Decode block i, or only the part [skip, skip + len) of it, to output
+static int range_read_block(range_reader *r, size_t i, size_t skip, size_t len, char *output) {
+    size_t block_len = i + 1 < r->block_count ? r->block_size : r->original_len - i * r->block_size;
+    const char *block = r->input + r->block_offsets[i];
+    size_t compressed_len = r->block_offsets[i + 1] - r->block_offsets[i];
+    size_t out_len;
+    if (skip == 0 && len == block_len) {
+        int rc = codec_ctx_decompress(r->ctx, block, compressed_len, output, len, &out_len);
+        return rc == CODEC_OK && out_len != len ? CODEC_ERR_CORRUPT : rc;
+    }
+    if (r->scratch == NULL) {
+        // A lone block may be shorter than the (untrusted) block size
+        r->scratch = (char *)alloc_with(&r->allocator, r->block_count > 1 ? r->block_size : r->original_len);
+        if (r->scratch == NULL) {
+            perror("Failed to allocate range reader block buffer");
+            return CODEC_ERR_ALLOC;
+        }
+    }
+    int rc = codec_ctx_decompress(r->ctx, block, compressed_len, r->scratch, block_len, &out_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    if (out_len != block_len) {
+        return CODEC_ERR_CORRUPT;
+    }
+    memcpy(output, r->scratch + skip, len);
+    return CODEC_OK;
+}
+
+// Decompress original bytes [offset, offset + len) into output, decoding only the
+// blocks that overlap them. A range past the end is cut short (*output_len says how
+// much was read); offset beyond the end is CODEC_ERR_INVALID_ARG.
+// On CODEC_ERR_BUFFER_TOO_SMALL, *output_len is set to the required size
+int range_reader_read(range_reader *r, size_t offset, size_t len, char *output, size_t output_cap,
+                      size_t *output_len) {
+    if (r == NULL || check_into_args(NULL, 0, output, output_cap, output_len) != CODEC_OK) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    *output_len = 0;
+    if (offset > r->original_len) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    if (len > r->original_len - offset) {
+        len = r->original_len - offset;
+    }
+    if (len > output_cap) {
+        *output_len = len;
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        size_t pos = offset + done;
+        size_t i = pos / r->block_size;
+        size_t skip = pos - i * r->block_size;
+        size_t block_len = i + 1 < r->block_count ? r->block_size : r->original_len - i * r->block_size;
+        size_t n = block_len - skip < len - done ? block_len - skip : len - done;
+        int rc = range_read_block(r, i, skip, n, output + done);
+        if (rc != CODEC_OK) {
+            return rc;
+        }
+        done += n;
+    }
+    *output_len = len;
+    return CODEC_OK;
+}
+
+// Free a reader. NULL is ignored
+void range_reader_close(range_reader *r) {
+    if (r == NULL) {
+        return;
+    }
+    codec_ctx_destroy(r->ctx);
+    codec_allocator a = r->allocator;
+    free_with(&a, r->block_offsets);
+    free_with(&a, r->scratch);
+    free_with(&a, r);
+}
+
+// One-shot range read: range_reader_read on a temporary reader
+// Parses the block index on every call; keep a range_reader open for repeated reads
+int read_range(const char *input, size_t input_len, size_t offset, size_t len, char *output, size_t output_cap,
+               size_t *output_len) {
+    if (check_into_args(input, input_len, output, output_cap, output_len) != CODEC_OK) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    *output_len = 0;
+    range_reader *r = range_reader_open(input, input_len);
+    if (r == NULL) {
+        return CODEC_ERR_CORRUPT;
+    }
+    int rc = range_reader_read(r, offset, len, output, output_cap, output_len);
+    range_reader_close(r);
+    return rc;
+}
+
+// Lazy record reader
+//
+// Many payloads are a sequence of records, each prefixed with its varint length. A
+// record_reader hands them out one at a time from a compress_string* blob, decoding the
+// payload on demand into a small window, so a scan that stops after the first N records
+// only decompresses about that much. zlib and zstd payloads run through a codec_stream
+// and the window slides: it only ever has to hold the largest record. LZ4 blocks cannot
+// be resumed part-way, so the window is a prefix of the data decoded with
+// LZ4_decompress_safe_partial and regrown whenever a record runs past it; the last
+// refill decodes the block in full so the end of the input is still checked.
+
+#define RECORD_END 1                      // record_reader_next: every record has been read
+#define RECORD_WINDOW_DEFAULT (64 * 1024) // window size when record_reader_open gets 0
+#define RECORD_LZ4_GROWTH 4               // LZ4 prefix growth per refill
+
+typedef struct record_reader {
+    int codec;
+    const char *payload; // compressed bytes after the varint length header
+    size_t payload_len;
+    size_t payload_pos;  // payload bytes fed to the stream so far
+    size_t original_len;
+    size_t decoded;      // original bytes decoded so far
+    size_t consumed;     // original bytes handed out as records (and their prefixes)
+    codec_stream *stream; // zlib and zstd only
+    char *window;
+    size_t window_cap;
+    size_t start;        // window[start, end) holds decoded bytes not yet handed out
+    size_t end;
+    int status;          // sticky RECORD_END or CODEC_ERR_* once the reader stops
+    codec_allocator allocator;
+} record_reader;
+
+void record_reader_close(record_reader *r);
+
+// Open a reader over the output of compress_string* / codec_ctx_compress for codec
+// (without a dictionary); input must stay valid until record_reader_close. window is
+// the initial window size (0 = 64 KiB); it grows when a record does not fit.
+// Returns NULL for invalid arguments, a malformed header or on allocation failure
+record_reader *record_reader_open(int codec, const char *input, size_t input_len, size_t window) {
+    if (codec != CODEC_ZLIB && codec != CODEC_LZ4 && codec != CODEC_ZSTD) {
+        return NULL;
+    }
+    unsigned long original_len;
+    int header_size = parse_length_header(input, input_len, &original_len, "record ");
+    if (header_size < 0) {
+        return NULL;
+    }
+    if (codec == CODEC_LZ4 && (original_len > LZ4_MAX_INPUT_SIZE || input_len - header_size > (size_t)INT32_MAX)) {
+        return NULL;
+    }
+    codec_allocator a = current_allocator();
+    record_reader *r = (record_reader *)alloc_with(&a, sizeof(record_reader));
+    if (r == NULL) {
+        perror("Failed to allocate record reader");
+        return NULL;
+    }
+    memset(r, 0, sizeof(*r));
+    r->allocator = a;
+    r->codec = codec;
+    r->payload = input + header_size;
+    r->payload_len = input_len - header_size;
+    r->original_len = original_len;
+    r->window_cap = window > 0 ? window : RECORD_WINDOW_DEFAULT;
+    if (r->window_cap < MAX_VARINT_LEN) {
+        r->window_cap = MAX_VARINT_LEN;
+    }
+    if (codec == CODEC_LZ4 && r->window_cap > original_len) {
+        r->window_cap = original_len > 0 ? original_len : 1;
+    }
+    r->window = (char *)alloc_with(&a, r->window_cap);
+    if (codec != CODEC_LZ4) {
+        r->stream = stream_begin(codec, STREAM_DECOMPRESS, 0);
+    }
+    if (r->window == NULL || (codec != CODEC_LZ4 && r->stream == NULL)) {
+        perror("Failed to allocate record reader");
+        record_reader_close(r);
+        return NULL;
+    }
+    return r;
+}
+
+// Make room for cap bytes in the window, keeping window[0, keep)
+static int record_window_reserve(record_reader *r, size_t cap, size_t keep) {
+    if (cap <= r->window_cap) {
+        return CODEC_OK;
+    }
+    char *grown = (char *)alloc_with(&r->allocator, cap);
+    if (grown == NULL) {
+        perror("Failed to grow record reader window");
+        return CODEC_ERR_ALLOC;
+    }
+    memcpy(grown, r->window, keep);
+    free_with(&r->allocator, r->window);
+    r->window = grown;
+    r->window_cap = cap;
+    return CODEC_OK;
+}
+
+// Decode an LZ4 prefix of at least want bytes into the window. Each refill decodes the
+// whole prefix again, so it grows by RECORD_LZ4_GROWTH to keep that to a third extra
+static int record_fill_lz4(record_reader *r, size_t want) {
+    size_t target = r->decoded > want / RECORD_LZ4_GROWTH ? r->decoded * RECORD_LZ4_GROWTH : want;
+    if (target < r->window_cap) {
+        target = r->window_cap;
+    }
+    if (target > r->original_len) {
+        target = r->original_len;
+    }
+    int rc = record_window_reserve(r, target, 0); // Decoded again from the start
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    uint64_t start = stats_clock();
+    int n;
+    if (target == r->original_len) {
+        n = LZ4_decompress_safe(r->payload, r->window, (int)r->payload_len, (int)target);
+    } else {
+        n = LZ4_decompress_safe_partial(r->payload, r->window, (int)r->payload_len, (int)target, (int)target);
+    }
+    rc = n < 0 || (size_t)n != target ? CODEC_ERR_CORRUPT : CODEC_OK;
+    stats_record(CODEC_LZ4, CODEC_STATS_DECOMPRESS, r->payload_len, rc == CODEC_OK ? target : 0, rc, start);
+    if (rc == CODEC_OK) {
+        r->decoded = target;
+        r->end = target;
+    }
+    return rc;
+}
+
+// Stream zlib/zstd output into the window until it holds want unread bytes or is full
+static int record_fill_stream(record_reader *r, size_t want) {
+    size_t pending = r->end - r->start;
+    if (r->window_cap - r->start < want) {
+        // Slide the unread bytes to the front, growing the window for a large record
+        memmove(r->window, r->window + r->start, pending);
+        r->start = 0;
+        r->end = pending;
+        int rc = record_window_reserve(r, want, pending);
+        if (rc != CODEC_OK) {
+            return rc;
+        }
+    }
+    while (r->end - r->start < want) {
+        size_t in_consumed, out_len;
+        int rc = stream_update(r->stream, r->payload + r->payload_pos, r->payload_len - r->payload_pos,
+                               &in_consumed, r->window + r->end, r->window_cap - r->end, &out_len);
+        if (rc < 0) {
+            return rc;
+        }
+        r->payload_pos += in_consumed;
+        r->end += out_len;
+        r->decoded += out_len;
+        if (r->decoded > r->original_len) {
+            return CODEC_ERR_CORRUPT;
+        }
+        if (rc == CODEC_OK && out_len == 0) {
+            return CODEC_ERR_CORRUPT; // All input used without reaching the frame end
+        }
+        if (rc == STREAM_FRAME_END) {
+            break;
+        }
+    }
+    return CODEC_OK;
+}
+
+// Make window[start, start + want) valid, within the original data
+static int record_fill(record_reader *r, size_t want) {
+    if (r->end - r->start >= want) {
+        return CODEC_OK;
+    }
+    int rc = r->codec == CODEC_LZ4 ? record_fill_lz4(r, r->start + want) : record_fill_stream(r, want);
+    if (rc == CODEC_OK && r->end - r->start < want) {
+        rc = CODEC_ERR_CORRUPT; // Payload ended before the original length
+    }
+    return rc;
+}
+
+// After the last record: the payload must end exactly at the original length
+static int record_finish(record_reader *r) {
+    if (r->codec == CODEC_LZ4) {
+        // Only the final full decode checks the end of the block
+        return r->original_len == 0 || r->decoded == r->original_len ? CODEC_OK : record_fill_lz4(r, r->original_len);
+    }
+    char extra;
+    size_t in_consumed, out_len;
+    int rc = stream_update(r->stream, r->payload + r->payload_pos, r->payload_len - r->payload_pos, &in_consumed,
+                           &extra, 1, &out_len);
+    if (rc < 0) {
+        return rc;
+    }
+    r->payload_pos += in_consumed;
+    return rc == STREAM_FRAME_END && out_len == 0 && r->payload_pos == r->payload_len ? CODEC_OK : CODEC_ERR_CORRUPT;
+}
+
+// Return the next record in *record / *record_len; the pointer is into the reader's
+// window and stays valid until the next call or record_reader_close
+// Returns CODEC_OK, RECORD_END after the last record, or a negative CODEC_ERR_* code;
+// once it returns anything but CODEC_OK it keeps returning the same value
+int record_reader_next(record_reader *r, const char **record, size_t *record_len) {
+    if (r == NULL || record == NULL || record_len == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    *record = NULL;
+    *record_len = 0;
+    if (r->status != CODEC_OK) {
+        return r->status;
+    }
+    size_t remaining = r->original_len - r->consumed;
+    if (remaining == 0) {
+        int rc = record_finish(r);
+        r->status = rc == CODEC_OK ? RECORD_END : rc;
+        return r->status;
+    }
+
+    int rc = record_fill(r, remaining < MAX_VARINT_LEN ? remaining : MAX_VARINT_LEN);
+    unsigned long len = 0;
+    int prefix = 0;
+    if (rc == CODEC_OK) {
+        size_t avail = r->end - r->start;
+        prefix = decode_varint(r->window + r->start, avail < MAX_VARINT_LEN ? (int)avail : MAX_VARINT_LEN, &len);
+        if (prefix <= 0 || len > remaining - prefix) {
+            rc = CODEC_ERR_CORRUPT; // Bad prefix, or a record running past the data
+        }
+    }
+    if (rc == CODEC_OK) {
+        rc = record_fill(r, prefix + len);
+    }
+    if (rc != CODEC_OK) {
+        #ifdef DEBUG_FUZZING
+        fprintf(stderr, "Record reader failed at offset %zu: %d\n", r->consumed, rc);
         #endif
-        free(output_buffer);
-        return result; // Return empty result
+        r->status = rc;
+        return rc;
     }
+    *record = r->window + r->start + prefix;
+    *record_len = len;
+    r->start += prefix + len;
+    r->consumed += prefix + len;
+    return CODEC_OK;
+}
 
-    result.buffer = output_buffer;
-    result.length = header_size + compressed_data_size; // Header + compressed data
-    return result;
+// Free a reader. NULL is ignored
+void record_reader_close(record_reader *r) {
+    if (r == NULL) {
+        return;
+    }
+    stream_destroy(r->stream);
+    codec_allocator a = r->allocator;
+    free_with(&a, r->window);
+    free_with(&a, r);
 }
 
-// Function to decompress data using Zstandard (zstd), automatically reading original size from varint header
-// Expects input format: [varint original length][ZSTD compressed data]
-// The caller is responsible for freeing the returned buffer
-DecompressedData decompress_data_zstd(const char *input, unsigned long input_len) {
-    DecompressedData result = {NULL, 0};
+// Self-describing frames
+//
+// A frame records which codec produced it, so readers no longer need to know the codec
+// out of band and the wrong decoder is never run on the payload. Format:
+//   ["RFFR"][version=1][codec][flags][varint body_len][crc32c, 4 bytes LE if FRAME_CHECKSUM]
+//   [body]
+// body is exactly one codec_ctx_compress output: [varint original length][payload], with
+// the dictionary ID after the length when FRAME_DICT is set. CODEC_STORED frames carry the
+// data as-is: [varint original length][original bytes]. The checksum is CRC32C
+// (Castagnoli) of the original data, verified after decompression unless the decoding
+// context has codec_ctx_set_verify(ctx, 0).
+//
+// The checksum is computed in the same pass as the data is handled where the codec
+// allows it: stored bodies checksum while copying, and zlib (both ways) and zstd
+// decoding checksum each cache-sized slice inside their loops. LZ4, whose block API
+// works on whole buffers, and zstd compression use a separate hardware-CRC pass.
+//
+// Whatever codec is asked for, a frame is written as CODEC_STORED when that is no larger:
+// inputs under FRAME_STORE_BELOW bytes skip the codec (they cannot win back its headers)
+// unless a dictionary is attached, and any input the codec expands is stored instead.
+// Stored frames decode with a memcpy, or none at all through frame_stored_view.
 
-    // Check minimum input size (at least 1 byte for varint + some compressed data)
-    if (input_len < 2) {
+#define FRAME_MAGIC "RFFR"
+#define FRAME_MAGIC_LEN 4
+#define FRAME_VERSION 1
+#define FRAME_FIXED_HEADER (FRAME_MAGIC_LEN + 3)
+#define FRAME_CHECKSUM_LEN 4
+#define FRAME_MAX_HEADER (FRAME_FIXED_HEADER + MAX_VARINT_LEN + FRAME_CHECKSUM_LEN)
+
+#define FRAME_CHECKSUM 1 // store and verify a CRC32C of the original data
+#define FRAME_DICT 2     // body was compressed with a dictionary (set by the library)
+#define FRAME_KNOWN_FLAGS (FRAME_CHECKSUM | FRAME_DICT)
+
+#define FRAME_STORE_BELOW 64 // Inputs shorter than this are stored without running the codec
+
+typedef struct {
+    int codec;
+    int flags;
+    size_t original_len;
+    size_t frame_len; // header + body, i.e. the offset of the next frame in a concatenation
+} FrameInfo;
+
+// Size of a CODEC_STORED frame body, or 0 if it would overflow size_t
+static size_t stored_body_len(size_t input_len) {
+    if (input_len > SIZE_MAX - FRAME_MAX_HEADER - MAX_VARINT_LEN) {
+        return 0;
+    }
+    return varint_len(input_len) + input_len;
+}
+
+// Worst-case output size of compress_frame_into, or 0 if input_len is too large for codec
+// CODEC_AUTO gives the bound for whatever compress_frame_auto_into may choose; the zstd
+// bound already covers a stored body
+size_t frame_compress_bound(int codec, size_t input_len) {
+    size_t bound;
+    if (codec == CODEC_STORED) {
+        bound = stored_body_len(input_len);
+    } else if (codec == CODEC_AUTO) {
+        size_t lz4 = codec_compress_bound(CODEC_LZ4, input_len);
+        bound = codec_compress_bound(CODEC_ZSTD, input_len);
+        if (bound != 0 && lz4 > bound) {
+            bound = lz4;
+        }
+    } else {
+        bound = codec_compress_bound(codec, input_len);
+    }
+    return bound == 0 ? 0 : bound + FRAME_MAX_HEADER;
+}
+
+// Write the CODEC_STORED body of input to output: [varint input_len][input], folding
+// the copy into the checksum when fused is set
+static int frame_store_body(const char *input, size_t input_len, char *output, size_t output_cap,
+                            size_t *body_len, fused_checksum *fused) {
+    uint64_t start = stats_clock();
+    *body_len = stored_body_len(input_len);
+    if (*body_len == 0 || *body_len > output_cap) {
+        stats_record(CODEC_STORED, CODEC_STATS_COMPRESS, input_len, 0, CODEC_ERR_BUFFER_TOO_SMALL, start);
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+    int header_size = write_length_header(input_len, output, output_cap);
+    if (fused != NULL) {
+        fused->crc = crc32c_copy(0, output + header_size, input, input_len);
+        fused->done = 1;
+    } else {
+        memcpy(output + header_size, input, input_len);
+    }
+    stats_record(CODEC_STORED, CODEC_STATS_COMPRESS, input_len, *body_len, CODEC_OK, start);
+    return CODEC_OK;
+}
+
+// Compress through ctx, or store the input as-is if ctx is NULL (or storing is no larger),
+// and wrap the result in a frame header
+// The body is written after room for the largest header it could need and moved down
+// only if its length varint turned out shorter
+static int frame_compress(codec_ctx *ctx, int flags, const char *input, size_t input_len, char *output,
+                          size_t output_cap, size_t *output_len) {
+    if ((flags & ~FRAME_CHECKSUM) != 0) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+    if (ctx != NULL && ctx->dict == NULL && input_len < FRAME_STORE_BELOW) {
+        ctx = NULL;
+    }
+    int codec = ctx != NULL ? ctx->codec : CODEC_STORED;
+    size_t body_bound = ctx != NULL ? codec_compress_bound(codec, input_len) : stored_body_len(input_len);
+    if (body_bound == 0) {
+        return CODEC_ERR_TOO_LARGE;
+    }
+    size_t checksum_len = (flags & FRAME_CHECKSUM) ? FRAME_CHECKSUM_LEN : 0;
+    size_t reserved = FRAME_FIXED_HEADER + varint_len(body_bound) + checksum_len;
+    if (reserved > output_cap) {
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+    size_t body_len;
+    int dict_flag = 0;
+    fused_checksum sum = {0, 0};
+    fused_checksum *fused = checksum_len > 0 ? &sum : NULL;
+    if (ctx != NULL) {
+        ctx->fused = fused;
+        rc = codec_ctx_compress(ctx, input, input_len, output + reserved, output_cap - reserved, &body_len);
+        ctx->fused = NULL;
+        // Output larger than the stored body, or too large for a buffer the stored body
+        // fits in: the codec expanded the input, so store it instead
+        size_t stored_len = stored_body_len(input_len);
+        if ((rc == CODEC_OK && body_len >= stored_len) ||
+            (rc == CODEC_ERR_BUFFER_TOO_SMALL && stored_len != 0 && stored_len <= output_cap - reserved)) {
+            codec = CODEC_STORED;
+            // A checksum zlib already folded in need not be taken again while copying
+            rc = frame_store_body(input, input_len, output + reserved, output_cap - reserved, &body_len,
+                                  sum.done ? NULL : fused);
+        } else if (ctx->dict != NULL) {
+            dict_flag = FRAME_DICT;
+        }
+    } else {
+        rc = frame_store_body(input, input_len, output + reserved, output_cap - reserved, &body_len, fused);
+    }
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+
+    char header[FRAME_MAX_HEADER];
+    memcpy(header, FRAME_MAGIC, FRAME_MAGIC_LEN);
+    header[FRAME_MAGIC_LEN] = FRAME_VERSION;
+    header[FRAME_MAGIC_LEN + 1] = (char)codec;
+    header[FRAME_MAGIC_LEN + 2] = (char)(flags | dict_flag);
+    size_t header_len = FRAME_FIXED_HEADER + encode_varint((unsigned long)body_len, header + FRAME_FIXED_HEADER);
+    if (checksum_len > 0) {
+        uint32_t crc = sum.done ? sum.crc : crc32c(input, input_len);
+        for (int i = 0; i < FRAME_CHECKSUM_LEN; i++) {
+            header[header_len++] = (char)(crc >> (8 * i));
+        }
+    }
+    if (header_len < reserved) {
+        memmove(output + header_len, output + reserved, body_len);
+    }
+    memcpy(output, header, header_len);
+    *output_len = header_len + body_len;
+    return CODEC_OK;
+}
+
+// Compress into a self-describing frame at an explicit level
+// flags may contain FRAME_CHECKSUM. CODEC_STORED ignores level and copies the input; the
+// other codecs fall back to it for tiny or incompressible input (see above).
+// Returns CODEC_OK or a negative CODEC_ERR_* code
+int compress_frame_into(int codec, int level, int flags, const char *input, size_t input_len, char *output,
+                        size_t output_cap, size_t *output_len) {
+    if (codec == CODEC_STORED) {
+        return frame_compress(NULL, flags, input, input_len, output, output_cap, output_len);
+    }
+    codec_ctx *ctx = codec_ctx_create(codec);
+    if (ctx == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    int rc = codec_ctx_set_level(ctx, level);
+    if (rc == CODEC_OK) {
+        rc = frame_compress(ctx, flags, input, input_len, output, output_cap, output_len);
+    }
+    codec_ctx_destroy(ctx);
+    return rc;
+}
+
+// Frame variant of codec_ctx_compress, using the context's level and dictionary
+int codec_ctx_compress_frame(codec_ctx *ctx, int flags, const char *input, size_t input_len, char *output,
+                             size_t output_cap, size_t *output_len) {
+    if (ctx == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    return frame_compress(ctx, flags, input, input_len, output, output_cap, output_len);
+}
+
+// Parse a frame header; on success fills info and *checksum and returns the body offset,
+// or -1 if the input does not start with a valid frame
+static int parse_frame_header(const char *input, size_t input_len, FrameInfo *info, uint32_t *checksum) {
+    if (input == NULL || input_len < FRAME_FIXED_HEADER + 1 ||
+        memcmp(input, FRAME_MAGIC, FRAME_MAGIC_LEN) != 0 || input[FRAME_MAGIC_LEN] != FRAME_VERSION) {
         #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid ZSTD compressed data: too small (need at least 2 bytes)\n");
+        fprintf(stderr, "Invalid frame: bad magic or version\n");
         #endif
-        return result;
+        return -1;
     }
-
-    // Decode original length from varint header
-    unsigned long original_len;
-    int header_size = decode_varint(input, input_len, &original_len);
-    if (header_size < 0) {
+    info->codec = (unsigned char)input[FRAME_MAGIC_LEN + 1];
+    info->flags = (unsigned char)input[FRAME_MAGIC_LEN + 2];
+    if (info->codec > CODEC_STORED || (info->flags & ~FRAME_KNOWN_FLAGS) != 0 ||
+        (info->codec == CODEC_STORED && (info->flags & FRAME_DICT))) {
         #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid ZSTD compressed data: failed to decode varint header\n");
+        fprintf(stderr, "Invalid frame: unknown codec %d or flags 0x%x\n", info->codec, info->flags);
         #endif
-        return result;
+        return -1;
     }
 
-    // Check that we have enough data after the header
-    if ((unsigned long)header_size >= input_len) {
+    size_t pos = FRAME_FIXED_HEADER;
+    size_t remaining = input_len - pos;
+    unsigned long body_len;
+    int n = decode_varint(input + pos, remaining < MAX_VARINT_LEN ? (int)remaining : MAX_VARINT_LEN, &body_len);
+    if (n <= 0) {
+        return -1;
+    }
+    pos += n;
+    *checksum = 0;
+    if (info->flags & FRAME_CHECKSUM) {
+        if (input_len - pos < FRAME_CHECKSUM_LEN) {
+            return -1;
+        }
+        for (int i = 0; i < FRAME_CHECKSUM_LEN; i++) {
+            *checksum |= (uint32_t)(unsigned char)input[pos++] << (8 * i);
+        }
+    }
+    if (body_len > input_len - pos) {
         #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid ZSTD compressed data: no data after varint header\n");
+        fprintf(stderr, "Invalid frame: body of %lu bytes extends past the input\n", body_len);
         #endif
-        return result;
+        return -1;
     }
 
-    // Sanity check on original length (prevent absurdly large allocations)
-    // Using the same limit as zlib/lz4 versions for consistency
-    if (original_len > 100 * 1024 * 1024) { // 100MB limit
+    unsigned long original_len;
+    if (info->codec == CODEC_STORED) {
+        // May be empty, which parse_length_header rejects for compressed bodies
+        int max_bytes = body_len < MAX_VARINT_LEN ? (int)body_len : MAX_VARINT_LEN;
+        if (decode_varint(input + pos, max_bytes, &original_len) <= 0) {
+            return -1;
+        }
+    } else if (parse_length_header(input + pos, body_len, &original_len, "frame ") < 0) {
+        return -1;
+    }
+    if (info->codec == CODEC_STORED && body_len != stored_body_len(original_len)) {
         #ifdef DEBUG_FUZZING
-        fprintf(stderr, "Invalid ZSTD compressed data: original length too large (%lu bytes)\n", original_len);
+        fprintf(stderr, "Invalid frame: stored body of %lu bytes for %lu bytes of data\n", body_len, original_len);
         #endif
-        return result;
+        return -1;
     }
-    
-    if (original_len == 0) { // Handle zero-length original string case
-        char *output_buffer = (char *)calloc(1, 1); 
-        if (output_buffer == NULL) {
-            perror("Failed to allocate memory for ZSTD decompression (empty string)");
-            return result;
-        }
-        output_buffer[0] = '\0';
-        result.buffer = output_buffer;
-        result.length = 0;
-        return result;
+    info->original_len = original_len;
+    info->frame_len = pos + body_len;
+    return (int)pos;
+}
+
+// Read the header of the frame at the start of input
+// Trailing bytes (e.g. further concatenated frames) are allowed; info->frame_len says where
+// this frame ends. Returns CODEC_OK, or CODEC_ERR_CORRUPT if input does not start with a frame
+int frame_header_info(const char *input, size_t input_len, FrameInfo *info) {
+    uint32_t checksum;
+    if (info == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    if (parse_frame_header(input, input_len, info, &checksum) < 0) {
+        return CODEC_ERR_CORRUPT;
     }
+    return CODEC_OK;
+}
 
-    // Allocate buffer for decompressed data
-    char *output_buffer = (char *)calloc(original_len + 1, 1); 
-    if (output_buffer == NULL) {
-        perror("Failed to allocate memory for ZSTD decompression");
-        return result;
+// Total length of the frame at the start of input, from its header alone, so a reader
+// pulling concatenated frames off a pipe knows how much to read next
+// Returns CODEC_ERR_BUFFER_TOO_SMALL with *frame_len set to the header bytes needed so far
+// (call again once that many are available), or CODEC_ERR_CORRUPT for a bad header
+int frame_length(const char *input, size_t input_len, size_t *frame_len) {
+    if (frame_len == NULL || (input == NULL && input_len > 0)) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    size_t have = input_len < FRAME_FIXED_HEADER ? input_len : FRAME_FIXED_HEADER;
+    if (have > 0 && memcmp(input, FRAME_MAGIC "\x01", have < FRAME_MAGIC_LEN + 1 ? have : FRAME_MAGIC_LEN + 1) != 0) {
+        return CODEC_ERR_CORRUPT;
+    }
+    if (input_len < FRAME_FIXED_HEADER + 1) {
+        *frame_len = FRAME_FIXED_HEADER + 1;
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+    int codec = (unsigned char)input[FRAME_MAGIC_LEN + 1];
+    int flags = (unsigned char)input[FRAME_MAGIC_LEN + 2];
+    if (codec > CODEC_STORED || (flags & ~FRAME_KNOWN_FLAGS) != 0) {
+        return CODEC_ERR_CORRUPT;
     }
 
-    // Decompress data (skip the varint header)
-    size_t decompressed_size = ZSTD_decompress(
-        output_buffer, 
-        original_len,
-        input + header_size, 
-        input_len - header_size
-    );
+    size_t pos = FRAME_FIXED_HEADER;
+    while ((unsigned char)input[pos] & 0x80) {
+        if (pos - FRAME_FIXED_HEADER + 1 >= MAX_VARINT_LEN) {
+            return CODEC_ERR_CORRUPT;
+        }
+        if (++pos == input_len) {
+            *frame_len = pos + 1;
+            return CODEC_ERR_BUFFER_TOO_SMALL;
+        }
+    }
+    unsigned long body_len;
+    int n = decode_varint(input + FRAME_FIXED_HEADER, (int)(pos + 1 - FRAME_FIXED_HEADER), &body_len);
+    if (n <= 0) {
+        return CODEC_ERR_CORRUPT;
+    }
+    size_t header_len = FRAME_FIXED_HEADER + n + ((flags & FRAME_CHECKSUM) ? FRAME_CHECKSUM_LEN : 0);
+    if (body_len > SIZE_MAX - header_len) {
+        return CODEC_ERR_CORRUPT;
+    }
+    *frame_len = header_len + body_len;
+    return CODEC_OK;
+}
 
-    if (ZSTD_isError(decompressed_size)) {
+// Original length of a frame or block-parallel container, for sizing decompress_auto_into
+int auto_decompressed_length(const char *input, size_t input_len, size_t *original_len) {
+    if (original_len == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    FrameInfo info;
+    if (frame_header_info(input, input_len, &info) == CODEC_OK) {
+        *original_len = info.original_len;
+        return CODEC_OK;
+    }
+    return parallel_decompressed_length(input, input_len, original_len);
+}
+
+// Decode one body through ctx, checksumming the output as it is written if fused is set
+static int frame_decode_body(codec_ctx *ctx, fused_checksum *fused, const char *body, size_t body_len, char *output,
+                             size_t output_cap, size_t *output_len) {
+    ctx->fused = fused;
+    int rc = codec_ctx_decompress(ctx, body, body_len, output, output_cap, output_len);
+    ctx->fused = NULL;
+    return rc;
+}
+
+// Decode one frame that must span all of input, through ctx if given or the thread's
+// cached context (the codec's one-shot decompressor without one), then verify its checksum
+static int frame_decompress(codec_ctx *ctx, const char *input, size_t input_len, char *output, size_t output_cap,
+                            size_t *output_len) {
+    FrameInfo info;
+    uint32_t checksum;
+    int body_pos = parse_frame_header(input, input_len, &info, &checksum);
+    if (body_pos < 0 || info.frame_len != input_len) {
+        return CODEC_ERR_CORRUPT;
+    }
+    if (info.original_len > output_cap) {
+        *output_len = info.original_len;
+        return CODEC_ERR_BUFFER_TOO_SMALL;
+    }
+    const char *body = input + body_pos;
+    size_t body_len = input_len - body_pos;
+    int verify = (info.flags & FRAME_CHECKSUM) && (ctx == NULL || !ctx->skip_verify);
+    fused_checksum sum = {0, 0};
+
+    int rc;
+    if (info.codec == CODEC_STORED) {
+        // Any context can read stored frames; the length was validated with the header
+        uint64_t start = stats_clock();
+        size_t header_size = body_len - info.original_len;
+        if (verify) {
+            sum.crc = crc32c_copy(0, output, body + header_size, info.original_len);
+            sum.done = 1;
+        } else {
+            memcpy(output, body + header_size, info.original_len);
+        }
+        *output_len = info.original_len;
+        rc = CODEC_OK;
+        stats_record(CODEC_STORED, CODEC_STATS_DECOMPRESS, body_len, info.original_len, rc, start);
+    } else if (ctx != NULL) {
+        if (info.codec != ctx->codec) {
+            return CODEC_ERR_WRONG_CODEC;
+        }
+        if ((info.flags & FRAME_DICT) && ctx->dict == NULL) {
+            return CODEC_ERR_DICT_MISMATCH;
+        }
+        // A frame without a dictionary has no ID to check, so decode it as if none were attached
+        const codec_dict *dict = ctx->dict;
+        if (!(info.flags & FRAME_DICT)) {
+            ctx->dict = NULL;
+        }
+        rc = frame_decode_body(ctx, verify ? &sum : NULL, body, body_len, output, output_cap, output_len);
+        ctx->dict = dict;
+    } else {
+        if (info.flags & FRAME_DICT) {
+            return CODEC_ERR_DICT_MISMATCH; // Needs a context with the dictionary attached
+        }
+        codec_ctx *cached = thread_ctx(info.codec);
+        if (cached != NULL) {
+            rc = frame_decode_body(cached, verify ? &sum : NULL, body, body_len, output, output_cap, output_len);
+        } else {
+            static const codec_into_fn decoders[] = {decompress_data_into, decompress_data_lz4_into,
+                                                     decompress_data_zstd_into};
+            rc = decoders[info.codec](body, body_len, output, output_cap, output_len);
+        }
+    }
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    if (verify && (sum.done ? sum.crc : crc32c(output, *output_len)) != checksum) {
         #ifdef DEBUG_FUZZING
-        fprintf(stderr, "ZSTD_decompress failed: %s\n", ZSTD_getErrorName(decompressed_size));
+        fprintf(stderr, "Frame checksum mismatch\n");
         #endif
-        free(output_buffer);
+        *output_len = 0;
+        return CODEC_ERR_CHECKSUM;
+    }
+    return CODEC_OK;
+}
+
+// Decompress a frame or block-parallel container, picking the codec from its header
+// Headerless one-shot output ([varint length][payload]) carries no codec ID and is
+// rejected with CODEC_ERR_CORRUPT; use the codec's own decompressor for it.
+// Same buffer contract as decompress_data_into
+int decompress_auto_into(const char *input, size_t input_len, char *output, size_t output_cap,
+                         size_t *output_len) {
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+    if (input_len >= PARALLEL_MAGIC_LEN && memcmp(input, PARALLEL_MAGIC, PARALLEL_MAGIC_LEN) == 0) {
+        return decompress_parallel_into(0, input, input_len, output, output_cap, output_len);
+    }
+    return frame_decompress(NULL, input, input_len, output, output_cap, output_len);
+}
+
+// Frame variant of codec_ctx_decompress: returns CODEC_ERR_WRONG_CODEC if the frame was
+// written by another codec and CODEC_ERR_DICT_MISMATCH if it needs a different dictionary
+int codec_ctx_decompress_frame(codec_ctx *ctx, const char *input, size_t input_len, char *output,
+                               size_t output_cap, size_t *output_len) {
+    if (ctx == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    *output_len = 0;
+    return frame_decompress(ctx, input, input_len, output, output_cap, output_len);
+}
+
+// Point *data at the original bytes of the CODEC_STORED frame spanning input, without
+// copying them; the checksum, if any, is verified first
+// Returns CODEC_OK, CODEC_ERR_WRONG_CODEC if the frame is compressed (decompress it
+// instead), CODEC_ERR_CHECKSUM, or CODEC_ERR_CORRUPT if input is not exactly one frame
+int frame_stored_view(const char *input, size_t input_len, const char **data, size_t *data_len) {
+    if (data == NULL || data_len == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    *data = NULL;
+    *data_len = 0;
+    FrameInfo info;
+    uint32_t checksum;
+    int body_pos = parse_frame_header(input, input_len, &info, &checksum);
+    if (body_pos < 0 || info.frame_len != input_len) {
+        return CODEC_ERR_CORRUPT;
+    }
+    if (info.codec != CODEC_STORED) {
+        return CODEC_ERR_WRONG_CODEC;
+    }
+    uint64_t start = stats_clock();
+    const char *original = input + input_len - info.original_len;
+    int rc = CODEC_OK;
+    if ((info.flags & FRAME_CHECKSUM) && crc32c(original, info.original_len) != checksum) {
+        rc = CODEC_ERR_CHECKSUM;
+    } else {
+        *data = original;
+        *data_len = info.original_len;
+    }
+    stats_record(CODEC_STORED, CODEC_STATS_DECOMPRESS, input_len - body_pos, *data_len, rc, start);
+    return rc;
+}
+
+// Adaptive codec selection
+//
+// compress_frame_auto_into picks the codec and level per input, so incompressible blobs
+// are stored instead of burning CPU on them. A sample is taken (the whole input when small,
+// otherwise AUTO_SAMPLE_CHUNKS evenly spaced chunks). If its byte entropy is close to
+// 8 bits it is stored right away; otherwise the candidates below are trial-compressed on
+// it, and the smallest output among those at least min_mb_per_s fast wins. Levels of one
+// codec are tried in increasing order and the first one under the floor ends that codec.
+// Stored is chosen when no candidate saves AUTO_MIN_SAVING of the sample. zlib is not a
+// candidate: zstd reaches its ratios at several times its speed.
+// Timings are measured, so near the speed floor the choice can differ between runs.
+
+#define AUTO_SAMPLE_CHUNK (16 * 1024)
+#define AUTO_SAMPLE_CHUNKS 4
+#define AUTO_MIN_INPUT 64         // Smaller inputs cannot win back the framing overhead
+#define AUTO_STORED_ENTROPY 7.9   // Bits per byte above which a sample is treated as random
+#define AUTO_MIN_SAVING 0.03      // Fraction of the sample a candidate must save
+#define AUTO_WARMUP_LEN 4096      // Untimed prefix run first, so timings exclude first-use costs
+
+static const struct {
+    int codec;
+    int level;
+} auto_candidates[] = {
+    {CODEC_LZ4, 0}, {CODEC_ZSTD, 1}, {CODEC_ZSTD, 3}, {CODEC_ZSTD, 7}, {CODEC_ZSTD, 12}, {CODEC_ZSTD, 19},
+};
+
+// Order-0 entropy of data in bits per byte
+static double byte_entropy(const char *data, size_t len) {
+    size_t counts[256] = {0};
+    for (size_t i = 0; i < len; i++) {
+        counts[(unsigned char)data[i]]++;
+    }
+    double bits = 0;
+    for (int c = 0; c < 256; c++) {
+        if (counts[c] != 0) {
+            double f = (double)counts[c] / (double)len;
+            bits -= f * log2(f);
+        }
+    }
+    return bits;
+}
+
+static double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Trial-compress sample with each candidate, keeping *codec / *level at CODEC_STORED
+// unless one saves enough while meeting the speed floor
+static int auto_trials(const char *sample, size_t sample_len, size_t input_len, double min_mb_per_s,
+                       char *scratch, size_t scratch_cap, int *codec, int *level) {
+    codec_ctx *ctxs[CODEC_ZSTD + 1] = {NULL};
+    int too_slow[CODEC_ZSTD + 1] = {0};
+    size_t best_len = sample_len - (size_t)((double)sample_len * AUTO_MIN_SAVING);
+    int rc = CODEC_OK;
+    for (size_t i = 0; i < sizeof(auto_candidates) / sizeof(auto_candidates[0]); i++) {
+        int c = auto_candidates[i].codec;
+        if (too_slow[c] || codec_compress_bound(c, input_len) == 0) {
+            continue; // e.g. LZ4 cannot take the full input in one call
+        }
+        if (ctxs[c] == NULL && (ctxs[c] = codec_ctx_create(c)) == NULL) {
+            rc = CODEC_ERR_ALLOC;
+            break;
+        }
+        rc = codec_ctx_set_level(ctxs[c], auto_candidates[i].level);
+        if (rc != CODEC_OK) {
+            break;
+        }
+        size_t trial_len;
+        if (sample_len > AUTO_WARMUP_LEN * 4) {
+            ctx_compress(ctxs[c], sample, AUTO_WARMUP_LEN, scratch, scratch_cap, &trial_len);
+        }
+        double start = monotonic_seconds();
+        rc = ctx_compress(ctxs[c], sample, sample_len, scratch, scratch_cap, &trial_len);
+        double elapsed = monotonic_seconds() - start;
+        if (rc != CODEC_OK) {
+            break;
+        }
+        if (min_mb_per_s > 0 && elapsed > 0 && (double)sample_len / elapsed / 1e6 < min_mb_per_s) {
+            too_slow[c] = 1; // Higher levels of this codec are slower still
+            continue;
+        }
+        if (trial_len < best_len) {
+            best_len = trial_len;
+            *codec = c;
+            *level = auto_candidates[i].level;
+        }
+    }
+    for (int c = 0; c <= CODEC_ZSTD; c++) {
+        codec_ctx_destroy(ctxs[c]);
+    }
+    return rc;
+}
+
+// Pick the codec and level compress_frame_auto_into would use for input
+// min_mb_per_s is the slowest acceptable compression speed in MB/s, or 0 for the best
+// ratio at any speed. *codec is set to CODEC_STORED when compressing does not pay off.
+// Returns CODEC_OK or a negative CODEC_ERR_* code
+int codec_auto_select(const char *input, size_t input_len, double min_mb_per_s, int *codec, int *level) {
+    if ((input == NULL && input_len > 0) || codec == NULL || level == NULL) {
+        return CODEC_ERR_INVALID_ARG;
+    }
+    *codec = CODEC_STORED;
+    *level = 0;
+    if (input_len < AUTO_MIN_INPUT) {
+        return CODEC_OK;
+    }
+
+    size_t sample_cap = (size_t)AUTO_SAMPLE_CHUNK * AUTO_SAMPLE_CHUNKS;
+    size_t sample_len = input_len < sample_cap ? input_len : sample_cap;
+    size_t scratch_cap = frame_compress_bound(CODEC_AUTO, sample_len);
+    char *scratch = (char *)scratch_alloc(scratch_cap + (input_len > sample_cap ? sample_cap : 0));
+    if (scratch == NULL) {
+        perror("Failed to allocate memory for codec selection");
+        return CODEC_ERR_ALLOC;
+    }
+    const char *sample = input;
+    if (input_len > sample_cap) {
+        char *chunks = scratch + scratch_cap;
+        size_t stride = (input_len - AUTO_SAMPLE_CHUNK) / (AUTO_SAMPLE_CHUNKS - 1);
+        for (size_t i = 0; i < AUTO_SAMPLE_CHUNKS; i++) {
+            memcpy(chunks + i * AUTO_SAMPLE_CHUNK, input + i * stride, AUTO_SAMPLE_CHUNK);
+        }
+        sample = chunks;
+    }
+
+    int rc = CODEC_OK;
+    if (byte_entropy(sample, sample_len) < AUTO_STORED_ENTROPY) {
+        rc = auto_trials(sample, sample_len, input_len, min_mb_per_s, scratch, scratch_cap, codec, level);
+    }
+    scratch_free(scratch);
+    return rc;
+}
+
+// Compress into a frame with the codec and level chosen by codec_auto_select
+// out_cap of frame_compress_bound(CODEC_AUTO, in_len) always suffices; the choice can be
+// read back with frame_header_info. Returns CODEC_OK or a negative CODEC_ERR_* code
+int compress_frame_auto_into(double min_mb_per_s, int flags, const char *input, size_t input_len, char *output,
+                             size_t output_cap, size_t *output_len) {
+    int rc = check_into_args(input, input_len, output, output_cap, output_len);
+    if (rc != CODEC_OK) {
+        return rc;
+    }
+    int codec, level;
+    rc = codec_auto_select(input, input_len, min_mb_per_s, &codec, &level);
+    if (rc != CODEC_OK) {
+        *output_len = 0;
+        return rc;
+    }
+    return compress_frame_into(codec, level, flags, input, input_len, output, output_cap, output_len);
+}
+
+// Allocating variant of compress_frame_into
+// The caller is responsible for freeing the returned buffer with free_compressed_data
+CompressedData compress_frame(int codec, int level, int flags, const char *input, unsigned long input_len) {
+    CompressedData result = {NULL, 0};
+    size_t bound = frame_compress_bound(codec, input_len);
+    if (bound == 0) {
+        return result;
+    }
+    char *output_buffer = buffer_alloc(bound);
+    if (output_buffer == NULL) {
+        perror("Failed to allocate memory for frame compression");
+        return result;
+    }
+    size_t output_len;
+    if (compress_frame_into(codec, level, flags, input, input_len, output_buffer, bound, &output_len) != CODEC_OK) {
+        buffer_free(output_buffer);
         return result;
     }
+    result.buffer = output_buffer;
+    result.length = output_len;
+    return result;
+}
 
-    // Verify that decompressed length matches expected length
-    if (decompressed_size != original_len) {
+// Allocating variant of decompress_auto_into, subject to MAX_DECOMPRESSED_SIZE
+// The returned buffer is null-terminated; free it with free_decompressed_data
+DecompressedData decompress_auto(const char *input, unsigned long input_len) {
+    DecompressedData result = {NULL, 0};
+    size_t original_len;
+    if (auto_decompressed_length(input, input_len, &original_len) != CODEC_OK) {
+        return result;
+    }
+    if (original_len > MAX_DECOMPRESSED_SIZE) {
         #ifdef DEBUG_FUZZING
-        fprintf(stderr, "ZSTD Decompression length mismatch: expected %lu, got %zu\n",
-                original_len, decompressed_size);
+        fprintf(stderr, "Invalid frame: original length too large (%zu bytes)\n", original_len);
         #endif
-        free(output_buffer);
+        STATS_COUNT(over_size_cap);
         return result;
     }
-    
-    output_buffer[original_len] = '\0'; // Ensure null termination
-
+    char *output_buffer = buffer_alloc(original_len + 1);
+    if (output_buffer == NULL) {
+        perror("Failed to allocate memory for decompression");
+        return result;
+    }
+    size_t output_len;
+    if (decompress_auto_into(input, input_len, output_buffer, original_len, &output_len) != CODEC_OK) {
+        buffer_free(output_buffer);
+        return result;
+    }
+    output_buffer[output_len] = '\0';
     result.buffer = output_buffer;
-    result.length = decompressed_size;
+    result.length = output_len;
     return result;
 }
 
 // Function to free the memory allocated by compress_string
 void free_compressed_data(CompressedData data) {
-    if (data.buffer != NULL) {
-        free(data.buffer);
-    }
+    buffer_free(data.buffer);
 }
 
 // Function to free the memory allocated by decompress_data
 void free_decompressed_data(DecompressedData data) {
-    if (data.buffer != NULL) {
-        free(data.buffer);
-    }
+    buffer_free(data.buffer);
 }
 
 #ifdef BUILD_TEST_MAIN
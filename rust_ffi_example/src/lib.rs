@@ -1,5 +1,5 @@
 use std::ffi::CString;
-use std::os::raw::{c_char, c_ulong};
+use std::os::raw::{c_char, c_ulong, c_void};
 use std::slice;
 
 // Define the Rust equivalent of the C struct CompressedData
@@ -34,6 +34,371 @@ extern "C" {
     // Variable-byte encoding functions
     pub fn encode_varint(value: c_ulong, buffer: *mut c_char) -> i32;
     pub fn decode_varint(buffer: *const c_char, max_bytes: i32, value: *mut c_ulong) -> i32;
+
+    // Caller-provided buffer variants (return CODEC_OK or a negative CODEC_ERR_* code)
+    pub fn compress_bound(input_len: usize) -> usize;
+    pub fn compress_bound_lz4(input_len: usize) -> usize;
+    pub fn compress_bound_zstd(input_len: usize) -> usize;
+    pub fn decompressed_length(input: *const c_char, input_len: usize, original_len: *mut usize) -> i32;
+    pub fn compress_string_into(input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn decompress_data_into(input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn compress_string_lz4_into(input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn decompress_data_lz4_into(input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn compress_string_zstd_into(input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn decompress_data_zstd_into(input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+
+    // Reusable compression contexts
+    pub fn codec_compress_bound(codec: i32, input_len: usize) -> usize;
+    pub fn codec_ctx_create(codec: i32) -> *mut CodecCtx;
+    pub fn codec_ctx_compress(ctx: *mut CodecCtx, input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn codec_ctx_decompress(ctx: *mut CodecCtx, input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn codec_ctx_destroy(ctx: *mut CodecCtx);
+    pub fn codec_thread_cache_release() -> i32;
+
+    // Compression levels
+    pub fn codec_default_level(codec: i32) -> i32;
+    pub fn codec_level_range(codec: i32, min_level: *mut i32, max_level: *mut i32) -> i32;
+    pub fn codec_ctx_set_level(ctx: *mut CodecCtx, level: i32) -> i32;
+    pub fn codec_ctx_set_verify(ctx: *mut CodecCtx, verify: i32) -> i32;
+    pub fn compress_string_level_into(codec: i32, level: i32, input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn compress_string_level(codec: i32, level: i32, input: *const c_char, input_len: c_ulong) -> CompressedData;
+
+    // Dictionaries
+    pub fn dict_train(samples: *const c_char, sample_lens: *const usize, count: usize, dict: *mut c_char, dict_cap: usize, dict_len: *mut usize) -> i32;
+    pub fn codec_dict_create(codec: i32, level: i32, dict: *const c_char, dict_len: usize) -> *mut CodecDict;
+    pub fn codec_dict_id(dict: *const CodecDict) -> u32;
+    pub fn codec_dict_destroy(dict: *mut CodecDict);
+    pub fn codec_ctx_set_dict(ctx: *mut CodecCtx, dict: *const CodecDict) -> i32;
+    pub fn compressed_dict_id(input: *const c_char, input_len: usize, dict_id: *mut u32) -> i32;
+
+    // Streaming compression
+    pub fn stream_begin(codec: i32, mode: i32, level: i32) -> *mut CodecStreamHandle;
+    pub fn stream_update(stream: *mut CodecStreamHandle, input: *const c_char, input_len: usize, input_consumed: *mut usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn stream_end(stream: *mut CodecStreamHandle, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn stream_destroy(stream: *mut CodecStreamHandle);
+
+    // Block-parallel compression
+    pub fn compress_parallel_bound(codec: i32, input_len: usize, block_size: usize) -> usize;
+    pub fn compress_parallel_into(codec: i32, level: i32, threads: i32, block_size: usize, input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn parallel_decompressed_length(input: *const c_char, input_len: usize, original_len: *mut usize) -> i32;
+    pub fn decompress_parallel_into(threads: i32, input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn compress_parallel(codec: i32, level: i32, threads: i32, input: *const c_char, input_len: c_ulong) -> CompressedData;
+    pub fn decompress_parallel(threads: i32, input: *const c_char, input_len: c_ulong) -> DecompressedData;
+    pub fn set_parallel_options(flags: i32, block_size: usize) -> i32;
+    pub fn parallel_default_block_size() -> usize;
+    pub fn parallel_cache_block_size() -> usize;
+    pub fn parallel_numa_nodes() -> i32;
+
+    // Random access into block-parallel containers
+    pub fn range_reader_open(input: *const c_char, input_len: usize) -> *mut RangeReaderHandle;
+    pub fn range_reader_size(reader: *const RangeReaderHandle) -> usize;
+    pub fn range_reader_read(reader: *mut RangeReaderHandle, offset: usize, len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn range_reader_close(reader: *mut RangeReaderHandle);
+    pub fn read_range(input: *const c_char, input_len: usize, offset: usize, len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+
+    // Lazy record reader
+    pub fn record_reader_open(codec: i32, input: *const c_char, input_len: usize, window: usize) -> *mut RecordReaderHandle;
+    pub fn record_reader_next(reader: *mut RecordReaderHandle, record: *mut *const c_char, record_len: *mut usize) -> i32;
+    pub fn record_reader_close(reader: *mut RecordReaderHandle);
+
+    // Self-describing frames
+    pub fn frame_compress_bound(codec: i32, input_len: usize) -> usize;
+    pub fn compress_frame_into(codec: i32, level: i32, flags: i32, input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn codec_ctx_compress_frame(ctx: *mut CodecCtx, flags: i32, input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn frame_header_info(input: *const c_char, input_len: usize, info: *mut FrameInfo) -> i32;
+    pub fn frame_length(input: *const c_char, input_len: usize, frame_len: *mut usize) -> i32;
+    pub fn auto_decompressed_length(input: *const c_char, input_len: usize, original_len: *mut usize) -> i32;
+    pub fn decompress_auto_into(input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn codec_ctx_decompress_frame(ctx: *mut CodecCtx, input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+    pub fn frame_stored_view(input: *const c_char, input_len: usize, data: *mut *const c_char, data_len: *mut usize) -> i32;
+    pub fn checksum_crc32c(crc: u32, data: *const c_char, len: usize) -> u32;
+    pub fn checksum_crc32c_kernel() -> *const c_char;
+    pub fn compress_frame(codec: i32, level: i32, flags: i32, input: *const c_char, input_len: c_ulong) -> CompressedData;
+    pub fn decompress_auto(input: *const c_char, input_len: c_ulong) -> DecompressedData;
+    pub fn set_allocator(alloc_fn: Option<CodecAllocFn>, free_fn: Option<CodecFreeFn>, opaque: *mut c_void) -> i32;
+    pub fn set_thread_allocator(alloc_fn: Option<CodecAllocFn>, free_fn: Option<CodecFreeFn>, opaque: *mut c_void) -> i32;
+    pub fn codec_arena_create(capacity: usize) -> *mut ArenaHandle;
+    pub fn codec_arena_alloc(opaque: *mut c_void, size: usize) -> *mut c_void;
+    pub fn codec_arena_free(opaque: *mut c_void, ptr: *mut c_void);
+    pub fn codec_arena_used(arena: *const ArenaHandle) -> usize;
+    pub fn codec_arena_reset(arena: *mut ArenaHandle);
+    pub fn codec_arena_destroy(arena: *mut ArenaHandle);
+    pub fn get_codec_stats(stats: *mut CodecStats) -> i32;
+    pub fn reset_codec_stats();
+    pub fn codec_auto_select(input: *const c_char, input_len: usize, min_mb_per_s: f64, codec: *mut i32, level: *mut i32) -> i32;
+    pub fn compress_frame_auto_into(min_mb_per_s: f64, flags: i32, input: *const c_char, input_len: usize, output: *mut c_char, output_cap: usize, output_len: *mut usize) -> i32;
+
+    // Batch compression
+    pub fn codec_batch_compress_bound(codec: i32, input_lens: *const usize, count: usize) -> usize;
+    pub fn codec_batch_decompressed_size(inputs: *const *const c_char, input_lens: *const usize, count: usize, total_len: *mut usize) -> i32;
+    pub fn codec_batch_compress(ctx: *mut CodecCtx, inputs: *const *const c_char, input_lens: *const usize, count: usize, arena: *mut c_char, arena_cap: usize, offsets: *mut usize) -> i32;
+    pub fn codec_batch_decompress(ctx: *mut CodecCtx, inputs: *const *const c_char, input_lens: *const usize, count: usize, arena: *mut c_char, arena_cap: usize, offsets: *mut usize) -> i32;
+
+    // Bulk variable-byte encoding
+    pub fn varint_array_bound(n: usize) -> usize;
+    pub fn encode_varint_array(values: *const u64, n: usize, output: *mut c_char) -> usize;
+    pub fn decode_varint_array(input: *const c_char, input_len: usize, values: *mut u64, n: usize, bytes_read: *mut usize) -> i32;
+    pub fn encode_varint_array_scalar(values: *const u64, n: usize, output: *mut c_char) -> usize;
+    pub fn decode_varint_array_scalar(input: *const c_char, input_len: usize, values: *mut u64, n: usize, bytes_read: *mut usize) -> i32;
+    pub fn varint_array_kernel() -> *const c_char;
+
+    // Stream-VByte integer format
+    pub fn streamvbyte_bound(n: usize) -> usize;
+    pub fn streamvbyte_encode(values: *const u32, n: usize, output: *mut c_char, flags: i32) -> usize;
+    pub fn streamvbyte_decode(input: *const c_char, input_len: usize, values: *mut u32, n: usize, flags: i32, bytes_read: *mut usize) -> i32;
+    pub fn streamvbyte_decode_scalar(input: *const c_char, input_len: usize, values: *mut u32, n: usize, flags: i32, bytes_read: *mut usize) -> i32;
+    pub fn streamvbyte_kernel() -> *const c_char;
+    pub fn pfor_bound(n: usize) -> usize;
+    pub fn pfor_encode(values: *const u64, n: usize, output: *mut c_char, flags: i32) -> usize;
+    pub fn pfor_decode(input: *const c_char, input_len: usize, values: *mut u64, n: usize, flags: i32, bytes_read: *mut usize) -> i32;
+    pub fn pfor_decode_scalar(input: *const c_char, input_len: usize, values: *mut u64, n: usize, flags: i32, bytes_read: *mut usize) -> i32;
+    pub fn pfor_kernel() -> *const c_char;
+}
+
+// Opaque C `codec_ctx` handle
+#[repr(C)]
+pub struct CodecCtx {
+    _private: [u8; 0],
+}
+
+// Status codes returned by the C `*_into` functions (mirrors rust_ffi_example.h)
+pub const CODEC_OK: i32 = 0;
+pub const CODEC_ERR_INVALID_ARG: i32 = -1;
+pub const CODEC_ERR_BUFFER_TOO_SMALL: i32 = -2;
+pub const CODEC_ERR_CORRUPT: i32 = -3;
+pub const CODEC_ERR_TOO_LARGE: i32 = -4;
+pub const CODEC_ERR_CODEC: i32 = -5;
+pub const CODEC_ERR_ALLOC: i32 = -6;
+pub const CODEC_ERR_DICT_MISMATCH: i32 = -7;
+pub const CODEC_ERR_CHECKSUM: i32 = -8;
+pub const CODEC_ERR_WRONG_CODEC: i32 = -9;
+
+/// Compression algorithms supported by the C library.
+/// The discriminants match the `CODEC_*` identifiers in rust_ffi_example.h.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(i32)]
+pub enum Codec {
+    Zlib = 0,
+    Lz4 = 1,
+    Zstd = 2,
+}
+
+impl Codec {
+    /// Level used by the codec's plain `compress_rust_string*` function.
+    pub fn default_level(self) -> i32 {
+        unsafe { codec_default_level(self as i32) }
+    }
+
+    /// Inclusive range of accepted levels.
+    ///
+    /// * zlib: -1 (library default) to 9.
+    /// * LZ4: negative values select the fast mode with acceleration `-level`,
+    ///   0-2 the default mode, 3-12 LZ4HC.
+    /// * zstd: negative (fastest) levels up to 19-22 (smallest output).
+    pub fn level_range(self) -> (i32, i32) {
+        let (mut min_level, mut max_level) = (0, 0);
+        unsafe { codec_level_range(self as i32, &mut min_level, &mut max_level) };
+        (min_level, max_level)
+    }
+}
+
+/// Compresses `input` with `codec` at an explicit `level` (see [`Codec::level_range`]).
+///
+/// The output uses the same `[varint length][payload]` format as the codec's
+/// `compress_rust_string*` function, so the existing decompressors read it.
+///
+/// # Returns
+/// * `Ok(Vec<u8>)` containing the compressed data if successful.
+/// * `Err(&str)` if the level is out of range or compression fails.
+pub fn compress_with_level(codec: Codec, level: i32, input: &[u8]) -> Result<Vec<u8>, &'static str> {
+    let mut ctx = CodecContext::with_level(codec, level)?;
+    ctx.compress(input)
+}
+
+/// Buffer allocated by the C library, handed to Rust without copying.
+///
+/// Derefs to `&[u8]` and frees the C allocation when dropped. Returned by
+/// [`compress`] and [`decompress`], which take raw bytes: no `CString`
+/// conversion, no copy into a `Vec`, and no UTF-8 validation.
+pub struct CBuf {
+    buffer: *mut c_char,
+    length: usize,
+    decompressed: bool, // selects the matching C free function
+}
+
+// The buffer is a plain heap allocation owned exclusively by this value.
+unsafe impl Send for CBuf {}
+unsafe impl Sync for CBuf {}
+
+impl CBuf {
+    fn from_compressed(data: CompressedData) -> Result<Self, &'static str> {
+        if data.buffer.is_null() {
+            return Err("Compression failed in C library (null buffer returned)");
+        }
+        Ok(CBuf { buffer: data.buffer, length: data.length as usize, decompressed: false })
+    }
+
+    fn from_decompressed(data: DecompressedData) -> Result<Self, &'static str> {
+        if data.buffer.is_null() {
+            return Err("Decompression failed in C library (null buffer returned)");
+        }
+        Ok(CBuf { buffer: data.buffer, length: data.length as usize, decompressed: true })
+    }
+
+    /// Copies the contents into a `Vec<u8>` (for callers that need an owned Rust buffer).
+    pub fn to_vec(&self) -> Vec<u8> {
+        self[..].to_vec()
+    }
+}
+
+impl std::ops::Deref for CBuf {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        unsafe { slice::from_raw_parts(self.buffer as *const u8, self.length) }
+    }
+}
+
+impl AsRef<[u8]> for CBuf {
+    fn as_ref(&self) -> &[u8] {
+        self
+    }
+}
+
+impl std::fmt::Debug for CBuf {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("CBuf").field("len", &self.length).finish()
+    }
+}
+
+impl Drop for CBuf {
+    fn drop(&mut self) {
+        let (buffer, length) = (self.buffer, self.length as c_ulong);
+        unsafe {
+            if self.decompressed {
+                free_decompressed_data(DecompressedData { buffer, length });
+            } else {
+                free_compressed_data(CompressedData { buffer, length });
+            }
+        }
+    }
+}
+
+/// Compresses raw bytes with `codec` at its default level.
+///
+/// Same output as the codec's `compress_rust_string*` function, but the input may
+/// contain NUL bytes and the result is the C allocation itself rather than a copy.
+///
+/// # Returns
+/// * `Ok(CBuf)` containing the compressed data if successful.
+/// * `Err(&str)` if compression fails.
+pub fn compress(codec: Codec, input: &[u8]) -> Result<CBuf, &'static str> {
+    let input_ptr = input.as_ptr() as *const c_char;
+    let input_len = input.len() as c_ulong;
+    let data = unsafe {
+        match codec {
+            Codec::Zlib => compress_string(input_ptr, input_len),
+            Codec::Lz4 => compress_string_lz4(input_ptr, input_len),
+            Codec::Zstd => compress_string_zstd(input_ptr, input_len),
+        }
+    };
+    CBuf::from_compressed(data)
+}
+
+/// Decompresses data produced by [`compress`] or `compress_rust_string*` for `codec`.
+///
+/// The bytes are returned as-is, without UTF-8 validation. Like the other allocating
+/// decompressors this is limited to 100 MB; use [`decompress_into`] for larger data.
+///
+/// # Returns
+/// * `Ok(CBuf)` containing the original data if successful.
+/// * `Err(&str)` if the header or payload is invalid.
+pub fn decompress(codec: Codec, compressed_data: &[u8]) -> Result<CBuf, &'static str> {
+    let input_ptr = compressed_data.as_ptr() as *const c_char;
+    let input_len = compressed_data.len() as c_ulong;
+    let data = unsafe {
+        match codec {
+            Codec::Zlib => decompress_data(input_ptr, input_len),
+            Codec::Lz4 => decompress_data_lz4(input_ptr, input_len),
+            Codec::Zstd => decompress_data_zstd(input_ptr, input_len),
+        }
+    };
+    CBuf::from_decompressed(data)
+}
+
+/// Compresses raw bytes with `codec` directly into `output`, replacing its contents.
+/// Reusing the same `output` across calls avoids reallocating it.
+///
+/// # Returns
+/// * `Ok(usize)` with the compressed length (equal to `output.len()`).
+/// * `Err(&str)` if compression fails.
+pub fn compress_into(codec: Codec, input: &[u8], output: &mut Vec<u8>) -> Result<usize, &'static str> {
+    let bound = unsafe { codec_compress_bound(codec as i32, input.len()) };
+    if bound == 0 {
+        return Err("Input too large for codec");
+    }
+    output.clear();
+    output.reserve(bound);
+
+    let into_fn = match codec {
+        Codec::Zlib => compress_string_into,
+        Codec::Lz4 => compress_string_lz4_into,
+        Codec::Zstd => compress_string_zstd_into,
+    };
+    let mut output_len = 0usize;
+    let rc = unsafe {
+        into_fn(
+            input.as_ptr() as *const c_char,
+            input.len(),
+            output.as_mut_ptr() as *mut c_char,
+            output.capacity(),
+            &mut output_len,
+        )
+    };
+    if rc != CODEC_OK {
+        return Err("Compression failed in C library");
+    }
+    // The C side initialized exactly output_len bytes
+    unsafe { output.set_len(output_len) };
+    Ok(output_len)
+}
+
+/// Decompresses data for `codec` directly into `output`, replacing its contents.
+///
+/// # Returns
+/// * `Ok(usize)` with the decompressed length (equal to `output.len()`).
+/// * `Err(&str)` if the header or payload is invalid.
+pub fn decompress_into(codec: Codec, compressed_data: &[u8], output: &mut Vec<u8>) -> Result<usize, &'static str> {
+    let mut original_len = 0usize;
+    let rc = unsafe {
+        decompressed_length(compressed_data.as_ptr() as *const c_char, compressed_data.len(), &mut original_len)
+    };
+    if rc != CODEC_OK {
+        return Err("Invalid compressed data header");
+    }
+    output.clear();
+    output.try_reserve(original_len).map_err(|_| "Original length too large to allocate")?;
+
+    let into_fn = match codec {
+        Codec::Zlib => decompress_data_into,
+        Codec::Lz4 => decompress_data_lz4_into,
+        Codec::Zstd => decompress_data_zstd_into,
+    };
+    let mut output_len = 0usize;
+    let rc = unsafe {
+        into_fn(
+            compressed_data.as_ptr() as *const c_char,
+            compressed_data.len(),
+            output.as_mut_ptr() as *mut c_char,
+            original_len,
+            &mut output_len,
+        )
+    };
+    if rc != CODEC_OK {
+        return Err("Decompression failed in C library");
+    }
+    unsafe { output.set_len(output_len) };
+    Ok(output_len)
 }
 
 /// Compresses a string using the C library's `compress_string` function.
@@ -410,6 +775,149 @@ pub fn decode_varint_rust(data: &[u8]) -> Result<(u64, usize), &'static str> {
     Ok((value as u64, bytes_read as usize))
 }
 
+/// Encodes a slice of values back to back in the varint format of
+/// [`encode_varint_rust`], using the C library's bulk kernel.
+///
+/// # Returns
+/// * `Vec<u8>` with the concatenated encodings.
+pub fn encode_varint_array_rust(values: &[u64]) -> Vec<u8> {
+    let mut output: Vec<u8> = Vec::with_capacity(values.len() * 10);
+    let written = unsafe {
+        encode_varint_array(values.as_ptr(), values.len(), output.as_mut_ptr() as *mut c_char)
+    };
+    // The C side initialized the first `written` bytes
+    unsafe { output.set_len(written) };
+    output
+}
+
+/// Decodes exactly `count` varints from the start of `data` with the C library's
+/// bulk kernel (SIMD where the CPU supports it).
+///
+/// # Returns
+/// * `Ok((Vec<u64>, usize))` with the values and the number of bytes consumed.
+/// * `Err(&str)` if a value is malformed or `data` ends early.
+pub fn decode_varint_array_rust(data: &[u8], count: usize) -> Result<(Vec<u64>, usize), &'static str> {
+    // Every varint takes at least one byte, which bounds the allocation by the input
+    if count > data.len() {
+        return Err("Not enough data for the requested number of varints");
+    }
+    let mut values: Vec<u64> = Vec::with_capacity(count);
+    let mut bytes_read = 0usize;
+    let rc = unsafe {
+        decode_varint_array(data.as_ptr() as *const c_char, data.len(), values.as_mut_ptr(), count, &mut bytes_read)
+    };
+    if rc != CODEC_OK {
+        return Err("Failed to decode varint array (malformed or truncated)");
+    }
+    unsafe { values.set_len(count) };
+    Ok((values, bytes_read))
+}
+
+/// Name of the bulk varint kernel the C library selected for this CPU.
+pub fn varint_array_kernel_name() -> &'static str {
+    let name = unsafe { std::ffi::CStr::from_ptr(varint_array_kernel()) };
+    name.to_str().unwrap_or("unknown")
+}
+
+// Stream-VByte transform flags (mirrors rust_ffi_example.h)
+pub const STREAMVBYTE_DELTA: i32 = 1;
+pub const STREAMVBYTE_ZIGZAG: i32 = 2;
+
+/// Encodes 32-bit values in the Stream-VByte format (control bytes followed by
+/// 1-4 byte little-endian values), which decodes much faster than LEB128.
+///
+/// # Arguments
+/// * `values`: The values to encode. Pass signed data as `u32` (`v as u32`) together
+///   with [`STREAMVBYTE_ZIGZAG`].
+/// * `flags`: Any combination of [`STREAMVBYTE_DELTA`] and [`STREAMVBYTE_ZIGZAG`].
+///
+/// # Returns
+/// * `Vec<u8>` with the encoded stream.
+pub fn streamvbyte_encode_rust(values: &[u32], flags: i32) -> Vec<u8> {
+    let bound = unsafe { streamvbyte_bound(values.len()) };
+    let mut output: Vec<u8> = Vec::with_capacity(bound);
+    let written = unsafe { streamvbyte_encode(values.as_ptr(), values.len(), output.as_mut_ptr() as *mut c_char, flags) };
+    // The C side initialized the first `written` bytes
+    unsafe { output.set_len(written) };
+    output
+}
+
+/// Decodes `count` values from a stream produced by [`streamvbyte_encode_rust`]
+/// with the same `flags`.
+///
+/// # Returns
+/// * `Ok((Vec<u32>, usize))` with the values and the encoded stream's length.
+/// * `Err(&str)` if `data` is too short.
+pub fn streamvbyte_decode_rust(data: &[u8], count: usize, flags: i32) -> Result<(Vec<u32>, usize), &'static str> {
+    // Each value needs at least one data byte plus a quarter control byte
+    if count > data.len() {
+        return Err("Not enough data for the requested number of values");
+    }
+    let mut values: Vec<u32> = Vec::with_capacity(count);
+    let mut bytes_read = 0usize;
+    let rc = unsafe {
+        streamvbyte_decode(data.as_ptr() as *const c_char, data.len(), values.as_mut_ptr(), count, flags, &mut bytes_read)
+    };
+    if rc != CODEC_OK {
+        return Err("Failed to decode Stream-VByte data (truncated)");
+    }
+    unsafe { values.set_len(count) };
+    Ok((values, bytes_read))
+}
+
+/// Name of the Stream-VByte decode kernel the C library selected for this CPU.
+pub fn streamvbyte_kernel_name() -> &'static str {
+    let name = unsafe { std::ffi::CStr::from_ptr(streamvbyte_kernel()) };
+    name.to_str().unwrap_or("unknown")
+}
+
+// Bit-packed block transform flags (mirrors rust_ffi_example.h)
+pub const PFOR_DELTA: i32 = 1;
+pub const PFOR_ZIGZAG: i32 = 2;
+
+/// Encodes 64-bit values as bit-packed blocks of 128 (frame of reference, a per-block
+/// bit width and an exception list for outliers), with a LEB128 tail.
+///
+/// # Arguments
+/// * `values`: The values to encode. Pass signed data as `u64` together with [`PFOR_ZIGZAG`].
+/// * `flags`: Any combination of [`PFOR_DELTA`] and [`PFOR_ZIGZAG`].
+///
+/// # Returns
+/// * `Vec<u8>` with the encoded stream.
+pub fn pfor_encode_rust(values: &[u64], flags: i32) -> Vec<u8> {
+    let bound = unsafe { pfor_bound(values.len()) };
+    let mut output: Vec<u8> = Vec::with_capacity(bound);
+    let written = unsafe { pfor_encode(values.as_ptr(), values.len(), output.as_mut_ptr() as *mut c_char, flags) };
+    // The C side initialized the first `written` bytes
+    unsafe { output.set_len(written) };
+    output
+}
+
+/// Decodes `count` values from a stream produced by [`pfor_encode_rust`] with the
+/// same `flags`.
+///
+/// # Returns
+/// * `Ok((Vec<u64>, usize))` with the values and the encoded stream's length.
+/// * `Err(&str)` if `data` is truncated or malformed.
+pub fn pfor_decode_rust(data: &[u8], count: usize, flags: i32) -> Result<(Vec<u64>, usize), &'static str> {
+    let mut values: Vec<u64> = Vec::with_capacity(count);
+    let mut bytes_read = 0usize;
+    let rc = unsafe {
+        pfor_decode(data.as_ptr() as *const c_char, data.len(), values.as_mut_ptr(), count, flags, &mut bytes_read)
+    };
+    if rc != CODEC_OK {
+        return Err("Failed to decode bit-packed blocks (truncated or corrupt)");
+    }
+    unsafe { values.set_len(count) };
+    Ok((values, bytes_read))
+}
+
+/// Name of the bit-unpacking kernel the C library selected for this CPU.
+pub fn pfor_kernel_name() -> &'static str {
+    let name = unsafe { std::ffi::CStr::from_ptr(pfor_kernel()) };
+    name.to_str().unwrap_or("unknown")
+}
+
 /// Compresses a string using the C library's `compress_string_lz4` function.
 ///
 /// # Arguments
@@ -1228,6 +1736,2942 @@ pub fn decompress_rust_data_zstd(compressed_data: &[u8]) -> Result<String, &'sta
 }
 
 
+#[cfg(test)]
+mod into_tests {
+    use super::*;
+
+    type IntoFn = unsafe extern "C" fn(*const c_char, usize, *mut c_char, usize, *mut usize) -> i32;
+
+    fn codecs() -> Vec<(&'static str, unsafe extern "C" fn(usize) -> usize, IntoFn, IntoFn)> {
+        vec![
+            ("zlib", compress_bound, compress_string_into, decompress_data_into),
+            ("lz4", compress_bound_lz4, compress_string_lz4_into, decompress_data_lz4_into),
+            ("zstd", compress_bound_zstd, compress_string_zstd_into, decompress_data_zstd_into),
+        ]
+    }
+
+    #[test]
+    fn test_into_round_trip_reuses_buffer() {
+        let inputs: Vec<Vec<u8>> = vec![
+            b"".to_vec(),
+            b"a".to_vec(),
+            b"hello\0world with an interior null byte".to_vec(),
+            "The quick brown fox jumps over the lazy dog. ".repeat(200).into_bytes(),
+        ];
+
+        for (name, bound_fn, compress_fn, decompress_fn) in codecs() {
+            // One buffer of each kind, reused across every input
+            let mut compressed = vec![0u8; 0];
+            let mut decompressed = vec![0u8; 0];
+
+            for input in &inputs {
+                let bound = unsafe { bound_fn(input.len()) };
+                assert!(bound > 0, "{}: bound should be non-zero", name);
+                if compressed.len() < bound {
+                    compressed.resize(bound, 0);
+                }
+
+                let mut compressed_len = 0usize;
+                let rc = unsafe {
+                    compress_fn(input.as_ptr() as *const c_char, input.len(),
+                                compressed.as_mut_ptr() as *mut c_char, compressed.len(), &mut compressed_len)
+                };
+                assert_eq!(rc, CODEC_OK, "{}: compress_into failed", name);
+                assert!(compressed_len <= bound, "{}: output exceeded bound", name);
+
+                let mut original_len = 0usize;
+                let rc = unsafe {
+                    decompressed_length(compressed.as_ptr() as *const c_char, compressed_len, &mut original_len)
+                };
+                assert_eq!(rc, CODEC_OK);
+                assert_eq!(original_len, input.len(), "{}: header length mismatch", name);
+
+                if decompressed.len() < original_len {
+                    decompressed.resize(original_len, 0);
+                }
+                let mut decompressed_len = 0usize;
+                let rc = unsafe {
+                    decompress_fn(compressed.as_ptr() as *const c_char, compressed_len,
+                                  decompressed.as_mut_ptr() as *mut c_char, decompressed.len(), &mut decompressed_len)
+                };
+                assert_eq!(rc, CODEC_OK, "{}: decompress_into failed", name);
+                assert_eq!(&decompressed[..decompressed_len], &input[..], "{}: round trip mismatch", name);
+            }
+        }
+    }
+
+    #[test]
+    fn test_into_buffer_too_small() {
+        let input = "Some data that will not fit in a tiny buffer. ".repeat(20);
+        for (name, bound_fn, compress_fn, decompress_fn) in codecs() {
+            let mut tiny = [0u8; 4];
+            let mut out_len = 0usize;
+            let rc = unsafe {
+                compress_fn(input.as_ptr() as *const c_char, input.len(),
+                            tiny.as_mut_ptr() as *mut c_char, tiny.len(), &mut out_len)
+            };
+            assert_eq!(rc, CODEC_ERR_BUFFER_TOO_SMALL, "{}: compress into tiny buffer", name);
+
+            let mut compressed = vec![0u8; unsafe { bound_fn(input.len()) }];
+            let mut compressed_len = 0usize;
+            let rc = unsafe {
+                compress_fn(input.as_ptr() as *const c_char, input.len(),
+                            compressed.as_mut_ptr() as *mut c_char, compressed.len(), &mut compressed_len)
+            };
+            assert_eq!(rc, CODEC_OK);
+
+            // Decompressing into a short buffer reports the required size
+            let mut required = 0usize;
+            let rc = unsafe {
+                decompress_fn(compressed.as_ptr() as *const c_char, compressed_len,
+                              tiny.as_mut_ptr() as *mut c_char, tiny.len(), &mut required)
+            };
+            assert_eq!(rc, CODEC_ERR_BUFFER_TOO_SMALL, "{}: decompress into tiny buffer", name);
+            assert_eq!(required, input.len(), "{}: required size should be reported", name);
+        }
+    }
+
+    #[test]
+    fn test_into_rejects_corrupt_and_null() {
+        let mut out = [0u8; 64];
+        let mut out_len = 0usize;
+        for (name, _, _, decompress_fn) in codecs() {
+            let garbage = [0xFFu8, 0xFF, 0xFF];
+            let rc = unsafe {
+                decompress_fn(garbage.as_ptr() as *const c_char, garbage.len(),
+                              out.as_mut_ptr() as *mut c_char, out.len(), &mut out_len)
+            };
+            assert_eq!(rc, CODEC_ERR_CORRUPT, "{}: garbage input should be corrupt", name);
+
+            let rc = unsafe {
+                decompress_fn(garbage.as_ptr() as *const c_char, garbage.len(),
+                              out.as_mut_ptr() as *mut c_char, out.len(), std::ptr::null_mut())
+            };
+            assert_eq!(rc, CODEC_ERR_INVALID_ARG, "{}: null out_len should be rejected", name);
+        }
+    }
+}
+
+/// Reusable compression context wrapping the C `codec_ctx` handle.
+///
+/// Keeps the codec's internal state (ZSTD_CCtx/ZSTD_DCtx, LZ4 stream, zlib streams)
+/// alive across calls, which matters most for small messages where context setup
+/// dominates. The handle is freed when the value is dropped.
+///
+/// A context can be moved between threads but not shared by them.
+pub struct CodecContext {
+    ctx: *mut CodecCtx,
+    codec: Codec,
+    dict: Option<Dictionary>, // keeps the attached C dictionary alive
+}
+
+// The C context has no thread affinity; it only must not be used concurrently.
+unsafe impl Send for CodecContext {}
+
+impl CodecContext {
+    /// Creates a context for `codec`.
+    ///
+    /// # Returns
+    /// * `Ok(CodecContext)` on success.
+    /// * `Err(&str)` if the C library failed to allocate the context.
+    pub fn new(codec: Codec) -> Result<Self, &'static str> {
+        let ctx = unsafe { codec_ctx_create(codec as i32) };
+        if ctx.is_null() {
+            return Err("Failed to create codec context");
+        }
+        Ok(CodecContext { ctx, codec, dict: None })
+    }
+
+    /// Creates a context for `codec` that compresses at `level`.
+    ///
+    /// # Returns
+    /// * `Err(&str)` if the level is outside [`Codec::level_range`] or allocation fails.
+    pub fn with_level(codec: Codec, level: i32) -> Result<Self, &'static str> {
+        let mut ctx = Self::new(codec)?;
+        ctx.set_level(level)?;
+        Ok(ctx)
+    }
+
+    /// Changes the level used by later compress calls.
+    pub fn set_level(&mut self, level: i32) -> Result<(), &'static str> {
+        if unsafe { codec_ctx_set_level(self.ctx, level) } != CODEC_OK {
+            return Err("Compression level out of range for codec");
+        }
+        Ok(())
+    }
+
+    /// Turns checksum verification of frames decoded through this context off (for
+    /// trusted data) or back on; it is on by default.
+    pub fn set_verify(&mut self, verify: bool) {
+        unsafe { codec_ctx_set_verify(self.ctx, verify as i32) };
+    }
+
+    /// Returns the codec this context was created for.
+    pub fn codec(&self) -> Codec {
+        self.codec
+    }
+
+    /// Uses `dict` for later compress and decompress calls, or none with `None`.
+    ///
+    /// Output then carries the dictionary ID after the length header, and decompressing
+    /// data that names another dictionary fails.
+    ///
+    /// # Returns
+    /// * `Err(&str)` if the dictionary was digested for a different codec.
+    pub fn set_dictionary(&mut self, dict: Option<&Dictionary>) -> Result<(), &'static str> {
+        let handle = dict.map_or(std::ptr::null(), |d| d.inner.dict as *const CodecDict);
+        if unsafe { codec_ctx_set_dict(self.ctx, handle) } != CODEC_OK {
+            return Err("Dictionary was created for a different codec");
+        }
+        self.dict = dict.cloned();
+        Ok(())
+    }
+
+    /// Compresses `input` into `output`, replacing its contents.
+    /// Reusing the same `output` across calls avoids reallocating it.
+    ///
+    /// # Returns
+    /// * `Ok(usize)` with the compressed length (equal to `output.len()`).
+    /// * `Err(&str)` if compression fails.
+    pub fn compress_into(&mut self, input: &[u8], output: &mut Vec<u8>) -> Result<usize, &'static str> {
+        let bound = unsafe { codec_compress_bound(self.codec as i32, input.len()) };
+        if bound == 0 {
+            return Err("Input too large for codec");
+        }
+        output.clear();
+        output.reserve(bound);
+
+        let mut output_len = 0usize;
+        let rc = unsafe {
+            codec_ctx_compress(
+                self.ctx,
+                input.as_ptr() as *const c_char,
+                input.len(),
+                output.as_mut_ptr() as *mut c_char,
+                output.capacity(),
+                &mut output_len,
+            )
+        };
+        if rc != CODEC_OK {
+            return Err("Compression failed in C library");
+        }
+        // The C side initialized exactly output_len bytes
+        unsafe { output.set_len(output_len) };
+        Ok(output_len)
+    }
+
+    /// Compresses `input` into a new `Vec<u8>`.
+    pub fn compress(&mut self, input: &[u8]) -> Result<Vec<u8>, &'static str> {
+        let mut output = Vec::new();
+        self.compress_into(input, &mut output)?;
+        Ok(output)
+    }
+
+    /// Decompresses `input`, replacing the contents of `output`.
+    ///
+    /// # Returns
+    /// * `Ok(usize)` with the decompressed length (equal to `output.len()`).
+    /// * `Err(&str)` if the header or payload is invalid.
+    pub fn decompress_into(&mut self, input: &[u8], output: &mut Vec<u8>) -> Result<usize, &'static str> {
+        let mut original_len = 0usize;
+        let rc = unsafe { decompressed_length(input.as_ptr() as *const c_char, input.len(), &mut original_len) };
+        if rc != CODEC_OK {
+            return Err("Invalid compressed data header");
+        }
+        output.clear();
+        output.try_reserve(original_len).map_err(|_| "Original length too large to allocate")?;
+
+        let mut output_len = 0usize;
+        let rc = unsafe {
+            codec_ctx_decompress(
+                self.ctx,
+                input.as_ptr() as *const c_char,
+                input.len(),
+                output.as_mut_ptr() as *mut c_char,
+                output.capacity(),
+                &mut output_len,
+            )
+        };
+        match rc {
+            CODEC_OK => {}
+            CODEC_ERR_DICT_MISMATCH => return Err("Data was compressed with a different dictionary"),
+            _ => return Err("Decompression failed in C library"),
+        }
+        unsafe { output.set_len(output_len) };
+        Ok(output_len)
+    }
+
+    /// Decompresses `input` into a new `Vec<u8>`.
+    pub fn decompress(&mut self, input: &[u8]) -> Result<Vec<u8>, &'static str> {
+        let mut output = Vec::new();
+        self.decompress_into(input, &mut output)?;
+        Ok(output)
+    }
+
+    /// Compresses `input` into a self-describing frame (see [`compress_rust_frame`]),
+    /// using this context's level and dictionary.
+    ///
+    /// # Returns
+    /// * `Ok(Vec<u8>)` containing the frame if successful.
+    /// * `Err(&str)` if compression fails.
+    pub fn compress_frame(&mut self, input: &[u8], checksum: bool) -> Result<Vec<u8>, &'static str> {
+        let bound = unsafe { frame_compress_bound(self.codec as i32, input.len()) };
+        if bound == 0 {
+            return Err("Input too large for codec");
+        }
+        let mut output: Vec<u8> = Vec::with_capacity(bound);
+        let mut output_len = 0usize;
+        let flags = if checksum { FRAME_CHECKSUM } else { 0 };
+        let rc = unsafe {
+            codec_ctx_compress_frame(
+                self.ctx,
+                flags,
+                input.as_ptr() as *const c_char,
+                input.len(),
+                output.as_mut_ptr() as *mut c_char,
+                output.capacity(),
+                &mut output_len,
+            )
+        };
+        if rc != CODEC_OK {
+            return Err("Compression failed in C library");
+        }
+        unsafe { output.set_len(output_len) };
+        Ok(output)
+    }
+
+    /// Decompresses a frame written for this context's codec (and dictionary, if any).
+    ///
+    /// # Returns
+    /// * `Ok(Vec<u8>)` containing the original data if successful.
+    /// * `Err(&str)` if the frame is invalid, was written by another codec or with
+    ///   another dictionary, or fails its checksum.
+    pub fn decompress_frame(&mut self, input: &[u8]) -> Result<Vec<u8>, &'static str> {
+        let info = frame_info(input)?;
+        let mut output: Vec<u8> = Vec::new();
+        output.try_reserve(info.original_len).map_err(|_| "Original length too large to allocate")?;
+
+        let mut output_len = 0usize;
+        let rc = unsafe {
+            codec_ctx_decompress_frame(
+                self.ctx,
+                input.as_ptr() as *const c_char,
+                input.len(),
+                output.as_mut_ptr() as *mut c_char,
+                info.original_len,
+                &mut output_len,
+            )
+        };
+        if rc != CODEC_OK {
+            return Err(frame_error(rc));
+        }
+        unsafe { output.set_len(output_len) };
+        Ok(output)
+    }
+
+    /// Compresses every item of `inputs` in one FFI call, replacing the contents of
+    /// `batch`. Results are stored back to back in a single arena; reusing the same
+    /// `batch` across calls avoids reallocating it.
+    ///
+    /// # Returns
+    /// * `Err(&str)` if any item fails to compress.
+    pub fn compress_batch(&mut self, inputs: &[&[u8]], batch: &mut BatchBuffer) -> Result<(), &'static str> {
+        batch.load_inputs(inputs);
+        let bound = unsafe { codec_batch_compress_bound(self.codec as i32, batch.input_lens.as_ptr(), inputs.len()) };
+        if bound == 0 && !inputs.is_empty() {
+            return Err("Input too large for codec");
+        }
+        batch.run(bound, |ptrs, lens, arena, arena_cap, offsets| unsafe {
+            codec_batch_compress(self.ctx, ptrs, lens, inputs.len(), arena, arena_cap, offsets)
+        })
+        .map_err(|_| "Batch compression failed in C library")
+    }
+
+    /// Decompresses every item of `inputs` in one FFI call, replacing the contents of `batch`.
+    ///
+    /// # Returns
+    /// * `Err(&str)` if any item's header or payload is invalid.
+    pub fn decompress_batch(&mut self, inputs: &[&[u8]], batch: &mut BatchBuffer) -> Result<(), &'static str> {
+        batch.load_inputs(inputs);
+        let mut total = 0usize;
+        let rc = unsafe {
+            codec_batch_decompressed_size(batch.input_ptrs.as_ptr(), batch.input_lens.as_ptr(), inputs.len(), &mut total)
+        };
+        if rc != CODEC_OK {
+            return Err("Invalid compressed data header");
+        }
+        batch.arena.clear();
+        batch.arena.try_reserve(total).map_err(|_| "Original length too large to allocate")?;
+        batch.run(total, |ptrs, lens, arena, arena_cap, offsets| unsafe {
+            codec_batch_decompress(self.ctx, ptrs, lens, inputs.len(), arena, arena_cap, offsets)
+        })
+        .map_err(|_| "Batch decompression failed in C library")
+    }
+}
+
+impl Drop for CodecContext {
+    fn drop(&mut self) {
+        unsafe { codec_ctx_destroy(self.ctx) };
+    }
+}
+
+/// Frees the calling thread's cached contexts.
+///
+/// [`compress`], [`decompress`] and the `*_rust_string*` functions reuse one C context per
+/// codec and thread; they are freed automatically when the thread exits, and recreated on
+/// demand after this call. All of these functions may be called from any number of
+/// threads at once.
+///
+/// # Returns
+/// The number of contexts released.
+pub fn release_thread_contexts() -> usize {
+    unsafe { codec_thread_cache_release() as usize }
+}
+
+/// Output of [`CodecContext::compress_batch`] / [`CodecContext::decompress_batch`].
+///
+/// Holds every result in one contiguous arena plus an offsets table, and keeps the
+/// pointer/length scratch arrays handed to C so a reused buffer does not allocate.
+#[derive(Default)]
+pub struct BatchBuffer {
+    arena: Vec<u8>,
+    offsets: Vec<usize>,
+    input_ptrs: Vec<*const c_char>,
+    input_lens: Vec<usize>,
+}
+
+// The raw pointers are only scratch space that is rewritten before each call.
+unsafe impl Send for BatchBuffer {}
+
+impl BatchBuffer {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Number of items in the last batch.
+    pub fn len(&self) -> usize {
+        self.offsets.len().saturating_sub(1)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Returns item `i`, or `None` if out of range.
+    pub fn get(&self, i: usize) -> Option<&[u8]> {
+        if i >= self.len() {
+            return None;
+        }
+        Some(&self.arena[self.offsets[i]..self.offsets[i + 1]])
+    }
+
+    /// Iterates over the items in order.
+    pub fn iter(&self) -> impl Iterator<Item = &[u8]> + '_ {
+        self.offsets.windows(2).map(move |w| &self.arena[w[0]..w[1]])
+    }
+
+    /// The contiguous arena holding every item back to back.
+    pub fn arena(&self) -> &[u8] {
+        &self.arena
+    }
+
+    /// Item boundaries: item `i` is `arena()[offsets()[i]..offsets()[i + 1]]`.
+    pub fn offsets(&self) -> &[usize] {
+        &self.offsets
+    }
+
+    fn load_inputs(&mut self, inputs: &[&[u8]]) {
+        self.input_ptrs.clear();
+        self.input_lens.clear();
+        for input in inputs {
+            self.input_ptrs.push(input.as_ptr() as *const c_char);
+            self.input_lens.push(input.len());
+        }
+    }
+
+    // Size the arena and offsets, run the C batch call and trim to what it wrote
+    fn run<F>(&mut self, arena_cap: usize, call: F) -> Result<(), i32>
+    where
+        F: FnOnce(*const *const c_char, *const usize, *mut c_char, usize, *mut usize) -> i32,
+    {
+        let count = self.input_lens.len();
+        self.arena.clear();
+        self.arena.reserve(arena_cap);
+        self.offsets.clear();
+        self.offsets.resize(count + 1, 0);
+
+        let rc = call(
+            self.input_ptrs.as_ptr(),
+            self.input_lens.as_ptr(),
+            self.arena.as_mut_ptr() as *mut c_char,
+            arena_cap,
+            self.offsets.as_mut_ptr(),
+        );
+        if rc != CODEC_OK {
+            self.offsets.clear();
+            return Err(rc);
+        }
+        // The C side initialized the arena up to the final offset
+        unsafe { self.arena.set_len(self.offsets[count]) };
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod context_tests {
+    use super::*;
+
+    const CODECS: [Codec; 3] = [Codec::Zlib, Codec::Lz4, Codec::Zstd];
+
+    #[test]
+    fn test_context_round_trip_many_messages() {
+        for codec in CODECS {
+            let mut ctx = CodecContext::new(codec).expect("context creation should work");
+            let mut compressed = Vec::new();
+            let mut decompressed = Vec::new();
+            for i in 0..200 {
+                let message = format!("{{\"id\":{},\"name\":\"user_{}\",\"active\":true}}", i, i % 7).repeat(i % 5 + 1);
+                ctx.compress_into(message.as_bytes(), &mut compressed).expect("compress should work");
+                ctx.decompress_into(&compressed, &mut decompressed).expect("decompress should work");
+                assert_eq!(decompressed, message.as_bytes(), "{:?}: round trip mismatch at {}", codec, i);
+            }
+        }
+    }
+
+    #[test]
+    fn test_context_output_matches_one_shot_format() {
+        let input = "Context output must be readable by the one-shot decompressors. ".repeat(30);
+        for codec in CODECS {
+            let compressed = CodecContext::new(codec).unwrap().compress(input.as_bytes()).unwrap();
+            let decompressed = match codec {
+                Codec::Zlib => decompress_rust_data(&compressed),
+                Codec::Lz4 => decompress_rust_data_lz4(&compressed),
+                Codec::Zstd => decompress_rust_data_zstd(&compressed),
+            };
+            assert_eq!(decompressed.expect("one-shot decompress should accept context output"), input);
+
+            let one_shot = match codec {
+                Codec::Zlib => compress_rust_string(&input),
+                Codec::Lz4 => compress_rust_string_lz4(&input),
+                Codec::Zstd => compress_rust_string_zstd(&input),
+            }
+            .unwrap();
+            let mut ctx = CodecContext::new(codec).unwrap();
+            assert_eq!(ctx.decompress(&one_shot).unwrap(), input.as_bytes());
+        }
+    }
+
+    #[test]
+    fn test_context_empty_and_binary_input() {
+        for codec in CODECS {
+            let mut ctx = CodecContext::new(codec).unwrap();
+            let empty = ctx.compress(b"").unwrap();
+            assert!(ctx.decompress(&empty).unwrap().is_empty(), "{:?}: empty round trip", codec);
+
+            let binary: Vec<u8> = (0..4096u32).map(|i| (i.wrapping_mul(2654435761) >> 24) as u8).collect();
+            let compressed = ctx.compress(&binary).unwrap();
+            assert_eq!(ctx.decompress(&compressed).unwrap(), binary, "{:?}: binary round trip", codec);
+        }
+    }
+
+    #[test]
+    fn test_context_rejects_corrupt_input() {
+        for codec in CODECS {
+            let mut ctx = CodecContext::new(codec).unwrap();
+            let mut compressed = ctx.compress("valid data valid data valid data".as_bytes()).unwrap();
+            let last = compressed.len() - 1;
+            compressed.truncate(last);
+            assert!(ctx.decompress(&compressed).is_err(), "{:?}: truncated input should fail", codec);
+            assert!(ctx.decompress(&[0xFF, 0xFF, 0xFF]).is_err(), "{:?}: garbage should fail", codec);
+
+            // The context must still work after a failed call
+            let ok = ctx.compress(b"still usable").unwrap();
+            assert_eq!(ctx.decompress(&ok).unwrap(), b"still usable");
+        }
+    }
+}
+
+// Inputs shared by the test modules below
+#[cfg(test)]
+mod test_fixtures {
+    /// `len` bytes of access-log-like ASCII: compressible like real logs but not periodic,
+    /// so block, chunk and range boundaries all land on different content
+    pub fn sample_text(len: usize) -> String {
+        let mut data = String::with_capacity(len + 128);
+        let mut i = 0usize;
+        while data.len() < len {
+            data.push_str(&format!(
+                "[2023-01-01 12:{:02}:{:02}] INFO worker={} request_id={} status=ok latency_ms={}\n",
+                i / 60 % 60, i % 60, i % 8, i * 7919, i % 113
+            ));
+            i += 1;
+        }
+        data.truncate(len);
+        data
+    }
+
+    pub fn sample_data(len: usize) -> Vec<u8> {
+        sample_text(len).into_bytes()
+    }
+}
+
+#[cfg(test)]
+mod level_tests {
+    use super::*;
+    use crate::test_fixtures::sample_text;
+
+    #[test]
+    fn test_levels_round_trip_across_range() {
+        let data = sample_text(32 * 1024);
+        let cases = vec![
+            (Codec::Zlib, vec![-1, 0, 1, 6, 9]),
+            (Codec::Lz4, vec![-100, -8, -1, 0, 1, 3, 9, 12]),
+            (Codec::Zstd, vec![-5, -1, 1, 3, 9, 19]),
+        ];
+        for (codec, levels) in cases {
+            for level in levels {
+                let compressed = compress_with_level(codec, level, data.as_bytes())
+                    .unwrap_or_else(|e| panic!("{:?} level {} failed: {}", codec, level, e));
+                let mut ctx = CodecContext::new(codec).unwrap();
+                let decompressed = ctx.decompress(&compressed).unwrap();
+                assert_eq!(decompressed, data.as_bytes(), "{:?} level {} round trip", codec, level);
+            }
+        }
+    }
+
+    #[test]
+    fn test_higher_levels_compress_better() {
+        let data = sample_text(32 * 1024);
+        let size = |codec, level| compress_with_level(codec, level, data.as_bytes()).unwrap().len();
+        assert!(size(Codec::Zstd, 19) < size(Codec::Zstd, -5), "zstd 19 should beat zstd -5");
+        assert!(size(Codec::Lz4, 12) < size(Codec::Lz4, -50), "LZ4HC should beat accelerated LZ4");
+        assert!(size(Codec::Zlib, 9) <= size(Codec::Zlib, 1), "zlib 9 should not lose to zlib 1");
+    }
+
+    #[test]
+    fn test_default_level_matches_plain_functions() {
+        let data = sample_text(32 * 1024);
+        assert_eq!(compress_with_level(Codec::Zlib, Codec::Zlib.default_level(), data.as_bytes()).unwrap(),
+                   compress_rust_string(&data).unwrap());
+        assert_eq!(compress_with_level(Codec::Lz4, Codec::Lz4.default_level(), data.as_bytes()).unwrap(),
+                   compress_rust_string_lz4(&data).unwrap());
+        assert_eq!(compress_with_level(Codec::Zstd, Codec::Zstd.default_level(), data.as_bytes()).unwrap(),
+                   compress_rust_string_zstd(&data).unwrap());
+    }
+
+    #[test]
+    fn test_level_out_of_range_rejected() {
+        for codec in [Codec::Zlib, Codec::Lz4, Codec::Zstd] {
+            let (min_level, max_level) = codec.level_range();
+            assert!(min_level < max_level);
+            assert!(CodecContext::with_level(codec, max_level + 1).is_err(), "{:?}: above max", codec);
+            assert!(CodecContext::with_level(codec, min_level - 1).is_err(), "{:?}: below min", codec);
+        }
+    }
+
+    #[test]
+    fn test_context_level_change_between_calls() {
+        let data = sample_text(32 * 1024);
+        let mut ctx = CodecContext::new(Codec::Zlib).unwrap();
+        let default_out = ctx.compress(data.as_bytes()).unwrap();
+        ctx.set_level(1).unwrap();
+        let fast_out = ctx.compress(data.as_bytes()).unwrap();
+        assert_ne!(default_out, fast_out, "changing the zlib level should change the output");
+        assert_eq!(ctx.decompress(&fast_out).unwrap(), data.as_bytes());
+    }
+}
+
+// Opaque C `codec_dict` handle
+#[repr(C)]
+pub struct CodecDict {
+    _private: [u8; 0],
+}
+
+/// Trains a dictionary of at most `max_size` bytes from sample messages.
+///
+/// Works best with a few hundred samples that look like the messages that will be
+/// compressed; 16-112 KB is a typical size. The result can be used with every codec.
+///
+/// # Returns
+/// * `Ok(Vec<u8>)` containing the dictionary if successful.
+/// * `Err(&str)` if there are too few samples to train on.
+pub fn train_dictionary(samples: &[&[u8]], max_size: usize) -> Result<Vec<u8>, &'static str> {
+    let joined: Vec<u8> = samples.concat();
+    let lens: Vec<usize> = samples.iter().map(|s| s.len()).collect();
+    let mut dict: Vec<u8> = Vec::with_capacity(max_size);
+    let mut dict_len = 0usize;
+    let rc = unsafe {
+        dict_train(
+            joined.as_ptr() as *const c_char,
+            lens.as_ptr(),
+            lens.len(),
+            dict.as_mut_ptr() as *mut c_char,
+            max_size,
+            &mut dict_len,
+        )
+    };
+    if rc != CODEC_OK {
+        return Err("Dictionary training failed (too few or too small samples)");
+    }
+    unsafe { dict.set_len(dict_len) };
+    Ok(dict)
+}
+
+/// Reads the dictionary ID from data compressed by a [`CodecContext`] with a dictionary,
+/// so the matching [`Dictionary`] can be looked up before decompressing.
+pub fn compressed_dictionary_id(input: &[u8]) -> Result<u32, &'static str> {
+    let mut id = 0u32;
+    if unsafe { compressed_dict_id(input.as_ptr() as *const c_char, input.len(), &mut id) } != CODEC_OK {
+        return Err("Invalid compressed data header");
+    }
+    Ok(id)
+}
+
+/// A dictionary digested once for one codec and shared by any number of contexts.
+///
+/// Cloning is cheap (reference counted); the C handle is freed once the last clone
+/// and every context using it are dropped.
+#[derive(Clone)]
+pub struct Dictionary {
+    inner: std::sync::Arc<DictHandle>,
+}
+
+struct DictHandle {
+    dict: *mut CodecDict,
+    codec: Codec,
+}
+
+// A digested dictionary is only read after creation, so it can be shared across threads.
+unsafe impl Send for DictHandle {}
+unsafe impl Sync for DictHandle {}
+
+impl Drop for DictHandle {
+    fn drop(&mut self) {
+        unsafe { codec_dict_destroy(self.dict) };
+    }
+}
+
+impl Dictionary {
+    /// Digests `content` (e.g. from [`train_dictionary`]) for `codec`.
+    /// zstd compresses at `level` with this dictionary; zlib and LZ4 follow the context level.
+    ///
+    /// # Returns
+    /// * `Err(&str)` if `content` is empty, the level is out of range or allocation fails.
+    pub fn new(codec: Codec, level: i32, content: &[u8]) -> Result<Self, &'static str> {
+        let dict = unsafe { codec_dict_create(codec as i32, level, content.as_ptr() as *const c_char, content.len()) };
+        if dict.is_null() {
+            return Err("Failed to create dictionary");
+        }
+        Ok(Dictionary { inner: std::sync::Arc::new(DictHandle { dict, codec }) })
+    }
+
+    /// ID recorded in data compressed with this dictionary.
+    pub fn id(&self) -> u32 {
+        unsafe { codec_dict_id(self.inner.dict) }
+    }
+
+    /// Returns the codec this dictionary was digested for.
+    pub fn codec(&self) -> Codec {
+        self.inner.codec
+    }
+}
+
+#[cfg(test)]
+mod dict_tests {
+    use super::*;
+
+    const CODECS: [Codec; 3] = [Codec::Zlib, Codec::Lz4, Codec::Zstd];
+
+    fn messages(n: usize, seed: usize) -> Vec<Vec<u8>> {
+        (seed..seed + n)
+            .map(|i| {
+                format!(
+                    "{{\"id\":{},\"user\":\"user{}\",\"event\":\"page_view\",\"path\":\"/products/{}\",\"agent\":\"Mozilla/5.0 (X11; Linux x86_64)\",\"ok\":{}}}",
+                    i, i % 311, i % 53, i % 2 == 0
+                )
+                .into_bytes()
+            })
+            .collect()
+    }
+
+    fn trained() -> Vec<u8> {
+        let samples = messages(1000, 0);
+        let refs: Vec<&[u8]> = samples.iter().map(|s| s.as_slice()).collect();
+        train_dictionary(&refs, 16 * 1024).unwrap()
+    }
+
+    #[test]
+    fn test_dictionary_roundtrip_and_ratio() {
+        let content = trained();
+        let probe = messages(200, 5000);
+        for codec in CODECS {
+            let dict = Dictionary::new(codec, codec.default_level(), &content).unwrap();
+            let mut with_dict = CodecContext::new(codec).unwrap();
+            with_dict.set_dictionary(Some(&dict)).unwrap();
+            let mut plain = CodecContext::new(codec).unwrap();
+
+            let (mut dict_total, mut plain_total) = (0usize, 0usize);
+            for msg in &probe {
+                let compressed = with_dict.compress(msg).unwrap();
+                assert_eq!(compressed_dictionary_id(&compressed).unwrap(), dict.id());
+                assert_eq!(&with_dict.decompress(&compressed).unwrap(), msg, "{:?}", codec);
+                dict_total += compressed.len();
+                plain_total += plain.compress(msg).unwrap().len();
+            }
+            assert!(dict_total * 2 < plain_total, "{:?}: {} with dictionary vs {} without", codec, dict_total, plain_total);
+        }
+    }
+
+    #[test]
+    fn test_dictionary_id_mismatch_is_reported() {
+        let mut ctx = CodecContext::new(Codec::Zstd).unwrap();
+        let a = Dictionary::new(Codec::Zstd, 3, &trained()).unwrap();
+        let b = Dictionary::new(Codec::Zstd, 3, b"an unrelated raw content dictionary").unwrap();
+        assert_ne!(a.id(), b.id());
+        ctx.set_dictionary(Some(&a)).unwrap();
+        let compressed = ctx.compress(b"{\"id\":1,\"user\":\"user1\"}").unwrap();
+        ctx.set_dictionary(Some(&b)).unwrap();
+        assert_eq!(ctx.decompress(&compressed), Err("Data was compressed with a different dictionary"));
+        ctx.set_dictionary(None).unwrap();
+        assert!(ctx.decompress(&compressed).is_err(), "dictionary data needs its dictionary");
+    }
+
+    #[test]
+    fn test_raw_content_dictionary_and_hc_level() {
+        let content = b"{\"id\":,\"user\":\"user\",\"event\":\"page_view\",\"path\":\"/products/\"}".repeat(4);
+        let msg = br#"{"id":7,"user":"user7","event":"page_view","path":"/products/7"}"#;
+        for (codec, level) in [(Codec::Zlib, 9), (Codec::Lz4, 0), (Codec::Lz4, 9), (Codec::Zstd, 19)] {
+            let dict = Dictionary::new(codec, level, &content).unwrap();
+            let mut ctx = CodecContext::with_level(codec, level).unwrap();
+            ctx.set_dictionary(Some(&dict)).unwrap();
+            let compressed = ctx.compress(msg).unwrap();
+            assert_eq!(ctx.decompress(&compressed).unwrap(), msg.to_vec(), "{:?} level {}", codec, level);
+            let empty = ctx.compress(b"").unwrap();
+            assert_eq!(ctx.decompress(&empty).unwrap(), Vec::<u8>::new());
+        }
+    }
+
+    #[test]
+    fn test_dictionary_rejects_bad_arguments() {
+        assert!(Dictionary::new(Codec::Zstd, 3, b"").is_err());
+        assert!(Dictionary::new(Codec::Zlib, 42, b"content").is_err());
+        let lz4 = Dictionary::new(Codec::Lz4, 0, b"content").unwrap();
+        let mut ctx = CodecContext::new(Codec::Zstd).unwrap();
+        assert!(ctx.set_dictionary(Some(&lz4)).is_err());
+        assert!(train_dictionary(&[b"too", b"few"], 1024).is_err());
+    }
+}
+
+// Opaque C `codec_stream` handle
+#[repr(C)]
+pub struct CodecStreamHandle {
+    _private: [u8; 0],
+}
+
+// Streaming modes and results (mirrors rust_ffi_example.h)
+pub const STREAM_COMPRESS: i32 = 0;
+pub const STREAM_DECOMPRESS: i32 = 1;
+pub const STREAM_OUTPUT_FULL: i32 = 1;
+pub const STREAM_FRAME_END: i32 = 2;
+
+// Output space reserved per stream_update/stream_end call
+const STREAM_CHUNK: usize = 64 * 1024;
+
+/// Streaming compressor or decompressor wrapping the C `codec_stream` handle.
+///
+/// Processes input of any size in chunks with constant memory. The compressed form is
+/// the codec's native frame (zstd frame with checksum, LZ4 frame, zlib stream) and
+/// carries no varint length header, so it is not interchangeable with
+/// `compress_rust_string*` output. The handle is freed when the value is dropped.
+pub struct CodecStream {
+    stream: *mut CodecStreamHandle,
+    finished: bool,
+}
+
+// The C stream has no thread affinity; it only must not be used concurrently.
+unsafe impl Send for CodecStream {}
+
+impl CodecStream {
+    /// Creates a streaming compressor for `codec` at `level` (see [`Codec::level_range`]).
+    ///
+    /// # Returns
+    /// * `Err(&str)` if the level is out of range or allocation fails.
+    pub fn compressor(codec: Codec, level: i32) -> Result<Self, &'static str> {
+        Self::begin(codec, STREAM_COMPRESS, level)
+    }
+
+    /// Creates a streaming decompressor for `codec`.
+    pub fn decompressor(codec: Codec) -> Result<Self, &'static str> {
+        Self::begin(codec, STREAM_DECOMPRESS, 0)
+    }
+
+    fn begin(codec: Codec, mode: i32, level: i32) -> Result<Self, &'static str> {
+        let stream = unsafe { stream_begin(codec as i32, mode, level) };
+        if stream.is_null() {
+            return Err("Failed to create codec stream");
+        }
+        Ok(CodecStream { stream, finished: false })
+    }
+
+    /// Feeds `input` to the stream, appending all output it produces to `output`.
+    ///
+    /// # Returns
+    /// * `Ok(usize)` with the number of input bytes consumed. This is `input.len()`
+    ///   unless decompression reached the end of the frame, in which case the
+    ///   trailing bytes are left unconsumed.
+    /// * `Err(&str)` if the data is corrupt or the codec fails.
+    pub fn update(&mut self, input: &[u8], output: &mut Vec<u8>) -> Result<usize, &'static str> {
+        let mut consumed = 0usize;
+        loop {
+            output.reserve(STREAM_CHUNK);
+            let spare = output.capacity() - output.len();
+            let mut step_consumed = 0usize;
+            let mut step_len = 0usize;
+            let rc = unsafe {
+                stream_update(
+                    self.stream,
+                    input[consumed..].as_ptr() as *const c_char,
+                    input.len() - consumed,
+                    &mut step_consumed,
+                    output.as_mut_ptr().add(output.len()) as *mut c_char,
+                    spare,
+                    &mut step_len,
+                )
+            };
+            if rc < 0 {
+                return Err("Stream update failed in C library");
+            }
+            consumed += step_consumed;
+            // The C side initialized exactly step_len bytes past the old length
+            unsafe { output.set_len(output.len() + step_len) };
+            match rc {
+                STREAM_OUTPUT_FULL => continue,
+                STREAM_FRAME_END => {
+                    self.finished = true;
+                    return Ok(consumed);
+                }
+                _ => return Ok(consumed),
+            }
+        }
+    }
+
+    /// Finishes the stream, appending any remaining output (the frame epilogue when
+    /// compressing) to `output`.
+    ///
+    /// # Returns
+    /// * `Err(&str)` if decompression ended before the end of the frame.
+    pub fn finish(&mut self, output: &mut Vec<u8>) -> Result<(), &'static str> {
+        loop {
+            output.reserve(STREAM_CHUNK);
+            let spare = output.capacity() - output.len();
+            let mut step_len = 0usize;
+            let rc = unsafe {
+                stream_end(
+                    self.stream,
+                    output.as_mut_ptr().add(output.len()) as *mut c_char,
+                    spare,
+                    &mut step_len,
+                )
+            };
+            if rc < 0 {
+                return Err("Stream ended before the end of the frame");
+            }
+            unsafe { output.set_len(output.len() + step_len) };
+            if rc != STREAM_OUTPUT_FULL {
+                self.finished = true;
+                return Ok(());
+            }
+        }
+    }
+
+    /// Returns true once the frame is complete: after [`CodecStream::finish`] when
+    /// compressing, or once the end of the frame was decoded when decompressing.
+    pub fn is_finished(&self) -> bool {
+        self.finished
+    }
+}
+
+impl Drop for CodecStream {
+    fn drop(&mut self) {
+        unsafe { stream_destroy(self.stream) };
+    }
+}
+
+#[cfg(test)]
+mod stream_tests {
+    use super::*;
+    use crate::test_fixtures::sample_data;
+
+    const CODECS: [Codec; 3] = [Codec::Zlib, Codec::Lz4, Codec::Zstd];
+
+    fn compress_chunked(codec: Codec, data: &[u8], chunk: usize) -> Vec<u8> {
+        let mut stream = CodecStream::compressor(codec, codec.default_level()).unwrap();
+        let mut out = Vec::new();
+        for piece in data.chunks(chunk.max(1)) {
+            assert_eq!(stream.update(piece, &mut out).unwrap(), piece.len());
+        }
+        stream.finish(&mut out).unwrap();
+        out
+    }
+
+    fn decompress_chunked(codec: Codec, data: &[u8], chunk: usize) -> Result<Vec<u8>, &'static str> {
+        let mut stream = CodecStream::decompressor(codec)?;
+        let mut out = Vec::new();
+        for piece in data.chunks(chunk.max(1)) {
+            stream.update(piece, &mut out)?;
+        }
+        stream.finish(&mut out)?;
+        Ok(out)
+    }
+
+    #[test]
+    fn test_stream_roundtrip_all_codecs() {
+        let data = sample_data(300 * 1024);
+        for codec in CODECS {
+            for chunk in [1usize, 1000, 64 * 1024, data.len()] {
+                // Byte-at-a-time is slow on 300 KB; use a smaller prefix for it
+                let input = if chunk == 1 { &data[..4096] } else { &data[..] };
+                let compressed = compress_chunked(codec, input, chunk);
+                for dchunk in [1usize, 777, compressed.len()] {
+                    let restored = decompress_chunked(codec, &compressed, dchunk).unwrap();
+                    assert_eq!(restored, input, "{:?}: chunk {} / {}", codec, chunk, dchunk);
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_stream_empty_input() {
+        for codec in CODECS {
+            let compressed = compress_chunked(codec, &[], 1024);
+            assert!(!compressed.is_empty(), "{:?}: a frame is still written", codec);
+            assert!(decompress_chunked(codec, &compressed, 1024).unwrap().is_empty());
+        }
+    }
+
+    #[test]
+    fn test_stream_truncated_frame_is_rejected() {
+        let data = sample_data(10 * 1024);
+        for codec in CODECS {
+            let compressed = compress_chunked(codec, &data, 4096);
+            let truncated = &compressed[..compressed.len() - 1];
+            assert!(decompress_chunked(codec, truncated, 4096).is_err(), "{:?}", codec);
+        }
+    }
+
+    #[test]
+    fn test_stream_corrupt_frame_is_rejected() {
+        for codec in CODECS {
+            let garbage = vec![0xA5u8; 256];
+            assert!(decompress_chunked(codec, &garbage, 64).is_err(), "{:?}", codec);
+        }
+    }
+
+    #[test]
+    fn test_stream_stops_at_frame_end() {
+        let data = sample_data(5000);
+        for codec in CODECS {
+            let mut compressed = compress_chunked(codec, &data, 5000);
+            let frame_len = compressed.len();
+            compressed.extend_from_slice(b"trailing");
+
+            let mut stream = CodecStream::decompressor(codec).unwrap();
+            let mut out = Vec::new();
+            let consumed = stream.update(&compressed, &mut out).unwrap();
+            assert_eq!(consumed, frame_len, "{:?}", codec);
+            assert!(stream.is_finished());
+            stream.finish(&mut out).unwrap();
+            assert_eq!(out, data);
+        }
+    }
+
+    #[test]
+    fn test_stream_rejects_bad_level() {
+        for codec in CODECS {
+            let (_, max_level) = codec.level_range();
+            assert!(CodecStream::compressor(codec, max_level + 1).is_err(), "{:?}", codec);
+        }
+    }
+}
+
+/// Compresses `input` into a block-parallel container using `threads` worker threads
+/// (0 = one per online CPU).
+///
+/// The input is split into blocks of [`parallel_default_block_size`] (1 MiB unless
+/// [`set_parallel_options`] changed it) that are compressed independently, so
+/// [`decompress_rust_parallel`] can decode them in parallel as well.
+///
+/// # Returns
+/// * `Ok(Vec<u8>)` containing the container if successful.
+/// * `Err(&str)` if the level is out of range or compression fails.
+pub fn compress_rust_parallel(codec: Codec, level: i32, threads: usize, input: &[u8]) -> Result<Vec<u8>, &'static str> {
+    compress_rust_parallel_blocks(codec, level, threads, 0, input)
+}
+
+/// Like [`compress_rust_parallel`] with an explicit `block_size` (0 = the default).
+///
+/// Smaller blocks make [`RangeReader`] reads cheaper, since a read decodes every block
+/// it touches, at some cost in compression ratio.
+pub fn compress_rust_parallel_blocks(codec: Codec, level: i32, threads: usize, block_size: usize, input: &[u8]) -> Result<Vec<u8>, &'static str> {
+    let bound = unsafe { compress_parallel_bound(codec as i32, input.len(), block_size) };
+    if bound == 0 {
+        return Err("Input too large for codec");
+    }
+    let mut output: Vec<u8> = Vec::with_capacity(bound);
+    let mut output_len = 0usize;
+    let rc = unsafe {
+        compress_parallel_into(
+            codec as i32,
+            level,
+            threads as i32,
+            block_size,
+            input.as_ptr() as *const c_char,
+            input.len(),
+            output.as_mut_ptr() as *mut c_char,
+            output.capacity(),
+            &mut output_len,
+        )
+    };
+    match rc {
+        CODEC_OK => {
+            unsafe { output.set_len(output_len) };
+            Ok(output)
+        }
+        CODEC_ERR_INVALID_ARG => Err("Compression level out of range for codec"),
+        _ => Err("Parallel compression failed in C library"),
+    }
+}
+
+/// Decompresses a container produced by [`compress_rust_parallel`] using `threads`
+/// worker threads (0 = one per online CPU). The codec is read from the container.
+///
+/// # Returns
+/// * `Ok(Vec<u8>)` containing the original data if successful.
+/// * `Err(&str)` if the container or any block is invalid.
+pub fn decompress_rust_parallel(threads: usize, input: &[u8]) -> Result<Vec<u8>, &'static str> {
+    let mut original_len = 0usize;
+    let rc = unsafe { parallel_decompressed_length(input.as_ptr() as *const c_char, input.len(), &mut original_len) };
+    if rc != CODEC_OK {
+        return Err("Invalid parallel container header");
+    }
+    let mut output: Vec<u8> = Vec::new();
+    output.try_reserve(original_len).map_err(|_| "Original length too large to allocate")?;
+
+    let mut output_len = 0usize;
+    let rc = unsafe {
+        decompress_parallel_into(
+            threads as i32,
+            input.as_ptr() as *const c_char,
+            input.len(),
+            output.as_mut_ptr() as *mut c_char,
+            original_len,
+            &mut output_len,
+        )
+    };
+    if rc != CODEC_OK {
+        return Err("Parallel decompression failed in C library");
+    }
+    unsafe { output.set_len(output_len) };
+    Ok(output)
+}
+
+// Block-parallel placement flags (mirrors PARALLEL_* in rust_ffi_example.h)
+pub const PARALLEL_PIN_WORKERS: i32 = 1;
+pub const PARALLEL_LOCAL_BLOCKS: i32 = 2;
+pub const PARALLEL_CACHE_BLOCKS: i32 = 4;
+
+#[cfg(test)]
+mod parallel_tests {
+    use super::*;
+    use crate::test_fixtures::sample_data;
+
+    const CODECS: [Codec; 3] = [Codec::Zlib, Codec::Lz4, Codec::Zstd];
+
+    #[test]
+    fn test_parallel_roundtrip_all_codecs() {
+        // Spans several 1 MiB blocks with a partial last block
+        let data = sample_data(3 * 1024 * 1024 + 12345);
+        for codec in CODECS {
+            let compressed = compress_rust_parallel(codec, codec.default_level(), 4, &data).unwrap();
+            assert_eq!(&compressed[..4], b"RFPB");
+            for threads in [1usize, 3, 0] {
+                let restored = decompress_rust_parallel(threads, &compressed).unwrap();
+                assert!(restored == data, "{:?}: {} threads", codec, threads);
+            }
+        }
+    }
+
+    #[test]
+    fn test_parallel_output_independent_of_thread_count() {
+        let data = sample_data(2 * 1024 * 1024 + 1);
+        for codec in CODECS {
+            let one = compress_rust_parallel(codec, codec.default_level(), 1, &data).unwrap();
+            let many = compress_rust_parallel(codec, codec.default_level(), 8, &data).unwrap();
+            assert_eq!(one, many, "{:?}", codec);
+        }
+    }
+
+    #[test]
+    fn test_parallel_small_and_empty_inputs() {
+        for codec in CODECS {
+            for data in [&b""[..], &b"x"[..], &b"hello parallel world"[..]] {
+                let compressed = compress_rust_parallel(codec, codec.default_level(), 0, data).unwrap();
+                assert_eq!(decompress_rust_parallel(0, &compressed).unwrap(), data, "{:?}", codec);
+            }
+        }
+    }
+
+    #[test]
+    fn test_parallel_custom_block_size() {
+        let data = sample_data(100_000);
+        for codec in CODECS {
+            let block_size = 4096;
+            let bound = unsafe { compress_parallel_bound(codec as i32, data.len(), block_size) };
+            let mut out = vec![0u8; bound];
+            let mut out_len = 0usize;
+            let rc = unsafe {
+                compress_parallel_into(codec as i32, codec.default_level(), 4, block_size,
+                                       data.as_ptr() as *const c_char, data.len(),
+                                       out.as_mut_ptr() as *mut c_char, out.len(), &mut out_len)
+            };
+            assert_eq!(rc, CODEC_OK);
+            out.truncate(out_len);
+            assert_eq!(decompress_rust_parallel(4, &out).unwrap(), data, "{:?}", codec);
+
+            // One byte short of the bound is rejected up front
+            let rc = unsafe {
+                compress_parallel_into(codec as i32, codec.default_level(), 4, block_size,
+                                       data.as_ptr() as *const c_char, data.len(),
+                                       out.as_mut_ptr() as *mut c_char, bound - 1, &mut out_len)
+            };
+            assert_eq!(rc, CODEC_ERR_BUFFER_TOO_SMALL);
+        }
+    }
+
+    #[test]
+    fn test_parallel_placement_options() {
+        // Only flags that leave the output unchanged, since the options are process-wide
+        // and the other tests compare outputs across calls
+        let data = sample_data(8 * 65536 + 999);
+        let block_size = 65536;
+        let reference = compress_rust_parallel_blocks(Codec::Zstd, 1, 1, block_size, &data).unwrap();
+        unsafe {
+            assert_eq!(set_parallel_options(8, 0), CODEC_ERR_INVALID_ARG);
+            assert_eq!(set_parallel_options(PARALLEL_CACHE_BLOCKS, 4096), CODEC_ERR_INVALID_ARG);
+            assert_eq!(set_parallel_options(PARALLEL_PIN_WORKERS | PARALLEL_LOCAL_BLOCKS, 0), CODEC_OK);
+        }
+        for threads in [1usize, 3, 8, 32] {
+            let compressed = compress_rust_parallel_blocks(Codec::Zstd, 1, threads, block_size, &data).unwrap();
+            assert!(compressed == reference, "{} threads", threads);
+            assert!(decompress_rust_parallel(threads, &compressed).unwrap() == data, "{} threads", threads);
+        }
+        assert!(decompress_rust_parallel(2, &reference[..reference.len() - 1]).is_err(), "truncated");
+        unsafe {
+            assert_eq!(set_parallel_options(0, 0), CODEC_OK);
+            assert_eq!(parallel_default_block_size(), 1024 * 1024);
+            let cache_block = parallel_cache_block_size();
+            assert!(cache_block.is_power_of_two() && (256 * 1024..=4 * 1024 * 1024).contains(&cache_block));
+            assert!(parallel_numa_nodes() >= 0);
+        }
+    }
+
+    #[test]
+    fn test_parallel_rejects_corruption() {
+        let data = sample_data(300_000);
+        let compressed = compress_rust_parallel(Codec::Zstd, 1, 2, &data).unwrap();
+
+        assert!(decompress_rust_parallel(2, &compressed[..compressed.len() - 1]).is_err(), "truncated");
+        assert!(decompress_rust_parallel(2, b"RFPB").is_err(), "header only");
+        assert!(decompress_rust_parallel(2, b"not a container").is_err(), "bad magic");
+
+        let mut flipped = compressed.clone();
+        let last = flipped.len() - 10;
+        flipped[last] ^= 0xFF;
+        assert!(decompress_rust_parallel(2, &flipped).is_err(), "corrupt block");
+
+        // Legacy single-shot data is not a container
+        let legacy = compress_rust_string("legacy").unwrap();
+        assert!(decompress_rust_parallel(1, &legacy).is_err());
+    }
+
+    #[test]
+    fn test_parallel_rejects_bad_level() {
+        let (_, max_level) = Codec::Zlib.level_range();
+        assert!(compress_rust_parallel(Codec::Zlib, max_level + 1, 2, b"data").is_err());
+    }
+}
+
+// Opaque C `range_reader` handle
+#[repr(C)]
+pub struct RangeReaderHandle {
+    _private: [u8; 0],
+}
+
+/// Random-access reader over a block-parallel container, wrapping the C `range_reader`.
+///
+/// The block index is resolved once in [`RangeReader::new`]; each read then decodes
+/// only the blocks that overlap the requested range. The reader borrows the container.
+pub struct RangeReader<'a> {
+    reader: *mut RangeReaderHandle,
+    _container: std::marker::PhantomData<&'a [u8]>,
+}
+
+// The C reader has no thread affinity; it only must not be used concurrently.
+unsafe impl Send for RangeReader<'_> {}
+
+impl<'a> RangeReader<'a> {
+    /// Opens a reader over a container from [`compress_rust_parallel`] (or `compress -j`).
+    ///
+    /// # Returns
+    /// * `Err(&str)` if `container` is not a valid block-parallel container.
+    pub fn new(container: &'a [u8]) -> Result<Self, &'static str> {
+        let reader = unsafe { range_reader_open(container.as_ptr() as *const c_char, container.len()) };
+        if reader.is_null() {
+            return Err("Invalid parallel container");
+        }
+        Ok(RangeReader { reader, _container: std::marker::PhantomData })
+    }
+
+    /// Original (decompressed) size of the container.
+    pub fn len(&self) -> usize {
+        unsafe { range_reader_size(self.reader) }
+    }
+
+    /// Returns true if the container holds no data.
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Reads original bytes `offset..offset + len` into `output`, replacing its contents.
+    /// A range running past the end is cut short.
+    ///
+    /// # Returns
+    /// * `Ok(usize)` with the number of bytes read (equal to `output.len()`).
+    /// * `Err(&str)` if `offset` is past the end or a block is corrupt.
+    pub fn read_into(&mut self, offset: usize, len: usize, output: &mut Vec<u8>) -> Result<usize, &'static str> {
+        if offset > self.len() {
+            return Err("Offset past the end of the data");
+        }
+        let len = len.min(self.len() - offset);
+        output.clear();
+        output.try_reserve(len).map_err(|_| "Range too large to allocate")?;
+
+        let mut output_len = 0usize;
+        let rc = unsafe {
+            range_reader_read(self.reader, offset, len, output.as_mut_ptr() as *mut c_char, len, &mut output_len)
+        };
+        if rc != CODEC_OK {
+            return Err("Range decompression failed in C library");
+        }
+        unsafe { output.set_len(output_len) };
+        Ok(output_len)
+    }
+
+    /// Reads original bytes `offset..offset + len` into a new `Vec<u8>`.
+    pub fn read(&mut self, offset: usize, len: usize) -> Result<Vec<u8>, &'static str> {
+        let mut output = Vec::new();
+        self.read_into(offset, len, &mut output)?;
+        Ok(output)
+    }
+}
+
+impl Drop for RangeReader<'_> {
+    fn drop(&mut self) {
+        unsafe { range_reader_close(self.reader) };
+    }
+}
+
+/// Reads original bytes `offset..offset + len` of a block-parallel container without
+/// decompressing the rest. Prefer a [`RangeReader`] for repeated reads.
+pub fn read_range_rust(container: &[u8], offset: usize, len: usize) -> Result<Vec<u8>, &'static str> {
+    RangeReader::new(container)?.read(offset, len)
+}
+
+#[cfg(test)]
+mod range_tests {
+    use super::*;
+    use crate::test_fixtures::sample_data;
+
+    #[test]
+    fn test_range_reads_match_slices() {
+        let data = sample_data(1_000_003);
+        for codec in [Codec::Zlib, Codec::Lz4, Codec::Zstd] {
+            let container = compress_rust_parallel_blocks(codec, codec.default_level(), 2, 64 * 1024, &data).unwrap();
+            let mut reader = RangeReader::new(&container).unwrap();
+            assert_eq!(reader.len(), data.len());
+            // Inside one block, across block boundaries, whole blocks, and the tail
+            for (offset, len) in [(0, 10), (65_530, 20), (64 * 1024, 64 * 1024), (100_000, 300_000), (999_990, 13), (0, data.len())] {
+                assert_eq!(reader.read(offset, len).unwrap(), &data[offset..offset + len], "{:?} {}+{}", codec, offset, len);
+            }
+            // Past the end is cut short; an offset past the end is an error
+            assert_eq!(reader.read(data.len() - 5, 100).unwrap(), &data[data.len() - 5..]);
+            assert!(reader.read(data.len(), 1).unwrap().is_empty());
+            assert!(reader.read(data.len() + 1, 1).is_err());
+        }
+        assert_eq!(read_range_rust(&compress_rust_parallel(Codec::Lz4, 0, 1, &data).unwrap(), 12345, 67).unwrap(),
+                   &data[12345..12345 + 67]);
+    }
+
+    #[test]
+    fn test_range_reader_small_buffer_and_bad_input() {
+        let data = sample_data(200_000);
+        let container = compress_rust_parallel_blocks(Codec::Zstd, 1, 1, 4096, &data).unwrap();
+        let mut out = vec![0u8; 8];
+        let mut out_len = 0usize;
+        let rc = unsafe {
+            read_range(container.as_ptr() as *const c_char, container.len(), 100, 50,
+                       out.as_mut_ptr() as *mut c_char, out.len(), &mut out_len)
+        };
+        assert_eq!(rc, CODEC_ERR_BUFFER_TOO_SMALL);
+        assert_eq!(out_len, 50);
+
+        assert!(RangeReader::new(&container[..container.len() - 1]).is_err());
+        assert!(RangeReader::new(b"RFPB").is_err());
+        let frame = compress_rust_frame(Codec::Zstd, 1, &data, false).unwrap();
+        assert!(RangeReader::new(&frame).is_err());
+
+        // A corrupt block only fails the reads that touch it
+        let mut flipped = container.clone();
+        let last = flipped.len() - 4;
+        flipped[last] ^= 0xFF;
+        let mut reader = RangeReader::new(&flipped).unwrap();
+        assert_eq!(reader.read(0, 4096).unwrap(), &data[..4096]);
+        assert!(reader.read(data.len() - 10, 10).is_err());
+    }
+}
+
+// Opaque C `record_reader` handle
+#[repr(C)]
+pub struct RecordReaderHandle {
+    _private: [u8; 0],
+}
+
+/// `record_reader_next` result after the last record (mirrors rust_ffi_example.h).
+pub const RECORD_END: i32 = 1;
+
+/// Encodes `records` as a sequence of varint-length-prefixed records, the layout
+/// [`RecordReader`] reads once the result is compressed.
+pub fn encode_records<T: AsRef<[u8]>>(records: &[T]) -> Vec<u8> {
+    let total: usize = records.iter().map(|r| r.as_ref().len() + 10).sum();
+    let mut out = Vec::with_capacity(total);
+    let mut prefix = [0u8; 10];
+    for record in records {
+        let record = record.as_ref();
+        let n = unsafe { encode_varint(record.len() as c_ulong, prefix.as_mut_ptr() as *mut c_char) };
+        out.extend_from_slice(&prefix[..n as usize]);
+        out.extend_from_slice(record);
+    }
+    out
+}
+
+/// Pull-based reader over compressed varint-length-prefixed records, wrapping the C
+/// `record_reader`.
+///
+/// The blob is decompressed on demand into a small window, so a scan that stops early
+/// (dropping the reader, `take(n)`, `find`) never decodes the rest.
+/// [`RecordReader::next_record`] borrows each record from the window without copying;
+/// the `Iterator` impl copies it into a `Vec`. After an error the reader yields nothing.
+pub struct RecordReader<'a> {
+    reader: *mut RecordReaderHandle,
+    finished: bool,
+    _blob: std::marker::PhantomData<&'a [u8]>,
+}
+
+// The C reader has no thread affinity; it only must not be used concurrently.
+unsafe impl Send for RecordReader<'_> {}
+
+impl<'a> RecordReader<'a> {
+    /// Opens a reader over `blob`, the [`compress_with_level`] / [`CodecContext::compress`]
+    /// output of `codec` (without a dictionary) for data from [`encode_records`].
+    ///
+    /// # Returns
+    /// * `Err(&str)` if the length header is malformed.
+    pub fn new(codec: Codec, blob: &'a [u8]) -> Result<Self, &'static str> {
+        Self::with_window(codec, blob, 0)
+    }
+
+    /// Like [`RecordReader::new`], with an initial window of `window` bytes (0 = 64 KiB).
+    pub fn with_window(codec: Codec, blob: &'a [u8], window: usize) -> Result<Self, &'static str> {
+        let reader = unsafe { record_reader_open(codec as i32, blob.as_ptr() as *const c_char, blob.len(), window) };
+        if reader.is_null() {
+            return Err("Invalid compressed record stream");
+        }
+        Ok(RecordReader { reader, finished: false, _blob: std::marker::PhantomData })
+    }
+
+    /// Returns the next record, borrowed from the reader's window.
+    ///
+    /// # Returns
+    /// * `None` after the last record (or after an error was returned).
+    /// * `Some(Err(&str))` if the payload or a length prefix is corrupt.
+    pub fn next_record(&mut self) -> Option<Result<&[u8], &'static str>> {
+        if self.finished {
+            return None;
+        }
+        let mut record: *const c_char = std::ptr::null();
+        let mut record_len = 0usize;
+        let rc = unsafe { record_reader_next(self.reader, &mut record, &mut record_len) };
+        match rc {
+            CODEC_OK if record_len == 0 => Some(Ok(&[])),
+            CODEC_OK => Some(Ok(unsafe { std::slice::from_raw_parts(record as *const u8, record_len) })),
+            RECORD_END => {
+                self.finished = true;
+                None
+            }
+            _ => {
+                self.finished = true;
+                Some(Err("Corrupt record stream"))
+            }
+        }
+    }
+}
+
+impl Iterator for RecordReader<'_> {
+    type Item = Result<Vec<u8>, &'static str>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        self.next_record().map(|record| record.map(<[u8]>::to_vec))
+    }
+}
+
+impl Drop for RecordReader<'_> {
+    fn drop(&mut self) {
+        unsafe { record_reader_close(self.reader) };
+    }
+}
+
+#[cfg(test)]
+mod record_tests {
+    use super::*;
+
+    fn sample_records(count: usize) -> Vec<Vec<u8>> {
+        // Mostly small records, with an empty one and a few larger than the window
+        (0..count)
+            .map(|i| {
+                let len = match i % 97 {
+                    0 => 0,
+                    13 => 150_000 + i,
+                    _ => (i * 37) % 300,
+                };
+                (0..len).map(|j| ((i * 31 + j * 7) % 251) as u8).collect()
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_record_reader_yields_every_record() {
+        let records = sample_records(2000);
+        let data = encode_records(&records);
+        for codec in [Codec::Zlib, Codec::Lz4, Codec::Zstd] {
+            let blob = compress_with_level(codec, codec.default_level(), &data).unwrap();
+            for window in [0, 16, 4096] {
+                let read: Vec<Vec<u8>> = RecordReader::with_window(codec, &blob, window).unwrap()
+                    .collect::<Result<_, _>>().unwrap();
+                assert_eq!(read, records, "{:?} window {}", codec, window);
+            }
+            let mut reader = RecordReader::new(codec, &blob).unwrap();
+            let mut count = 0;
+            while let Some(record) = reader.next_record() {
+                assert_eq!(record.unwrap(), &records[count][..]);
+                count += 1;
+            }
+            assert_eq!(count, records.len());
+            assert!(reader.next_record().is_none());
+
+            let empty = compress_with_level(codec, codec.default_level(), b"").unwrap();
+            assert_eq!(RecordReader::new(codec, &empty).unwrap().count(), 0);
+        }
+    }
+
+    #[test]
+    fn test_record_reader_stops_early() {
+        let records = sample_records(3000);
+        let data = encode_records(&records);
+        for codec in [Codec::Zlib, Codec::Lz4, Codec::Zstd] {
+            let full = compress_with_level(codec, codec.default_level(), &data).unwrap();
+            // A missing tail goes unnoticed by a scan that stops before reaching it
+            let blob = &full[..full.len() - 1000];
+            let first: Vec<Vec<u8>> = RecordReader::new(codec, blob).unwrap().take(10).map(Result::unwrap).collect();
+            assert_eq!(first, &records[..10], "{:?}", codec);
+            assert!(RecordReader::new(codec, blob).unwrap().any(|r| r.is_err()), "{:?}", codec);
+            assert!(decompress(codec, blob).is_err());
+        }
+    }
+
+    #[test]
+    fn test_record_reader_rejects_corrupt_input() {
+        let records = sample_records(500);
+        let data = encode_records(&records);
+        for codec in [Codec::Zlib, Codec::Lz4, Codec::Zstd] {
+            let blob = compress_with_level(codec, codec.default_level(), &data).unwrap();
+            // Truncated payloads fail part-way, after the records that were intact
+            let truncated = &blob[..blob.len() - 8];
+            let results: Vec<_> = RecordReader::new(codec, truncated).unwrap().collect();
+            assert!(results.last().unwrap().is_err(), "{:?}", codec);
+            assert!(results[..results.len() - 1].iter().zip(&records).all(|(r, e)| r.as_ref().unwrap() == e));
+
+            // A length prefix running past the data
+            let mut bad = encode_records(&records[..3]);
+            bad.extend_from_slice(&[0x80 | 100, 1]);
+            let bad_blob = compress_with_level(codec, codec.default_level(), &bad).unwrap();
+            let results: Vec<_> = RecordReader::new(codec, &bad_blob).unwrap().collect();
+            assert_eq!(results.len(), 4);
+            assert!(results[3].is_err());
+
+            // Payloads holding more or less data than the length header says
+            let (_, header_len) = decode_varint_rust(&blob).unwrap();
+            for claimed in [data.len() - 1, data.len() + 1] {
+                let mut relabeled = encode_varint_rust(claimed as u64).unwrap();
+                relabeled.extend_from_slice(&blob[header_len..]);
+                assert!(RecordReader::new(codec, &relabeled).unwrap().any(|r| r.is_err()), "{:?} {}", codec, claimed);
+            }
+            assert!(RecordReader::new(codec, b"").is_err());
+        }
+        let zstd = compress_with_level(Codec::Zstd, 1, &data).unwrap();
+        assert!(RecordReader::new(Codec::Zlib, &zstd).unwrap().next().unwrap().is_err());
+        assert!(unsafe { record_reader_open(CODEC_STORED, zstd.as_ptr() as *const c_char, zstd.len(), 0) }.is_null());
+    }
+}
+
+// Frame flags (mirrors rust_ffi_example.h)
+pub const FRAME_CHECKSUM: i32 = 1;
+pub const FRAME_DICT: i32 = 2;
+
+/// [`FrameInfo::codec`] of a frame that holds its data uncompressed.
+pub const CODEC_STORED: i32 = 3;
+/// Pseudo-codec for sizing auto-selected frames with `frame_compress_bound`.
+pub const CODEC_AUTO: i32 = -1;
+
+/// Header fields of a self-describing frame, as returned by [`frame_info`].
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct FrameInfo {
+    /// `CODEC_*` identifier of the codec that wrote the frame (see [`Codec`]).
+    pub codec: i32,
+    /// `FRAME_*` flags.
+    pub flags: i32,
+    /// Decompressed size.
+    pub original_len: usize,
+    /// Total frame size, i.e. where the next frame starts in a concatenation.
+    pub frame_len: usize,
+}
+
+fn frame_error(rc: i32) -> &'static str {
+    match rc {
+        CODEC_ERR_CHECKSUM => "Frame checksum mismatch",
+        CODEC_ERR_WRONG_CODEC => "Frame was written by a different codec",
+        CODEC_ERR_DICT_MISMATCH => "Data was compressed with a different dictionary",
+        _ => "Decompression failed in C library",
+    }
+}
+
+/// Compresses `input` into a self-describing frame that records the codec, so
+/// [`decompress_rust_auto`] can read it without being told which codec wrote it.
+/// With `checksum`, a CRC32C of `input` is stored and verified on decompression.
+///
+/// # Returns
+/// * `Ok(CBuf)` containing the frame if successful.
+/// * `Err(&str)` if the level is out of range or compression fails.
+pub fn compress_rust_frame(codec: Codec, level: i32, input: &[u8], checksum: bool) -> Result<CBuf, &'static str> {
+    let flags = if checksum { FRAME_CHECKSUM } else { 0 };
+    let data = unsafe { compress_frame(codec as i32, level, flags, input.as_ptr() as *const c_char, input.len() as c_ulong) };
+    CBuf::from_compressed(data)
+}
+
+/// Reads the header of the frame at the start of `input`.
+///
+/// # Returns
+/// * `Ok(FrameInfo)` if `input` starts with a valid frame (trailing bytes are allowed).
+/// * `Err(&str)` otherwise.
+pub fn frame_info(input: &[u8]) -> Result<FrameInfo, &'static str> {
+    let mut info = FrameInfo::default();
+    let rc = unsafe { frame_header_info(input.as_ptr() as *const c_char, input.len(), &mut info) };
+    if rc != CODEC_OK {
+        return Err("Invalid frame header");
+    }
+    Ok(info)
+}
+
+/// Borrows the original data of a stored frame (see [`CODEC_STORED`]) without copying it,
+/// after verifying its checksum if present. Frames are stored when that is no larger,
+/// e.g. for tiny or incompressible input, whatever codec was asked for.
+///
+/// # Returns
+/// * `Ok(Some(&[u8]))` with the data inside `input` for a stored frame.
+/// * `Ok(None)` for a compressed frame, which must be decompressed instead.
+/// * `Err(&str)` if `input` is not exactly one frame or fails its checksum.
+pub fn stored_frame_view(input: &[u8]) -> Result<Option<&[u8]>, &'static str> {
+    let mut data: *const c_char = std::ptr::null();
+    let mut data_len = 0usize;
+    let rc = unsafe { frame_stored_view(input.as_ptr() as *const c_char, input.len(), &mut data, &mut data_len) };
+    match rc {
+        CODEC_OK if data_len == 0 => Ok(Some(&input[input.len()..])),
+        CODEC_OK => Ok(Some(unsafe { std::slice::from_raw_parts(data as *const u8, data_len) })),
+        CODEC_ERR_WRONG_CODEC => Ok(None),
+        CODEC_ERR_CHECKSUM => Err(frame_error(rc)),
+        _ => Err("Invalid frame header"),
+    }
+}
+
+/// Updates a CRC32C (the checksum stored in frames) with `data`; start from 0.
+pub fn crc32c(crc: u32, data: &[u8]) -> u32 {
+    unsafe { checksum_crc32c(crc, data.as_ptr() as *const c_char, data.len()) }
+}
+
+/// Name of the CRC32C kernel the C library selected for this CPU.
+pub fn crc32c_kernel_name() -> &'static str {
+    let name = unsafe { std::ffi::CStr::from_ptr(checksum_crc32c_kernel()) };
+    name.to_str().unwrap_or("unknown")
+}
+
+/// Decompresses a frame or block-parallel container, choosing the codec from its header.
+///
+/// Like the other allocating decompressors this is limited to 100 MB; use
+/// [`decompress_auto_into_vec`] for larger data.
+///
+/// # Returns
+/// * `Ok(CBuf)` containing the original data if successful.
+/// * `Err(&str)` if the input is not a frame or container, or is corrupt.
+pub fn decompress_rust_auto(input: &[u8]) -> Result<CBuf, &'static str> {
+    let data = unsafe { decompress_auto(input.as_ptr() as *const c_char, input.len() as c_ulong) };
+    CBuf::from_decompressed(data)
+}
+
+/// Decompresses a frame or block-parallel container into `output`, replacing its contents.
+///
+/// # Returns
+/// * `Ok(usize)` with the decompressed length (equal to `output.len()`).
+/// * `Err(&str)` if the input is invalid, needs a dictionary or fails its checksum.
+pub fn decompress_auto_into_vec(input: &[u8], output: &mut Vec<u8>) -> Result<usize, &'static str> {
+    let mut original_len = 0usize;
+    let rc = unsafe { auto_decompressed_length(input.as_ptr() as *const c_char, input.len(), &mut original_len) };
+    if rc != CODEC_OK {
+        return Err("Input is not a frame or parallel container");
+    }
+    output.clear();
+    output.try_reserve(original_len).map_err(|_| "Original length too large to allocate")?;
+
+    let mut output_len = 0usize;
+    let rc = unsafe {
+        decompress_auto_into(
+            input.as_ptr() as *const c_char,
+            input.len(),
+            output.as_mut_ptr() as *mut c_char,
+            original_len,
+            &mut output_len,
+        )
+    };
+    if rc != CODEC_OK {
+        return Err(frame_error(rc));
+    }
+    unsafe { output.set_len(output_len) };
+    Ok(output_len)
+}
+
+#[cfg(test)]
+mod frame_tests {
+    use super::*;
+
+    const CODECS: [Codec; 3] = [Codec::Zlib, Codec::Lz4, Codec::Zstd];
+
+    #[test]
+    fn test_frame_length_from_partial_header() {
+        let big = b"streamed frames ".repeat(2000); // body length needs a multi-byte varint
+        for (data, checksum) in [(&big[..], true), (&b"x"[..], false), (&b""[..], true)] {
+            let frame = compress_rust_frame(Codec::Zstd, 3, data, checksum).unwrap();
+            let mut have = 0usize;
+            let mut steps = 0;
+            // Feed exactly what frame_length asks for until it knows the total
+            loop {
+                let mut len = 0usize;
+                let rc = unsafe { frame_length(frame.as_ptr() as *const c_char, have, &mut len) };
+                if rc == CODEC_OK {
+                    assert_eq!(len, frame.len());
+                    break;
+                }
+                assert_eq!(rc, CODEC_ERR_BUFFER_TOO_SMALL);
+                assert!(len > have && len <= frame.len());
+                have = len;
+                steps += 1;
+            }
+            assert!(steps <= 8);
+        }
+        let mut len = 0usize;
+        assert_eq!(unsafe { frame_length(b"RFXX".as_ptr() as *const c_char, 4, &mut len) }, CODEC_ERR_CORRUPT);
+        assert_eq!(unsafe { frame_length(std::ptr::null(), 0, &mut len) }, CODEC_ERR_BUFFER_TOO_SMALL);
+    }
+
+    #[test]
+    fn test_frame_roundtrip_and_header() {
+        let data = b"The quick brown fox jumps over the lazy dog. ".repeat(40);
+        for codec in CODECS {
+            for checksum in [false, true] {
+                let frame = compress_rust_frame(codec, codec.default_level(), &data, checksum).unwrap();
+                assert_eq!(&frame[..4], b"RFFR");
+                let info = frame_info(&frame).unwrap();
+                assert_eq!(info.codec, codec as i32);
+                assert_eq!(info.flags, if checksum { FRAME_CHECKSUM } else { 0 });
+                assert_eq!(info.original_len, data.len());
+                assert_eq!(info.frame_len, frame.len());
+                assert_eq!(&decompress_rust_auto(&frame).unwrap()[..], &data[..]);
+            }
+        }
+        // Empty input and the block-parallel container go through the same entry point
+        let empty = compress_rust_frame(Codec::Lz4, 0, b"", true).unwrap();
+        assert!(decompress_rust_auto(&empty).unwrap().is_empty());
+        let container = compress_rust_parallel(Codec::Zstd, 3, 2, &data).unwrap();
+        let mut out = Vec::new();
+        assert_eq!(decompress_auto_into_vec(&container, &mut out).unwrap(), data.len());
+        assert_eq!(out, data);
+    }
+
+    #[test]
+    fn test_frame_checksum_is_crc32c() {
+        // Standard CRC32C check value, stored little-endian after the body length
+        let frame = compress_rust_frame(Codec::Zlib, 6, b"123456789", true).unwrap();
+        let body_len = frame[7] as usize;
+        assert!(body_len < 0x80);
+        assert_eq!(&frame[8..12], &0xE306_9283u32.to_le_bytes());
+        assert_eq!(frame.len(), 12 + body_len);
+    }
+
+    #[test]
+    fn test_frame_detects_corruption() {
+        let data: Vec<u8> = (0..5000u32).map(|i| (i % 97) as u8).collect();
+        let frame = compress_rust_frame(Codec::Lz4, 0, &data, true).unwrap().to_vec();
+
+        // Flipping a literal in the body is caught by the checksum or the decoder
+        let mut flipped = frame.clone();
+        let last = flipped.len() - 1;
+        flipped[last] ^= 0x55;
+        assert!(decompress_auto_into_vec(&flipped, &mut Vec::new()).is_err());
+
+        let mut wrong_crc = frame.clone();
+        wrong_crc[9] ^= 1;
+        assert_eq!(decompress_auto_into_vec(&wrong_crc, &mut Vec::new()), Err("Frame checksum mismatch"));
+
+        let mut unknown_flag = frame.clone();
+        unknown_flag[6] |= 0x80;
+        assert!(frame_info(&unknown_flag).is_err());
+
+        assert!(decompress_rust_auto(&frame[..frame.len() - 1]).is_err());
+        let mut trailing = frame.clone();
+        trailing.push(0);
+        assert!(decompress_rust_auto(&trailing).is_err());
+        assert_eq!(frame_info(&trailing).unwrap().frame_len, frame.len());
+
+        // Headerless one-shot output carries no codec ID
+        let legacy = compress(Codec::Lz4, &data).unwrap();
+        assert!(decompress_rust_auto(&legacy).is_err());
+    }
+
+    #[test]
+    fn test_frame_context_codec_and_dictionary() {
+        let samples: Vec<Vec<u8>> = (0..200)
+            .map(|i| format!("{{\"user\":{},\"event\":\"click\",\"page\":\"/home\"}}", i).into_bytes())
+            .collect();
+        let refs: Vec<&[u8]> = samples.iter().map(|s| s.as_slice()).collect();
+        let content = train_dictionary(&refs, 4096).unwrap();
+        let dict = Dictionary::new(Codec::Zstd, 3, &content).unwrap();
+
+        // Without a dictionary a single sample is too small to compress and would be stored
+        let batch = samples[..20].concat();
+        let mut ctx = CodecContext::new(Codec::Zstd).unwrap();
+        let plain = ctx.compress_frame(&batch, true).unwrap();
+        ctx.set_dictionary(Some(&dict)).unwrap();
+        let with_dict = ctx.compress_frame(&samples[7], true).unwrap();
+        assert_eq!(frame_info(&with_dict).unwrap().flags, FRAME_CHECKSUM | FRAME_DICT);
+
+        // The context reads frames with and without its dictionary
+        assert_eq!(ctx.decompress_frame(&with_dict).unwrap(), samples[7]);
+        assert_eq!(ctx.decompress_frame(&plain).unwrap(), batch);
+        assert_eq!(
+            decompress_auto_into_vec(&with_dict, &mut Vec::new()),
+            Err("Data was compressed with a different dictionary")
+        );
+
+        let mut lz4 = CodecContext::new(Codec::Lz4).unwrap();
+        assert_eq!(lz4.decompress_frame(&plain), Err("Frame was written by a different codec"));
+    }
+
+    #[test]
+    fn test_frame_stores_tiny_and_incompressible_input() {
+        let mut state = 0x2545_F491_4F6C_DD1Du64;
+        let random: Vec<u8> = (0..5000)
+            .map(|_| {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                (state >> 24) as u8
+            })
+            .collect();
+        let text = b"stored frames keep the codec out of the way. ".repeat(50);
+        let varint_len = |n: usize| if n < 128 { 1 } else { 2 };
+        for codec in CODECS {
+            for data in [&b""[..], &b"tiny message"[..], &text[..63], &random[..]] {
+                let frame = compress_rust_frame(codec, codec.default_level(), data, true).unwrap();
+                let info = frame_info(&frame).unwrap();
+                assert_eq!(info.codec, CODEC_STORED, "{:?}, {} bytes", codec, data.len());
+                // "RFFR", version, codec, flags, body length, CRC32C, then [length][data]
+                let body_len = varint_len(data.len()) + data.len();
+                assert_eq!(frame.len(), 7 + varint_len(body_len) + 4 + body_len);
+                // The view points into the frame itself
+                let view = stored_frame_view(&frame).unwrap().unwrap();
+                assert_eq!(view, data);
+                assert_eq!(view.as_ptr(), frame[frame.len() - data.len()..].as_ptr());
+                assert_eq!(&decompress_rust_auto(&frame).unwrap()[..], data);
+            }
+            let frame = compress_rust_frame(codec, codec.default_level(), &text, false).unwrap();
+            assert_eq!(frame_info(&frame).unwrap().codec, codec as i32);
+            assert_eq!(stored_frame_view(&frame), Ok(None));
+
+            // A buffer sized for the stored frame is enough for input the codec would expand
+            let mut out = vec![0u8; unsafe { frame_compress_bound(CODEC_STORED, random.len()) }];
+            let mut out_len = 0usize;
+            let rc = unsafe {
+                compress_frame_into(codec as i32, codec.default_level(), 0, random.as_ptr() as *const c_char,
+                                    random.len(), out.as_mut_ptr() as *mut c_char, out.len(), &mut out_len)
+            };
+            assert_eq!(rc, CODEC_OK);
+            assert_eq!(stored_frame_view(&out[..out_len]).unwrap().unwrap(), &random[..]);
+        }
+
+        let mut frame = compress_rust_frame(Codec::Zstd, 3, &random, true).unwrap().to_vec();
+        let last = frame.len() - 1;
+        frame[last] ^= 1;
+        assert_eq!(stored_frame_view(&frame), Err("Frame checksum mismatch"));
+        assert!(stored_frame_view(&frame[..last]).is_err());
+    }
+
+    fn crc32c_bitwise(data: &[u8]) -> u32 {
+        let mut crc = !0u32;
+        for &b in data {
+            crc ^= b as u32;
+            for _ in 0..8 {
+                crc = (crc >> 1) ^ (0x82F6_3B78 & (crc & 1).wrapping_neg());
+            }
+        }
+        !crc
+    }
+
+    #[test]
+    fn test_crc32c_kernel_matches_bitwise_reference() {
+        let data: Vec<u8> = (0..40_000u32).map(|i| (i.wrapping_mul(2_654_435_761) >> 13) as u8).collect();
+        // Around the 3 x 4 KiB stripe boundaries of the hardware kernels
+        for len in [0usize, 1, 7, 8, 9, 12_287, 12_288, 12_289, 24_577, 40_000] {
+            assert_eq!(crc32c(0, &data[..len]), crc32c_bitwise(&data[..len]), "len {} ({})", len, crc32c_kernel_name());
+        }
+        assert_eq!(crc32c(0, b"123456789"), 0xE306_9283);
+        // Chaining over any split gives the one-shot value
+        for split in [0usize, 5, 4096, 13_000, 40_000] {
+            assert_eq!(crc32c(crc32c(0, &data[..split]), &data[split..]), crc32c(0, &data));
+        }
+    }
+
+    #[test]
+    fn test_fused_checksums_match_the_data() {
+        // Larger than the fused slices, in compressible and incompressible (stored) form
+        let text: Vec<u8> = (0..300_000u32).flat_map(|i| format!("row {} value {}\n", i % 1000, i % 7).into_bytes()).collect();
+        let mut state = 0x9E37_79B9_7F4A_7C15u64;
+        let random: Vec<u8> = (0..200_000)
+            .map(|_| {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                (state >> 24) as u8
+            })
+            .collect();
+        for data in [&text, &random] {
+            let expected = crc32c(0, data);
+            for codec in CODECS {
+                let mut ctx = CodecContext::new(codec).unwrap();
+                let frame = ctx.compress_frame(data, true).unwrap();
+                // The checksum follows the fixed header and body-length varint
+                let (_, n) = decode_varint_rust(&frame[7..]).unwrap();
+                assert_eq!(&frame[7 + n..11 + n], &expected.to_le_bytes(), "{:?}", codec);
+                assert_eq!(ctx.decompress_frame(&frame).unwrap(), *data);
+                assert_eq!(&decompress_rust_auto(&frame).unwrap()[..], &data[..]);
+            }
+        }
+
+        // zstd and zlib decode with a dictionary on the fused path too
+        let content = text[..8192].to_vec();
+        for codec in [Codec::Zlib, Codec::Zstd] {
+            let dict = Dictionary::new(codec, codec.default_level(), &content).unwrap();
+            let mut ctx = CodecContext::new(codec).unwrap();
+            ctx.set_dictionary(Some(&dict)).unwrap();
+            let frame = ctx.compress_frame(&text, true).unwrap();
+            assert_eq!(ctx.decompress_frame(&frame).unwrap(), text);
+            // The context still decodes plain frames afterwards
+            ctx.set_dictionary(None).unwrap();
+            let plain = ctx.compress_frame(&text[..5000], false).unwrap();
+            assert_eq!(ctx.decompress_frame(&plain).unwrap(), &text[..5000]);
+        }
+    }
+
+    #[test]
+    fn test_set_verify_skips_the_checksum() {
+        let data = b"trusted path payload, checked once upstream. ".repeat(500);
+        for codec in CODECS {
+            let mut frame = compress_rust_frame(codec, codec.default_level(), &data, true).unwrap().to_vec();
+            let (_, n) = decode_varint_rust(&frame[7..]).unwrap();
+            frame[7 + n] ^= 0x55;
+            let mut ctx = CodecContext::new(codec).unwrap();
+            assert_eq!(ctx.decompress_frame(&frame), Err(frame_error(CODEC_ERR_CHECKSUM)));
+            assert!(decompress_rust_auto(&frame).is_err());
+            ctx.set_verify(false);
+            assert_eq!(ctx.decompress_frame(&frame).unwrap(), data);
+            ctx.set_verify(true);
+            assert!(ctx.decompress_frame(&frame).is_err());
+        }
+    }
+}
+
+/// Picks a codec and level for `input` the way [`compress_rust_frame_auto`] does.
+///
+/// A sample of the input is trial-compressed with LZ4 and a ladder of zstd levels; the
+/// smallest output among the settings that compress at least `min_mb_per_s` MB/s on this
+/// machine wins (0 means no speed floor).
+///
+/// # Returns
+/// * `Ok(Some((codec, level)))` with the chosen setting.
+/// * `Ok(None)` if the input is tiny or does not compress, so it should be stored.
+/// * `Err(&str)` if selection fails.
+pub fn auto_select_codec(input: &[u8], min_mb_per_s: f64) -> Result<Option<(Codec, i32)>, &'static str> {
+    let (mut codec, mut level) = (0i32, 0i32);
+    let rc = unsafe { codec_auto_select(input.as_ptr() as *const c_char, input.len(), min_mb_per_s, &mut codec, &mut level) };
+    if rc != CODEC_OK {
+        return Err("Codec selection failed in C library");
+    }
+    Ok(match codec {
+        CODEC_STORED => None,
+        c if c == Codec::Lz4 as i32 => Some((Codec::Lz4, level)),
+        c if c == Codec::Zstd as i32 => Some((Codec::Zstd, level)),
+        _ => Some((Codec::Zlib, level)),
+    })
+}
+
+/// Compresses `input` into a frame with an automatically chosen codec and level (see
+/// [`auto_select_codec`]); incompressible input is stored as-is. The choice is
+/// recorded in the frame header, so [`decompress_rust_auto`] reads the result.
+///
+/// # Returns
+/// * `Ok(Vec<u8>)` containing the frame if successful.
+/// * `Err(&str)` if compression fails.
+pub fn compress_rust_frame_auto(input: &[u8], min_mb_per_s: f64, checksum: bool) -> Result<Vec<u8>, &'static str> {
+    let bound = unsafe { frame_compress_bound(CODEC_AUTO, input.len()) };
+    if bound == 0 {
+        return Err("Input too large for codec");
+    }
+    let flags = if checksum { FRAME_CHECKSUM } else { 0 };
+    let mut output: Vec<u8> = Vec::with_capacity(bound);
+    let mut output_len = 0usize;
+    let rc = unsafe {
+        compress_frame_auto_into(
+            min_mb_per_s,
+            flags,
+            input.as_ptr() as *const c_char,
+            input.len(),
+            output.as_mut_ptr() as *mut c_char,
+            output.capacity(),
+            &mut output_len,
+        )
+    };
+    if rc != CODEC_OK {
+        return Err("Compression failed in C library");
+    }
+    unsafe { output.set_len(output_len) };
+    Ok(output)
+}
+
+#[cfg(test)]
+mod auto_tests {
+    use super::*;
+
+    fn random_bytes(len: usize) -> Vec<u8> {
+        let mut state = 0x9E37_79B9_7F4A_7C15u64;
+        (0..len)
+            .map(|_| {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                (state >> 24) as u8
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_auto_stores_incompressible_and_tiny_input() {
+        for data in [random_bytes(300_000), random_bytes(2000), b"tiny".to_vec(), Vec::new()] {
+            assert_eq!(auto_select_codec(&data, 0.0).unwrap(), None, "{} bytes", data.len());
+            let frame = compress_rust_frame_auto(&data, 0.0, true).unwrap();
+            let info = frame_info(&frame).unwrap();
+            assert_eq!(info.codec, CODEC_STORED);
+            assert_eq!(info.frame_len, frame.len());
+            assert!(frame.len() <= data.len() + 20);
+            assert_eq!(&decompress_rust_auto(&frame).unwrap()[..], &data[..]);
+        }
+    }
+
+    #[test]
+    fn test_auto_compresses_redundant_input() {
+        let data = b"timestamp=1700000000 level=info msg=\"request served\" status=200\n".repeat(5000);
+        let (codec, _) = auto_select_codec(&data, 0.0).unwrap().expect("text should compress");
+        let frame = compress_rust_frame_auto(&data, 0.0, false).unwrap();
+        assert_eq!(frame_info(&frame).unwrap().codec, codec as i32);
+        assert!(frame.len() < data.len() / 10);
+        let mut out = Vec::new();
+        decompress_auto_into_vec(&frame, &mut out).unwrap();
+        assert_eq!(out, data);
+
+        // No codec reaches an impossible speed floor, so the data is stored
+        let stored = compress_rust_frame_auto(&data, 1e12, false).unwrap();
+        assert_eq!(frame_info(&stored).unwrap().codec, CODEC_STORED);
+        assert_eq!(&decompress_rust_auto(&stored).unwrap()[..], &data[..]);
+    }
+
+    #[test]
+    fn test_stored_frame_reads_through_any_context() {
+        let data = random_bytes(5000);
+        let mut frame = compress_rust_frame_auto(&data, 0.0, true).unwrap();
+        for codec in [Codec::Zlib, Codec::Lz4, Codec::Zstd] {
+            let mut ctx = CodecContext::new(codec).unwrap();
+            assert_eq!(ctx.decompress_frame(&frame).unwrap(), data);
+        }
+        let last = frame.len() - 1;
+        frame[last] ^= 1;
+        assert_eq!(decompress_auto_into_vec(&frame, &mut Vec::new()), Err("Frame checksum mismatch"));
+        // A stored body must hold exactly the original length
+        frame[7] -= 1;
+        frame.pop();
+        assert!(frame_info(&frame).is_err());
+    }
+}
+
+/// C allocation hook (`codec_alloc_fn`): returns `size` bytes, or null on failure.
+pub type CodecAllocFn = unsafe extern "C" fn(opaque: *mut c_void, size: usize) -> *mut c_void;
+/// C release hook (`codec_free_fn`) matching a [`CodecAllocFn`].
+pub type CodecFreeFn = unsafe extern "C" fn(opaque: *mut c_void, ptr: *mut c_void);
+
+// Opaque C `codec_arena` handle
+#[repr(C)]
+pub struct ArenaHandle {
+    _private: [u8; 0],
+}
+
+/// Bump allocator for the C library's buffers and codec state, wrapping `codec_arena`.
+///
+/// Inside [`Arena::scope`] every allocation the C library makes on the calling thread
+/// (returned buffers such as [`CBuf`], contexts, zstd/zlib state) comes from one block
+/// and is released all at once by [`Arena::reset`], which avoids malloc for runs of
+/// short-lived requests. Allocations that no longer fit fall back to malloc.
+pub struct Arena {
+    arena: *mut ArenaHandle,
+}
+
+// Allocation from the arena is lock-free; reset needs exclusive access.
+unsafe impl Send for Arena {}
+unsafe impl Sync for Arena {}
+
+impl Arena {
+    /// Creates an arena of `capacity` bytes.
+    pub fn new(capacity: usize) -> Result<Self, &'static str> {
+        let arena = unsafe { codec_arena_create(capacity) };
+        if arena.is_null() {
+            return Err("Failed to allocate arena");
+        }
+        Ok(Arena { arena })
+    }
+
+    /// Bytes handed out since the last reset.
+    pub fn used(&self) -> usize {
+        unsafe { codec_arena_used(self.arena) }
+    }
+
+    /// Runs `f` with this arena as the calling thread's C allocator, then removes the
+    /// thread override again (scopes do not nest).
+    ///
+    /// # Safety
+    /// Everything the C library allocates inside `f` - [`CBuf`]s, [`CodecContext`]s,
+    /// streams - must be dropped before the arena is reset or dropped.
+    pub unsafe fn scope<R>(&self, f: impl FnOnce() -> R) -> R {
+        struct Restore;
+        impl Drop for Restore {
+            fn drop(&mut self) {
+                unsafe { set_thread_allocator(None, None, std::ptr::null_mut()) };
+            }
+        }
+        set_thread_allocator(Some(codec_arena_alloc), Some(codec_arena_free), self.arena as *mut c_void);
+        let _restore = Restore;
+        f()
+    }
+
+    /// Reclaims the whole arena.
+    ///
+    /// # Safety
+    /// Nothing allocated from the arena may still be alive.
+    pub unsafe fn reset(&mut self) {
+        codec_arena_reset(self.arena);
+    }
+}
+
+impl Drop for Arena {
+    fn drop(&mut self) {
+        unsafe { codec_arena_destroy(self.arena) };
+    }
+}
+
+#[cfg(test)]
+mod thread_tests {
+    use super::*;
+    use std::thread;
+
+    const CODECS: [Codec; 3] = [Codec::Zlib, Codec::Lz4, Codec::Zstd];
+
+    #[test]
+    fn test_concurrent_one_shot_round_trips() {
+        thread::scope(|s| {
+            for t in 0..16 {
+                s.spawn(move || {
+                    for i in 0..200 {
+                        let data = format!("{{\"thread\":{},\"seq\":{},\"pad\":\"{}\"}}", t, i, "x".repeat(i % 97)).into_bytes();
+                        for codec in CODECS {
+                            let compressed = compress(codec, &data).unwrap();
+                            assert_eq!(&decompress(codec, &compressed).unwrap()[..], &data[..], "{:?}", codec);
+                        }
+                        let text = String::from_utf8(data).unwrap();
+                        let z = compress_rust_string_zstd(&text).unwrap();
+                        assert_eq!(decompress_rust_data_zstd(&z).unwrap(), text);
+                    }
+                });
+            }
+        });
+    }
+
+    #[test]
+    fn test_contexts_cached_per_thread() {
+        thread::spawn(|| {
+            assert_eq!(release_thread_contexts(), 0);
+            let data = b"cached context ".repeat(100);
+            for _ in 0..3 {
+                for codec in CODECS {
+                    let compressed = compress(codec, &data).unwrap();
+                    assert_eq!(&decompress(codec, &compressed).unwrap()[..], &data[..]);
+                }
+            }
+            // One context per codec, reused by every call on this thread
+            assert_eq!(release_thread_contexts(), 3);
+            assert_eq!(release_thread_contexts(), 0);
+            assert_eq!(&decompress(Codec::Zstd, &compress(Codec::Zstd, &data).unwrap()).unwrap()[..], &data[..]);
+            assert_eq!(release_thread_contexts(), 1);
+
+            // A thread allocator scope bypasses the cache, so nothing outlives the arena
+            let mut arena = Arena::new(1 << 20).unwrap();
+            unsafe {
+                arena.scope(|| {
+                    let compressed = compress(Codec::Zstd, &data).unwrap();
+                    assert_eq!(&decompress(Codec::Zstd, &compressed).unwrap()[..], &data[..]);
+                });
+                arena.reset();
+            }
+            assert_eq!(release_thread_contexts(), 0);
+        })
+        .join()
+        .unwrap();
+    }
+}
+
+#[cfg(test)]
+mod allocator_tests {
+    use super::*;
+    use std::sync::atomic::{AtomicUsize, Ordering};
+
+    #[derive(Default)]
+    struct Counts {
+        allocs: AtomicUsize,
+        frees: AtomicUsize,
+    }
+
+    unsafe extern "C" fn counting_alloc(opaque: *mut c_void, size: usize) -> *mut c_void {
+        (*(opaque as *const Counts)).allocs.fetch_add(1, Ordering::Relaxed);
+        libc_malloc(size)
+    }
+
+    unsafe extern "C" fn counting_free(opaque: *mut c_void, ptr: *mut c_void) {
+        (*(opaque as *const Counts)).frees.fetch_add(1, Ordering::Relaxed);
+        libc_free(ptr)
+    }
+
+    extern "C" {
+        #[link_name = "malloc"]
+        fn libc_malloc(size: usize) -> *mut c_void;
+        #[link_name = "free"]
+        fn libc_free(ptr: *mut c_void);
+    }
+
+    #[test]
+    fn test_thread_allocator_sees_all_codec_allocations() {
+        let counts = Counts::default();
+        let data = b"allocator hooks route codec state through the caller ".repeat(200);
+        unsafe {
+            assert_eq!(set_thread_allocator(Some(counting_alloc), None, std::ptr::null_mut()), CODEC_ERR_INVALID_ARG);
+            set_thread_allocator(Some(counting_alloc), Some(counting_free), &counts as *const Counts as *mut c_void);
+        }
+        for codec in [Codec::Zlib, Codec::Lz4, Codec::Zstd] {
+            let compressed = compress(codec, &data).unwrap();
+            assert_eq!(&decompress(codec, &compressed).unwrap()[..], &data[..]);
+            let mut ctx = CodecContext::with_level(codec, codec.default_level()).unwrap();
+            let again = ctx.compress(&data).unwrap();
+            assert_eq!(ctx.decompress(&again).unwrap(), data);
+            let container = compress_rust_parallel(codec, codec.default_level(), 2, &data).unwrap();
+            assert_eq!(&decompress_rust_parallel(2, &container).unwrap()[..], &data[..]);
+        }
+        let stream = CodecStream::compressor(Codec::Zstd, 3).unwrap();
+        drop(stream);
+        let dict = Dictionary::new(Codec::Zstd, 3, &data[..4096]).unwrap();
+        let mut ctx = CodecContext::new(Codec::Zstd).unwrap();
+        ctx.set_dictionary(Some(&dict)).unwrap();
+        let with_dict = ctx.compress(&data).unwrap();
+        assert_eq!(ctx.decompress(&with_dict).unwrap(), data);
+        drop(ctx);
+        drop(dict);
+        unsafe { set_thread_allocator(None, None, std::ptr::null_mut()) };
+
+        // Every allocation went through the hook and was handed back to it
+        let allocs = counts.allocs.load(Ordering::Relaxed);
+        assert!(allocs > 20, "only {} allocations seen", allocs);
+        assert_eq!(counts.frees.load(Ordering::Relaxed), allocs);
+    }
+
+    #[test]
+    fn test_large_buffers_mapped_or_hooked() {
+        // Above 2 MiB the default path maps result buffers directly; a custom allocator
+        // still receives them
+        let data: Vec<u8> = (0..5_000_000u32).map(|i| (i % 251) as u8 ^ (i >> 12) as u8).collect();
+        for codec in [Codec::Zlib, Codec::Lz4, Codec::Zstd] {
+            let compressed = compress(codec, &data).unwrap();
+            assert_eq!(&decompress(codec, &compressed).unwrap()[..], &data[..], "{:?}", codec);
+
+            let counts = Counts::default();
+            unsafe {
+                set_thread_allocator(Some(counting_alloc), Some(counting_free), &counts as *const Counts as *mut c_void);
+            }
+            let out = decompress(codec, &compressed).unwrap();
+            assert!(counts.allocs.load(Ordering::Relaxed) > 0);
+            unsafe { set_thread_allocator(None, None, std::ptr::null_mut()) };
+            assert_eq!(&out[..], &data[..]);
+            drop(out);
+            assert_eq!(counts.frees.load(Ordering::Relaxed), counts.allocs.load(Ordering::Relaxed));
+        }
+    }
+
+    #[test]
+    fn test_arena_reset_and_fallback() {
+        let data = b"{\"id\":42,\"event\":\"click\",\"ok\":true}".repeat(4);
+        let mut arena = Arena::new(4 * 1024 * 1024).unwrap();
+        for _ in 0..3 {
+            unsafe {
+                let kept = arena.scope(|| {
+                    for codec in [Codec::Zlib, Codec::Lz4, Codec::Zstd] {
+                        let compressed = compress(codec, &data).unwrap();
+                        assert_eq!(&decompress(codec, &compressed).unwrap()[..], &data[..]);
+                    }
+                    // Codec state is released in reverse order, so only kept buffers remain
+                    assert_eq!(arena.used(), 0);
+                    compress(Codec::Zstd, &data).unwrap()
+                });
+                assert!(arena.used() > 0 && arena.used() < 4096, "{} bytes held", arena.used());
+                assert_eq!(&decompress(Codec::Zstd, &kept).unwrap()[..], &data[..]);
+                drop(kept);
+                arena.reset();
+            }
+            assert_eq!(arena.used(), 0);
+        }
+
+        // A buffer made inside the scope can be freed after it, while the arena lives
+        let small = Arena::new(1024).unwrap();
+        let big = vec![7u8; 1 << 20];
+        let compressed = unsafe { small.scope(|| compress(Codec::Zstd, &big).unwrap()) };
+        assert_eq!(&decompress(Codec::Zstd, &compressed).unwrap()[..], &big[..]);
+        drop(compressed);
+    }
+}
+
+// Runtime statistics (mirrors rust_ffi_example.h)
+pub const CODEC_STATS_CODECS: usize = 4;
+pub const CODEC_STATS_COMPRESS: usize = 0;
+pub const CODEC_STATS_DECOMPRESS: usize = 1;
+pub const CODEC_STATS_BUCKETS: usize = 32;
+pub const CODEC_STATS_ERROR_CODES: usize = 10;
+
+/// Counters for one codec and direction (`codec_op_stats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CodecOpStats {
+    /// Calls, failed ones included.
+    pub calls: u64,
+    /// Calls that returned a `CODEC_ERR_*` code.
+    pub errors: u64,
+    /// Input bytes of successful calls.
+    pub bytes_in: u64,
+    /// Output bytes of successful calls.
+    pub bytes_out: u64,
+    /// Time spent in all calls.
+    pub total_ns: u64,
+    /// `latency[i]` counts calls that took `[2^i, 2^(i+1))` ns; the last bucket is open-ended.
+    pub latency: [u64; CODEC_STATS_BUCKETS],
+}
+
+/// Process-wide counters of the C library, as returned by [`codec_stats`].
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CodecStats {
+    /// `ops[codec][CODEC_STATS_COMPRESS or CODEC_STATS_DECOMPRESS]`, with rows for
+    /// zlib, LZ4, zstd and [`CODEC_STORED`].
+    pub ops: [[CodecOpStats; 2]; CODEC_STATS_CODECS],
+    /// Failed calls by status: `errors_by_code[-CODEC_ERR_*]`.
+    pub errors_by_code: [u64; CODEC_STATS_ERROR_CODES],
+    /// Varints (e.g. length headers) that failed to decode.
+    pub bad_varint: u64,
+    /// Allocating decompressions refused for an original length over 100 MB.
+    pub over_size_cap: u64,
+    /// 0 if the library was built without statistics (feature `no-stats`).
+    pub enabled: i32,
+}
+
+/// Snapshot of the C library's call, byte, latency and error counters, summed over threads.
+pub fn codec_stats() -> CodecStats {
+    let mut stats = CodecStats::default();
+    unsafe { get_codec_stats(&mut stats) };
+    stats
+}
+
+/// Zeroes the counters behind [`codec_stats`].
+pub fn reset_stats() {
+    unsafe { reset_codec_stats() }
+}
+
+#[cfg(test)]
+mod stats_tests {
+    use super::*;
+
+    // Other tests run concurrently in this process, so only lower bounds on the
+    // change between two snapshots can be checked
+
+    #[test]
+    fn test_counts_calls_bytes_and_latency() {
+        let before = codec_stats();
+        if before.enabled == 0 {
+            return;
+        }
+        let data = b"statistics counters ".repeat(500);
+        let mut compressed_len = 0;
+        for _ in 0..10 {
+            let compressed = compress(Codec::Zstd, &data).unwrap();
+            compressed_len = compressed.len() as u64;
+            assert_eq!(&decompress(Codec::Zstd, &compressed).unwrap()[..], &data[..]);
+        }
+        let after = codec_stats();
+        let zstd = Codec::Zstd as usize;
+        for (op, bytes_in, bytes_out) in [
+            (CODEC_STATS_COMPRESS, data.len() as u64, compressed_len),
+            (CODEC_STATS_DECOMPRESS, compressed_len, data.len() as u64),
+        ] {
+            let (b, a) = (&before.ops[zstd][op], &after.ops[zstd][op]);
+            assert!(a.calls - b.calls >= 10);
+            assert!(a.bytes_in - b.bytes_in >= 10 * bytes_in);
+            assert!(a.bytes_out - b.bytes_out >= 10 * bytes_out);
+            assert!(a.total_ns > b.total_ns);
+            assert!(a.latency.iter().sum::<u64>() - b.latency.iter().sum::<u64>() >= 10);
+        }
+    }
+
+    #[test]
+    fn test_counts_errors_by_reason() {
+        let before = codec_stats();
+        if before.enabled == 0 {
+            return;
+        }
+        // Valid header, garbage payload
+        assert!(decompress(Codec::Zstd, &[0x05, 1, 2, 3, 4, 5]).is_err());
+        // Length header that never terminates
+        assert!(decompress(Codec::Zlib, &[0xff; 12]).is_err());
+        // Claims 200 MB, over the allocating decompressors' cap
+        let mut huge = encode_varint_rust(200 << 20).unwrap();
+        huge.extend_from_slice(&[0; 16]);
+        assert!(decompress(Codec::Lz4, &huge).is_err());
+
+        let after = codec_stats();
+        let corrupt = -CODEC_ERR_CORRUPT as usize;
+        assert!(after.errors_by_code[corrupt] > before.errors_by_code[corrupt]);
+        let zstd = &after.ops[Codec::Zstd as usize][CODEC_STATS_DECOMPRESS];
+        assert!(zstd.errors > before.ops[Codec::Zstd as usize][CODEC_STATS_DECOMPRESS].errors);
+        assert!(after.bad_varint > before.bad_varint);
+        assert!(after.over_size_cap > before.over_size_cap);
+    }
+
+    #[test]
+    fn test_counts_streams_and_stored_frames() {
+        let before = codec_stats();
+        if before.enabled == 0 {
+            return;
+        }
+        let data = b"streamed and stored ".repeat(200);
+        let mut stream = CodecStream::compressor(Codec::Lz4, 0).unwrap();
+        let mut out = Vec::new();
+        stream.update(&data, &mut out).unwrap();
+        stream.finish(&mut out).unwrap();
+
+        let frame = unsafe {
+            CBuf::from_compressed(compress_frame(CODEC_STORED, 0, 0, data.as_ptr() as *const c_char, data.len() as c_ulong))
+        }
+        .unwrap();
+        assert_eq!(&decompress_rust_auto(&frame).unwrap()[..], &data[..]);
+
+        let after = codec_stats();
+        let lz4 = Codec::Lz4 as usize;
+        let stored = CODEC_STORED as usize;
+        assert!(after.ops[lz4][CODEC_STATS_COMPRESS].calls >= before.ops[lz4][CODEC_STATS_COMPRESS].calls + 2);
+        assert!(after.ops[lz4][CODEC_STATS_COMPRESS].bytes_out - before.ops[lz4][CODEC_STATS_COMPRESS].bytes_out >= out.len() as u64);
+        assert!(after.ops[stored][CODEC_STATS_COMPRESS].bytes_in - before.ops[stored][CODEC_STATS_COMPRESS].bytes_in >= data.len() as u64);
+        assert!(after.ops[stored][CODEC_STATS_DECOMPRESS].calls > before.ops[stored][CODEC_STATS_DECOMPRESS].calls);
+    }
+}
+
+#[cfg(test)]
+mod batch_tests {
+    use super::*;
+
+    const CODECS: [Codec; 3] = [Codec::Zlib, Codec::Lz4, Codec::Zstd];
+
+    fn records() -> Vec<Vec<u8>> {
+        (0..500)
+            .map(|i| format!("{{\"id\":{},\"user\":\"user{}\",\"action\":\"click\",\"ok\":true}}", i, i % 17).into_bytes())
+            .chain([Vec::new(), vec![0u8; 10_000]])
+            .collect()
+    }
+
+    #[test]
+    fn test_batch_roundtrip_all_codecs() {
+        let records = records();
+        let inputs: Vec<&[u8]> = records.iter().map(|r| r.as_slice()).collect();
+        for codec in CODECS {
+            let mut ctx = CodecContext::new(codec).unwrap();
+            let mut compressed = BatchBuffer::new();
+            ctx.compress_batch(&inputs, &mut compressed).unwrap();
+            assert_eq!(compressed.len(), inputs.len());
+            assert_eq!(compressed.offsets().len(), inputs.len() + 1);
+            assert_eq!(*compressed.offsets().last().unwrap(), compressed.arena().len());
+
+            // Each item matches a standalone compression with the same context
+            for (i, input) in inputs.iter().enumerate() {
+                assert_eq!(compressed.get(i).unwrap(), ctx.compress(input).unwrap().as_slice(), "{:?} item {}", codec, i);
+            }
+
+            let items: Vec<&[u8]> = compressed.iter().collect();
+            let mut restored = BatchBuffer::new();
+            ctx.decompress_batch(&items, &mut restored).unwrap();
+            assert_eq!(restored.len(), inputs.len());
+            for (i, input) in inputs.iter().enumerate() {
+                assert_eq!(restored.get(i).unwrap(), *input, "{:?} item {}", codec, i);
+            }
+            assert!(restored.get(inputs.len()).is_none());
+        }
+    }
+
+    #[test]
+    fn test_batch_reuse_and_empty_batch() {
+        let mut ctx = CodecContext::new(Codec::Zstd).unwrap();
+        let mut batch = BatchBuffer::new();
+        ctx.compress_batch(&[b"first", b"second"], &mut batch).unwrap();
+        assert_eq!(batch.len(), 2);
+        ctx.compress_batch(&[], &mut batch).unwrap();
+        assert!(batch.is_empty());
+        assert!(batch.arena().is_empty());
+        ctx.decompress_batch(&[], &mut batch).unwrap();
+        assert!(batch.is_empty());
+    }
+
+    #[test]
+    fn test_batch_decompress_rejects_corrupt_item() {
+        let mut ctx = CodecContext::new(Codec::Lz4).unwrap();
+        let mut compressed = BatchBuffer::new();
+        ctx.compress_batch(&[b"good record", b"another good record"], &mut compressed).unwrap();
+        let good = compressed.get(0).unwrap().to_vec();
+        let mut bad = compressed.get(1).unwrap().to_vec();
+        bad.truncate(bad.len() - 2);
+
+        let mut restored = BatchBuffer::new();
+        assert!(ctx.decompress_batch(&[&good, &bad], &mut restored).is_err());
+        assert!(restored.is_empty(), "failed batch leaves no items");
+        assert!(ctx.decompress_batch(&[&good, &[0xFFu8; 12][..]], &mut restored).is_err());
+    }
+}
+
+#[cfg(test)]
+mod zero_copy_tests {
+    use super::*;
+
+    const CODECS: [Codec; 3] = [Codec::Zlib, Codec::Lz4, Codec::Zstd];
+
+    #[test]
+    fn test_cbuf_roundtrip_binary_data() {
+        // Interior NULs and invalid UTF-8 are fine for the byte-oriented API
+        let data: Vec<u8> = (0..50_000u32).map(|i| (i % 256) as u8).chain([0, 0xFF, 0xFE, 0]).collect();
+        for codec in CODECS {
+            let compressed = compress(codec, &data).unwrap();
+            let restored = decompress(codec, &compressed).unwrap();
+            assert_eq!(&restored[..], &data[..], "{:?}", codec);
+        }
+    }
+
+    #[test]
+    fn test_cbuf_matches_string_wrappers() {
+        let text = "the same bytes as the string API ".repeat(100);
+        assert_eq!(&compress(Codec::Zlib, text.as_bytes()).unwrap()[..], &compress_rust_string(&text).unwrap()[..]);
+        assert_eq!(&compress(Codec::Lz4, text.as_bytes()).unwrap()[..], &compress_rust_string_lz4(&text).unwrap()[..]);
+        assert_eq!(&compress(Codec::Zstd, text.as_bytes()).unwrap()[..], &compress_rust_string_zstd(&text).unwrap()[..]);
+    }
+
+    #[test]
+    fn test_cbuf_empty_input() {
+        for codec in CODECS {
+            let compressed = compress(codec, b"").unwrap();
+            let restored = decompress(codec, &compressed).unwrap();
+            assert!(restored.is_empty(), "{:?}", codec);
+        }
+    }
+
+    #[test]
+    fn test_into_variants_reuse_buffer() {
+        let mut compressed = Vec::new();
+        let mut restored = Vec::new();
+        for codec in CODECS {
+            for payload in [&b"short"[..], &[7u8; 100_000][..], &b""[..]] {
+                let n = compress_into(codec, payload, &mut compressed).unwrap();
+                assert_eq!(n, compressed.len());
+                assert_eq!(&compressed[..], &compress(codec, payload).unwrap()[..]);
+                decompress_into(codec, &compressed, &mut restored).unwrap();
+                assert_eq!(&restored[..], payload, "{:?}", codec);
+            }
+        }
+    }
+
+    #[test]
+    fn test_cbuf_rejects_corrupt_input() {
+        for codec in CODECS {
+            assert!(decompress(codec, &[0x05, 0xFF, 0xFF]).is_err(), "{:?}", codec);
+            let mut out = Vec::new();
+            assert!(decompress_into(codec, &[0x05, 0xFF, 0xFF], &mut out).is_err(), "{:?}", codec);
+        }
+    }
+}
+
+#[cfg(test)]
+mod varint_array_tests {
+    use super::*;
+
+    // Deterministic mix of 1-10 byte values with runs of small ones
+    fn sample_values(n: usize) -> Vec<u64> {
+        let mut state = 0x9E3779B97F4A7C15u64;
+        (0..n)
+            .map(|i| {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                match i % 7 {
+                    0..=2 => state % 128,
+                    3 => state % 16384,
+                    4 => state >> (state % 64),
+                    5 => u64::MAX - (state % 3),
+                    _ => 1u64 << (state % 64),
+                }
+            })
+            .collect()
+    }
+
+    fn scalar_encode(values: &[u64]) -> Vec<u8> {
+        values.iter().flat_map(|&v| encode_varint_rust(v).unwrap()).collect()
+    }
+
+    #[test]
+    fn test_encode_matches_single_value_encoder() {
+        for n in [0usize, 1, 7, 8, 15, 16, 33, 1000, 10_000] {
+            let values = sample_values(n);
+            assert_eq!(encode_varint_array_rust(&values), scalar_encode(&values), "n = {}", n);
+        }
+        let small: Vec<u64> = (0..1000).map(|i| i % 128).collect();
+        assert_eq!(encode_varint_array_rust(&small), scalar_encode(&small));
+    }
+
+    #[test]
+    fn test_decode_roundtrip() {
+        for n in [1usize, 16, 31, 32, 33, 64, 10_000] {
+            let values = sample_values(n);
+            let encoded = scalar_encode(&values);
+            let (decoded, used) = decode_varint_array_rust(&encoded, n).unwrap();
+            assert_eq!(decoded, values, "n = {} on {}", n, varint_array_kernel_name());
+            assert_eq!(used, encoded.len());
+        }
+        // Pure single-byte runs exercise the vector path end to end
+        let small: Vec<u64> = (0..4096).map(|i| (i * 37) % 128).collect();
+        let (decoded, _) = decode_varint_array_rust(&scalar_encode(&small), small.len()).unwrap();
+        assert_eq!(decoded, small);
+    }
+
+    #[test]
+    fn test_decode_matches_scalar_reference() {
+        let values = sample_values(5000);
+        let encoded = scalar_encode(&values);
+        let mut fast = vec![0u64; values.len()];
+        let mut reference = vec![0u64; values.len()];
+        let (mut fast_len, mut ref_len) = (0usize, 0usize);
+        unsafe {
+            assert_eq!(decode_varint_array(encoded.as_ptr() as *const c_char, encoded.len(), fast.as_mut_ptr(), values.len(), &mut fast_len), CODEC_OK);
+            assert_eq!(decode_varint_array_scalar(encoded.as_ptr() as *const c_char, encoded.len(), reference.as_mut_ptr(), values.len(), &mut ref_len), CODEC_OK);
+        }
+        assert_eq!(fast, reference);
+        assert_eq!(fast_len, ref_len);
+    }
+
+    #[test]
+    fn test_decode_stops_after_count() {
+        let encoded = scalar_encode(&[300, 5, 70000, 1]);
+        let (decoded, used) = decode_varint_array_rust(&encoded, 2).unwrap();
+        assert_eq!(decoded, vec![300, 5]);
+        assert_eq!(used, 3);
+    }
+
+    #[test]
+    fn test_decode_rejects_malformed() {
+        // Truncated: continuation bit on the last byte
+        assert!(decode_varint_array_rust(&[0x81, 0x80], 1).is_err());
+        // More values requested than present
+        let mut many = vec![1u8; 40];
+        assert!(decode_varint_array_rust(&many, 41).is_err());
+        many[39] = 0x80;
+        assert!(decode_varint_array_rust(&many, 40).is_err(), "truncated after a single-byte run");
+        // 11-byte varint is rejected just like decode_varint_rust
+        let overlong = [0xFFu8; 11];
+        assert!(decode_varint_array_rust(&overlong, 1).is_err());
+        assert!(decode_varint_rust(&overlong).is_err());
+        // A 10-byte varint is accepted by both decoders with the same value
+        let ten = [0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F];
+        assert_eq!(decode_varint_array_rust(&ten, 1).unwrap().0[0], decode_varint_rust(&ten).unwrap().0);
+    }
+
+    #[test]
+    fn test_kernel_name_is_reported() {
+        assert!(["avx2+bmi2", "sse2", "neon", "word"].contains(&varint_array_kernel_name()));
+    }
+}
+
+#[cfg(test)]
+mod streamvbyte_tests {
+    use super::*;
+
+    const ALL_FLAGS: [i32; 4] = [0, STREAMVBYTE_DELTA, STREAMVBYTE_ZIGZAG, STREAMVBYTE_DELTA | STREAMVBYTE_ZIGZAG];
+
+    fn sample_values(n: usize) -> Vec<u32> {
+        let mut state = 0x1234_5678u32;
+        (0..n)
+            .map(|i| {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                match i % 4 {
+                    0 => state % 200,
+                    1 => state % 70_000,
+                    2 => state % 20_000_000,
+                    _ => state,
+                }
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_streamvbyte_roundtrip_all_flags() {
+        for n in [0usize, 1, 3, 4, 5, 17, 1000, 4099] {
+            let values = sample_values(n);
+            for flags in ALL_FLAGS {
+                let encoded = streamvbyte_encode_rust(&values, flags);
+                let (decoded, used) = streamvbyte_decode_rust(&encoded, n, flags).unwrap();
+                assert_eq!(decoded, values, "n = {}, flags = {}", n, flags);
+                assert_eq!(used, encoded.len());
+            }
+        }
+    }
+
+    #[test]
+    fn test_streamvbyte_layout() {
+        // 1, 2, 3 and 4 byte values: control byte 0b11_10_01_00, then little-endian data
+        let encoded = streamvbyte_encode_rust(&[0x01, 0x0203, 0x040506, 0x0708090A], 0);
+        assert_eq!(encoded, vec![0xE4, 0x01, 0x03, 0x02, 0x06, 0x05, 0x04, 0x0A, 0x09, 0x08, 0x07]);
+    }
+
+    #[test]
+    fn test_delta_shrinks_sorted_input() {
+        let sorted: Vec<u32> = (0..10_000u32).map(|i| 1_000_000 + i * 3).collect();
+        let plain = streamvbyte_encode_rust(&sorted, 0);
+        let delta = streamvbyte_encode_rust(&sorted, STREAMVBYTE_DELTA);
+        assert!(delta.len() < plain.len() / 2, "{} vs {}", delta.len(), plain.len());
+        assert_eq!(streamvbyte_decode_rust(&delta, sorted.len(), STREAMVBYTE_DELTA).unwrap().0, sorted);
+    }
+
+    #[test]
+    fn test_zigzag_keeps_small_negatives_short() {
+        let signed: Vec<i32> = (-500..500).collect();
+        let as_u32: Vec<u32> = signed.iter().map(|&v| v as u32).collect();
+        let zigzag = streamvbyte_encode_rust(&as_u32, STREAMVBYTE_ZIGZAG);
+        let plain = streamvbyte_encode_rust(&as_u32, 0);
+        assert!(zigzag.len() < plain.len());
+        let (decoded, _) = streamvbyte_decode_rust(&zigzag, as_u32.len(), STREAMVBYTE_ZIGZAG).unwrap();
+        let decoded: Vec<i32> = decoded.iter().map(|&v| v as i32).collect();
+        assert_eq!(decoded, signed);
+    }
+
+    #[test]
+    fn test_simd_matches_scalar_reference() {
+        let values = sample_values(10_001);
+        for flags in ALL_FLAGS {
+            let encoded = streamvbyte_encode_rust(&values, flags);
+            let mut fast = vec![0u32; values.len()];
+            let mut reference = vec![0u32; values.len()];
+            let (mut a, mut b) = (0usize, 0usize);
+            unsafe {
+                assert_eq!(streamvbyte_decode(encoded.as_ptr() as *const c_char, encoded.len(), fast.as_mut_ptr(), values.len(), flags, &mut a), CODEC_OK);
+                assert_eq!(streamvbyte_decode_scalar(encoded.as_ptr() as *const c_char, encoded.len(), reference.as_mut_ptr(), values.len(), flags, &mut b), CODEC_OK);
+            }
+            assert_eq!(fast, reference);
+            assert_eq!(a, b);
+        }
+    }
+
+    #[test]
+    fn test_streamvbyte_rejects_truncated() {
+        let values = sample_values(100);
+        let encoded = streamvbyte_encode_rust(&values, 0);
+        for cut in [0, 10, encoded.len() / 2, encoded.len() - 1] {
+            assert!(streamvbyte_decode_rust(&encoded[..cut], values.len(), 0).is_err(), "cut at {}", cut);
+        }
+    }
+}
+
+#[cfg(test)]
+mod pfor_tests {
+    use super::*;
+
+    const ALL_FLAGS: [i32; 4] = [0, PFOR_DELTA, PFOR_ZIGZAG, PFOR_DELTA | PFOR_ZIGZAG];
+
+    // Timestamp-like column: small steps with an occasional large gap
+    fn timestamps(n: usize) -> Vec<u64> {
+        let mut state = 0x9E37_79B9_7F4A_7C15u64;
+        let mut t = 1_700_000_000_000u64;
+        (0..n)
+            .map(|i| {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                t += if i % 97 == 0 { state % 10_000_000 } else { state % 50 };
+                t
+            })
+            .collect()
+    }
+
+    fn mixed(n: usize) -> Vec<u64> {
+        let mut state = 0x2545_F491_4F6C_DD1Du64;
+        (0..n)
+            .map(|_| {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                state >> (state % 64)
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_pfor_roundtrip_all_flags() {
+        for n in [0usize, 1, 127, 128, 129, 256, 1000, 4099] {
+            for values in [timestamps(n), mixed(n), vec![u64::MAX; n], vec![0; n]] {
+                for flags in ALL_FLAGS {
+                    let encoded = pfor_encode_rust(&values, flags);
+                    assert!(encoded.len() <= unsafe { pfor_bound(n) });
+                    let (decoded, used) = pfor_decode_rust(&encoded, n, flags).unwrap();
+                    assert_eq!(decoded, values, "n = {}, flags = {}", n, flags);
+                    assert_eq!(used, encoded.len());
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_pfor_exceptions_keep_blocks_narrow() {
+        // One outlier per block costs a few bytes instead of widening every value
+        let mut values: Vec<u64> = (0..1024u64).map(|i| 1000 + i % 16).collect();
+        for i in (0..1024).step_by(128) {
+            values[i + 5] = 1 << 40;
+        }
+        let encoded = pfor_encode_rust(&values, 0);
+        assert!(encoded.len() < 8 * (16 * 4 + 16), "{} bytes", encoded.len());
+        assert_eq!(pfor_decode_rust(&encoded, values.len(), 0).unwrap().0, values);
+    }
+
+    #[test]
+    fn test_pfor_beats_leb128_on_timestamps() {
+        let values = timestamps(1 << 14);
+        let encoded = pfor_encode_rust(&values, PFOR_DELTA);
+        let mut prev = 0u64;
+        let leb: usize = values
+            .iter()
+            .map(|&v| {
+                let d = v - prev;
+                prev = v;
+                encode_varint_rust(d).unwrap().len()
+            })
+            .sum();
+        assert!(encoded.len() < leb, "{} vs leb128 {}", encoded.len(), leb);
+    }
+
+    #[test]
+    fn test_pfor_simd_matches_scalar_reference() {
+        let values = mixed(10_001);
+        for flags in ALL_FLAGS {
+            let encoded = pfor_encode_rust(&values, flags);
+            let mut fast = vec![0u64; values.len()];
+            let mut reference = vec![0u64; values.len()];
+            let (mut a, mut b) = (0usize, 0usize);
+            unsafe {
+                assert_eq!(pfor_decode(encoded.as_ptr() as *const c_char, encoded.len(), fast.as_mut_ptr(), values.len(), flags, &mut a), CODEC_OK);
+                assert_eq!(pfor_decode_scalar(encoded.as_ptr() as *const c_char, encoded.len(), reference.as_mut_ptr(), values.len(), flags, &mut b), CODEC_OK);
+            }
+            assert_eq!(fast, reference);
+            assert_eq!(fast, values);
+            assert_eq!(a, b);
+        }
+    }
+
+    #[test]
+    fn test_pfor_rejects_truncated_and_corrupt() {
+        let values = timestamps(300);
+        let encoded = pfor_encode_rust(&values, PFOR_DELTA);
+        for cut in [0, 1, 10, encoded.len() / 2, encoded.len() - 1] {
+            assert!(pfor_decode_rust(&encoded[..cut], values.len(), PFOR_DELTA).is_err(), "cut at {}", cut);
+        }
+        // Bit width byte follows the first block's base varint
+        let base_len = {
+            let (_, used) = decode_varint_rust(&encoded).unwrap();
+            used
+        };
+        let mut bad = encoded.clone();
+        bad[base_len] = 33;
+        assert!(pfor_decode_rust(&bad, values.len(), PFOR_DELTA).is_err());
+        let mut bad = encoded.clone();
+        bad[base_len + 1] = 129;
+        assert!(pfor_decode_rust(&bad, values.len(), PFOR_DELTA).is_err());
+    }
+}
+
 #[cfg(test)]
 mod reproduce_fuzzing_bug {
     use super::*;